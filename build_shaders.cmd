@@ -16,7 +16,14 @@ set OUTDIR=bin\data\shaders
 
 mkdir %OUTDIR% > NUL
 fxc shaders\tex2vid.hlsl %CS_FXCOPTS% /D AV_PIX_FMT_NV12=1 /Fo %OUTDIR%\convert_nv12
+fxc shaders\tex2vid.hlsl %CS_FXCOPTS% /D AV_PIX_FMT_YUV420P=1 /Fo %OUTDIR%\convert_yuv420
 fxc shaders\tex2vid.hlsl %CS_FXCOPTS% /D AV_PIX_FMT_YUV422P=1 /Fo %OUTDIR%\convert_yuv422
+fxc shaders\tex2vid.hlsl %CS_FXCOPTS% /D AV_PIX_FMT_YUV422P10LE=1 /Fo %OUTDIR%\convert_yuv422_10
 fxc shaders\tex2vid.hlsl %CS_FXCOPTS% /D AV_PIX_FMT_YUV444P=1 /Fo %OUTDIR%\convert_yuv444
+fxc shaders\tex2vid.hlsl %CS_FXCOPTS% /D AV_PIX_FMT_RGBA=1 /Fo %OUTDIR%\convert_rgba
+fxc shaders\tex2vid.hlsl %CS_FXCOPTS% /D AV_PIX_FMT_GBRPF32LE=1 /Fo %OUTDIR%\convert_gbrpf32
 fxc shaders\motion_sample.hlsl %CS_FXCOPTS% /Fo %OUTDIR%\mosample
 fxc shaders\downsample.hlsl %CS_FXCOPTS% /Fo %OUTDIR%\downsample
+fxc shaders\scale.hlsl %CS_FXCOPTS% /D SCALE_FILTER_BOX=1 /Fo %OUTDIR%\scale_box
+fxc shaders\scale.hlsl %CS_FXCOPTS% /D SCALE_FILTER_BILINEAR=1 /Fo %OUTDIR%\scale_bilinear
+fxc shaders\scale.hlsl %CS_FXCOPTS% /D SCALE_FILTER_LANCZOS=1 /Fo %OUTDIR%\scale_lanczos
@@ -0,0 +1,111 @@
+// This file is intended to be compiled into many resulting shaders.
+// Purpose of these are to downscale the game texture to the movie resolution before converting to a video pixel format.
+// Scaling is separable, so this runs twice. The first pass scales horizontally and the second pass scales vertically.
+// The filtering is done in the same gamma space as the game texture, like most video scalers do.
+
+// #define SCALE_FILTER_BOX 1
+// #define SCALE_FILTER_BILINEAR 1
+// #define SCALE_FILTER_LANCZOS 1
+
+Texture2D<float4> input_texture : register(t0);
+RWTexture2D<float4> output_texture : register(u0);
+
+// --------------------------------------------------------------------------------------------------------------------
+
+#define PI 3.14159265f
+
+#if SCALE_FILTER_BOX
+
+// Area average of all source pixels covered by the destination pixel.
+
+#define KERNEL_RADIUS 0.5f
+
+float kernel_weight(float x)
+{
+    return abs(x) <= 0.5f ? 1.0f : 0.0f;
+}
+
+#elif SCALE_FILTER_BILINEAR
+
+// Triangle filter widened by the scale ratio, so this does not alias like a plain bilinear fetch would.
+
+#define KERNEL_RADIUS 1.0f
+
+float kernel_weight(float x)
+{
+    return max(1.0f - abs(x), 0.0f);
+}
+
+#elif SCALE_FILTER_LANCZOS
+
+// Lanczos with 3 lobes. Sharpest of the filters but may ring slightly around hard edges.
+
+#define KERNEL_RADIUS 3.0f
+
+float kernel_weight(float x)
+{
+    x = abs(x);
+
+    if (x < 0.0001f)
+    {
+        return 1.0f;
+    }
+
+    if (x >= KERNEL_RADIUS)
+    {
+        return 0.0f;
+    }
+
+    float px = PI * x;
+    return (KERNEL_RADIUS * sin(px) * sin(px / KERNEL_RADIUS)) / (px * px);
+}
+
+#endif
+
+// --------------------------------------------------------------------------------------------------------------------
+
+// This must be synchronized with the compute shader Dispatch call in CPU code!
+[numthreads(8, 8, 1)]
+void main(uint3 dtid : SV_DispatchThreadID)
+{
+    uint2 input_size;
+    uint2 output_size;
+    input_texture.GetDimensions(input_size.x, input_size.y);
+    output_texture.GetDimensions(output_size.x, output_size.y);
+
+    if (dtid.x >= output_size.x || dtid.y >= output_size.y)
+    {
+        return;
+    }
+
+    // The first pass keeps the height and the second pass keeps the width.
+    // If neither axis is scaled this just becomes a copy.
+    bool horizontal = input_size.y == output_size.y;
+
+    uint input_length = horizontal ? input_size.x : input_size.y;
+    uint output_length = horizontal ? output_size.x : output_size.y;
+    uint pos = horizontal ? dtid.x : dtid.y;
+
+    float ratio = (float)input_length / (float)output_length;
+    float center = ((float)pos + 0.5f) * ratio;
+    float radius = KERNEL_RADIUS * ratio;
+
+    int first = max((int)floor(center - radius), 0);
+    int last = min((int)ceil(center + radius), (int)input_length - 1);
+
+    float4 sum = 0.0f;
+    float weight_sum = 0.0f;
+
+    for (int i = first; i <= last; i++)
+    {
+        float weight = kernel_weight(((float)i + 0.5f - center) / ratio);
+
+        int2 source_pos = horizontal ? int2(i, dtid.y) : int2(dtid.x, i);
+
+        sum += input_texture.Load(int3(source_pos, 0)) * weight;
+        weight_sum += weight;
+    }
+
+    // Lanczos has negative lobes so the result can go slightly outside of the valid range.
+    output_texture[dtid.xy] = saturate(sum / weight_sum);
+}
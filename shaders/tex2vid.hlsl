@@ -12,7 +12,8 @@ Texture2D<float4> input_texture : register(t0);
 
 // --------------------------------------------------------------------------------------------------------------------
 
-uint3 convert_rgb_to_yuv(float3 rgb)
+// Result is in the 8 bit range (0 to 255).
+float3 convert_rgb_to_yuv_float(float3 rgb)
 {
     rgb = rgb * 255.0f;
 
@@ -20,7 +21,7 @@ uint3 convert_rgb_to_yuv(float3 rgb)
     // This number comes from the partial MPEG range. We don't add 16.0 / 255.0 to this.
     rgb /= 1.164383;
 
-    uint3 ret;
+    float3 ret;
 
     #if AVCOL_SPC_BT709
     ret.x = 16  + (rgb.x * +0.212600) + (rgb.y * +0.715200) + (rgb.z * +0.072200);
@@ -35,6 +36,17 @@ uint3 convert_rgb_to_yuv(float3 rgb)
     return ret;
 }
 
+uint3 convert_rgb_to_yuv(float3 rgb)
+{
+    return uint3(convert_rgb_to_yuv_float(rgb));
+}
+
+// Same as above but in the 10 bit range (0 to 1023).
+uint3 convert_rgb_to_yuv_10(float3 rgb)
+{
+    return uint3(convert_rgb_to_yuv_float(rgb) * 4.0f);
+}
+
 // --------------------------------------------------------------------------------------------------------------------
 
 #if AV_PIX_FMT_NV12
@@ -58,6 +70,29 @@ void proc(uint3 dtid)
 
 // --------------------------------------------------------------------------------------------------------------------
 
+#if AV_PIX_FMT_YUV420P
+
+// The first plane is as large as the source material.
+// The second and third planes are half in size in both directions.
+// Used by libx265, libsvtav1 and ffv1.
+
+RWTexture2D<uint> output_texture_y : register(u0);
+RWTexture2D<uint> output_texture_u : register(u1);
+RWTexture2D<uint> output_texture_v : register(u2);
+
+void proc(uint3 dtid)
+{
+    float4 pix = input_texture.Load(dtid);
+    uint3 yuv = convert_rgb_to_yuv(pix.xyz);
+    output_texture_y[dtid.xy] = yuv.x;
+    output_texture_u[dtid.xy >> 1] = yuv.y;
+    output_texture_v[dtid.xy >> 1] = yuv.z;
+}
+
+#endif
+
+// --------------------------------------------------------------------------------------------------------------------
+
 #if AV_PIX_FMT_YUV422P
 
 // The first plane is as large as the source material.
@@ -81,6 +116,28 @@ void proc(uint3 dtid)
 
 // --------------------------------------------------------------------------------------------------------------------
 
+#if AV_PIX_FMT_YUV422P10LE
+
+// Same as AV_PIX_FMT_YUV422P but with 10 bits in every 16 bit sample.
+// Used by prores.
+
+RWTexture2D<uint> output_texture_y : register(u0);
+RWTexture2D<uint> output_texture_u : register(u1);
+RWTexture2D<uint> output_texture_v : register(u2);
+
+void proc(uint3 dtid)
+{
+    float4 pix = input_texture.Load(dtid);
+    uint3 yuv = convert_rgb_to_yuv_10(pix.xyz);
+    output_texture_y[dtid.xy] = yuv.x;
+    output_texture_u[int2(dtid.x >> 1, dtid.y)] = yuv.y;
+    output_texture_v[int2(dtid.x >> 1, dtid.y)] = yuv.z;
+}
+
+#endif
+
+// --------------------------------------------------------------------------------------------------------------------
+
 #if AV_PIX_FMT_YUV444P
 
 // Every plane is as big as the source material.
@@ -102,6 +159,54 @@ void proc(uint3 dtid)
 
 // --------------------------------------------------------------------------------------------------------------------
 
+#if AV_PIX_FMT_RGBA
+
+// Single plane with the color channels as they are.
+// The game texture is BGRA, and is not always opaque, so alpha is set to be fully opaque.
+// Used by png and tiff.
+
+RWTexture2D<uint4> output_texture_rgba : register(u0);
+
+void proc(uint3 dtid)
+{
+    float4 pix = input_texture.Load(dtid);
+    output_texture_rgba[dtid.xy] = uint4(round(saturate(pix.xyz) * 255.0f), 255);
+}
+
+#endif
+
+// --------------------------------------------------------------------------------------------------------------------
+
+#if AV_PIX_FMT_GBRPF32LE
+
+// Every plane is as big as the source material, in the order of green, blue and red.
+// Float images are expected to be in linear light, so the sRGB curve of the game is removed.
+// Used by exr.
+
+RWTexture2D<float> output_texture_g : register(u0);
+RWTexture2D<float> output_texture_b : register(u1);
+RWTexture2D<float> output_texture_r : register(u2);
+
+float3 convert_srgb_to_linear(float3 rgb)
+{
+    float3 lo = rgb / 12.92f;
+    float3 hi = pow(max((rgb + 0.055f) / 1.055f, 0.0f), 2.4f);
+    return rgb <= 0.04045f ? lo : hi;
+}
+
+void proc(uint3 dtid)
+{
+    float4 pix = input_texture.Load(dtid);
+    float3 rgb = convert_srgb_to_linear(pix.xyz);
+    output_texture_g[dtid.xy] = rgb.y;
+    output_texture_b[dtid.xy] = rgb.z;
+    output_texture_r[dtid.xy] = rgb.x;
+}
+
+#endif
+
+// --------------------------------------------------------------------------------------------------------------------
+
 // This must be synchronized with the compute shader Dispatch call in CPU code!
 [numthreads(8, 8, 1)]
 void main(uint3 dtid : SV_DispatchThreadID)
@@ -1,18 +1,143 @@
 #pragma once
 #include "svr_common.h"
+#include "svr_handoff.h"
+#include <string.h>
+
+// Spool files have the movie parameters and are read outside of Windows too, see svr_spool.h.
+#ifndef _WIN32
+#include <strings.h>
+#define _strnicmp strncasecmp
+#endif
 
 // Shared stuff between svr_game and svr_encoder.
 
 // All Windows handles only use 32 bits of data, so we can safely refer to them in here as u32 with _h in the name.
 // https://learn.microsoft.com/en-us/windows/win32/winprog64/interprocess-communication
 
-const s32 ENCODER_MAX_SAMPLES = 4096; // How many samples can be stored at most in the buffer placed at audio_buffer_offset.
+const s32 ENCODER_MAX_SAMPLES = 4096; // How many samples svr_encoder processes at once.
+const s32 ENCODER_MAX_SHARED_SAMPLES = 65536; // How many samples can be stored at most in the buffer placed at audio_buffer_offset. More than a second of audio.
+const s32 ENCODER_MAX_PIPE_TARGET = 512; // Max length of the command or named pipe that the movie can be written to.
+
+// Segmented movies have a checkpoint next to them with this extension, written by svr_encoder every time a segment is complete.
+// It is an ini file with these keys:
+// segment: The first segment that is not complete. A resumed movie writes this segment again.
+// demo_tick: Demo tick of the first frame of that segment, which the demo must be at when resuming.
+// video_frame: Number of the first frame of that segment.
+// audio_samples: Number of audio samples before that segment.
+// manifest_size: Size of the segment list without that segment.
+// video_fps, video_encoder: Must be the same for the segments to be joined.
+#define ENCODER_CHECKPOINT_EXT "svrresume"
+
+// Live preview of the movie, written by svr_encoder when preview_interval is set in the movie profile.
+// Other programs can open the shared memory named ENCODER_PREVIEW_MAPPING followed by the process id of the game
+// (or of svr_encoder when there is no game) to show the movie while it is rendering, without the game presenting anything.
+// The memory is an EncoderPreviewMem. Read the slot in latest_slot, and only use the image if the sequence of the slot
+// was the same even number before and after copying it.
+#define ENCODER_PREVIEW_MAPPING "Local\\svr_preview_"
+const s32 ENCODER_PREVIEW_SLOTS = 4;
+const s32 ENCODER_PREVIEW_MAX_SIZE = 1024 * 1024;
 
 // Identifiers used by the DXGI lock for synchronizing with the shared texture.
 // You need to specify which device to give access to, so that's what these are.
 const s32 ENCODER_GAME_ID = 0;
 const s32 ENCODER_PROC_ID = 1;
 
+// Video encoders that can be selected with video_encoder in the movie profile.
+// This is the only list of them. svr_game takes the names and containers from here, and svr_encoder has the codec settings
+// for every id in RENDER_VIDEO_INFOS in encoder_render.cpp.
+// X(id, name in the movie profile, containers)
+// The containers are the file extensions that can be used, separated by spaces.
+#define ENCODER_VIDEO_ENCODERS(X) \
+    X(ENCODER_VIDEO_LIBX264, "libx264", "mp4 mkv mov") \
+    X(ENCODER_VIDEO_LIBX264_444, "libx264_444", "mp4 mkv mov") \
+    X(ENCODER_VIDEO_LIBX265, "libx265", "mp4 mkv mov") \
+    X(ENCODER_VIDEO_LIBSVTAV1, "libsvtav1", "mp4 mkv") \
+    X(ENCODER_VIDEO_DNXHR, "dnxhr", "mkv mov") \
+    X(ENCODER_VIDEO_PRORES, "prores", "mkv mov") \
+    X(ENCODER_VIDEO_FFV1, "ffv1", "mkv") \
+    X(ENCODER_VIDEO_UTVIDEO, "utvideo", "mkv") \
+    X(ENCODER_VIDEO_RAWVIDEO, "rawvideo", "nut y4m") \
+    X(ENCODER_VIDEO_RAWVIDEO_444, "rawvideo_444", "nut y4m") \
+    X(ENCODER_VIDEO_PNG, "png", "png") \
+    X(ENCODER_VIDEO_TIFF, "tiff", "tif tiff") \
+    X(ENCODER_VIDEO_EXR, "exr", "exr")
+
+#define ENCODER_VIDEO_ENCODER_ID(ID, NAME, CONTAINERS) ID,
+
+using EncoderVideoEncoder = s32;
+
+enum // EncoderVideoEncoder
+{
+    ENCODER_VIDEO_ENCODERS(ENCODER_VIDEO_ENCODER_ID)
+    ENCODER_NUM_VIDEO_ENCODERS,
+};
+
+#undef ENCODER_VIDEO_ENCODER_ID
+
+// If a file extension (without the dot) is in the container list of an encoder above.
+inline bool encoder_has_container(const char* containers, const char* ext)
+{
+    s32 ext_len = (s32)strlen(ext);
+
+    while (*containers)
+    {
+        const char* end = strchr(containers, ' ');
+        s32 len = end ? (s32)(end - containers) : (s32)strlen(containers);
+
+        if (len == ext_len && !_strnicmp(containers, ext, len))
+        {
+            return true;
+        }
+
+        containers += end ? len + 1 : len;
+    }
+
+    return false;
+}
+
+// Audio encoders that can be selected with audio_encoder in the movie profile.
+// This is the only list of them. svr_game takes the names from here, and svr_encoder has the codec settings
+// for every id in RENDER_AUDIO_INFOS in encoder_render.cpp.
+// X(id, name in the movie profile)
+#define ENCODER_AUDIO_ENCODERS(X) \
+    X(ENCODER_AUDIO_AAC, "aac") \
+    X(ENCODER_AUDIO_PCM, "pcm") \
+    X(ENCODER_AUDIO_FLAC, "flac") \
+    X(ENCODER_AUDIO_OPUS, "opus")
+
+#define ENCODER_AUDIO_ENCODER_ID(ID, NAME) ID,
+
+using EncoderAudioEncoder = s32;
+
+enum // EncoderAudioEncoder
+{
+    ENCODER_AUDIO_ENCODERS(ENCODER_AUDIO_ENCODER_ID)
+    ENCODER_NUM_AUDIO_ENCODERS,
+};
+
+#undef ENCODER_AUDIO_ENCODER_ID
+
+// Filters that can be selected with video_scale_filter in the movie profile to downscale the movie.
+// This is the only list of them. svr_game takes the names from here, and svr_encoder has the compute shader
+// for every id in VID_SCALE_FILTERS in encoder_video.cpp.
+// X(id, name in the movie profile)
+#define ENCODER_SCALE_FILTERS(X) \
+    X(ENCODER_SCALE_BOX, "box") \
+    X(ENCODER_SCALE_BILINEAR, "bilinear") \
+    X(ENCODER_SCALE_LANCZOS, "lanczos")
+
+#define ENCODER_SCALE_FILTER_ID(ID, NAME) ID,
+
+using EncoderScaleFilter = s32;
+
+enum // EncoderScaleFilter
+{
+    ENCODER_SCALE_FILTERS(ENCODER_SCALE_FILTER_ID)
+    ENCODER_NUM_SCALE_FILTERS,
+};
+
+#undef ENCODER_SCALE_FILTER_ID
+
 using EncoderSharedEvent = s32;
 
 enum // EncoderSharedEvent
@@ -22,6 +147,8 @@ enum // EncoderSharedEvent
     ENCODER_EVENT_STOP, // Rendering will stop. This event cannot fail.
     ENCODER_EVENT_NEW_VIDEO, // Texture at game_texture_h will have new data. This event can fail.
     ENCODER_EVENT_NEW_AUDIO, // New samples will be placed at audio_buffer_offset. This event can fail.
+    ENCODER_EVENT_NEW_FRAME, // Both of the above at once, with all audio since the last frame. There may be no samples. This event can fail.
+    ENCODER_EVENT_FINALIZE, // Waits until the stopped movies have been completely written. This event can fail.
 };
 
 struct EncoderSharedMovieParams
@@ -41,10 +168,58 @@ struct EncoderSharedMovieParams
     char audio_encoder[32];
     char x264_preset[32];
     char dnxhr_profile[32];
+    char x265_preset[32];
+    char prores_profile[32];
+    char scale_filter[32];
+    s32 output_width; // Same as video_width unless the movie should be downscaled.
+    s32 output_height; // Same as video_height unless the movie should be downscaled.
     s32 video_fps;
+    s32 video_threads; // Threads for the video encoder. 0 to let the encoder decide.
+    s32 video_queue_depth; // How many converted frames can be waiting on the GPU before they are downloaded.
+    u64 cpu_encoder_mask; // Logical processors the encoder may use. 0 to use all of them.
     s32 x264_crf;
     bool x264_intra;
+    s32 x265_crf;
+    s32 svtav1_crf;
+    s32 svtav1_preset;
     bool use_audio;
+    bool use_fragmented; // Write the container in pieces so the file is usable even if the movie is never finished.
+    bool use_spool; // Write the uncompressed video and audio to a spool file that is encoded later with svr_encoder --from-spool.
+    bool record_session; // Record all events of the movie to a session file that can be replayed with svr_encoder --replay.
+
+    // Command or named pipe that the container is written to instead of dest_file. Empty to write to dest_file.
+    // The extension of dest_file still decides the container.
+    char pipe_target[ENCODER_MAX_PIPE_TARGET];
+
+    // Split the movie into files of this length or size, cut on keyframes. 0 to not split on that.
+    // Files are named after dest_file with the segment number added, and are listed in a .ffconcat file.
+    s32 segment_seconds;
+    s32 segment_mb;
+
+    bool resume; // Continue a segmented movie from its checkpoint instead of starting over.
+
+    s32 expected_seconds; // Expected length of the movie, or 0 if not known. Used to allocate the movie file up front.
+
+    // Publish every this many frames as a small JPEG in the preview memory, see ENCODER_PREVIEW_MAPPING. 0 to not publish.
+    s32 preview_interval;
+    s32 preview_width;
+};
+
+// One JPEG image of the live preview.
+struct EncoderPreviewSlot
+{
+    SvrAtom32 sequence; // Odd while svr_encoder is writing the slot.
+    s32 width;
+    s32 height;
+    s32 size; // Size of the JPEG image in data.
+    s64 video_frame; // Movie frame that the image is from.
+    u8 data[ENCODER_PREVIEW_MAX_SIZE];
+};
+
+struct EncoderPreviewMem
+{
+    SvrAtom32 latest_slot; // Slot with the newest image, or -1 before the first image.
+    EncoderPreviewSlot slots[ENCODER_PREVIEW_SLOTS];
 };
 
 // Memory that is shared between the processes.
@@ -56,13 +231,20 @@ struct EncoderSharedMem
     u32 game_texture_h;
 
     // Pointer types have different sizes in 32-bit and 64-bit so we have to store the offsets from the base
-    // of the shared memory instead. The audio samples here are updated on ENCODER_EVENT_NEW_AUDIO.
+    // of the shared memory instead. The audio samples here are updated on ENCODER_EVENT_NEW_AUDIO and ENCODER_EVENT_NEW_FRAME.
     s32 audio_buffer_offset;
 
-    s32 waiting_audio_samples; // Set by svr_game to how many audio samples are waiting at audio_buffer_offset. Updated on ENCODER_EVENT_NEW_AUDIO.
+    s32 waiting_audio_samples; // Set by svr_game to how many audio samples are waiting at audio_buffer_offset. Updated on ENCODER_EVENT_NEW_AUDIO and ENCODER_EVENT_NEW_FRAME.
+
+    s32 demo_tick; // Demo tick of the frame, or -1 if not known. Updated on ENCODER_EVENT_NEW_VIDEO and ENCODER_EVENT_NEW_FRAME.
 
     u32 game_wake_event_h; // Event set by svr_encoder to wake svr_game up.
     u32 encoder_wake_event_h; // Event set by svr_game to wake svr_encoder up.
+
+    // The events above are only set if the other side is sleeping, see svr_handoff.h.
+    SvrHandoffChannel game_to_encoder; // Handoff from svr_game when an event should be handled.
+    SvrHandoffChannel encoder_to_game; // Handoff from svr_encoder when an event has been handled.
+
     u32 encoder_ready_event_h; // Event set by svr_encoder to notify svr_game the process is ready.
     u32 game_pid; // Game process id. Used by svr_encoder to know if the game exits so we don't get stuck.
 
@@ -11,6 +11,7 @@
 // 3) Call svr_start when movie production should start.
 // 4a) Call svr_frame for all frames where movie production is active.
 // 4b) Optionally call svr_give_velocity before svr_frame.
+// 4c) Optionally call svr_give_demo_tick before svr_frame so the movie can be resumed.
 // 5) Call svr_stop when movie production should stop.
 
 // Programming errors are printed to the debugger output (prefixed with "SVR (<function name>):").
@@ -30,7 +31,7 @@ extern "C"
 
 // To be increased when something in the interface changes. Internal DLL changes (svr_dll_version) does not have to up this.
 // The API must not be used if the DLL API version does not match the client header API version.
-const int32_t SVR_API_VERSION = 2;
+const int32_t SVR_API_VERSION = 6;
 
 struct IUnknown;
 struct IDirect3DSurface9;
@@ -56,6 +57,14 @@ struct SvrStartMovieData
 
     // Audio parameters that are being sent to svr_give_audio.
     SvrAudioParams audio_params;
+
+    // Set to 1 to continue a segmented movie from the checkpoint of an earlier render that did not finish.
+    // The demo must already be at the tick that svr_get_resume_point returns.
+    int32_t resume;
+
+    // Expected length of the movie in seconds, or 0 if not known.
+    // The movie file is allocated up front from this, so the file system does not have to find space for it while rendering.
+    int32_t expected_seconds;
 };
 
 struct SvrWaveSample
@@ -137,6 +146,13 @@ SVR_API int32_t svr_get_game_rate();
 
 SVR_API int32_t svr_get_video_frame_rate();
 
+// Returns how many frames at the rate of svr_get_game_rate the next game frame should cover. This is 1 unless motion blur is set to
+// skip the frames where the shutter is closed, in which case one longer frame replaces the frames that would not be used.
+// Call this after svr_frame, and when the value changes set the host_framerate console variable to this divided by svr_get_game_rate.
+// The value is for the frame after the next one, because the engine has already read host_framerate for the next frame when
+// console commands run. Audio must be given for the whole length of every frame.
+SVR_API int32_t svr_get_next_frame_length();
+
 // To be called when movie recording should stop. Can be in response to a console command or UI element or some automatic event.
 // Calling this function will stop movie production and calling svr_frame will not do anything.
 // The console variables mentioned in svr_start can be reset back to their previous value after this. Also the host_framerate console variable must be set back to 0.
@@ -171,6 +187,28 @@ SVR_API void svr_give_velocity(float* xyz);
 // Must be called before svr_frame.
 SVR_API void svr_give_buttons(SvrButtons buttons);
 
+// For resumable movies, call this to give the demo tick of the frame so it can be written to the checkpoint.
+// Must be called before svr_frame. Checkpoints are not written if this is never called.
+SVR_API void svr_give_demo_tick(int32_t tick);
+
+// Reads where a segmented movie that did not finish can be continued from.
+// Seek the demo to the tick and then call svr_start with resume set. The video frame is where the movie continues, which can be used for progress.
+// Returns false if the movie has no checkpoint.
+SVR_API bool svr_get_resume_point(const char* movie_name, int32_t* demo_tick, int64_t* video_frame);
+
+// Returns how many video frames were given to the encoder in the current or last movie. With motion blur this is fewer than the game frames.
+// Can be called after svr_stop to know how long the last movie became.
+SVR_API int64_t svr_get_video_frames();
+
+// Returns true if the encoder failed or exited during the current or last movie, in which case the movie is not complete.
+// The movie keeps going after a failure until svr_stop is called. Can be called after svr_stop to know if the last movie was finished.
+SVR_API bool svr_movie_failed();
+
+// The end of the movie file is written in the background after svr_stop, so the next movie can start right away.
+// Call this after svr_stop to block until the last movie has been completely written, such as when the file is handed on to something else.
+// Returns false if the file could not be finished, which will also make svr_movie_failed return true.
+SVR_API bool svr_wait_for_movie();
+
 // Give audio samples to write. This must be 2 channel 16 bit samples at 44100 hz.
 SVR_API void svr_give_audio(SvrWaveSample* samples, int32_t num_samples);
 
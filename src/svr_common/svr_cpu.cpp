@@ -0,0 +1,150 @@
+#include "svr_cpu.h"
+
+void svr_cpu_build_topology(SvrCpuSet* sets, s32 num_sets, u64 allowed_mask, SvrCpuTopology* topology)
+{
+    *topology = {};
+
+    for (s32 i = 0; i < num_sets; i++)
+    {
+        SvrCpuSet* set = &sets[i];
+
+        if (set->group != 0 || set->index < 0 || set->index >= 64 || !(allowed_mask & (1ULL << set->index)))
+        {
+            continue;
+        }
+
+        SvrCpuCore* core = NULL;
+
+        for (s32 j = 0; j < topology->num_cores; j++)
+        {
+            if (topology->cores[j].core_index == set->core_index)
+            {
+                core = &topology->cores[j];
+                break;
+            }
+        }
+
+        if (core == NULL)
+        {
+            if (topology->num_cores == SVR_CPU_MAX_CORES)
+            {
+                continue;
+            }
+
+            core = &topology->cores[topology->num_cores];
+            topology->num_cores++;
+
+            *core = {};
+            core->core_index = set->core_index;
+            core->efficiency_class = set->efficiency_class;
+        }
+
+        core->mask |= 1ULL << set->index;
+    }
+}
+
+bool svr_cpu_split_layout(SvrCpuTopology* topology, s32 game_cores, s32 max_game_cpu, SvrCpuLayout* layout)
+{
+    bool ret = false;
+
+    *layout = {};
+
+    for (s32 i = 0; i < game_cores; i++)
+    {
+        SvrCpuCore* best = NULL;
+
+        for (s32 j = 0; j < topology->num_cores; j++)
+        {
+            SvrCpuCore* core = &topology->cores[j];
+
+            if ((core->mask & layout->game_mask) || (max_game_cpu < 64 && core->mask >= (1ULL << max_game_cpu)))
+            {
+                continue;
+            }
+
+            if (best == NULL || core->efficiency_class >= best->efficiency_class)
+            {
+                best = core;
+            }
+        }
+
+        if (best == NULL)
+        {
+            goto rfail;
+        }
+
+        layout->game_mask |= best->mask;
+    }
+
+    for (s32 i = 0; i < topology->num_cores; i++)
+    {
+        layout->encoder_mask |= topology->cores[i].mask;
+    }
+
+    layout->encoder_mask &= ~layout->game_mask;
+
+    layout->num_game_cpus = svr_cpu_count(layout->game_mask);
+    layout->num_encoder_cpus = svr_cpu_count(layout->encoder_mask);
+
+    if (layout->num_encoder_cpus == 0)
+    {
+        goto rfail;
+    }
+
+    ret = true;
+    goto rexit;
+
+rfail:
+    *layout = {};
+
+rexit:
+    return ret;
+}
+
+s32 svr_cpu_count(u64 mask)
+{
+    s32 ret = 0;
+
+    while (mask)
+    {
+        mask &= mask - 1;
+        ret++;
+    }
+
+    return ret;
+}
+
+void svr_cpu_mask_to_string(u64 mask, char* buf, s32 buf_size)
+{
+    s32 len = 0;
+    buf[0] = 0;
+
+    for (s32 i = 0; i < 64; i++)
+    {
+        if (!(mask & (1ULL << i)))
+        {
+            continue;
+        }
+
+        s32 end = i;
+
+        while (end + 1 < 64 && (mask & (1ULL << (end + 1))))
+        {
+            end++;
+        }
+
+        const char* sep = len > 0 ? "," : "";
+
+        if (end > i)
+        {
+            len += stbsp_snprintf(buf + len, buf_size - len, "%s%d-%d", sep, i, end);
+        }
+
+        else
+        {
+            len += stbsp_snprintf(buf + len, buf_size - len, "%s%d", sep, i);
+        }
+
+        i = end;
+    }
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include "svr_common.h"
+
+// Division of the logical processors between the game and the encoder.
+// Only the first processor group is used, which has all processors on computers with up to 64 of them.
+// Reading the processors of the computer and setting the affinity is done with the Win32 API in svr_cpu_win32.cpp.
+// The rest only uses standard C so it can be tested outside of Windows.
+
+const s32 SVR_CPU_MAX_CORES = 64;
+
+struct SvrCpuLayout
+{
+    u64 game_mask; // Logical processors reserved for the game thread.
+    u64 encoder_mask; // Logical processors left for the encoder and its codec threads.
+    s32 num_game_cpus;
+    s32 num_encoder_cpus;
+};
+
+// A logical processor as the system describes it.
+struct SvrCpuSet
+{
+    s32 group;
+    s32 index; // Logical processor index in the group.
+    s32 core_index; // Physical core that the processor is on.
+    s32 efficiency_class; // Higher is faster.
+};
+
+struct SvrCpuCore
+{
+    s32 core_index;
+    s32 efficiency_class;
+    u64 mask; // All logical processors of this core.
+};
+
+// The physical cores of the first processor group.
+struct SvrCpuTopology
+{
+    SvrCpuCore cores[SVR_CPU_MAX_CORES];
+    s32 num_cores;
+};
+
+// Reserves all logical processors of this many physical cores for the game.
+// The fastest cores are reserved first, so the game gets the performance cores on hybrid processors.
+// Returns false if there would be no processors left for the encoder.
+bool svr_cpu_make_layout(s32 game_cores, SvrCpuLayout* layout);
+
+// Groups the logical processors into their physical cores.
+// Processors outside of the first group or outside of allowed_mask are left out.
+void svr_cpu_build_topology(SvrCpuSet* sets, s32 num_sets, u64 allowed_mask, SvrCpuTopology* topology);
+
+// The split of svr_cpu_make_layout. Only cores where every processor is below max_game_cpu can be reserved for the game.
+// Among equally fast cores the last one is picked, as the first core usually handles most of the interrupts.
+bool svr_cpu_split_layout(SvrCpuTopology* topology, s32 game_cores, s32 max_game_cpu, SvrCpuLayout* layout);
+
+s32 svr_cpu_count(u64 mask);
+
+// Writes the processors in the mask as ranges, such as 0-3,8.
+void svr_cpu_mask_to_string(u64 mask, char* buf, s32 buf_size);
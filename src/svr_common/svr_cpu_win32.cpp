@@ -0,0 +1,100 @@
+#include "svr_cpu.h"
+#include "svr_alloc.h"
+#include <Windows.h>
+
+// Reads the processors that this process can use from the cpu sets, which are the only place with the efficiency classes.
+static bool svr_cpu_read_topology(SvrCpuTopology* topology)
+{
+    bool ret = false;
+
+    SYSTEM_CPU_SET_INFORMATION* infos = NULL;
+    ULONG infos_size = 0;
+
+    SvrCpuSet* sets = NULL;
+    s32 num_sets = 0;
+
+    DWORD_PTR process_mask;
+    DWORD_PTR system_mask;
+    GetProcessAffinityMask(GetCurrentProcess(), &process_mask, &system_mask);
+
+    u64 allowed_mask = process_mask;
+
+    // A 32-bit process cannot see the processors above 32, but the encoder is 64-bit and can use them.
+    if (sizeof(DWORD_PTR) == 4)
+    {
+        allowed_mask |= 0xffffffff00000000ULL;
+    }
+
+    GetSystemCpuSetInformation(NULL, 0, &infos_size, GetCurrentProcess(), 0);
+
+    if (infos_size == 0)
+    {
+        goto rfail;
+    }
+
+    infos = (SYSTEM_CPU_SET_INFORMATION*)svr_alloc(infos_size);
+
+    if (!GetSystemCpuSetInformation(infos, infos_size, &infos_size, GetCurrentProcess(), 0))
+    {
+        goto rfail;
+    }
+
+    // Every entry is at least as large as the structure, so this is enough for all of them.
+    sets = (SvrCpuSet*)svr_alloc(sizeof(SvrCpuSet) * (infos_size / sizeof(SYSTEM_CPU_SET_INFORMATION) + 1));
+
+    // The entries can be of different sizes, so they must be walked by the size of each.
+    for (u8* ptr = (u8*)infos; ptr < (u8*)infos + infos_size; ptr += ((SYSTEM_CPU_SET_INFORMATION*)ptr)->Size)
+    {
+        SYSTEM_CPU_SET_INFORMATION* info = (SYSTEM_CPU_SET_INFORMATION*)ptr;
+
+        if (info->Type != CpuSetInformation)
+        {
+            continue;
+        }
+
+        SvrCpuSet* set = &sets[num_sets];
+        num_sets++;
+
+        set->group = info->CpuSet.Group;
+        set->index = info->CpuSet.LogicalProcessorIndex;
+        set->core_index = info->CpuSet.CoreIndex;
+        set->efficiency_class = info->CpuSet.EfficiencyClass;
+    }
+
+    svr_cpu_build_topology(sets, num_sets, allowed_mask, topology);
+
+    ret = true;
+    goto rexit;
+
+rfail:
+
+rexit:
+    if (infos)
+    {
+        svr_free(infos);
+    }
+
+    if (sets)
+    {
+        svr_free(sets);
+    }
+
+    return ret;
+}
+
+bool svr_cpu_make_layout(s32 game_cores, SvrCpuLayout* layout)
+{
+    SvrCpuTopology topology;
+
+    // The game is 32-bit, so it can only use the first 32 processors in an affinity mask.
+    const s32 max_game_cpu = 32;
+
+    *layout = {};
+
+    if (!svr_cpu_read_topology(&topology))
+    {
+        return false;
+    }
+
+    return svr_cpu_split_layout(&topology, game_cores, max_game_cpu, layout);
+}
@@ -0,0 +1,544 @@
+#include "svr_dem.h"
+#include "svr_alloc.h"
+#include <string.h>
+
+// Large demos go past what a long can hold on Windows.
+#ifdef _WIN32
+#define SVR_DEM_SEEK _fseeki64
+#define SVR_DEM_TELL _ftelli64
+#else
+#define SVR_DEM_SEEK fseeko
+#define SVR_DEM_TELL ftello
+#endif
+
+const char SVR_DEM_MAGIC[8] = { 'H', 'L', '2', 'D', 'E', 'M', 'O', 0 };
+const s32 SVR_DEM_HEADER_SIZE = 1072;
+
+const char SVR_DEM_INDEX_MAGIC[8] = { 'S', 'V', 'R', 'D', 'E', 'M', 'I', 'X' };
+const s32 SVR_DEM_INDEX_VERSION = 2;
+
+// Size of the view angles and origins in signon and packet messages. Demo protocol 4 has one for each split screen player.
+const s32 SVR_DEM_CMD_INFO_SIZE = 76;
+
+using SvrDemCmd = s32;
+
+enum // SvrDemCmd
+{
+    SVR_DEM_CMD_SIGNON = 1,
+    SVR_DEM_CMD_PACKET = 2,
+    SVR_DEM_CMD_SYNCTICK = 3,
+    SVR_DEM_CMD_CONSOLECMD = 4,
+    SVR_DEM_CMD_USERCMD = 5,
+    SVR_DEM_CMD_DATATABLES = 6,
+    SVR_DEM_CMD_STOP = 7,
+    SVR_DEM_CMD_CUSTOMDATA = 8, // Demo protocol 4 and later. String tables before that.
+    SVR_DEM_CMD_STRINGTABLES = 9, // Demo protocol 4 and later.
+};
+
+// Reads the demo with a plain FILE so the offsets are known without the file being loaded into memory.
+struct SvrDemReader
+{
+    FILE* file;
+    s64 offset;
+    s64 file_size;
+};
+
+// The demo is little endian, so read byte by byte to not depend on the host.
+static bool svr_dem_read_s32(SvrDemReader* reader, s32* value)
+{
+    u8 buf[4];
+
+    if (fread(buf, 1, 4, reader->file) != 4)
+    {
+        return false;
+    }
+
+    *value = (s32)((u32)buf[0] | ((u32)buf[1] << 8) | ((u32)buf[2] << 16) | ((u32)buf[3] << 24));
+    reader->offset += 4;
+
+    return true;
+}
+
+static bool svr_dem_read_u8(SvrDemReader* reader, u8* value)
+{
+    if (fread(value, 1, 1, reader->file) != 1)
+    {
+        return false;
+    }
+
+    reader->offset += 1;
+
+    return true;
+}
+
+static bool svr_dem_read_bytes(SvrDemReader* reader, void* dest, s32 size)
+{
+    if (fread(dest, 1, size, reader->file) != (size_t)size)
+    {
+        return false;
+    }
+
+    reader->offset += size;
+
+    return true;
+}
+
+static bool svr_dem_skip(SvrDemReader* reader, s64 size)
+{
+    if (size < 0 || reader->offset + size > reader->file_size)
+    {
+        return false;
+    }
+
+    if (SVR_DEM_SEEK(reader->file, size, SEEK_CUR) != 0)
+    {
+        return false;
+    }
+
+    reader->offset += size;
+
+    return true;
+}
+
+// Skips data that starts with its size.
+static bool svr_dem_skip_sized(SvrDemReader* reader)
+{
+    s32 size;
+
+    if (!svr_dem_read_s32(reader, &size))
+    {
+        return false;
+    }
+
+    return svr_dem_skip(reader, size);
+}
+
+static bool svr_dem_open(const char* path, SvrDemReader* reader)
+{
+    *reader = {};
+
+    reader->file = fopen(path, "rb");
+
+    if (reader->file == NULL)
+    {
+        return false;
+    }
+
+    SVR_DEM_SEEK(reader->file, 0, SEEK_END);
+    reader->file_size = SVR_DEM_TELL(reader->file);
+    SVR_DEM_SEEK(reader->file, 0, SEEK_SET);
+
+    return true;
+}
+
+static bool svr_dem_read_header(SvrDemReader* reader, SvrDemHeader* header)
+{
+    char magic[8];
+
+    *header = {};
+
+    if (reader->file_size < SVR_DEM_HEADER_SIZE)
+    {
+        return false;
+    }
+
+    bool ret = true;
+
+    ret &= svr_dem_read_bytes(reader, magic, sizeof(magic));
+    ret &= svr_dem_read_s32(reader, &header->demo_protocol);
+    ret &= svr_dem_read_s32(reader, &header->network_protocol);
+    ret &= svr_dem_read_bytes(reader, header->server_name, sizeof(header->server_name));
+    ret &= svr_dem_read_bytes(reader, header->client_name, sizeof(header->client_name));
+    ret &= svr_dem_read_bytes(reader, header->map_name, sizeof(header->map_name));
+    ret &= svr_dem_read_bytes(reader, header->game_dir, sizeof(header->game_dir));
+
+    s32 playback_time;
+    ret &= svr_dem_read_s32(reader, &playback_time);
+    memcpy(&header->playback_time, &playback_time, sizeof(float));
+
+    ret &= svr_dem_read_s32(reader, &header->ticks);
+    ret &= svr_dem_read_s32(reader, &header->frames);
+    ret &= svr_dem_read_s32(reader, &header->signon_length);
+
+    if (!ret || memcmp(magic, SVR_DEM_MAGIC, sizeof(magic)))
+    {
+        return false;
+    }
+
+    // Strings are not always terminated if they fill the whole field.
+    header->server_name[SVR_ARRAY_SIZE(header->server_name) - 1] = 0;
+    header->client_name[SVR_ARRAY_SIZE(header->client_name) - 1] = 0;
+    header->map_name[SVR_ARRAY_SIZE(header->map_name) - 1] = 0;
+    header->game_dir[SVR_ARRAY_SIZE(header->game_dir) - 1] = 0;
+
+    return true;
+}
+
+static bool svr_dem_read_messages(SvrDemReader* reader, SvrDemIndex* index)
+{
+    s32 protocol = index->header.demo_protocol;
+    s32 cmd_info_size = SVR_DEM_CMD_INFO_SIZE * (protocol >= 4 ? 2 : 1);
+    bool in_signon = true;
+
+    index->signon_end = reader->offset;
+    index->stop_offset = reader->file_size;
+
+    while (true)
+    {
+        s64 msg_offset = reader->offset;
+        u8 cmd;
+        s32 tick;
+        u8 player_slot;
+
+        // Demos of games that crashed or were closed end without a stop message.
+        if (!svr_dem_read_u8(reader, &cmd))
+        {
+            break;
+        }
+
+        if (!svr_dem_read_s32(reader, &tick))
+        {
+            break;
+        }
+
+        if (protocol >= 4 && !svr_dem_read_u8(reader, &player_slot))
+        {
+            break;
+        }
+
+        if (cmd == SVR_DEM_CMD_STOP)
+        {
+            index->stop_offset = msg_offset;
+            break;
+        }
+
+        if (in_signon && cmd != SVR_DEM_CMD_SIGNON)
+        {
+            in_signon = false;
+        }
+
+        if (!in_signon && cmd != SVR_DEM_CMD_SYNCTICK)
+        {
+            if (index->ticks.size == 0 || tick > index->ticks[index->ticks.size - 1].tick)
+            {
+                SvrDemTick entry;
+                entry.tick = tick;
+                entry.offset = msg_offset;
+
+                index->ticks.push(entry);
+            }
+        }
+
+        bool res;
+
+        switch (cmd)
+        {
+            case SVR_DEM_CMD_SIGNON:
+            case SVR_DEM_CMD_PACKET:
+            {
+                // View info, then the incoming and outgoing sequence numbers.
+                res = svr_dem_skip(reader, cmd_info_size + 8) && svr_dem_skip_sized(reader);
+                break;
+            }
+
+            case SVR_DEM_CMD_SYNCTICK:
+            {
+                res = true;
+                break;
+            }
+
+            case SVR_DEM_CMD_USERCMD:
+            {
+                // Outgoing sequence number before the command.
+                res = svr_dem_skip(reader, 4) && svr_dem_skip_sized(reader);
+                break;
+            }
+
+            case SVR_DEM_CMD_CONSOLECMD:
+            case SVR_DEM_CMD_DATATABLES:
+            case SVR_DEM_CMD_STRINGTABLES:
+            {
+                res = svr_dem_skip_sized(reader);
+                break;
+            }
+
+            case SVR_DEM_CMD_CUSTOMDATA:
+            {
+                if (protocol >= 4)
+                {
+                    // Callback index before the data.
+                    res = svr_dem_skip(reader, 4) && svr_dem_skip_sized(reader);
+                }
+
+                else
+                {
+                    res = svr_dem_skip_sized(reader); // String tables.
+                }
+
+                break;
+            }
+
+            default:
+            {
+                // Anything after this cannot be read.
+                return false;
+            }
+        }
+
+        if (!res)
+        {
+            // Cut off in the middle of a message. The ticks before this are still good.
+            index->stop_offset = msg_offset;
+            break;
+        }
+
+        // Moved along with every signon message, so a demo that has nothing after the signon ends where the signon ends.
+        if (in_signon)
+        {
+            index->signon_end = reader->offset;
+        }
+    }
+
+    return true;
+}
+
+bool svr_dem_build_index(const char* path, SvrDemIndex* index)
+{
+    bool ret = false;
+    SvrDemReader reader;
+
+    *index = {};
+    index->ticks.init(0);
+
+    if (!svr_dem_open(path, &reader))
+    {
+        goto rfail;
+    }
+
+    if (!svr_dem_read_header(&reader, &index->header))
+    {
+        goto rfail;
+    }
+
+    index->file_size = reader.file_size;
+
+    if (!svr_dem_read_messages(&reader, index))
+    {
+        goto rfail;
+    }
+
+    ret = true;
+    goto rexit;
+
+rfail:
+    svr_dem_free_index(index);
+
+rexit:
+    if (reader.file)
+    {
+        fclose(reader.file);
+    }
+
+    return ret;
+}
+
+// The cache has the header of the demo to know if it is for the same demo.
+static bool svr_dem_read_cache(const char* cache_path, SvrDemHeader* header, s64 file_size, SvrDemIndex* index)
+{
+    bool ret = false;
+    FILE* file = fopen(cache_path, "rb");
+    char magic[8];
+    s32 version;
+    s32 num_ticks;
+
+    *index = {};
+    index->ticks.init(0);
+
+    if (file == NULL)
+    {
+        goto rfail;
+    }
+
+    if (fread(magic, sizeof(magic), 1, file) != 1 || memcmp(magic, SVR_DEM_INDEX_MAGIC, sizeof(magic)))
+    {
+        goto rfail;
+    }
+
+    if (fread(&version, sizeof(version), 1, file) != 1 || version != SVR_DEM_INDEX_VERSION)
+    {
+        goto rfail;
+    }
+
+    if (fread(&index->header, sizeof(SvrDemHeader), 1, file) != 1 || memcmp(&index->header, header, sizeof(SvrDemHeader)))
+    {
+        goto rfail;
+    }
+
+    if (fread(&index->file_size, sizeof(s64), 1, file) != 1 || index->file_size != file_size)
+    {
+        goto rfail;
+    }
+
+    if (fread(&index->signon_end, sizeof(s64), 1, file) != 1 || fread(&index->stop_offset, sizeof(s64), 1, file) != 1)
+    {
+        goto rfail;
+    }
+
+    if (fread(&num_ticks, sizeof(s32), 1, file) != 1 || num_ticks < 0)
+    {
+        goto rfail;
+    }
+
+    index->ticks.change_capacity(num_ticks);
+
+    if (num_ticks > 0 && fread(index->ticks.mem, sizeof(SvrDemTick), num_ticks, file) != (size_t)num_ticks)
+    {
+        goto rfail;
+    }
+
+    index->ticks.size = num_ticks;
+
+    ret = true;
+    goto rexit;
+
+rfail:
+    svr_dem_free_index(index);
+
+rexit:
+    if (file)
+    {
+        fclose(file);
+    }
+
+    return ret;
+}
+
+static void svr_dem_write_cache(const char* cache_path, SvrDemIndex* index)
+{
+    FILE* file = fopen(cache_path, "wb");
+
+    if (file == NULL)
+    {
+        return;
+    }
+
+    bool ret = true;
+
+    ret &= fwrite(SVR_DEM_INDEX_MAGIC, sizeof(SVR_DEM_INDEX_MAGIC), 1, file) == 1;
+    ret &= fwrite(&SVR_DEM_INDEX_VERSION, sizeof(s32), 1, file) == 1;
+    ret &= fwrite(&index->header, sizeof(SvrDemHeader), 1, file) == 1;
+    ret &= fwrite(&index->file_size, sizeof(s64), 1, file) == 1;
+    ret &= fwrite(&index->signon_end, sizeof(s64), 1, file) == 1;
+    ret &= fwrite(&index->stop_offset, sizeof(s64), 1, file) == 1;
+    ret &= fwrite(&index->ticks.size, sizeof(s32), 1, file) == 1;
+
+    if (index->ticks.size > 0)
+    {
+        ret &= fwrite(index->ticks.mem, sizeof(SvrDemTick), index->ticks.size, file) == (size_t)index->ticks.size;
+    }
+
+    fclose(file);
+
+    // Don't leave a broken cache around. It would be rejected anyway but it takes space.
+    if (!ret)
+    {
+        remove(cache_path);
+    }
+}
+
+bool svr_dem_load_index(const char* path, SvrDemIndex* index)
+{
+    char cache_path[512];
+    SvrDemReader reader;
+    SvrDemHeader header;
+    bool header_ok;
+
+    SVR_SNPRINTF(cache_path, "%s.%s", path, SVR_DEM_INDEX_EXT);
+
+    if (!svr_dem_open(path, &reader))
+    {
+        *index = {};
+        return false;
+    }
+
+    header_ok = svr_dem_read_header(&reader, &header);
+    fclose(reader.file);
+
+    if (header_ok && svr_dem_read_cache(cache_path, &header, reader.file_size, index))
+    {
+        return true;
+    }
+
+    if (!svr_dem_build_index(path, index))
+    {
+        return false;
+    }
+
+    svr_dem_write_cache(cache_path, index);
+
+    return true;
+}
+
+void svr_dem_free_index(SvrDemIndex* index)
+{
+    index->ticks.free();
+}
+
+s32 svr_dem_find_tick(SvrDemIndex* index, s32 tick)
+{
+    s32 low = 0;
+    s32 high = index->ticks.size - 1;
+    s32 ret = -1;
+
+    while (low <= high)
+    {
+        s32 mid = low + (high - low) / 2;
+
+        if (index->ticks[mid].tick <= tick)
+        {
+            ret = mid;
+            low = mid + 1;
+        }
+
+        else
+        {
+            high = mid - 1;
+        }
+    }
+
+    return ret;
+}
+
+// The engine reads every message up to the tick it skips to, so the number of bytes between the ticks is how much work it is.
+static s64 svr_dem_get_tick_offset(SvrDemIndex* index, s32 tick)
+{
+    s32 pos = svr_dem_find_tick(index, tick);
+
+    if (pos == -1)
+    {
+        return index->signon_end;
+    }
+
+    // Everything of the tick itself is read too.
+    if (pos + 1 < index->ticks.size)
+    {
+        return index->ticks[pos + 1].offset;
+    }
+
+    return index->stop_offset;
+}
+
+s64 svr_dem_get_skip_cost(SvrDemIndex* index, s32 from_tick, s32 to_tick, bool* restart)
+{
+    *restart = to_tick < from_tick;
+
+    s64 from_offset = *restart ? index->signon_end : svr_dem_get_tick_offset(index, from_tick);
+    s64 to_offset = svr_dem_get_tick_offset(index, to_tick);
+
+    if (to_offset < from_offset)
+    {
+        return 0;
+    }
+
+    return to_offset - from_offset;
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include "svr_common.h"
+#include "svr_array.h"
+
+// Index of where every tick of a Source demo file starts, so the cost of skipping to a tick can be known before doing it.
+// This only reads the framing of the demo messages and not the network data inside, so it works for all games of the
+// same demo protocol and builds in a fraction of the time it takes the engine to play through the demo.
+// Only standard C is used here so this can be used and tested outside of Windows.
+
+// References:
+// https://developer.valvesoftware.com/wiki/DEM_(file_format)
+
+// The built index is cached next to the demo with this extension, and is built again when the demo changes.
+#define SVR_DEM_INDEX_EXT "svrdemidx"
+
+struct SvrDemHeader
+{
+    s32 demo_protocol;
+    s32 network_protocol;
+    char server_name[260];
+    char client_name[260];
+    char map_name[260];
+    char game_dir[260];
+    float playback_time; // In seconds.
+    s32 ticks;
+    s32 frames;
+    s32 signon_length; // Size of the signon messages that come after the header.
+};
+
+// Where the messages of a tick start in the demo.
+struct SvrDemTick
+{
+    s32 tick;
+    s64 offset;
+};
+
+struct SvrDemIndex
+{
+    SvrDemHeader header;
+    s64 file_size;
+    s64 signon_end; // Offset of the first message after the signon. The engine starts here when the demo is played from the start.
+    s64 stop_offset; // Offset of the stop message, or the end of the file if the demo was not stopped cleanly.
+    SvrDynArray<SvrDemTick> ticks; // Ticks of the packets after the signon, in order.
+};
+
+// Reads the demo at path and builds the index for it.
+bool svr_dem_build_index(const char* path, SvrDemIndex* index);
+
+// Same as svr_dem_build_index, but uses the cached index next to the demo if it is for the same demo.
+// The index is written next to the demo when it had to be built. Failing to write the cache is not an error.
+bool svr_dem_load_index(const char* path, SvrDemIndex* index);
+
+// Call when no longer needed.
+void svr_dem_free_index(SvrDemIndex* index);
+
+// Returns the position in ticks of the last tick at or before the given tick, or -1 if the tick is before the first tick.
+s32 svr_dem_find_tick(SvrDemIndex* index, s32 tick);
+
+// Number of bytes the engine has to go through when skipping from one tick to another.
+// Going back makes the engine start from the signon again, which restart is set to.
+s64 svr_dem_get_skip_cost(SvrDemIndex* index, s32 from_tick, s32 to_tick, bool* restart);
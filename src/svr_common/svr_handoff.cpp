@@ -0,0 +1,107 @@
+#include "svr_handoff.h"
+#include "svr_prof.h"
+#include <immintrin.h>
+
+void svr_handoff_init(SvrHandoff* handoff, SvrHandoffChannel* channel, const SvrHandoffBackend* backend)
+{
+    *handoff = {};
+    handoff->backend = backend;
+
+    // Spin in the same way as the wait does, as the pause instruction takes very different time on different processors.
+    const s32 CALIBRATION_LOOPS = 20000;
+
+    SvrAtom32 dummy = {};
+
+    s64 start_time = svr_prof_get_real_time();
+
+    for (s32 i = 0; i < CALIBRATION_LOOPS; i++)
+    {
+        svr_atom_load(&dummy);
+        _mm_pause();
+    }
+
+    s64 taken = svr_max(svr_prof_get_real_time() - start_time, (s64)1);
+
+    handoff->loops_per_us = svr_max((s32)(CALIBRATION_LOOPS / taken), 1);
+    handoff->spin_loops = handoff->loops_per_us * SVR_HANDOFF_MAX_SPIN_US;
+    handoff->last_seq = svr_atom_load(&channel->seq);
+}
+
+void svr_handoff_reset_stats(SvrHandoff* handoff)
+{
+    handoff->num_spun = 0;
+    handoff->num_blocked = 0;
+}
+
+void svr_handoff_signal(SvrHandoff* handoff, SvrHandoffChannel* channel, void* event_h)
+{
+    svr_atom_add(&channel->seq, 1);
+
+    // Only go through the kernel if the other side is sleeping.
+    if (svr_atom_swap(&channel->sleeping, 0))
+    {
+        handoff->backend->wake(channel, event_h);
+    }
+}
+
+bool svr_handoff_wait(SvrHandoff* handoff, SvrHandoffChannel* channel, void* event_h, void* other_h)
+{
+    for (s32 i = 0; i < handoff->spin_loops; i++)
+    {
+        if (svr_atom_load(&channel->seq) != handoff->last_seq)
+        {
+            handoff->last_seq = svr_atom_load(&channel->seq);
+            handoff->num_spun++;
+
+            // Spinning worked, so allow spinning for longer next time.
+            handoff->spin_loops = svr_min(handoff->spin_loops * 2, handoff->loops_per_us * SVR_HANDOFF_MAX_SPIN_US);
+
+            return true;
+        }
+
+        _mm_pause();
+    }
+
+    while (true)
+    {
+        // The swap is a full barrier, so a handoff that happens after this will see that we are sleeping.
+        svr_atom_swap(&channel->sleeping, 1);
+
+        if (svr_atom_load(&channel->seq) != handoff->last_seq)
+        {
+            svr_atom_store(&channel->sleeping, 0);
+            break;
+        }
+
+        if (!handoff->backend->sleep(channel, handoff->last_seq, event_h, other_h))
+        {
+            return false;
+        }
+
+        // The wake can be left over from a handoff that was already seen, so the sequence must be checked again.
+        if (svr_atom_load(&channel->seq) != handoff->last_seq)
+        {
+            break;
+        }
+    }
+
+    handoff->last_seq = svr_atom_load(&channel->seq);
+    handoff->num_blocked++;
+
+    // Spinning did not work, so spin for shorter next time.
+    handoff->spin_loops = svr_max(handoff->spin_loops / 2, handoff->loops_per_us);
+
+    return true;
+}
+
+float svr_handoff_get_spin_ratio(SvrHandoff* handoff)
+{
+    s64 total = handoff->num_spun + handoff->num_blocked;
+
+    if (total == 0)
+    {
+        return 0.0f;
+    }
+
+    return (100.0f * handoff->num_spun) / total;
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include "svr_common.h"
+#include "svr_atom.h"
+
+// Handing over work between two threads or processes that wait for each other.
+// The sending side increases a sequence number, and the waiting side spins on it for a short time before going to sleep on an event.
+// The event is only set when the waiting side said that it went to sleep, so most handoffs don't need the kernel when the other
+// side answers quickly. The time to spin is changed after every wait, so the waiting side stops spinning if it keeps having to sleep.
+
+// How a side sleeps and is woken up is up to the backend, so the spinning and the sequence numbers are the same everywhere.
+// svr_game and svr_encoder use SVR_HANDOFF_WIN32_BACKEND with events. SVR_HANDOFF_FUTEX_BACKEND is for Linux, where it sleeps on the
+// sequence number itself and needs no events (see svr_handoff_futex.cpp and svr_tests/svr_handoff_test.cpp).
+
+// Longest time to spin before sleeping, in microseconds.
+const s32 SVR_HANDOFF_MAX_SPIN_US = 50;
+
+// Shared between the two sides, once for each direction.
+struct SvrHandoffChannel
+{
+    SvrAtom32 seq; // Increased by the sending side for every handoff.
+    SvrAtom32 sleeping; // Set by the waiting side before it sleeps on the event.
+};
+
+struct SvrHandoffChannel;
+
+struct SvrHandoffBackend
+{
+    // Wakes up the other side that is sleeping on the channel.
+    void(*wake)(SvrHandoffChannel* channel, void* event_h);
+
+    // Sleeps until woken up, or until other_h says that the other side is gone. The sequence number of the channel is
+    // checked after this, so this may return early. Returns false if the other side is gone or the sleep failed.
+    bool(*sleep)(SvrHandoffChannel* channel, s32 last_seq, void* event_h, void* other_h);
+};
+
+// The event handles are HANDLE and other_h is the process of the other side.
+extern const SvrHandoffBackend SVR_HANDOFF_WIN32_BACKEND;
+
+// The event handles are not used and other_h points to a file descriptor (such as a pidfd) that is readable when the other side is gone.
+// Other_h can be NULL to not check that.
+extern const SvrHandoffBackend SVR_HANDOFF_FUTEX_BACKEND;
+
+// State of one side, which waits on one channel and signals on the other.
+struct SvrHandoff
+{
+    const SvrHandoffBackend* backend;
+
+    s32 loops_per_us; // How many spin loops are one microsecond on this processor.
+    s32 spin_loops; // How many spin loops to do on the next wait.
+    s32 last_seq; // Last sequence number that was received.
+
+    s64 num_spun; // Waits that ended while spinning.
+    s64 num_blocked; // Waits that had to sleep on the event.
+};
+
+// Measures the spin speed of this processor and starts waiting from the current sequence number of the channel.
+// The profiler must be initialized first.
+void svr_handoff_init(SvrHandoff* handoff, SvrHandoffChannel* channel, const SvrHandoffBackend* backend);
+
+void svr_handoff_reset_stats(SvrHandoff* handoff);
+
+// Hands over to the other side, which waits on the channel. The handles depend on the backend.
+void svr_handoff_signal(SvrHandoff* handoff, SvrHandoffChannel* channel, void* event_h);
+
+// Waits until the other side hands over, or until other_h is signaled (such as when the other process exits).
+// Returns false if other_h was signaled or the wait failed.
+bool svr_handoff_wait(SvrHandoff* handoff, SvrHandoffChannel* channel, void* event_h, void* other_h);
+
+// Percentage of the waits that ended while spinning.
+float svr_handoff_get_spin_ratio(SvrHandoff* handoff);
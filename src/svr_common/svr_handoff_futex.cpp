@@ -0,0 +1,52 @@
+#include "svr_handoff.h"
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <poll.h>
+#include <errno.h>
+#include <time.h>
+
+// Backend for Linux, which sleeps on the sequence number of the channel so no events are needed.
+// This is not part of the Windows build.
+
+// The futex has no way to also wait on the other side, so wake up this often to check if it is gone.
+const s32 SVR_HANDOFF_FUTEX_CHECK_MS = 100;
+
+static void svr_handoff_futex_wake(SvrHandoffChannel* channel, void*)
+{
+    // Channels can be in memory that is shared between processes, so the private futex operations can't be used.
+    syscall(SYS_futex, &channel->seq.v, FUTEX_WAKE, 1, NULL, NULL, 0);
+}
+
+static bool svr_handoff_futex_sleep(SvrHandoffChannel* channel, s32 last_seq, void*, void* other_h)
+{
+    timespec timeout = { 0, SVR_HANDOFF_FUTEX_CHECK_MS * 1000000L };
+
+    // Returns right away if the sequence number has already changed.
+    long res = syscall(SYS_futex, &channel->seq.v, FUTEX_WAIT, last_seq, &timeout, NULL, 0);
+
+    if (res == -1 && errno != EAGAIN && errno != EINTR && errno != ETIMEDOUT)
+    {
+        return false;
+    }
+
+    if (other_h)
+    {
+        pollfd other_fd = {};
+        other_fd.fd = *(int*)other_h;
+        other_fd.events = POLLIN;
+
+        if (poll(&other_fd, 1, 0) != 0)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+const SvrHandoffBackend SVR_HANDOFF_FUTEX_BACKEND =
+{
+    svr_handoff_futex_wake,
+    svr_handoff_futex_sleep,
+};
@@ -0,0 +1,25 @@
+#include "svr_handoff.h"
+#include <Windows.h>
+
+static void svr_handoff_win32_wake(SvrHandoffChannel* channel, void* event_h)
+{
+    SetEvent((HANDLE)event_h);
+}
+
+static bool svr_handoff_win32_sleep(SvrHandoffChannel* channel, s32 last_seq, void* event_h, void* other_h)
+{
+    HANDLE handles[] =
+    {
+        (HANDLE)event_h,
+        (HANDLE)other_h,
+    };
+
+    DWORD waited = WaitForMultipleObjects(SVR_ARRAY_SIZE(handles), handles, FALSE, INFINITE);
+    return waited == WAIT_OBJECT_0;
+}
+
+const SvrHandoffBackend SVR_HANDOFF_WIN32_BACKEND =
+{
+    svr_handoff_win32_wake,
+    svr_handoff_win32_sleep,
+};
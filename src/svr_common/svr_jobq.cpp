@@ -0,0 +1,329 @@
+#include "svr_jobq.h"
+#include <string.h>
+
+// Jobs of the same demo go to the same worker so the demo is only loaded once, and are rendered in order of ticks so the demo is only skipped forward.
+bool svr_jobq_is_before(SvrJobq* q, s32 a, s32 b)
+{
+    SvrJobqJob* job_a = &q->jobs[a];
+    SvrJobqJob* job_b = &q->jobs[b];
+
+    s32 res = strcmp(job_a->demo, job_b->demo);
+
+    if (res != 0)
+    {
+        return res < 0;
+    }
+
+    if (job_a->start_tick != job_b->start_tick)
+    {
+        return job_a->start_tick < job_b->start_tick;
+    }
+
+    return a < b;
+}
+
+s64 svr_jobq_get_remaining_cost(SvrJobq* q, SvrJobqWorker* worker)
+{
+    s64 ret = 0;
+
+    for (s32 i = worker->begin; i < worker->end; i++)
+    {
+        ret += q->jobs[q->order[i]].cost;
+    }
+
+    return ret;
+}
+
+bool svr_jobq_add(SvrJobq* q, const char* line, s32 line_num, const char* demo, s32 start_tick, s64 cost)
+{
+    if (q->num_jobs == SVR_JOBQ_MAX_JOBS)
+    {
+        return false;
+    }
+
+    SvrJobqJob* job = &q->jobs[q->num_jobs];
+    memset(job, 0, sizeof(SvrJobqJob));
+
+    SVR_COPY_STRING(line, job->line);
+    job->line_num = line_num;
+    SVR_COPY_STRING(demo, job->demo);
+    job->start_tick = start_tick;
+    job->cost = cost > 0 ? cost : 1;
+    job->state = SVR_JOBQ_JOB_PENDING;
+    job->worker = -1;
+
+    q->num_jobs++;
+    return true;
+}
+
+void svr_jobq_distribute(SvrJobq* q, s32 num_workers)
+{
+    // Sorted jobs, then groups of jobs with the same demo.
+    s32 sorted[SVR_JOBQ_MAX_JOBS];
+    s32 group_start[SVR_JOBQ_MAX_JOBS];
+    s32 group_end[SVR_JOBQ_MAX_JOBS];
+    s64 group_cost[SVR_JOBQ_MAX_JOBS];
+    s32 group_worker[SVR_JOBQ_MAX_JOBS];
+    s32 by_cost[SVR_JOBQ_MAX_JOBS];
+    s64 worker_cost[SVR_JOBQ_MAX_WORKERS];
+    s32 num_groups = 0;
+    s32 pos = 0;
+
+    svr_clamp(&num_workers, 1, SVR_JOBQ_MAX_WORKERS);
+    q->num_workers = num_workers;
+
+    // There are not many jobs so this does not need to be fast.
+    for (s32 i = 0; i < q->num_jobs; i++)
+    {
+        s32 j = i;
+
+        while (j > 0 && svr_jobq_is_before(q, i, sorted[j - 1]))
+        {
+            sorted[j] = sorted[j - 1];
+            j--;
+        }
+
+        sorted[j] = i;
+    }
+
+    for (s32 i = 0; i < q->num_jobs; i++)
+    {
+        if (i == 0 || strcmp(q->jobs[sorted[i]].demo, q->jobs[sorted[i - 1]].demo))
+        {
+            group_start[num_groups] = i;
+            group_cost[num_groups] = 0;
+            num_groups++;
+        }
+
+        group_end[num_groups - 1] = i + 1;
+        group_cost[num_groups - 1] += q->jobs[sorted[i]].cost;
+    }
+
+    // Largest groups first, each to the worker with the least work so far.
+    for (s32 i = 0; i < num_groups; i++)
+    {
+        s32 j = i;
+
+        while (j > 0 && group_cost[i] > group_cost[by_cost[j - 1]])
+        {
+            by_cost[j] = by_cost[j - 1];
+            j--;
+        }
+
+        by_cost[j] = i;
+    }
+
+    for (s32 i = 0; i < num_workers; i++)
+    {
+        worker_cost[i] = 0;
+    }
+
+    for (s32 i = 0; i < num_groups; i++)
+    {
+        s32 group = by_cost[i];
+        s32 least = 0;
+
+        for (s32 j = 1; j < num_workers; j++)
+        {
+            if (worker_cost[j] < worker_cost[least])
+            {
+                least = j;
+            }
+        }
+
+        group_worker[group] = least;
+        worker_cost[least] += group_cost[group];
+    }
+
+    // Every worker owns the range of its groups, still in order of demo and tick.
+    for (s32 i = 0; i < num_workers; i++)
+    {
+        SvrJobqWorker* worker = &q->workers[i];
+        memset(worker, 0, sizeof(SvrJobqWorker));
+
+        worker->begin = pos;
+        worker->running = -1;
+
+        for (s32 j = 0; j < num_groups; j++)
+        {
+            if (group_worker[j] != i)
+            {
+                continue;
+            }
+
+            for (s32 k = group_start[j]; k < group_end[j]; k++)
+            {
+                q->order[pos] = sorted[k];
+                pos++;
+            }
+        }
+
+        worker->end = pos;
+    }
+}
+
+// Moves the later half of the remaining work of the worker with the most work left to the given worker, which must have no jobs left.
+bool svr_jobq_steal(SvrJobq* q, s32 worker)
+{
+    SvrJobqWorker* thief = &q->workers[worker];
+    SvrJobqWorker* victim = NULL;
+    s64 victim_cost = 0;
+
+    for (s32 i = 0; i < q->num_workers; i++)
+    {
+        if (i == worker)
+        {
+            continue;
+        }
+
+        s64 cost = svr_jobq_get_remaining_cost(q, &q->workers[i]);
+
+        if (cost > victim_cost)
+        {
+            victim = &q->workers[i];
+            victim_cost = cost;
+        }
+    }
+
+    if (victim == NULL)
+    {
+        return false;
+    }
+
+    // At least one job. The victim keeps its next job if it has more than one, since that demo may already be loaded by the victim.
+    s32 split = victim->end - 1;
+    s64 stolen_cost = q->jobs[q->order[split]].cost;
+
+    while (split - 1 > victim->begin && stolen_cost * 2 < victim_cost)
+    {
+        split--;
+        stolen_cost += q->jobs[q->order[split]].cost;
+    }
+
+    // A worker that has exited does not need anything left for it.
+    if (victim->gone)
+    {
+        split = victim->begin;
+    }
+
+    // The ranges of the workers stay apart since the range of the thief is empty.
+    thief->begin = split;
+    thief->end = victim->end;
+    victim->end = split;
+
+    for (s32 i = thief->begin; i < thief->end; i++)
+    {
+        q->jobs[q->order[i]].stolen = true;
+    }
+
+    thief->num_steals++;
+    return true;
+}
+
+s32 svr_jobq_take(SvrJobq* q, s32 worker)
+{
+    if (worker < 0 || worker >= q->num_workers)
+    {
+        return -1;
+    }
+
+    SvrJobqWorker* w = &q->workers[worker];
+
+    if (w->gone)
+    {
+        return -1;
+    }
+
+    if (w->begin == w->end)
+    {
+        if (!svr_jobq_steal(q, worker))
+        {
+            return -1;
+        }
+    }
+
+    s32 job = q->order[w->begin];
+    w->begin++;
+
+    q->jobs[job].state = SVR_JOBQ_JOB_RUNNING;
+    q->jobs[job].worker = worker;
+    w->running = job;
+
+    return job;
+}
+
+void svr_jobq_finish(SvrJobq* q, s32 worker, s32 job, bool failed, s64 num_frames, float render_secs)
+{
+    if (worker < 0 || worker >= q->num_workers || job < 0 || job >= q->num_jobs)
+    {
+        return;
+    }
+
+    SvrJobqWorker* w = &q->workers[worker];
+    SvrJobqJob* j = &q->jobs[job];
+
+    // Already failed if the worker was removed.
+    if (j->state != SVR_JOBQ_JOB_RUNNING || j->worker != worker)
+    {
+        return;
+    }
+
+    j->state = failed ? SVR_JOBQ_JOB_FAILED : SVR_JOBQ_JOB_DONE;
+    j->num_frames = num_frames;
+    j->render_secs = render_secs;
+
+    w->running = -1;
+    w->num_done++;
+}
+
+void svr_jobq_remove_worker(SvrJobq* q, s32 worker)
+{
+    if (worker < 0 || worker >= q->num_workers)
+    {
+        return;
+    }
+
+    SvrJobqWorker* w = &q->workers[worker];
+    w->gone = true;
+
+    // The job may be what made the game exit, so it is not given to another worker.
+    if (w->running != -1)
+    {
+        q->jobs[w->running].state = SVR_JOBQ_JOB_FAILED;
+        w->running = -1;
+    }
+}
+
+s32 svr_jobq_add_worker(SvrJobq* q)
+{
+    if (q->num_workers == SVR_JOBQ_MAX_WORKERS)
+    {
+        return -1;
+    }
+
+    s32 worker = q->num_workers;
+
+    SvrJobqWorker* w = &q->workers[worker];
+    memset(w, 0, sizeof(SvrJobqWorker));
+
+    // An empty range, so the first take steals.
+    w->begin = q->num_jobs;
+    w->end = q->num_jobs;
+    w->running = -1;
+
+    q->num_workers++;
+    return worker;
+}
+
+bool svr_jobq_is_done(SvrJobq* q)
+{
+    for (s32 i = 0; i < q->num_jobs; i++)
+    {
+        if (q->jobs[i].state == SVR_JOBQ_JOB_PENDING || q->jobs[i].state == SVR_JOBQ_JOB_RUNNING)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,96 @@
+#pragma once
+#include "svr_common.h"
+
+// Queue of movie jobs that several game processes render at the same time, started by svr_launcher --jobs.
+// One game thread cannot use a whole processor, so more movies are done at once by running several games.
+//
+// The jobs are first spread over the workers so each worker gets whole demos, and every worker renders its own jobs in order of
+// demo and tick. A worker that runs out of jobs steals the later half of the remaining jobs of the worker with the most work left,
+// so the workers that finish early help the others. Jobs of a worker that has exited are taken over the same way.
+//
+// The queue is plain memory without pointers, so it can be placed in memory that is shared between processes.
+// It does no locking by itself. All functions must be called with the queue locked by the caller.
+// Only standard C is used here so this can be used and tested outside of Windows.
+
+const s32 SVR_JOBQ_MAX_JOBS = 1024;
+const s32 SVR_JOBQ_MAX_WORKERS = 32;
+const s32 SVR_JOBQ_MAX_LINE = 1024;
+
+// The launcher places the queue in shared memory named SVR_JOBQ_MAPPING followed by the launcher process id,
+// and locks it with a mutex named SVR_JOBQ_MUTEX followed by the launcher process id.
+#define SVR_JOBQ_MAPPING "Local\\svr_jobq_"
+#define SVR_JOBQ_MUTEX "Local\\svr_jobq_mutex_"
+
+// Environment variable given to the game processes, which is "<launcher process id> <worker index>".
+// This is also inherited by svr_encoder, so every worker writes its own logs.
+#define SVR_JOBQ_WORKER_ENV "SVR_JOBQ_WORKER"
+
+using SvrJobqJobState = s32;
+
+enum // SvrJobqJobState
+{
+    SVR_JOBQ_JOB_PENDING,
+    SVR_JOBQ_JOB_RUNNING,
+    SVR_JOBQ_JOB_DONE,
+    SVR_JOBQ_JOB_FAILED,
+};
+
+struct SvrJobqJob
+{
+    char line[SVR_JOBQ_MAX_LINE]; // The job as written in the job file, which is what the workers read.
+    s32 line_num; // Line in the job file.
+    char demo[260];
+    s32 start_tick;
+    s64 cost; // Estimated work of the job in any unit, used to balance the workers.
+
+    SvrJobqJobState state;
+    s32 worker; // Worker that took the job, or -1.
+    bool stolen; // If the job was stolen from another worker.
+    s64 num_frames;
+    float render_secs;
+};
+
+struct SvrJobqWorker
+{
+    // Range in order of the jobs this worker has not taken yet.
+    // The worker takes from the start, and other workers steal from the end.
+    s32 begin;
+    s32 end;
+
+    s32 running; // Job being rendered, or -1.
+    s32 num_done;
+    s32 num_steals;
+    bool gone; // The worker has exited and takes no more jobs.
+};
+
+struct SvrJobq
+{
+    s32 num_jobs;
+    s32 num_workers;
+    s32 order[SVR_JOBQ_MAX_JOBS]; // Job indexes, where each worker owns a range.
+    SvrJobqWorker workers[SVR_JOBQ_MAX_WORKERS];
+    SvrJobqJob jobs[SVR_JOBQ_MAX_JOBS];
+};
+
+// Adds a job before the queue is distributed. Returns false if the queue is full.
+bool svr_jobq_add(SvrJobq* q, const char* line, s32 line_num, const char* demo, s32 start_tick, s64 cost);
+
+// Spreads the jobs over the workers. Must be called once after all jobs have been added.
+void svr_jobq_distribute(SvrJobq* q, s32 num_workers);
+
+// Takes the next job for a worker, stealing from other workers if it has none left.
+// Returns the job index, or -1 if there are no more jobs to take.
+s32 svr_jobq_take(SvrJobq* q, s32 worker);
+
+// Called by a worker when a job taken with svr_jobq_take is finished.
+void svr_jobq_finish(SvrJobq* q, s32 worker, s32 job, bool failed, s64 num_frames, float render_secs);
+
+// Called when a worker has exited. Its running job is failed and its remaining jobs are left for the other workers.
+void svr_jobq_remove_worker(SvrJobq* q, s32 worker);
+
+// Adds a worker with no jobs of its own, which steals from the others when it takes a job.
+// Used to start a new worker for the jobs of workers that have exited. Returns the worker index, or -1 if there is no room.
+s32 svr_jobq_add_worker(SvrJobq* q);
+
+// Returns true when no job is pending or running.
+bool svr_jobq_is_done(SvrJobq* q);
@@ -0,0 +1,104 @@
+#include "svr_mosample.h"
+
+void svr_mosample_start(SvrMosample* m, s32 video_fps, s32 mult, float exposure, bool skip_closed)
+{
+    s32 sps = video_fps * mult;
+
+    m->exposure = exposure;
+    m->remainder = 0.0f;
+    m->step = (1.0f / sps) / (1.0f / video_fps);
+    m->skip_closed = skip_closed;
+
+    for (s32 i = 0; i < SVR_MOSAMPLE_LENGTH_DELAY; i++)
+    {
+        m->lengths[i] = 1;
+    }
+}
+
+// Where a game frame that starts at rem and covers length steps ends in its last video frame.
+// This must be the same as what svr_mosample_frame does, so the length that is asked for before a frame is right for it.
+static float svr_mosample_advance(SvrMosample* m, float rem, s32 length)
+{
+    rem += m->step * length;
+
+    if (rem >= 1.0f)
+    {
+        rem -= 1.0f;
+        rem -= (s32)rem;
+    }
+
+    return rem;
+}
+
+SvrMosampleFrame svr_mosample_frame(SvrMosample* m)
+{
+    SvrMosampleFrame ret = {};
+
+    float old_rem = m->remainder;
+    float closed = 1.0f - m->exposure;
+
+    // A frame that covers several steps always ends within the closed part, so it has no weight like the steps it replaces.
+    float rem = old_rem + m->step * m->lengths[0];
+
+    for (s32 i = 0; i < SVR_MOSAMPLE_LENGTH_DELAY - 1; i++)
+    {
+        m->lengths[i] = m->lengths[i + 1];
+    }
+
+    m->lengths[SVR_MOSAMPLE_LENGTH_DELAY - 1] = 1;
+
+    if (rem <= closed)
+    {
+    }
+
+    else if (rem < 1.0f)
+    {
+        ret.weight = (rem - svr_max(closed, old_rem)) * (1.0f / m->exposure);
+    }
+
+    else
+    {
+        ret.weight = (1.0f - svr_max(closed, old_rem)) * (1.0f / m->exposure);
+
+        rem -= 1.0f;
+
+        s32 additional = rem;
+
+        ret.num_finished = 1 + additional;
+        rem -= additional;
+
+        if (rem > SVR_MOSAMPLE_MIN_WEIGHT && rem > closed)
+        {
+            ret.next_weight = (rem - closed) * (1.0f / m->exposure);
+        }
+    }
+
+    m->remainder = rem;
+
+    return ret;
+}
+
+s32 svr_mosample_next_frame_length(SvrMosample* m)
+{
+    if (!m->skip_closed)
+    {
+        return 1;
+    }
+
+    float closed = 1.0f - m->exposure;
+
+    // Where the frames that are already decided end.
+    float rem = m->remainder;
+
+    for (s32 i = 0; i < SVR_MOSAMPLE_LENGTH_DELAY - 1; i++)
+    {
+        rem = svr_mosample_advance(m, rem, m->lengths[i]);
+    }
+
+    // Every step that still ends at or before the closed part.
+    s32 length = (s32)((closed - rem) / m->step);
+    length = svr_max(length, 1);
+
+    m->lengths[SVR_MOSAMPLE_LENGTH_DELAY - 1] = length;
+    return length;
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include "svr_common.h"
+
+// Weights of motion blur, where every video frame is the sum of the game frames rendered during it.
+// svr_game does the blending on the GPU in proc_mosample.cpp and asks this what to blend.
+// Only standard C is used here so this can be tested outside of Windows, see svr_tests/svr_mosample_test.cpp.
+
+// Any weight less than this is not productive to spin up the pipeline for.
+const float SVR_MOSAMPLE_MIN_WEIGHT = 1.0f / 255.0f;
+
+// How many game frames after the one that is asked for the length of a frame takes effect.
+// The game changes its frame length through the host_framerate console variable, which is read by the engine before the
+// console commands of a frame run, so a new length only reaches the frame after the one that is already running.
+const s32 SVR_MOSAMPLE_LENGTH_DELAY = 2;
+
+struct SvrMosample
+{
+    float exposure; // Part of every video frame where the shutter is open, at the end of the frame.
+    float remainder; // How far into the current video frame the last game frame ended, from 0 to 1.
+    float step; // Length of one frame at the game rate, in video frames.
+    bool skip_closed;
+
+    // How many steps the next game frames cover, starting with the one that svr_mosample_frame is given next.
+    s32 lengths[SVR_MOSAMPLE_LENGTH_DELAY];
+};
+
+// What to do with a rendered game frame.
+struct SvrMosampleFrame
+{
+    float weight; // Weight in the current video frame. 0 when the frame ends in the closed part.
+    s32 num_finished; // How many video frames are complete after this. More than 1 if the game frame is longer than a video frame.
+    float next_weight; // Weight in the video frame that is started when num_finished is not 0.
+};
+
+void svr_mosample_start(SvrMosample* m, s32 video_fps, s32 mult, float exposure, bool skip_closed);
+
+// Call for every game frame that is rendered.
+SvrMosampleFrame svr_mosample_frame(SvrMosample* m);
+
+// Returns how many steps the game frame after the one that is already running should cover.
+// When the shutter is closed for a part of every video frame, the steps in that part have no weight and do not need to be rendered,
+// so one longer frame can cover all of them and only the last one is rendered. This is always 1 unless skip_closed is set.
+s32 svr_mosample_next_frame_length(SvrMosample* m);
@@ -0,0 +1,33 @@
+#pragma once
+#include "svr_common.h"
+
+// Writing of a stream to another program, either to the stdin of a child process or to a named pipe that the other program has created.
+// svr_encoder writes the container of the movie through this when video_pipe is set, from its IO thread.
+// This is the Win32 version in svr_pipe_win32.cpp. The one in svr_pipe_posix.cpp is not part of the Windows build and is
+// used to test the streams that are written on Linux.
+
+struct SvrPipe
+{
+#ifdef _WIN32
+    void* write_h; // Write end of the pipe.
+    void* process_h; // Child process that reads from the pipe, or NULL for a named pipe.
+#else
+    s32 write_fd; // Write end of the pipe, or -1.
+    s32 process_id; // Child process that reads from the pipe, or 0 for a named pipe.
+#endif
+
+    char message[256]; // Why the pipe could not be opened or written to, or why the child failed.
+};
+
+// On Windows, a target starting with \\.\pipe\ is a named pipe. Elsewhere, a target that is an existing fifo is a named pipe.
+// Anything else is a command that is started with the read end of a new pipe of pipe_size bytes as its stdin.
+// The output and errors of the child go to the same place as ours.
+bool svr_pipe_open(SvrPipe* p, const char* target, s32 pipe_size);
+
+// Blocks until the reader has made room for everything.
+// Fails if the reader has closed its end, such as when the child process has exited.
+bool svr_pipe_write(SvrPipe* p, const void* data, s32 size);
+
+// Closing lets the reader know that nothing more is coming. For a command, this waits for the child to exit.
+// Returns false if the child exited with a code other than 0.
+bool svr_pipe_close(SvrPipe* p);
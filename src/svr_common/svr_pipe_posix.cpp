@@ -0,0 +1,149 @@
+#include "svr_pipe.h"
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <string.h>
+#include <signal.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+// Version for Linux, where commands are run through the shell like the Windows version runs them through CreateProcess.
+// This is not part of the Windows build.
+
+bool svr_pipe_open(SvrPipe* p, const char* target, s32 pipe_size)
+{
+    bool ret = false;
+    int fds[2] = { -1, -1 };
+    struct stat st = {};
+
+    p->write_fd = -1;
+    p->process_id = 0;
+    p->message[0] = 0;
+
+    // A reader that goes away must give an error on the next write instead of ending our process.
+    signal(SIGPIPE, SIG_IGN);
+
+    if (stat(target, &st) == 0 && S_ISFIFO(st.st_mode))
+    {
+        // Blocks until the other program opens its end.
+        p->write_fd = open(target, O_WRONLY | O_CLOEXEC);
+
+        if (p->write_fd == -1)
+        {
+            SVR_SNPRINTF(p->message, "ERROR: Could not open pipe %s (%d)\n", target, errno);
+            goto rfail;
+        }
+    }
+
+    else
+    {
+        // Our ends must not be given to other children, or their readers would never see the end of the pipe.
+        if (pipe2(fds, O_CLOEXEC) == -1)
+        {
+            SVR_SNPRINTF(p->message, "ERROR: Could not create pipe (%d)\n", errno);
+            goto rfail;
+        }
+
+        // Not an error if this is more than the system allows, the writes just block more often.
+        fcntl(fds[1], F_SETPIPE_SZ, pipe_size);
+
+        pid_t pid = fork();
+
+        if (pid == -1)
+        {
+            SVR_SNPRINTF(p->message, "ERROR: Could not start pipe command %s (%d)\n", target, errno);
+            goto rfail;
+        }
+
+        if (pid == 0)
+        {
+            dup2(fds[0], STDIN_FILENO);
+            execl("/bin/sh", "sh", "-c", target, (char*)NULL);
+            _exit(127);
+        }
+
+        close(fds[0]); // The child has its own now.
+        fds[0] = -1;
+
+        p->write_fd = fds[1];
+        p->process_id = pid;
+    }
+
+    ret = true;
+    goto rexit;
+
+rfail:
+    if (fds[1] != -1)
+    {
+        close(fds[1]);
+    }
+
+    if (fds[0] != -1)
+    {
+        close(fds[0]);
+    }
+
+    p->write_fd = -1;
+
+rexit:
+    return ret;
+}
+
+bool svr_pipe_write(SvrPipe* p, const void* data, s32 size)
+{
+    const u8* pos = (const u8*)data;
+
+    while (size > 0)
+    {
+        ssize_t written = write(p->write_fd, pos, size);
+
+        if (written == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            SVR_SNPRINTF(p->message, "ERROR: Could not write to pipe (%d)\n", errno);
+            return false;
+        }
+
+        pos += written;
+        size -= (s32)written;
+    }
+
+    return true;
+}
+
+bool svr_pipe_close(SvrPipe* p)
+{
+    bool ret = true;
+
+    if (p->write_fd != -1)
+    {
+        close(p->write_fd);
+        p->write_fd = -1;
+    }
+
+    // The child process may still be working on what it has read.
+    if (p->process_id)
+    {
+        int status = 0;
+
+        while (waitpid(p->process_id, &status, 0) == -1 && errno == EINTR)
+        {
+        }
+
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        {
+            s32 exit_code = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+
+            SVR_SNPRINTF(p->message, "ERROR: Pipe command exited with code %d\n", exit_code);
+            ret = false;
+        }
+
+        p->process_id = 0;
+    }
+
+    return ret;
+}
@@ -0,0 +1,145 @@
+#include "svr_pipe.h"
+#include <Windows.h>
+#include <string.h>
+
+bool svr_pipe_open(SvrPipe* p, const char* target, s32 pipe_size)
+{
+    bool ret = false;
+
+    p->write_h = NULL;
+    p->process_h = NULL;
+    p->message[0] = 0;
+
+    if (!_strnicmp(target, "\\\\.\\pipe\\", 9))
+    {
+        HANDLE file_h = CreateFileA(target, GENERIC_WRITE, 0, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+
+        if (file_h == INVALID_HANDLE_VALUE)
+        {
+            DWORD error_code = GetLastError();
+
+            SVR_SNPRINTF(p->message, "ERROR: Could not open pipe %s (%lu)\n", target, error_code);
+            goto rfail;
+        }
+
+        p->write_h = file_h;
+    }
+
+    else
+    {
+        SECURITY_ATTRIBUTES sec_attrs = {};
+        sec_attrs.nLength = sizeof(SECURITY_ATTRIBUTES);
+        sec_attrs.bInheritHandle = TRUE;
+
+        HANDLE read_h = NULL;
+        HANDLE write_h = NULL;
+
+        if (!CreatePipe(&read_h, &write_h, &sec_attrs, pipe_size))
+        {
+            DWORD error_code = GetLastError();
+
+            SVR_SNPRINTF(p->message, "ERROR: Could not create pipe (%lu)\n", error_code);
+            goto rfail;
+        }
+
+        p->write_h = write_h;
+
+        // Only the read end goes to the child. It must not keep our end open, or it would never see the end of the pipe.
+        SetHandleInformation(write_h, HANDLE_FLAG_INHERIT, 0);
+
+        STARTUPINFOA start_info = {};
+        start_info.cb = sizeof(STARTUPINFOA);
+        start_info.dwFlags = STARTF_USESTDHANDLES;
+        start_info.hStdInput = read_h;
+        start_info.hStdOutput = GetStdHandle(STD_OUTPUT_HANDLE);
+        start_info.hStdError = GetStdHandle(STD_ERROR_HANDLE);
+
+        PROCESS_INFORMATION proc_info = {};
+
+        // The command line may be written to. This is longer than any target that svr_encoder takes.
+        char cmd[1024];
+        SVR_COPY_STRING(target, cmd);
+
+        BOOL created = CreateProcessA(NULL, cmd, NULL, NULL, TRUE, CREATE_NO_WINDOW, NULL, NULL, &start_info, &proc_info);
+
+        CloseHandle(read_h); // The child has its own now.
+
+        if (!created)
+        {
+            DWORD error_code = GetLastError();
+
+            SVR_SNPRINTF(p->message, "ERROR: Could not start pipe command %s (%lu)\n", target, error_code);
+            goto rfail;
+        }
+
+        CloseHandle(proc_info.hThread);
+        p->process_h = proc_info.hProcess;
+    }
+
+    ret = true;
+    goto rexit;
+
+rfail:
+    if (p->write_h)
+    {
+        CloseHandle((HANDLE)p->write_h);
+        p->write_h = NULL;
+    }
+
+rexit:
+    return ret;
+}
+
+bool svr_pipe_write(SvrPipe* p, const void* data, s32 size)
+{
+    const u8* pos = (const u8*)data;
+
+    while (size > 0)
+    {
+        DWORD written = 0;
+
+        if (!WriteFile((HANDLE)p->write_h, pos, size, &written, NULL))
+        {
+            DWORD error_code = GetLastError();
+
+            SVR_SNPRINTF(p->message, "ERROR: Could not write to pipe (%lu)\n", error_code);
+            return false;
+        }
+
+        pos += written;
+        size -= written;
+    }
+
+    return true;
+}
+
+bool svr_pipe_close(SvrPipe* p)
+{
+    bool ret = true;
+
+    if (p->write_h)
+    {
+        CloseHandle((HANDLE)p->write_h);
+        p->write_h = NULL;
+    }
+
+    // The child process may still be working on what it has read.
+    if (p->process_h)
+    {
+        WaitForSingleObject((HANDLE)p->process_h, INFINITE);
+
+        DWORD exit_code = 0;
+        GetExitCodeProcess((HANDLE)p->process_h, &exit_code);
+
+        if (exit_code != 0)
+        {
+            SVR_SNPRINTF(p->message, "ERROR: Pipe command exited with code %lu\n", exit_code);
+            ret = false;
+        }
+
+        CloseHandle((HANDLE)p->process_h);
+        p->process_h = NULL;
+    }
+
+    return ret;
+}
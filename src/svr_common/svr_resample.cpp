@@ -0,0 +1,520 @@
+#include "svr_resample.h"
+#include "svr_alloc.h"
+#include <string.h>
+#include <math.h>
+#include <immintrin.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+// The AVX2 functions are only called when the processor has it. MSVC allows the intrinsics anywhere, but other compilers
+// must be told that these functions can use them.
+#ifdef _MSC_VER
+#define SVR_RESAMPLE_AVX2
+#else
+#define SVR_RESAMPLE_AVX2 __attribute__((target("avx2,fma")))
+#endif
+
+const double SVR_RESAMPLE_CUTOFF = 0.97;
+const double SVR_RESAMPLE_KAISER_BETA = 9.0;
+const double SVR_RESAMPLE_PI = 3.14159265358979323846;
+const s32 SVR_RESAMPLE_MIN_HISTORY = 8192; // Samples per channel.
+
+const float SVR_RESAMPLE_S16_TO_FLOAT = 1.0f / 32768.0f;
+
+static void svr_resample_cpuid(int* regs, int leaf)
+{
+#ifdef _MSC_VER
+    __cpuidex(regs, leaf, 0);
+#else
+    __cpuid_count(leaf, 0, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+static u64 svr_resample_xgetbv()
+{
+#ifdef _MSC_VER
+    return _xgetbv(0);
+#else
+    u32 lo;
+    u32 hi;
+    __asm__("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+    return ((u64)hi << 32) | lo;
+#endif
+}
+
+bool svr_resample_has_avx2()
+{
+    int regs[4];
+
+    svr_resample_cpuid(regs, 0);
+
+    if (regs[0] < 7)
+    {
+        return false;
+    }
+
+    svr_resample_cpuid(regs, 1);
+
+    bool has_fma = regs[2] & (1 << 12);
+    bool has_osxsave = regs[2] & (1 << 27);
+    bool has_avx = regs[2] & (1 << 28);
+
+    if (!has_fma || !has_osxsave || !has_avx)
+    {
+        return false;
+    }
+
+    // The operating system must save the ymm registers.
+    if ((svr_resample_xgetbv() & 6) != 6)
+    {
+        return false;
+    }
+
+    svr_resample_cpuid(regs, 7);
+
+    return regs[1] & (1 << 5);
+}
+
+static s32 svr_resample_gcd(s32 a, s32 b)
+{
+    while (b != 0)
+    {
+        s32 t = a % b;
+        a = b;
+        b = t;
+    }
+
+    return a;
+}
+
+bool svr_resample_is_supported(s32 num_channels, s32 input_hz, s32 output_hz)
+{
+    if (num_channels > SVR_RESAMPLE_MAX_CHANS)
+    {
+        return false;
+    }
+
+    if (input_hz != output_hz)
+    {
+        if (output_hz / svr_resample_gcd(input_hz, output_hz) > SVR_RESAMPLE_MAX_PHASES)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Modified Bessel function of the first kind, for the Kaiser window.
+static double svr_resample_bessel_i0(double x)
+{
+    double sum = 1.0;
+    double term = 1.0;
+
+    for (s32 k = 1; k < 64; k++)
+    {
+        double v = x / (2.0 * k);
+        term *= v * v;
+        sum += term;
+
+        if (term < sum * 1e-12)
+        {
+            break;
+        }
+    }
+
+    return sum;
+}
+
+static void svr_resample_make_filter(SvrResampler* rs)
+{
+    s32 half = SVR_RESAMPLE_TAPS / 2;
+
+    // Lower the cutoff when going down in rate so there is no aliasing.
+    double cutoff = SVR_RESAMPLE_CUTOFF * svr_min(1.0, (double)rs->output_hz / (double)rs->input_hz);
+    double beta_i0 = svr_resample_bessel_i0(SVR_RESAMPLE_KAISER_BETA);
+
+    for (s32 p = 0; p < rs->num_phases; p++)
+    {
+        float* coefs = rs->filter + p * SVR_RESAMPLE_TAPS;
+
+        double frac = (double)p / (double)rs->num_phases;
+        double coefs_d[SVR_RESAMPLE_TAPS];
+        double sum = 0.0;
+
+        for (s32 k = 0; k < SVR_RESAMPLE_TAPS; k++)
+        {
+            // Distance from the point between input samples that this phase is for.
+            double x = (double)(k - (half - 1)) - frac;
+            double w = x / (double)half;
+            double window = 0.0;
+
+            if (w >= -1.0 && w <= 1.0)
+            {
+                window = svr_resample_bessel_i0(SVR_RESAMPLE_KAISER_BETA * sqrt(1.0 - w * w)) / beta_i0;
+            }
+
+            double sinc = 1.0;
+
+            if (x != 0.0)
+            {
+                double t = SVR_RESAMPLE_PI * cutoff * x;
+                sinc = sin(t) / t;
+            }
+
+            coefs_d[k] = sinc * window;
+            sum += coefs_d[k];
+        }
+
+        // Unity gain for every phase.
+        for (s32 k = 0; k < SVR_RESAMPLE_TAPS; k++)
+        {
+            coefs[k] = (float)(coefs_d[k] / sum);
+        }
+    }
+}
+
+void svr_resample_reset(SvrResampler* rs)
+{
+    rs->history_size = SVR_RESAMPLE_TAPS / 2 - 1;
+    rs->history_pos = 0;
+    rs->phase = 0;
+    rs->drained = false;
+
+    for (s32 i = 0; i < rs->num_channels; i++)
+    {
+        memset(rs->history[i], 0, rs->history_size * sizeof(float));
+    }
+}
+
+void svr_resample_free(SvrResampler* rs)
+{
+    svr_maybe_free((void**)&rs->filter);
+
+    for (s32 i = 0; i < SVR_RESAMPLE_MAX_CHANS; i++)
+    {
+        svr_maybe_free((void**)&rs->history[i]);
+    }
+
+    *rs = {};
+}
+
+void svr_resample_init(SvrResampler* rs, SvrResampleFormat output_format, s32 num_channels, s32 input_hz, s32 output_hz)
+{
+    svr_resample_free(rs);
+
+    rs->output_format = output_format;
+    rs->num_channels = num_channels;
+    rs->input_hz = input_hz;
+    rs->output_hz = output_hz;
+    rs->use_avx2 = svr_resample_has_avx2();
+    rs->resample = input_hz != output_hz;
+
+    if (rs->resample)
+    {
+        s32 gcd = svr_resample_gcd(input_hz, output_hz);
+
+        rs->num_phases = output_hz / gcd;
+        rs->step = input_hz / gcd;
+        rs->filter = (float*)svr_alloc(rs->num_phases * SVR_RESAMPLE_TAPS * sizeof(float));
+
+        svr_resample_make_filter(rs);
+
+        rs->history_capacity = SVR_RESAMPLE_MIN_HISTORY;
+
+        for (s32 i = 0; i < num_channels; i++)
+        {
+            rs->history[i] = (float*)svr_alloc(rs->history_capacity * sizeof(float));
+        }
+
+        svr_resample_reset(rs);
+    }
+}
+
+// Stereo interleaved S16 to planar float. Returns how many samples were done, the rest is left for the scalar path.
+SVR_RESAMPLE_AVX2 static s32 svr_resample_deinterleave_avx2(const s16* input, s32 num_samples, float** dest)
+{
+    s32 i = 0;
+
+    const __m256i shuffle = _mm256_setr_epi8(0, 1, 4, 5, 8, 9, 12, 13, 2, 3, 6, 7, 10, 11, 14, 15,
+                                             0, 1, 4, 5, 8, 9, 12, 13, 2, 3, 6, 7, 10, 11, 14, 15);
+    const __m256 scale = _mm256_set1_ps(SVR_RESAMPLE_S16_TO_FLOAT);
+
+    for (; i + 8 <= num_samples; i += 8)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(input + i * 2));
+
+        // Left and right together in each lane, and then the lanes are put together.
+        v = _mm256_shuffle_epi8(v, shuffle);
+        v = _mm256_permute4x64_epi64(v, _MM_SHUFFLE(3, 1, 2, 0));
+
+        __m256 l = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm256_castsi256_si128(v)));
+        __m256 r = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm256_extracti128_si256(v, 1)));
+
+        _mm256_storeu_ps(dest[0] + i, _mm256_mul_ps(l, scale));
+        _mm256_storeu_ps(dest[1] + i, _mm256_mul_ps(r, scale));
+    }
+
+    return i;
+}
+
+// Interleaved S16 to planar float.
+static void svr_resample_deinterleave(SvrResampler* rs, const s16* input, s32 num_samples, float** dest)
+{
+    s32 i = 0;
+
+    if (rs->use_avx2 && rs->num_channels == 2)
+    {
+        i = svr_resample_deinterleave_avx2(input, num_samples, dest);
+    }
+
+    for (; i < num_samples; i++)
+    {
+        for (s32 j = 0; j < rs->num_channels; j++)
+        {
+            dest[j][i] = input[i * rs->num_channels + j] * SVR_RESAMPLE_S16_TO_FLOAT;
+        }
+    }
+}
+
+// Returns how many values were done, the rest is left for the scalar path.
+SVR_RESAMPLE_AVX2 static s32 svr_resample_s16_to_flt_avx2(const s16* input, s32 num_values, float* dest)
+{
+    s32 i = 0;
+
+    const __m256 scale = _mm256_set1_ps(SVR_RESAMPLE_S16_TO_FLOAT);
+
+    for (; i + 16 <= num_values; i += 16)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(input + i));
+
+        __m256 a = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm256_castsi256_si128(v)));
+        __m256 b = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm256_extracti128_si256(v, 1)));
+
+        _mm256_storeu_ps(dest + i, _mm256_mul_ps(a, scale));
+        _mm256_storeu_ps(dest + i + 8, _mm256_mul_ps(b, scale));
+    }
+
+    return i;
+}
+
+// Interleaved S16 to interleaved float.
+static void svr_resample_s16_to_flt(SvrResampler* rs, const s16* input, s32 num_values, float* dest)
+{
+    s32 i = 0;
+
+    if (rs->use_avx2)
+    {
+        i = svr_resample_s16_to_flt_avx2(input, num_values, dest);
+    }
+
+    for (; i < num_values; i++)
+    {
+        dest[i] = input[i] * SVR_RESAMPLE_S16_TO_FLOAT;
+    }
+}
+
+static s16 svr_resample_float_to_s16(float v)
+{
+    s32 i = (s32)lrintf(v * 32768.0f);
+    svr_clamp(&i, -32768, 32767);
+    return (s16)i;
+}
+
+void svr_resample_convert(SvrResampler* rs, u8** dest, const s16* input, s32 num_samples)
+{
+    s32 num_channels = rs->num_channels;
+
+    switch (rs->output_format)
+    {
+        case SVR_RESAMPLE_S16:
+        {
+            memcpy(dest[0], input, num_samples * num_channels * sizeof(s16));
+            break;
+        }
+
+        case SVR_RESAMPLE_S16P:
+        {
+            for (s32 i = 0; i < num_samples; i++)
+            {
+                for (s32 j = 0; j < num_channels; j++)
+                {
+                    ((s16*)dest[j])[i] = input[i * num_channels + j];
+                }
+            }
+
+            break;
+        }
+
+        case SVR_RESAMPLE_FLT:
+        {
+            svr_resample_s16_to_flt(rs, input, num_samples * num_channels, (float*)dest[0]);
+            break;
+        }
+
+        case SVR_RESAMPLE_FLTP:
+        {
+            svr_resample_deinterleave(rs, input, num_samples, (float**)dest);
+            break;
+        }
+    }
+}
+
+// Sum of 32 taps.
+SVR_RESAMPLE_AVX2 static float svr_resample_dot_avx2(const float* samples, const float* coefs)
+{
+    __m256 a = _mm256_mul_ps(_mm256_loadu_ps(samples), _mm256_loadu_ps(coefs));
+    __m256 b = _mm256_mul_ps(_mm256_loadu_ps(samples + 8), _mm256_loadu_ps(coefs + 8));
+    a = _mm256_fmadd_ps(_mm256_loadu_ps(samples + 16), _mm256_loadu_ps(coefs + 16), a);
+    b = _mm256_fmadd_ps(_mm256_loadu_ps(samples + 24), _mm256_loadu_ps(coefs + 24), b);
+
+    a = _mm256_add_ps(a, b);
+
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(a), _mm256_extractf128_ps(a, 1));
+    s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+    s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+
+    return _mm_cvtss_f32(s);
+}
+
+static float svr_resample_dot(const float* samples, const float* coefs)
+{
+    float sum = 0.0f;
+
+    for (s32 i = 0; i < SVR_RESAMPLE_TAPS; i++)
+    {
+        sum += samples[i] * coefs[i];
+    }
+
+    return sum;
+}
+
+// Makes room for this many more input samples per channel at the end of the history.
+static void svr_resample_reserve_history(SvrResampler* rs, s32 num_samples)
+{
+    // Samples before the position are not needed anymore.
+    if (rs->history_pos > 0)
+    {
+        s32 keep = rs->history_size - rs->history_pos;
+
+        for (s32 i = 0; i < rs->num_channels; i++)
+        {
+            memmove(rs->history[i], rs->history[i] + rs->history_pos, keep * sizeof(float));
+        }
+
+        rs->history_size = keep;
+        rs->history_pos = 0;
+    }
+
+    if (rs->history_size + num_samples > rs->history_capacity)
+    {
+        s32 new_capacity = svr_max(rs->history_capacity * 2, rs->history_size + num_samples);
+
+        for (s32 i = 0; i < rs->num_channels; i++)
+        {
+            float* mem = (float*)svr_alloc(new_capacity * sizeof(float));
+            memcpy(mem, rs->history[i], rs->history_size * sizeof(float));
+
+            svr_free(rs->history[i]);
+            rs->history[i] = mem;
+        }
+
+        rs->history_capacity = new_capacity;
+    }
+}
+
+static void svr_resample_append_history(SvrResampler* rs, const s16* input, s32 num_samples)
+{
+    svr_resample_reserve_history(rs, num_samples);
+
+    float* dest[SVR_RESAMPLE_MAX_CHANS];
+
+    for (s32 i = 0; i < rs->num_channels; i++)
+    {
+        dest[i] = rs->history[i] + rs->history_size;
+    }
+
+    svr_resample_deinterleave(rs, input, num_samples, dest);
+    rs->history_size += num_samples;
+}
+
+s32 svr_resample_process(SvrResampler* rs, u8** dest, s32 space, const s16* input, s32 num_samples)
+{
+    if (num_samples > 0)
+    {
+        svr_resample_append_history(rs, input, num_samples);
+    }
+
+    s32 num_channels = rs->num_channels;
+    s32 num_written = 0;
+
+    while (num_written < space && rs->history_pos + SVR_RESAMPLE_TAPS <= rs->history_size)
+    {
+        const float* coefs = rs->filter + rs->phase * SVR_RESAMPLE_TAPS;
+
+        for (s32 i = 0; i < num_channels; i++)
+        {
+            const float* samples = rs->history[i] + rs->history_pos;
+            float v = rs->use_avx2 ? svr_resample_dot_avx2(samples, coefs) : svr_resample_dot(samples, coefs);
+
+            switch (rs->output_format)
+            {
+                case SVR_RESAMPLE_FLTP:
+                {
+                    ((float*)dest[i])[num_written] = v;
+                    break;
+                }
+
+                case SVR_RESAMPLE_FLT:
+                {
+                    ((float*)dest[0])[num_written * num_channels + i] = v;
+                    break;
+                }
+
+                case SVR_RESAMPLE_S16P:
+                {
+                    ((s16*)dest[i])[num_written] = svr_resample_float_to_s16(v);
+                    break;
+                }
+
+                case SVR_RESAMPLE_S16:
+                {
+                    ((s16*)dest[0])[num_written * num_channels + i] = svr_resample_float_to_s16(v);
+                    break;
+                }
+            }
+        }
+
+        num_written++;
+
+        rs->phase += rs->step;
+        rs->history_pos += rs->phase / rs->num_phases;
+        rs->phase %= rs->num_phases;
+    }
+
+    return num_written;
+}
+
+s32 svr_resample_drain(SvrResampler* rs, u8** dest, s32 space)
+{
+    if (!rs->drained)
+    {
+        s32 num_pad = SVR_RESAMPLE_TAPS / 2;
+
+        svr_resample_reserve_history(rs, num_pad);
+
+        for (s32 i = 0; i < rs->num_channels; i++)
+        {
+            memset(rs->history[i] + rs->history_size, 0, num_pad * sizeof(float));
+        }
+
+        rs->history_size += num_pad;
+        rs->drained = true;
+    }
+
+    return svr_resample_process(rs, dest, space, NULL, 0);
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include "svr_common.h"
+
+// Resampling and sample format conversion of the audio from svr_game.
+// The game gives interleaved S16 at 44100 or 48000 hz, so this covers the conversions to the S16 and float formats that the
+// audio encoders take. This is faster than libswresample for these cases and can be done on the main thread of svr_encoder, so the
+// audio thread is not needed. Other conversions still go through libswresample, see audio_create_resampler.
+// The resampler is a polyphase windowed sinc filter with the same length, cutoff and Kaiser window as the default of libswresample.
+// Measured against libswresample with svr_encoder --benchmark, and against a reference resampler in svr_tests/svr_resample_test.cpp.
+// Only standard C and the x86 intrinsics are used here so this can be used and tested outside of Windows.
+
+const s32 SVR_RESAMPLE_TAPS = 32; // Filter length of every phase, same as the default of libswresample.
+const s32 SVR_RESAMPLE_MAX_PHASES = 1024; // Rates with a ratio that needs more phases than this go through libswresample.
+const s32 SVR_RESAMPLE_MAX_CHANS = 8;
+
+// Same as the AVSampleFormat of the same name.
+using SvrResampleFormat = s32;
+
+enum // SvrResampleFormat
+{
+    SVR_RESAMPLE_S16,
+    SVR_RESAMPLE_S16P,
+    SVR_RESAMPLE_FLT,
+    SVR_RESAMPLE_FLTP,
+};
+
+struct SvrResampler
+{
+    SvrResampleFormat output_format; // Input is always interleaved S16.
+    s32 num_channels;
+    s32 input_hz;
+    s32 output_hz;
+
+    bool use_avx2;
+
+    // Only used when the rates are different.
+    // For every step input samples there are num_phases output samples.
+    bool resample;
+    s32 num_phases;
+    s32 step;
+    float* filter; // SVR_RESAMPLE_TAPS coefficients for every phase.
+
+    // Input samples per channel that are still needed for the next output samples.
+    float* history[SVR_RESAMPLE_MAX_CHANS];
+    s32 history_size;
+    s32 history_capacity;
+    s32 history_pos; // First input sample of the next output sample.
+    s32 phase; // Phase of the next output sample.
+    bool drained; // Silence has been added after the last input, see svr_resample_drain.
+};
+
+// Needs both the processor and the operating system to support AVX2 and FMA.
+bool svr_resample_has_avx2();
+
+bool svr_resample_is_supported(s32 num_channels, s32 input_hz, s32 output_hz);
+
+// The resampler must be supported, see svr_resample_is_supported.
+// The AVX2 path is used if the processor has it, which can be turned off with use_avx2 after this.
+void svr_resample_init(SvrResampler* rs, SvrResampleFormat output_format, s32 num_channels, s32 input_hz, s32 output_hz);
+
+// Starts over for a new movie with silence before the first samples.
+// The first output sample is then in line with the first input sample, like libswresample.
+void svr_resample_reset(SvrResampler* rs);
+
+void svr_resample_free(SvrResampler* rs);
+
+// Converts samples without changing the rate. The destination pointers are where the samples should be written to, like swr_convert.
+void svr_resample_convert(SvrResampler* rs, u8** dest, const s16* input, s32 num_samples);
+
+// Resamples into the destination pointers and returns how many samples were written, at most space.
+// Like swr_convert, the input that does not fit is kept and is given on later calls (which can have no input).
+s32 svr_resample_process(SvrResampler* rs, u8** dest, s32 space, const s16* input, s32 num_samples);
+
+// Gives the samples that are still held back for the filter at the end of the movie, like swr_convert with no input.
+// The input is padded with silence, so the last output sample is in line with the last input sample.
+// Call until it returns less than space. Nothing more can be given to the resampler until it is reset.
+s32 svr_resample_drain(SvrResampler* rs, u8** dest, s32 space);
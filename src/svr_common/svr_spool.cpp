@@ -0,0 +1,266 @@
+#include "svr_spool.h"
+#include "svr_alloc.h"
+#include <string.h>
+
+// Spool files are many gigabytes, which goes past what a long can hold on Windows.
+#ifdef _WIN32
+#define SVR_SPOOL_SEEK _fseeki64
+#define SVR_SPOOL_TELL _ftelli64
+#else
+#define SVR_SPOOL_SEEK fseeko
+#define SVR_SPOOL_TELL ftello
+#endif
+
+// Most audio records are the samples of one frame, so this is only grown for the first few records.
+const s32 SVR_SPOOL_INITIAL_AUDIO_BUFFER = 64 * 1024;
+
+bool svr_spool_open(const char* path, SvrSpool* spool)
+{
+    bool ret = false;
+    FILE* file = NULL;
+    s64 index_size;
+
+    *spool = {};
+
+    SVR_COPY_STRING(path, spool->path);
+
+    file = fopen(path, "rb");
+
+    if (file == NULL)
+    {
+        SVR_SNPRINTF(spool->message, "Could not open spool file %s\n", path);
+        goto rfail;
+    }
+
+    SVR_SPOOL_SEEK(file, 0, SEEK_END);
+    spool->file_size = SVR_SPOOL_TELL(file);
+    SVR_SPOOL_SEEK(file, 0, SEEK_SET);
+
+    if (fread(&spool->header, sizeof(SvrSpoolHeader), 1, file) != 1)
+    {
+        SVR_SNPRINTF(spool->message, "Spool file %s is too small\n", path);
+        goto rfail;
+    }
+
+    if (memcmp(spool->header.magic, SVR_SPOOL_MAGIC, sizeof(SVR_SPOOL_MAGIC)))
+    {
+        SVR_SNPRINTF(spool->message, "%s is not a spool file\n", path);
+        goto rfail;
+    }
+
+    if (spool->header.version != SVR_SPOOL_VERSION)
+    {
+        SVR_SNPRINTF(spool->message, "Spool file has version %d but version %d is needed\n", spool->header.version, SVR_SPOOL_VERSION);
+        goto rfail;
+    }
+
+    if (spool->header.num_planes < 1 || spool->header.num_planes > SVR_SPOOL_MAX_PLANES || spool->header.num_records < 0)
+    {
+        SVR_SNPRINTF(spool->message, "Spool file %s is damaged\n", path);
+        goto rfail;
+    }
+
+    index_size = spool->header.num_records * (s64)sizeof(SvrSpoolRecord);
+
+    if (spool->header.index_offset == 0 || spool->header.index_offset + index_size > spool->file_size)
+    {
+        SVR_COPY_STRING("Spool file was not finished and cannot be used\n", spool->message);
+        goto rfail;
+    }
+
+    spool->records = SVR_ZALLOC_NUM(SvrSpoolRecord, svr_max(spool->header.num_records, 1));
+
+    SVR_SPOOL_SEEK(file, spool->header.index_offset, SEEK_SET);
+
+    if (fread(spool->records, sizeof(SvrSpoolRecord), spool->header.num_records, file) != (size_t)spool->header.num_records)
+    {
+        SVR_SNPRINTF(spool->message, "Could not read the index of spool file %s\n", path);
+        goto rfail;
+    }
+
+    ret = true;
+    goto rexit;
+
+rfail:
+    svr_maybe_free((void**)&spool->records);
+
+rexit:
+    if (file)
+    {
+        fclose(file);
+    }
+
+    return ret;
+}
+
+void svr_spool_close(SvrSpool* spool)
+{
+    svr_maybe_free((void**)&spool->records);
+}
+
+s32 svr_spool_plan_chunks(SvrSpool* spool, s32 max_chunks, SvrSpoolChunk* chunks)
+{
+    s32 num_video_frames = spool->header.num_video_frames;
+    s32 num_chunks = max_chunks;
+
+    if (num_video_frames == 0)
+    {
+        return 0;
+    }
+
+    svr_clamp(&num_chunks, 1, SVR_SPOOL_MAX_CHUNKS);
+    svr_clamp(&num_chunks, 1, svr_max(num_video_frames / SVR_SPOOL_MIN_CHUNK_FRAMES, 1));
+
+    // Rounding the size up can leave nothing for the last chunks, so there may be fewer of them.
+    s32 chunk_size = (num_video_frames + num_chunks - 1) / num_chunks;
+    num_chunks = (num_video_frames + chunk_size - 1) / chunk_size;
+
+    for (s32 i = 0; i < num_chunks; i++)
+    {
+        SvrSpoolChunk* chunk = &chunks[i];
+        *chunk = {};
+
+        chunk->index = i;
+        chunk->first_frame = i * chunk_size;
+        chunk->num_frames = svr_min(chunk_size, num_video_frames - chunk->first_frame);
+        chunk->use_audio = spool->header.movie_params.use_audio && i == 0;
+    }
+
+    return num_chunks;
+}
+
+// Planes are packed tightly in the spool, but the destination may have padding at the end of each row.
+static bool svr_spool_read_video_frame(SvrSpool* spool, FILE* file, u8** planes, s32* strides)
+{
+    for (s32 i = 0; i < spool->header.num_planes; i++)
+    {
+        s32 row_size = spool->header.plane_row_sizes[i];
+        s32 height = spool->header.plane_heights[i];
+        u8* dest_ptr = planes[i];
+
+        if (strides[i] == row_size)
+        {
+            if (fread(dest_ptr, row_size, height, file) != (size_t)height)
+            {
+                return false;
+            }
+
+            continue;
+        }
+
+        for (s32 j = 0; j < height; j++)
+        {
+            if (fread(dest_ptr, row_size, 1, file) != 1)
+            {
+                return false;
+            }
+
+            dest_ptr += strides[i];
+        }
+    }
+
+    return true;
+}
+
+bool svr_spool_run_chunk(SvrSpool* spool, SvrSpoolChunk* chunk, SvrSpoolSink* sink)
+{
+    bool ret = false;
+    FILE* file = NULL;
+    u8* audio_buf = NULL;
+    s32 audio_buf_size = 0;
+
+    s32 frame_idx = 0;
+    s32 end_frame = chunk->first_frame + chunk->num_frames;
+
+    // Every chunk reads by itself so the chunks don't have to wait for each other.
+    file = fopen(spool->path, "rb");
+
+    if (file == NULL)
+    {
+        SVR_SNPRINTF(chunk->message, "Could not open spool file %s\n", spool->path);
+        goto rfail;
+    }
+
+    for (s32 i = 0; i < spool->header.num_records; i++)
+    {
+        SvrSpoolRecord* record = &spool->records[i];
+
+        if (record->type == SVR_SPOOL_RECORD_VIDEO)
+        {
+            if (frame_idx >= chunk->first_frame && frame_idx < end_frame)
+            {
+                u8* planes[SVR_SPOOL_MAX_PLANES] = {};
+                s32 strides[SVR_SPOOL_MAX_PLANES] = {};
+
+                if (!sink->get_video_frame(sink->user, planes, strides))
+                {
+                    goto rfail;
+                }
+
+                SVR_SPOOL_SEEK(file, record->offset, SEEK_SET);
+
+                if (!svr_spool_read_video_frame(spool, file, planes, strides))
+                {
+                    SVR_SNPRINTF(chunk->message, "Could not read video frame %d from the spool file\n", frame_idx);
+                    goto rfail;
+                }
+
+                // Timestamps are for the whole movie, so the chunks can be put together as they are.
+                if (!sink->submit_video_frame(sink->user, frame_idx))
+                {
+                    goto rfail;
+                }
+            }
+
+            frame_idx++;
+
+            // Only the chunk with the audio has to go through the whole spool.
+            if (frame_idx >= end_frame && !chunk->use_audio)
+            {
+                break;
+            }
+        }
+
+        else if (record->type == SVR_SPOOL_RECORD_AUDIO)
+        {
+            if (!chunk->use_audio)
+            {
+                continue;
+            }
+
+            if (record->size > audio_buf_size)
+            {
+                audio_buf_size = svr_max((s32)record->size, SVR_SPOOL_INITIAL_AUDIO_BUFFER);
+                audio_buf = (u8*)svr_realloc(audio_buf, audio_buf_size);
+            }
+
+            SVR_SPOOL_SEEK(file, record->offset, SEEK_SET);
+
+            if (fread(audio_buf, record->size, 1, file) != 1)
+            {
+                SVR_COPY_STRING("Could not read audio from the spool file\n", chunk->message);
+                goto rfail;
+            }
+
+            if (!sink->submit_audio_samples(sink->user, audio_buf, record->num_samples))
+            {
+                goto rfail;
+            }
+        }
+    }
+
+    ret = true;
+    goto rexit;
+
+rfail:
+
+rexit:
+    if (file)
+    {
+        fclose(file);
+    }
+
+    svr_maybe_free((void**)&audio_buf);
+
+    return ret;
+}
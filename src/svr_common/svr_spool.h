@@ -0,0 +1,110 @@
+#pragma once
+#include "svr_common.h"
+#include "encoder_shared.h"
+
+// Spool files have the uncompressed video frames (already converted to the pixel format of the encoder) and audio samples
+// (in the format from svr_game) of a movie. They are written by svr_encoder in spool mode and later encoded with svr_encoder --from-spool.
+// The file starts with a SvrSpoolHeader, followed by the data of the records, followed by the SvrSpoolRecord index.
+// The index is written last, so a spool file that was not finished cannot be used.
+//
+// The video frames are encoded in chunks that can be done in parallel, and which are then put together into the final movie.
+// Reading the spool and splitting it into chunks does not need the game or a GPU, so this is kept apart from the encoder
+// which only gives the frames and samples to its codecs. Every chunk reads the spool file by itself, so the chunks can run on any threads.
+// Only standard C is used here so this can be used and tested outside of Windows.
+
+const char SVR_SPOOL_MAGIC[8] = { 'S', 'V', 'R', 'S', 'P', 'O', 'O', 'L' };
+const s32 SVR_SPOOL_VERSION = 1;
+
+const s32 SVR_SPOOL_MAX_PLANES = 3; // At most, YUV uses 3 planes.
+
+const s32 SVR_SPOOL_MAX_CHUNKS = 16;
+const s32 SVR_SPOOL_MIN_CHUNK_FRAMES = 60; // Chunks that are too small are not worth the extra keyframe.
+
+using SvrSpoolRecordType = s32;
+
+enum // SvrSpoolRecordType
+{
+    SVR_SPOOL_RECORD_VIDEO, // Planes are tightly packed one after another.
+    SVR_SPOOL_RECORD_AUDIO, // Interleaved samples.
+};
+
+struct SvrSpoolRecord
+{
+    SvrSpoolRecordType type;
+    s32 num_samples; // For audio.
+    s64 offset; // Where the data is in the file.
+    s64 size;
+};
+
+struct SvrSpoolHeader
+{
+    char magic[8];
+    s32 version;
+
+    s32 num_planes;
+    s32 plane_row_sizes[SVR_SPOOL_MAX_PLANES]; // Bytes per row.
+    s32 plane_heights[SVR_SPOOL_MAX_PLANES];
+
+    s32 num_records;
+    s32 num_video_frames;
+    s64 index_offset; // Where the SvrSpoolRecord index starts. This is 0 if the spool was not finished.
+
+    EncoderSharedMovieParams movie_params; // The destination file is where the encoded movie will be written.
+};
+
+// A spool file opened for reading. The header and the index are kept in memory.
+struct SvrSpool
+{
+    char path[260];
+    s64 file_size;
+
+    SvrSpoolHeader header;
+    SvrSpoolRecord* records;
+
+    char message[256]; // Why the spool could not be opened.
+};
+
+// Range of video frames that are encoded together into one file.
+struct SvrSpoolChunk
+{
+    s32 index;
+
+    s32 first_frame;
+    s32 num_frames;
+
+    bool use_audio; // Only the first chunk has the audio, which goes through the whole spool.
+
+    char message[256]; // Why the chunk could not be read.
+};
+
+// Receives the data of a chunk in the order of the spool. Called on the thread that runs the chunk.
+// The functions return false to stop the chunk, such as when the encoder has failed.
+struct SvrSpoolSink
+{
+    void* user;
+
+    // Gives the planes that the next video frame is read into.
+    // Rows are stride bytes apart, which can be more than the row size of the plane in the spool.
+    bool(*get_video_frame)(void* user, u8** planes, s32* strides);
+
+    // The planes from get_video_frame have been filled. The pts is the index of the frame in the whole movie.
+    bool(*submit_video_frame)(void* user, s64 pts);
+
+    // The samples are only valid during the call.
+    bool(*submit_audio_samples)(void* user, void* samples, s32 num_samples);
+};
+
+// Reads the header and index of the spool at path. The message of the spool says why this failed.
+bool svr_spool_open(const char* path, SvrSpool* spool);
+
+// Call when no longer needed.
+void svr_spool_close(SvrSpool* spool);
+
+// Splits the video frames into at most max_chunks chunks of the same size, but not smaller than SVR_SPOOL_MIN_CHUNK_FRAMES.
+// Every chunk starts with a keyframe, so don't ask for too many of them. There must be room for SVR_SPOOL_MAX_CHUNKS chunks.
+// Returns the number of chunks.
+s32 svr_spool_plan_chunks(SvrSpool* spool, s32 max_chunks, SvrSpoolChunk* chunks);
+
+// Reads the frames of the chunk (and the audio if the chunk has it) and gives them to the sink.
+// Returns false if the spool could not be read, in which case the message of the chunk says why, or if the sink stopped the chunk.
+bool svr_spool_run_chunk(SvrSpool* spool, SvrSpoolChunk* chunk, SvrSpoolSink* sink);
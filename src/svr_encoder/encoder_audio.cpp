@@ -2,6 +2,39 @@
 
 // Conversion from game audio format to audio encoder format.
 
+// The sample formats that our own resampler can write, see svr_resample.h.
+bool audio_get_resample_format(AVSampleFormat format, SvrResampleFormat* dest)
+{
+    switch (format)
+    {
+        case AV_SAMPLE_FMT_S16:
+        {
+            *dest = SVR_RESAMPLE_S16;
+            return true;
+        }
+
+        case AV_SAMPLE_FMT_S16P:
+        {
+            *dest = SVR_RESAMPLE_S16P;
+            return true;
+        }
+
+        case AV_SAMPLE_FMT_FLT:
+        {
+            *dest = SVR_RESAMPLE_FLT;
+            return true;
+        }
+
+        case AV_SAMPLE_FMT_FLTP:
+        {
+            *dest = SVR_RESAMPLE_FLTP;
+            return true;
+        }
+    }
+
+    return false;
+}
+
 bool EncoderState::audio_init()
 {
     return true;
@@ -9,22 +42,21 @@ bool EncoderState::audio_init()
 
 void EncoderState::audio_free_static()
 {
+    swr_free(&audio_swr);
+    svr_resample_free(&audio_resampler);
 }
 
 void EncoderState::audio_free_dynamic()
 {
-    if (audio_output_buffers[0])
-    {
-        av_freep(&audio_output_buffers[0]);
-    }
+    // The resampler is kept for the next movie, see audio_create_resampler.
 
-    swr_free(&audio_swr);
-
-    if (audio_fifo)
+    // Only left if the movie stopped because of an error, as the frame is submitted when the movie ends normally.
+    if (audio_frame)
     {
-        av_audio_fifo_free(audio_fifo);
-        audio_fifo = NULL;
+        av_frame_free(&audio_frame);
     }
+
+    audio_frame_pos = 0;
 }
 
 bool EncoderState::audio_start()
@@ -36,10 +68,9 @@ bool EncoderState::audio_start()
         goto rfail;
     }
 
-    if (!audio_create_fifo())
-    {
-        goto rfail;
-    }
+    audio_frame = NULL;
+    audio_frame_pos = 0;
+    audio_copied_bytes = 0;
 
     ret = true;
     goto rexit;
@@ -55,21 +86,15 @@ bool EncoderState::audio_create_resampler()
     bool ret = false;
     s32 res;
 
-    audio_input_hz = movie_params.audio_hz;
-    audio_output_hz = movie_params.audio_hz;
-
-    // Set from encoder if it requires a set sample rate.
-    if (render_audio_info->hz != 0)
-    {
-        audio_output_hz = render_audio_info->hz;
-    }
-
-    audio_num_channels = movie_params.audio_channels;
+    s32 input_hz = movie_params.audio_hz;
+    s32 output_hz = render_audio_hz;
 
     AVChannelLayout channel_layout;
     av_channel_layout_default(&channel_layout, movie_params.audio_channels);
 
     AVSampleFormat input_format; // Sample format we get from svr_game.
+    AVSampleFormat output_format = render_audio_sample_format;
+    SvrResampleFormat resample_format;
 
     switch (movie_params.audio_bits)
     {
@@ -86,32 +111,83 @@ bool EncoderState::audio_create_resampler()
         }
     }
 
+    // The resampler from the previous movie can be reused if the conversion is the same.
+    if (input_format != audio_input_format || input_hz != audio_input_hz || output_hz != audio_output_hz)
+    {
+        swr_free(&audio_swr);
+    }
+
+    if (output_format != audio_output_format || movie_params.audio_channels != audio_num_channels)
+    {
+        swr_free(&audio_swr);
+    }
+
+    audio_use_native = false;
+
+    audio_input_format = input_format;
+    audio_output_format = output_format;
+    audio_input_hz = input_hz;
+    audio_output_hz = output_hz;
+    audio_num_channels = movie_params.audio_channels;
+
     // If the input is matching the output, we can just copy directly over and we don't need to do any of this. Nice!
 
-    if (input_format == render_audio_info->sample_format)
+    if (input_format == output_format)
     {
-        if (audio_input_hz == audio_output_hz)
+        if (input_hz == output_hz)
         {
             ret = true;
             goto rexit;
         }
     }
 
-    audio_output_size = 0;
-
-    for (s32 i = 0; i < AUDIO_MAX_CHANS; i++)
+    if (input_format == AV_SAMPLE_FMT_S16 && audio_get_resample_format(output_format, &resample_format) && svr_resample_is_supported(audio_num_channels, input_hz, output_hz))
     {
-        audio_output_buffers[i] = NULL;
+        // Not used for this movie, so it does not have to be kept.
+        swr_free(&audio_swr);
+
+        SvrResampler* rs = &audio_resampler;
+
+        if (rs->num_channels == audio_num_channels && rs->output_format == resample_format && rs->input_hz == input_hz && rs->output_hz == output_hz)
+        {
+            svr_log("Reusing audio resampler from previous movie\n");
+
+            if (rs->resample)
+            {
+                svr_resample_reset(rs);
+            }
+        }
+
+        else
+        {
+            svr_resample_init(rs, resample_format, audio_num_channels, input_hz, output_hz);
+        }
+
+        svr_log("Using own audio resampler (%s)\n", rs->use_avx2 ? "AVX2" : "no AVX2");
+
+        audio_use_native = true;
+
+        ret = true;
+        goto rexit;
     }
 
-    res = swr_alloc_set_opts2(&audio_swr, &channel_layout, render_audio_info->sample_format, audio_output_hz, &channel_layout, input_format, audio_input_hz, 0, NULL);
+    if (audio_swr == NULL)
+    {
+        res = swr_alloc_set_opts2(&audio_swr, &channel_layout, output_format, output_hz, &channel_layout, input_format, input_hz, 0, NULL);
 
-    if (res < 0)
+        if (res < 0)
+        {
+            error("ERROR: Could not create audio resampler (%d)\n", res);
+            goto rfail;
+        }
+    }
+
+    else
     {
-        error("ERROR: Could not create audio resampler (%d)\n", res);
-        goto rfail;
+        svr_log("Reusing audio resampler from previous movie\n");
     }
 
+    // This also clears out any samples that were left in the resampler from the previous movie.
     res = swr_init(audio_swr);
 
     if (res < 0)
@@ -130,92 +206,194 @@ rexit:
     return ret;
 }
 
-bool EncoderState::audio_create_fifo()
+// Writes samples from svr_game straight into the frames that are given to the encoder, and converts them on the way if needed.
+// Some encoders only work with a fixed amount of samples, so a frame is only submitted when it has been filled up.
+void EncoderState::audio_write_samples(void* mem, s32 num_samples)
 {
-    bool ret = false;
-
-    audio_fifo = av_audio_fifo_alloc(render_audio_info->sample_format, audio_num_channels, render_audio_ctx->frame_size * 2);
+    const u8* input = (const u8*)mem;
+    s32 frame_size = render_audio_ctx->frame_size;
+    s32 input_sample_size = render_get_audio_buffer_size(1);
+    s32 output_sample_size = av_get_bytes_per_sample(audio_output_format) * audio_num_channels;
 
-    if (audio_fifo == NULL)
+    while (true)
     {
-        error("ERROR: Could not create audio fifo");
-        goto rfail;
-    }
+        if (audio_frame == NULL)
+        {
+            audio_frame = render_get_new_audio_frame();
+            audio_frame_pos = 0;
 
-    ret = true;
-    goto rexit;
+            if (audio_frame == NULL)
+            {
+                break;
+            }
+        }
 
-rfail:
+        u8* dest[AUDIO_MAX_CHANS];
+        audio_get_frame_pointers(dest);
 
-rexit:
-    return ret;
-}
+        s32 space = frame_size - audio_frame_pos;
+        s32 num_written = 0;
 
-// Copies the audio samples into the fifo.
-// The samples get converted if needed.
-void EncoderState::audio_convert_to_codec_samples(RenderAudioThreadInput* buffer)
-{
-    // Try to avoid extra procesing if we can.
-    // If we have matching input and output parameters, just copy over and return.
+        if (audio_need_conversion())
+        {
+            // The resampler keeps the input that does not fit in the frame, so the input is only given on the first call.
+            // Later calls with no input give the rest. The resampler also keeps some samples for the interpolation with
+            // the next samples, so the number of samples we get back is not exactly the amount given in.
+            num_written = swr_convert(audio_swr, dest, space, &input, num_samples);
+            num_samples = 0;
 
-    if (audio_need_conversion())
-    {
-        // The delay are queued samples that are needed when resampling, because the resampling algorithm
-        // requires future samples for interpolation. This may be 16 samples for example, that will be used to interpolate
-        // with future samples we give it. Those samples are accounted for here, so they will not be forgotten about.
-        // This is why you cannot get exact amount of samples back that you give in, as then you would notice the harsh
-        // change in the curve where the interpolation breaks. If no resampling is needed (if the sample rate matches what we want)
-        // then there will not be any queued samples.
-        // We must always fill at least one paint buffer. If we end up getting more samples than anticipated, then those will be stored in the channel.
-        s64 delay = swr_get_delay(audio_swr, audio_input_hz);
+            if (num_written < 0)
+            {
+                break;
+            }
+        }
 
-        // Don't use more than necessary here, because we should not be receiving tons of more samples than we need.
-        s64 estimated = av_rescale_rnd(delay + (int64_t)buffer->num_samples, audio_output_hz, audio_input_hz, AV_ROUND_UP);
+        // Same as with libswresample, the input that does not fit in the frame is kept in the resampler.
+        else if (audio_use_native && audio_resampler.resample)
+        {
+            num_written = svr_resample_process(&audio_resampler, dest, space, (const s16*)input, num_samples);
+            num_samples = 0;
+        }
 
-        // Grow buffer.
-        if (estimated > audio_output_size)
+        // Same rate, so the samples are just copied or converted over.
+        else
         {
-            if (audio_output_buffers[0])
+            if (num_samples == 0)
+            {
+                break;
+            }
+
+            num_written = svr_min(num_samples, space);
+
+            if (audio_use_native)
             {
-                av_freep(&audio_output_buffers[0]);
+                svr_resample_convert(&audio_resampler, dest, (const s16*)input, num_written);
             }
 
-            av_samples_alloc(audio_output_buffers, NULL, audio_num_channels, estimated, render_audio_info->sample_format, 0);
+            else
+            {
+                memcpy(dest[0], input, num_written * input_sample_size);
+            }
 
-            audio_output_size = estimated;
+            input += num_written * input_sample_size;
+            num_samples -= num_written;
         }
 
-        // For the first call, we may get less samples than written because during resampling, additional samples
-        // need to be kept for the interpolation. We will call again with the number of samples we are missing to exactly fill out one paint buffer.
-        s32 num_output_samples = swr_convert(audio_swr, audio_output_buffers, audio_output_size, (const uint8_t**)&buffer->mem, buffer->num_samples);
+        audio_frame_pos += num_written;
+        audio_copied_bytes += num_written * output_sample_size;
+
+        // Out of samples for now.
+        if (audio_frame_pos < frame_size)
+        {
+            break;
+        }
 
-        // Some encoders have a restriction that they only work with a fixed amount of samples.
-        // We can get less samples from the game so we have to queue them up and only copy to a frame when we have enough.
-        av_audio_fifo_write(audio_fifo, (void**)audio_output_buffers, num_output_samples);
+        audio_submit_frame();
+    }
+}
+
+// Where the next samples should be written in the frame being filled.
+void EncoderState::audio_get_frame_pointers(u8** dest)
+{
+    s32 bytes_per_sample = av_get_bytes_per_sample(audio_output_format);
+
+    if (av_sample_fmt_is_planar(audio_output_format))
+    {
+        for (s32 i = 0; i < audio_num_channels; i++)
+        {
+            dest[i] = audio_frame->extended_data[i] + audio_frame_pos * bytes_per_sample;
+        }
     }
 
-    // Matching parameters, just copy over.
     else
     {
-        // Some encoders have a restriction that they only work with a fixed amount of samples.
-        // We can get less samples from the game so we have to queue them up and only copy to a frame when we have enough.
-        av_audio_fifo_write(audio_fifo, (void**)&buffer->mem, buffer->num_samples);
+        dest[0] = audio_frame->data[0] + audio_frame_pos * bytes_per_sample * audio_num_channels;
     }
 }
 
-void EncoderState::audio_copy_samples_to_frame(AVFrame* dest_frame, s32 num_samples)
+void EncoderState::audio_submit_frame()
 {
-    assert(num_samples <= audio_num_queued_samples());
-    av_audio_fifo_read(audio_fifo, (void**)dest_frame->data, num_samples);
+    audio_frame->pts = render_audio_pts;
+
+    // The frame has a capacity of the codec frame size, but the last frame does not have to be full.
+    audio_frame->nb_samples = audio_frame_pos;
+
+    render_audio_pts += audio_frame_pos;
+
+    render_encode_audio_frame(audio_frame);
+
+    audio_frame = NULL;
+    audio_frame_pos = 0;
+}
+
+// Call this when rendering is stopping to submit the slack.
+void EncoderState::audio_flush()
+{
+    // Our resampler holds back the last samples for the filter, and they need silence after them to come out.
+    if (audio_use_native && audio_resampler.resample)
+    {
+        audio_drain_resampler();
+    }
+
+    if (audio_frame && audio_frame_pos > 0)
+    {
+        audio_submit_frame();
+    }
+
+    else if (audio_frame)
+    {
+        render_movie->recycled_audio_frames.push(&audio_frame);
+        audio_frame = NULL;
+    }
+
+    if (render_audio_pts > 0)
+    {
+        double seconds = (double)render_audio_pts / (double)audio_output_hz;
+        svr_log("Copied %.1f KB of audio for every second of audio\n", (audio_copied_bytes / 1024.0) / seconds);
+    }
 }
 
-s32 EncoderState::audio_num_queued_samples()
+// Writes the samples that are left in our resampler at the end of the movie into the frames.
+void EncoderState::audio_drain_resampler()
 {
-    s32 num_samples = av_audio_fifo_size(audio_fifo);
-    return num_samples;
+    s32 frame_size = render_audio_ctx->frame_size;
+    s32 output_sample_size = av_get_bytes_per_sample(audio_output_format) * audio_num_channels;
+
+    while (true)
+    {
+        if (audio_frame == NULL)
+        {
+            audio_frame = render_get_new_audio_frame();
+            audio_frame_pos = 0;
+
+            if (audio_frame == NULL)
+            {
+                break;
+            }
+        }
+
+        u8* dest[AUDIO_MAX_CHANS];
+        audio_get_frame_pointers(dest);
+
+        s32 space = frame_size - audio_frame_pos;
+        s32 num_written = svr_resample_drain(&audio_resampler, dest, space);
+
+        audio_frame_pos += num_written;
+        audio_copied_bytes += num_written * output_sample_size;
+
+        // Nothing left, the partial frame is submitted by audio_flush.
+        if (audio_frame_pos < frame_size)
+        {
+            break;
+        }
+
+        audio_submit_frame();
+    }
 }
 
+// If libswresample is used, which needs the audio thread.
 bool EncoderState::audio_need_conversion()
 {
-    return audio_swr;
+    // The resampler may be left from an earlier movie that used audio.
+    return movie_params.use_audio && audio_swr;
 }
@@ -0,0 +1,990 @@
+#include "encoder_priv.h"
+
+// Benchmarking of the encoder without a game.
+// Started with svr_encoder --benchmark [width] [height] [fps] [frames] [video encoder] [pipe command].
+// Generated video and audio is given to the encoder in the same way as svr_game would, for every combination of
+// video encoder, container and preset. Our own audio resampler is also compared against libswresample, and the scale shaders
+// are compared against the CPU reference in vid_scale_reference. The writer of the movie file is also measured on its own.
+// With a pipe command, the movies are written to its stdin instead, such as: ffmpeg -f nut -i - -c:v h264_nvenc out.mp4.
+// The results are written to data\encoder_bench_log.txt, so they can be compared between versions.
+
+// Should be synchronized with proc_profile.cpp.
+const char* BENCH_X264_PRESETS[] =
+{
+    "ultrafast",
+    "superfast",
+    "veryfast",
+    "faster",
+    "fast",
+    "medium",
+    "slow",
+    "slower",
+    "veryslow",
+};
+
+// Should be synchronized with proc_profile.cpp.
+const char* BENCH_X265_PRESETS[] =
+{
+    "ultrafast",
+    "superfast",
+    "veryfast",
+    "faster",
+    "fast",
+    "medium",
+    "slow",
+    "slower",
+    "veryslow",
+};
+
+// The presets of svtav1 go from 0 to 13, where the slowest ones take far too long to benchmark.
+const char* BENCH_SVTAV1_PRESETS[] =
+{
+    "4",
+    "6",
+    "8",
+    "10",
+    "12",
+    "13",
+};
+
+// Should be synchronized with proc_profile.cpp.
+const char* BENCH_DNXHR_PROFILES[] =
+{
+    "lb",
+    "sq",
+    "hq",
+};
+
+// Should be synchronized with proc_profile.cpp.
+const char* BENCH_PRORES_PROFILES[] =
+{
+    "proxy",
+    "lt",
+    "standard",
+    "hq",
+};
+
+// For encoders that have no presets.
+const char* BENCH_NO_PRESETS[] =
+{
+    "default",
+};
+
+struct BenchPresetList
+{
+    EncoderVideoEncoder encoder;
+    const char** presets;
+    s32 num_presets;
+};
+
+// Every preset or profile of these encoders is benchmarked. Other encoders are run once with BENCH_NO_PRESETS.
+const BenchPresetList BENCH_PRESET_LISTS[] =
+{
+    BenchPresetList { ENCODER_VIDEO_LIBX264, BENCH_X264_PRESETS, SVR_ARRAY_SIZE(BENCH_X264_PRESETS) },
+    BenchPresetList { ENCODER_VIDEO_LIBX264_444, BENCH_X264_PRESETS, SVR_ARRAY_SIZE(BENCH_X264_PRESETS) },
+    BenchPresetList { ENCODER_VIDEO_LIBX265, BENCH_X265_PRESETS, SVR_ARRAY_SIZE(BENCH_X265_PRESETS) },
+    BenchPresetList { ENCODER_VIDEO_LIBSVTAV1, BENCH_SVTAV1_PRESETS, SVR_ARRAY_SIZE(BENCH_SVTAV1_PRESETS) },
+    BenchPresetList { ENCODER_VIDEO_DNXHR, BENCH_DNXHR_PROFILES, SVR_ARRAY_SIZE(BENCH_DNXHR_PROFILES) },
+    BenchPresetList { ENCODER_VIDEO_PRORES, BENCH_PRORES_PROFILES, SVR_ARRAY_SIZE(BENCH_PRORES_PROFILES) },
+};
+
+// The image containers are image sequences with one file per frame.
+const char* BENCH_CONTAINERS[] =
+{
+    "mp4",
+    "mkv",
+    "mov",
+    "nut",
+    "y4m",
+    "png",
+    "tiff",
+    "exr",
+};
+
+const s32 BENCH_AUDIO_HZ = 44100;
+const s32 BENCH_AUDIO_CHANNELS = 2;
+
+// Our own resampler is compared against libswresample with tones of these frequencies.
+const s32 BENCH_RESAMPLE_RATES[] = { 44100, 48000 };
+const float BENCH_RESAMPLE_TONES[] = { 1000.0f, 15000.0f };
+const s32 BENCH_RESAMPLE_SECONDS = 10;
+
+// Our own resampler fails the benchmark if its signal to noise ratio is lower than that of libswresample by more than this, in dB.
+const double BENCH_RESAMPLE_MAX_SNR_LOSS = 3.0;
+
+// The frame is scaled to half size this many times with each scale filter, on the GPU and with the CPU reference.
+const s32 BENCH_SCALE_GPU_PASSES = 200;
+const s32 BENCH_SCALE_CPU_PASSES = 3;
+
+// Largest difference between the GPU and the CPU reference in 8-bit levels. The GPU keeps the result in half floats.
+const float BENCH_SCALE_MAX_ERROR = 1.0f;
+
+// Size of the file written by the movie file writer without any encoder, and of every write to it.
+const s32 BENCH_IO_MB = 512;
+const s32 BENCH_IO_WRITE_SIZE = 256 * 1024;
+
+struct BenchState
+{
+    EncoderState* es;
+
+    s32 width;
+    s32 height;
+    s32 fps;
+    s32 num_frames;
+    const char* only_encoder; // Only run this encoder if set.
+    const char* pipe_target; // Write to this command or named pipe instead of a file if set.
+
+    // The pattern is twice as wide as the frame, so every frame can start at a different column to make it move.
+    u32* pattern;
+    s32 pattern_pitch;
+
+    s16* audio_samples;
+};
+
+struct BenchResult
+{
+    bool ok;
+
+    // All times in microseconds.
+    s64 total_time;
+    s64 upload_time;
+    s64 video_time; // Conversion, download and submit to the frame thread.
+    s64 audio_time;
+    s64 finish_time; // Stopping the movie and waiting until it is written.
+
+    s64 peak_memory;
+    s64 output_size;
+
+    double audio_copy_rate; // Bytes of audio copied by the encoder for every second of audio.
+};
+
+// Smooth gradient with some noise. The noise keeps the encoders from making everything into tiny skip blocks.
+void bench_generate_pattern(BenchState* bench)
+{
+    s32 pattern_width = bench->width * 2;
+
+    bench->pattern = (u32*)svr_alloc(pattern_width * bench->height * sizeof(u32));
+    bench->pattern_pitch = pattern_width * sizeof(u32);
+
+    u32 seed = 1;
+
+    for (s32 y = 0; y < bench->height; y++)
+    {
+        for (s32 x = 0; x < pattern_width; x++)
+        {
+            seed = seed * 1664525 + 1013904223;
+            s32 noise = (seed >> 24) & 31;
+
+            u32 r = ((x * 255) / pattern_width + noise) & 255;
+            u32 g = ((y * 255) / bench->height + noise) & 255;
+            u32 b = (((x + y) * 127) / (pattern_width + bench->height) + noise) & 255;
+
+            bench->pattern[y * pattern_width + x] = 0xff000000 | (r << 16) | (g << 8) | b;
+        }
+    }
+}
+
+// Sine wave in the format that svr_game gives.
+void bench_fill_audio(BenchState* bench, s64 first_sample, s32 num_samples)
+{
+    for (s32 i = 0; i < num_samples; i++)
+    {
+        float t = (float)(first_sample + i) / (float)BENCH_AUDIO_HZ;
+        s16 v = (s16)(sinf(t * 440.0f * 2.0f * 3.14159265f) * 8000.0f);
+
+        for (s32 j = 0; j < BENCH_AUDIO_CHANNELS; j++)
+        {
+            bench->audio_samples[i * BENCH_AUDIO_CHANNELS + j] = v;
+        }
+    }
+}
+
+s64 bench_get_memory_usage()
+{
+    PROCESS_MEMORY_COUNTERS counters = {};
+    K32GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+
+    return counters.WorkingSetSize;
+}
+
+// Creates the headless encoder and the generated content.
+bool bench_init(BenchState* bench)
+{
+    CreateDirectoryA("data\\benchmark", NULL);
+
+    bench->es = SVR_ZALLOC(EncoderState);
+
+    if (!bench->es->init_headless())
+    {
+        return false;
+    }
+
+    bench_generate_pattern(bench);
+    bench->audio_samples = (s16*)svr_alloc(ENCODER_MAX_SAMPLES * BENCH_AUDIO_CHANNELS * sizeof(s16));
+
+    return true;
+}
+
+void bench_free(BenchState* bench)
+{
+    if (bench->es)
+    {
+        bench->es->free_static();
+        svr_free(bench->es);
+        bench->es = NULL;
+    }
+
+    svr_maybe_free((void**)&bench->pattern);
+    svr_maybe_free((void**)&bench->audio_samples);
+}
+
+// Movie parameters like the default profile would give, with the preset or profile of the encoder changed.
+void bench_setup_params(BenchState* bench, EncoderVideoEncoder video_encoder, const char* container, const char* preset, EncoderSharedMovieParams* params)
+{
+    *params = {};
+    SVR_SNPRINTF(params->dest_file, "data\\benchmark\\bench.%s", container);
+    params->video_width = bench->width;
+    params->video_height = bench->height;
+    params->output_width = bench->width;
+    params->output_height = bench->height;
+    params->audio_channels = BENCH_AUDIO_CHANNELS;
+    params->audio_hz = BENCH_AUDIO_HZ;
+    params->audio_bits = 16;
+    params->video_fps = bench->fps;
+    params->video_threads = 0;
+    params->video_queue_depth = VID_QUEUED_TEXTURES;
+    params->x264_crf = 15;
+    params->x265_crf = 20;
+    params->svtav1_crf = 30;
+    params->svtav1_preset = 10;
+    params->use_audio = true;
+    SVR_COPY_STRING(RENDER_VIDEO_NAMES[video_encoder], params->video_encoder);
+    SVR_COPY_STRING("aac", params->audio_encoder);
+    SVR_COPY_STRING("ultrafast", params->x264_preset);
+    SVR_COPY_STRING("hq", params->dnxhr_profile);
+    SVR_COPY_STRING("ultrafast", params->x265_preset);
+    SVR_COPY_STRING("hq", params->prores_profile);
+    SVR_COPY_STRING("lanczos", params->scale_filter);
+
+    switch (video_encoder)
+    {
+        case ENCODER_VIDEO_LIBX264:
+        case ENCODER_VIDEO_LIBX264_444:
+        {
+            SVR_COPY_STRING(preset, params->x264_preset);
+            break;
+        }
+
+        case ENCODER_VIDEO_LIBX265:
+        {
+            SVR_COPY_STRING(preset, params->x265_preset);
+            break;
+        }
+
+        case ENCODER_VIDEO_LIBSVTAV1:
+        {
+            params->svtav1_preset = atoi(preset);
+            break;
+        }
+
+        case ENCODER_VIDEO_DNXHR:
+        {
+            SVR_COPY_STRING(preset, params->dnxhr_profile);
+            break;
+        }
+
+        case ENCODER_VIDEO_PRORES:
+        {
+            SVR_COPY_STRING(preset, params->prores_profile);
+            break;
+        }
+    }
+
+    if (bench->pipe_target)
+    {
+        SVR_COPY_STRING(bench->pipe_target, params->pipe_target);
+    }
+}
+
+// Deletes a file and returns how large it was.
+s64 bench_remove_file(const char* path)
+{
+    s64 size = 0;
+
+    WIN32_FILE_ATTRIBUTE_DATA file_info;
+
+    if (GetFileAttributesExA(path, GetFileExInfoStandard, &file_info))
+    {
+        size = ((s64)file_info.nFileSizeHigh << 32) | file_info.nFileSizeLow;
+    }
+
+    DeleteFileA(path);
+    return size;
+}
+
+// Deletes everything that a movie wrote and returns the total size.
+// Image sequences have a file for every frame, and containers without audio have it in a file of its own.
+s64 bench_remove_output(BenchState* bench, EncoderSharedMovieParams* params)
+{
+    const AVOutputFormat* container = av_guess_format(NULL, params->dest_file, NULL);
+
+    if (container == NULL)
+    {
+        return 0;
+    }
+
+    s64 size = 0;
+
+    if (container->flags & AVFMT_NOFILE)
+    {
+        char pattern[MAX_PATH];
+        render_make_sequence_pattern(params->dest_file, pattern, sizeof(pattern));
+
+        for (s32 i = 0; i < bench->num_frames; i++)
+        {
+            char path[MAX_PATH];
+            SVR_SNPRINTF(path, pattern, i);
+
+            size += bench_remove_file(path);
+        }
+    }
+
+    else
+    {
+        size += bench_remove_file(params->dest_file);
+    }
+
+    if (container->audio_codec != AV_CODEC_ID_NONE)
+    {
+        return size;
+    }
+
+    for (s32 i = 0; i < SVR_ARRAY_SIZE(RENDER_AUDIO_INFOS); i++)
+    {
+        const RenderAudioInfo* info = &RENDER_AUDIO_INFOS[i];
+
+        if (!strcmp(RENDER_AUDIO_NAMES[info->id], params->audio_encoder))
+        {
+            char path[MAX_PATH];
+            render_make_sidecar_path(params->dest_file, info->sidecar_container, path, sizeof(path));
+
+            size += bench_remove_file(path);
+        }
+    }
+
+    return size;
+}
+
+BenchResult bench_run(BenchState* bench, EncoderSharedMovieParams* params)
+{
+    BenchResult res = {};
+    EncoderState* es = bench->es;
+
+    s64 start_time = svr_prof_get_real_time();
+    s64 finish_start_time = 0;
+    s64 audio_pos = 0;
+    s64 audio_samples_wanted = 0;
+
+    es->movie_params = *params;
+
+    if (!es->start_movie())
+    {
+        goto rfail;
+    }
+
+    for (s32 i = 0; i < bench->num_frames; i++)
+    {
+        s64 t = svr_prof_get_real_time();
+        es->vid_write_headless_game_texture(bench->pattern + (i * 4) % bench->width, bench->pattern_pitch);
+        res.upload_time += svr_prof_get_real_time() - t;
+
+        t = svr_prof_get_real_time();
+
+        if (!es->render_receive_video())
+        {
+            es->free_dynamic();
+            goto rfail;
+        }
+
+        res.video_time += svr_prof_get_real_time() - t;
+
+        // Same amount of audio for every video frame as the game would give.
+        audio_samples_wanted = ((s64)(i + 1) * BENCH_AUDIO_HZ) / bench->fps;
+        s32 num_samples = (s32)svr_min(audio_samples_wanted - audio_pos, (s64)ENCODER_MAX_SAMPLES);
+
+        bench_fill_audio(bench, audio_pos, num_samples);
+        audio_pos += num_samples;
+
+        t = svr_prof_get_real_time();
+        es->render_receive_audio_samples(bench->audio_samples, num_samples);
+        res.audio_time += svr_prof_get_real_time() - t;
+
+        res.peak_memory = svr_max(res.peak_memory, bench_get_memory_usage());
+    }
+
+    finish_start_time = svr_prof_get_real_time();
+
+    es->free_dynamic();
+
+    if (!es->render_reap_finalized_movies(true))
+    {
+        goto rfail;
+    }
+
+    res.finish_time = svr_prof_get_real_time() - finish_start_time;
+    res.total_time = svr_prof_get_real_time() - start_time;
+    res.audio_copy_rate = (double)es->audio_copied_bytes / ((double)audio_pos / (double)BENCH_AUDIO_HZ);
+    res.ok = true;
+
+    goto rexit;
+
+rfail:
+
+rexit:
+    // Movies that failed to start are still being closed.
+    es->render_reap_finalized_movies(true);
+
+    res.output_size = bench_remove_output(bench, params);
+    return res;
+}
+
+void bench_log_result(BenchState* bench, const char* video_encoder, const char* container, const char* preset, BenchResult* res)
+{
+    if (!res->ok)
+    {
+        svr_log("%-12s %-4s %-10s failed or not supported\n", video_encoder, container, preset);
+        return;
+    }
+
+    double frames = bench->num_frames;
+
+    svr_log("%-12s %-4s %-10s %8.1f fps | upload %6.3f ms | video %6.3f ms | audio %6.3f ms | audio copy %6.1f KB/s | finish %8.1f ms | peak %5lld MB | size %7.2f MB\n",
+            video_encoder, container, preset,
+            frames / (res->total_time / 1000000.0),
+            (res->upload_time / 1000.0) / frames,
+            (res->video_time / 1000.0) / frames,
+            (res->audio_time / 1000.0) / frames,
+            res->audio_copy_rate / 1024.0,
+            res->finish_time / 1000.0,
+            res->peak_memory / (1024 * 1024),
+            res->output_size / (1024.0 * 1024.0));
+}
+
+// Signal to noise ratio in dB of a resampled tone.
+// A sine of the same frequency is fitted to the output, so it does not matter how the resampler aligns the samples.
+double bench_tone_snr(const float* samples, s32 num_samples, s32 hz, float freq)
+{
+    double w = 2.0 * RESAMPLE_PI * freq / hz;
+
+    // Skip the start and the end where the filter is not full.
+    s32 start = SVR_RESAMPLE_TAPS * 4;
+    s32 end = num_samples - SVR_RESAMPLE_TAPS * 4;
+
+    double ss = 0.0;
+    double cc = 0.0;
+    double sc = 0.0;
+    double sy = 0.0;
+    double cy = 0.0;
+
+    for (s32 i = start; i < end; i++)
+    {
+        double sv = sin(w * i);
+        double cv = cos(w * i);
+
+        ss += sv * sv;
+        cc += cv * cv;
+        sc += sv * cv;
+        sy += sv * samples[i];
+        cy += cv * samples[i];
+    }
+
+    double det = ss * cc - sc * sc;
+    double a = (sy * cc - cy * sc) / det;
+    double b = (cy * ss - sy * sc) / det;
+
+    double signal = 0.0;
+    double noise = 0.0;
+
+    for (s32 i = start; i < end; i++)
+    {
+        double fit = a * sin(w * i) + b * cos(w * i);
+        double diff = samples[i] - fit;
+
+        signal += fit * fit;
+        noise += diff * diff;
+    }
+
+    return 10.0 * log10(signal / svr_max(noise, 1e-20));
+}
+
+// Converts to planar float in the same chunks as the game would give.
+s32 bench_resample_own(const s16* input, s32 num_samples, s32 output_hz, float** dest, s32 capacity)
+{
+    SvrResampler rs = {};
+    svr_resample_init(&rs, SVR_RESAMPLE_FLTP, BENCH_AUDIO_CHANNELS, BENCH_AUDIO_HZ, output_hz);
+
+    s32 chunk_size = BENCH_AUDIO_HZ / 60;
+    s32 num_written = 0;
+
+    for (s32 pos = 0; pos < num_samples; pos += chunk_size)
+    {
+        s32 part_samples = svr_min(chunk_size, num_samples - pos);
+        const s16* part = input + pos * BENCH_AUDIO_CHANNELS;
+
+        u8* part_dest[BENCH_AUDIO_CHANNELS];
+
+        for (s32 i = 0; i < BENCH_AUDIO_CHANNELS; i++)
+        {
+            part_dest[i] = (u8*)(dest[i] + num_written);
+        }
+
+        if (rs.resample)
+        {
+            num_written += svr_resample_process(&rs, part_dest, capacity - num_written, part, part_samples);
+        }
+
+        else
+        {
+            svr_resample_convert(&rs, part_dest, part, part_samples);
+            num_written += part_samples;
+        }
+    }
+
+    // End of the movie.
+    if (rs.resample)
+    {
+        u8* part_dest[BENCH_AUDIO_CHANNELS];
+
+        for (s32 i = 0; i < BENCH_AUDIO_CHANNELS; i++)
+        {
+            part_dest[i] = (u8*)(dest[i] + num_written);
+        }
+
+        num_written += svr_resample_drain(&rs, part_dest, capacity - num_written);
+    }
+
+    svr_resample_free(&rs);
+    return num_written;
+}
+
+s32 bench_resample_swr(const s16* input, s32 num_samples, s32 output_hz, float** dest, s32 capacity)
+{
+    SwrContext* swr = NULL;
+    s32 chunk_size = BENCH_AUDIO_HZ / 60;
+    s32 num_written = 0;
+
+    AVChannelLayout channel_layout;
+    av_channel_layout_default(&channel_layout, BENCH_AUDIO_CHANNELS);
+
+    swr_alloc_set_opts2(&swr, &channel_layout, AV_SAMPLE_FMT_FLTP, output_hz, &channel_layout, AV_SAMPLE_FMT_S16, BENCH_AUDIO_HZ, 0, NULL);
+
+    if (swr == NULL || swr_init(swr) < 0)
+    {
+        goto rexit;
+    }
+
+    for (s32 pos = 0; pos < num_samples; pos += chunk_size)
+    {
+        s32 part_samples = svr_min(chunk_size, num_samples - pos);
+        const u8* part = (const u8*)(input + pos * BENCH_AUDIO_CHANNELS);
+
+        u8* part_dest[BENCH_AUDIO_CHANNELS];
+
+        for (s32 i = 0; i < BENCH_AUDIO_CHANNELS; i++)
+        {
+            part_dest[i] = (u8*)(dest[i] + num_written);
+        }
+
+        s32 res = swr_convert(swr, part_dest, capacity - num_written, &part, part_samples);
+
+        if (res > 0)
+        {
+            num_written += res;
+        }
+    }
+
+    // End of the movie, same as for our own resampler.
+    {
+        u8* part_dest[BENCH_AUDIO_CHANNELS];
+
+        for (s32 i = 0; i < BENCH_AUDIO_CHANNELS; i++)
+        {
+            part_dest[i] = (u8*)(dest[i] + num_written);
+        }
+
+        s32 res = swr_convert(swr, part_dest, capacity - num_written, NULL, 0);
+
+        if (res > 0)
+        {
+            num_written += res;
+        }
+    }
+
+rexit:
+    swr_free(&swr);
+    av_channel_layout_uninit(&channel_layout);
+    return num_written;
+}
+
+// Quality and speed of our own resampler and libswresample for the conversions that the audio encoders use.
+// Returns false if our own resampler is worse than libswresample, see BENCH_RESAMPLE_MAX_SNR_LOSS.
+bool bench_run_resampler()
+{
+    bool ret = true;
+    s32 num_samples = BENCH_AUDIO_HZ * BENCH_RESAMPLE_SECONDS;
+    s32 capacity = 48000 * BENCH_RESAMPLE_SECONDS + 4096;
+
+    s16* input = (s16*)svr_alloc(num_samples * BENCH_AUDIO_CHANNELS * sizeof(s16));
+    float* output[BENCH_AUDIO_CHANNELS];
+
+    for (s32 i = 0; i < BENCH_AUDIO_CHANNELS; i++)
+    {
+        output[i] = (float*)svr_alloc(capacity * sizeof(float));
+    }
+
+    for (s32 i = 0; i < SVR_ARRAY_SIZE(BENCH_RESAMPLE_RATES); i++)
+    {
+        s32 output_hz = BENCH_RESAMPLE_RATES[i];
+
+        for (s32 j = 0; j < SVR_ARRAY_SIZE(BENCH_RESAMPLE_TONES); j++)
+        {
+            float freq = BENCH_RESAMPLE_TONES[j];
+
+            for (s32 k = 0; k < num_samples; k++)
+            {
+                s16 v = (s16)lrint(sin(2.0 * RESAMPLE_PI * freq * k / BENCH_AUDIO_HZ) * 16000.0);
+
+                for (s32 c = 0; c < BENCH_AUDIO_CHANNELS; c++)
+                {
+                    input[k * BENCH_AUDIO_CHANNELS + c] = v;
+                }
+            }
+
+            s64 t = svr_prof_get_real_time();
+            s32 own_samples = bench_resample_own(input, num_samples, output_hz, output, capacity);
+            s64 own_time = svr_prof_get_real_time() - t;
+            double own_snr = bench_tone_snr(output[0], own_samples, output_hz, freq);
+
+            t = svr_prof_get_real_time();
+            s32 swr_samples = bench_resample_swr(input, num_samples, output_hz, output, capacity);
+            s64 swr_time = svr_prof_get_real_time() - t;
+            double swr_snr = bench_tone_snr(output[0], swr_samples, output_hz, freq);
+
+            // How many seconds of audio can be converted in one second.
+            double own_speed = BENCH_RESAMPLE_SECONDS / (svr_max(own_time, 1LL) / 1000000.0);
+            double swr_speed = BENCH_RESAMPLE_SECONDS / (svr_max(swr_time, 1LL) / 1000000.0);
+
+            bool passed = own_snr >= swr_snr - BENCH_RESAMPLE_MAX_SNR_LOSS;
+
+            svr_log("Audio %d -> %d hz, %5.0f hz tone | own %5.1f dB %7.0fx realtime | libswresample %5.1f dB %7.0fx realtime%s\n",
+                    BENCH_AUDIO_HZ, output_hz, freq, own_snr, own_speed, swr_snr, swr_speed, passed ? "" : " | FAILED");
+
+            if (!passed)
+            {
+                ret = false;
+            }
+        }
+    }
+
+    svr_free(input);
+
+    for (s32 i = 0; i < BENCH_AUDIO_CHANNELS; i++)
+    {
+        svr_free(output[i]);
+    }
+
+    return ret;
+}
+
+// The scale textures are R16G16B16A16_FLOAT.
+float bench_half_to_float(u16 h)
+{
+    s32 exponent = (h >> 10) & 31;
+    s32 mantissa = h & 1023;
+    float v;
+
+    if (exponent == 0)
+    {
+        v = ldexpf((float)mantissa, -24);
+    }
+
+    else if (exponent == 31)
+    {
+        v = mantissa ? NAN : INFINITY;
+    }
+
+    else
+    {
+        v = ldexpf((float)(mantissa | 1024), exponent - 25);
+    }
+
+    return (h & 0x8000) ? -v : v;
+}
+
+// Speed of the scale shaders against the CPU reference, and the largest difference between them.
+void bench_run_scaler(BenchState* bench)
+{
+    EncoderState* es = bench->es;
+    HRESULT hr;
+
+    s32 output_width = svr_max(bench->width / 2, 1);
+    s32 output_height = svr_max(bench->height / 2, 1);
+
+    float* temp = (float*)svr_alloc(output_width * bench->height * 4 * sizeof(float));
+    float* reference = (float*)svr_alloc(bench->width * bench->height * 4 * sizeof(float));
+
+    ID3D11Texture2D* staging_tex = NULL;
+
+    for (s32 i = 0; i < ENCODER_NUM_SCALE_FILTERS; i++)
+    {
+        const char* name = VID_SCALE_FILTER_NAMES[i];
+
+        es->movie_params = {};
+        es->movie_params.video_width = bench->width;
+        es->movie_params.video_height = bench->height;
+        es->movie_params.output_width = output_width;
+        es->movie_params.output_height = output_height;
+        SVR_COPY_STRING(name, es->movie_params.scale_filter);
+
+        if (!es->vid_create_headless_game_texture() || !es->vid_create_scale_texs() || es->vid_scale_cs == NULL)
+        {
+            svr_log("Scale %-8s failed or not supported\n", name);
+            es->vid_free_dynamic();
+            continue;
+        }
+
+        ID3D11Texture2D* result_tex = es->vid_scale_texs[SVR_ARRAY_SIZE(es->vid_scale_texs) - 1];
+
+        if (staging_tex == NULL)
+        {
+            D3D11_TEXTURE2D_DESC tex_desc;
+            result_tex->GetDesc(&tex_desc);
+
+            tex_desc.Usage = D3D11_USAGE_STAGING;
+            tex_desc.BindFlags = 0;
+            tex_desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+
+            hr = es->vid_d3d11_device->CreateTexture2D(&tex_desc, NULL, &staging_tex);
+
+            if (FAILED(hr))
+            {
+                svr_log("Could not create scale staging texture (%#x)\n", hr);
+                es->vid_free_dynamic();
+                break;
+            }
+        }
+
+        es->vid_write_headless_game_texture(bench->pattern, bench->pattern_pitch);
+        es->vid_game_tex_lock->AcquireSync(ENCODER_PROC_ID, INFINITE);
+
+        D3D11_MAPPED_SUBRESOURCE map;
+
+        // Once before measuring so the shader is ready. Mapping waits until the GPU is done.
+        es->vid_scale_game_texture();
+        es->vid_d3d11_context->CopyResource(staging_tex, result_tex);
+        es->vid_d3d11_context->Map(staging_tex, 0, D3D11_MAP_READ, 0, &map);
+        es->vid_d3d11_context->Unmap(staging_tex, 0);
+
+        s64 t = svr_prof_get_real_time();
+
+        for (s32 j = 0; j < BENCH_SCALE_GPU_PASSES; j++)
+        {
+            es->vid_scale_game_texture();
+        }
+
+        es->vid_d3d11_context->CopyResource(staging_tex, result_tex);
+        hr = es->vid_d3d11_context->Map(staging_tex, 0, D3D11_MAP_READ, 0, &map);
+
+        s64 gpu_time = svr_prof_get_real_time() - t;
+
+        es->vid_game_tex_lock->ReleaseSync(ENCODER_GAME_ID);
+
+        t = svr_prof_get_real_time();
+
+        for (s32 j = 0; j < BENCH_SCALE_CPU_PASSES; j++)
+        {
+            vid_scale_reference(i, bench->pattern, bench->pattern_pitch, bench->width, bench->height, temp, reference, output_width, output_height);
+        }
+
+        s64 cpu_time = svr_prof_get_real_time() - t;
+
+        float max_error = 0.0f;
+
+        if (SUCCEEDED(hr))
+        {
+            for (s32 y = 0; y < output_height; y++)
+            {
+                const u16* row = (const u16*)((const u8*)map.pData + y * map.RowPitch);
+
+                for (s32 x = 0; x < output_width * 4; x++)
+                {
+                    float diff = fabsf(bench_half_to_float(row[x]) - reference[y * output_width * 4 + x]) * 255.0f;
+                    max_error = svr_max(max_error, diff);
+                }
+            }
+
+            es->vid_d3d11_context->Unmap(staging_tex, 0);
+        }
+
+        es->vid_free_dynamic();
+
+        double gpu_ms = (gpu_time / 1000.0) / BENCH_SCALE_GPU_PASSES;
+        double cpu_ms = (cpu_time / 1000.0) / BENCH_SCALE_CPU_PASSES;
+
+        svr_log("Scale %dx%d -> %dx%d %-8s | gpu %7.3f ms | cpu reference %8.1f ms | gpu %6.0fx faster | max difference %5.2f levels%s\n",
+                bench->width, bench->height, output_width, output_height, name, gpu_ms, cpu_ms, cpu_ms / svr_max(gpu_ms, 0.001),
+                max_error, FAILED(hr) || max_error > BENCH_SCALE_MAX_ERROR ? " | MISMATCH" : "");
+    }
+
+    svr_maybe_release(&staging_tex);
+
+    svr_free(temp);
+    svr_free(reference);
+}
+
+// Speed of the movie file writer with the same data regardless of the encoder.
+// The writes are either left to fill the buffers, or flushed one by one like fragmented output does.
+// The file is either allocated in steps, or allocated up front like when the length of the movie is known.
+void bench_run_io(BenchState* bench)
+{
+    EncoderState* es = bench->es;
+
+    const char* path = "data\\benchmark\\bench_io.bin";
+    s64 total_size = (s64)BENCH_IO_MB * 1024 * 1024;
+
+    u8* data = (u8*)svr_alloc(BENCH_IO_WRITE_SIZE);
+    u32 seed = 1;
+
+    for (s32 i = 0; i < BENCH_IO_WRITE_SIZE; i++)
+    {
+        seed = seed * 1664525 + 1013904223;
+        data[i] = seed >> 24;
+    }
+
+    for (s32 i = 0; i < 4; i++)
+    {
+        bool flush = i & 1;
+        bool allocate = i & 2;
+
+        IoWriter io = {};
+
+        s64 t = svr_prof_get_real_time();
+
+        if (!es->io_open(&io, path, allocate ? total_size : 0))
+        {
+            svr_log("Write failed\n");
+            break;
+        }
+
+        for (s64 pos = 0; pos < total_size; pos += BENCH_IO_WRITE_SIZE)
+        {
+            avio_write(io.avio, data, BENCH_IO_WRITE_SIZE);
+
+            if (flush)
+            {
+                avio_flush(io.avio);
+            }
+        }
+
+        bool ok = es->io_close(&io);
+
+        s64 write_time = svr_prof_get_real_time() - t;
+        s64 size = bench_remove_file(path);
+
+        svr_log("Write %d MB %-11s %-18s | %7.1f MB/s | %4d writes | size %s\n",
+                BENCH_IO_MB, flush ? "flushed" : "buffered", allocate ? "allocated up front" : "allocated in steps",
+                BENCH_IO_MB / (svr_max(write_time, 1LL) / 1000000.0), io.num_submitted,
+                ok && size == total_size ? "ok" : "WRONG");
+    }
+
+    svr_free(data);
+}
+
+void bench_run_encoder(BenchState* bench, const RenderVideoInfo* info)
+{
+    const char** presets = BENCH_NO_PRESETS;
+    s32 num_presets = SVR_ARRAY_SIZE(BENCH_NO_PRESETS);
+
+    for (s32 i = 0; i < SVR_ARRAY_SIZE(BENCH_PRESET_LISTS); i++)
+    {
+        if (BENCH_PRESET_LISTS[i].encoder == info->id)
+        {
+            presets = BENCH_PRESET_LISTS[i].presets;
+            num_presets = BENCH_PRESET_LISTS[i].num_presets;
+            break;
+        }
+    }
+
+    for (s32 i = 0; i < SVR_ARRAY_SIZE(BENCH_CONTAINERS); i++)
+    {
+        if (!encoder_has_container(RENDER_VIDEO_CONTAINERS_TABLE[info->id], BENCH_CONTAINERS[i]))
+        {
+            continue;
+        }
+
+        for (s32 j = 0; j < num_presets; j++)
+        {
+            EncoderSharedMovieParams params;
+            bench_setup_params(bench, info->id, BENCH_CONTAINERS[i], presets[j], &params);
+
+            BenchResult res = bench_run(bench, &params);
+            bench_log_result(bench, RENDER_VIDEO_NAMES[info->id], BENCH_CONTAINERS[i], presets[j], &res);
+        }
+    }
+}
+
+int bench_main(s32 argc, char** argv)
+{
+    int ret = 1;
+
+    BenchState bench = {};
+    bench.width = argc > 2 ? atoi(argv[2]) : 1920;
+    bench.height = argc > 3 ? atoi(argv[3]) : 1080;
+    bench.fps = argc > 4 ? atoi(argv[4]) : 60;
+    bench.num_frames = argc > 5 ? atoi(argv[5]) : 600;
+    bench.only_encoder = argc > 6 ? argv[6] : NULL;
+    bench.pipe_target = argc > 7 ? argv[7] : NULL;
+
+    if (bench.width <= 0 || bench.height <= 0 || bench.fps <= 0 || bench.num_frames <= 0)
+    {
+        svr_log("ERROR: Usage: svr_encoder --benchmark [width] [height] [fps] [frames] [video encoder] [pipe command]\n");
+        return 1;
+    }
+
+    svr_log("Benchmarking %d frames at %dx%d %d fps\n", bench.num_frames, bench.width, bench.height, bench.fps);
+
+    if (!bench_init(&bench))
+    {
+        goto rfail;
+    }
+
+    if (!bench_run_resampler())
+    {
+        svr_log("ERROR: Own audio resampler has lost more than %0.1f dB against libswresample\n", BENCH_RESAMPLE_MAX_SNR_LOSS);
+        goto rfail;
+    }
+
+    bench_run_scaler(&bench);
+    bench_run_io(&bench);
+
+    for (s32 i = 0; i < SVR_ARRAY_SIZE(RENDER_VIDEO_INFOS); i++)
+    {
+        const RenderVideoInfo* info = &RENDER_VIDEO_INFOS[i];
+
+        if (bench.only_encoder && strcmp(bench.only_encoder, RENDER_VIDEO_NAMES[info->id]))
+        {
+            continue;
+        }
+
+        bench_run_encoder(&bench, info);
+    }
+
+    ret = 0;
+    goto rexit;
+
+rfail:
+
+rexit:
+    bench_free(&bench);
+    return ret;
+}
@@ -0,0 +1,121 @@
+#include "encoder_priv.h"
+
+// Thread budget of the encoder.
+// When the game reserves processors for itself (cpu_game_cores in the profile), the encoder process is kept to the rest of them.
+// Threads created by libavcodec inherit the affinity of the process, so they are limited too. The main thread handles the
+// events from the game while the game waits, and the render threads feed the codec threads, so these run at a higher priority.
+// The finalize thread of a movie keeps encoding after the movie has stopped, so the process stays on its processors until the
+// next movie starts or the encoder exits, when every older movie has been finalized or is limited by the new movie again.
+
+void EncoderState::cpu_start()
+{
+    cpu_budget_active = false;
+
+    cpu_release();
+
+    if (movie_params.cpu_encoder_mask == 0)
+    {
+        return;
+    }
+
+    DWORD_PTR system_mask;
+    GetProcessAffinityMask(GetCurrentProcess(), &cpu_old_process_mask, &system_mask);
+
+    DWORD_PTR mask = (DWORD_PTR)movie_params.cpu_encoder_mask & system_mask;
+
+    if (mask == 0 || !SetProcessAffinityMask(GetCurrentProcess(), mask))
+    {
+        DWORD error_code = GetLastError();
+
+        svr_log("Could not set encoder processor affinity (%lu), using all processors\n", error_code);
+        return;
+    }
+
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_ABOVE_NORMAL);
+
+    cpu_budget_active = true;
+    cpu_mask_held = true;
+    cpu_num_processors = svr_cpu_count(mask);
+    cpu_start_time = svr_prof_get_real_time();
+    cpu_start_process_time = cpu_get_process_time();
+
+    char mask_str[256];
+    svr_cpu_mask_to_string(mask, mask_str, SVR_ARRAY_SIZE(mask_str));
+
+    svr_log("Encoder uses %d processors (%s)\n", cpu_num_processors, mask_str);
+}
+
+void EncoderState::cpu_end()
+{
+    if (!cpu_budget_active)
+    {
+        return;
+    }
+
+    cpu_budget_active = false;
+
+    s64 wall_time = svr_prof_get_real_time() - cpu_start_time;
+    s64 process_time = cpu_get_process_time() - cpu_start_process_time;
+
+    if (wall_time > 0)
+    {
+        svr_log("Encoder used an average of %.1f of its %d processors\n", (double)process_time / (double)wall_time, cpu_num_processors);
+    }
+
+    // The process mask is kept for the finalize thread, see cpu_release.
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_NORMAL);
+}
+
+// Gives the process all of its processors back.
+// Must only be called when no movie is finalizing, or when a new movie is starting which sets its own processors.
+void EncoderState::cpu_release()
+{
+    if (!cpu_mask_held)
+    {
+        return;
+    }
+
+    cpu_mask_held = false;
+
+    SetProcessAffinityMask(GetCurrentProcess(), cpu_old_process_mask);
+}
+
+void EncoderState::cpu_setup_worker_thread(HANDLE thread_h)
+{
+    if (cpu_budget_active && thread_h)
+    {
+        SetThreadPriority(thread_h, THREAD_PRIORITY_ABOVE_NORMAL);
+    }
+}
+
+// Number of threads to give to libavcodec.
+// The codecs count all processors in the system by themselves, so the count must be capped to the budget.
+s32 EncoderState::cpu_get_codec_threads(s32 wanted)
+{
+    if (!cpu_budget_active)
+    {
+        return wanted;
+    }
+
+    if (wanted == 0 || wanted > cpu_num_processors)
+    {
+        return cpu_num_processors;
+    }
+
+    return wanted;
+}
+
+// Returns the processor time used by all threads of the process in microseconds.
+s64 EncoderState::cpu_get_process_time()
+{
+    FILETIME creation_time;
+    FILETIME exit_time;
+    FILETIME kernel_time;
+    FILETIME user_time;
+    GetProcessTimes(GetCurrentProcess(), &creation_time, &exit_time, &kernel_time, &user_time);
+
+    s64 kernel = ((s64)kernel_time.dwHighDateTime << 32) | kernel_time.dwLowDateTime;
+    s64 user = ((s64)user_time.dwHighDateTime << 32) | user_time.dwLowDateTime;
+
+    return (kernel + user) / 10; // From 100 nanosecond units.
+}
@@ -0,0 +1,43 @@
+#include "encoder_priv.h"
+
+// References:
+// ffmpeg -h encoder=ffv1
+// https://raw.githubusercontent.com/FFmpeg/FFmpeg/master/libavcodec/ffv1enc.c
+// https://github.com/FFmpeg/FFV1/blob/master/ffv1.md
+
+// Frames must be split into one of these amounts of slices.
+const s32 FFV1_SLICE_COUNTS[] = { 4, 6, 9, 12, 16, 24, 30 };
+
+void EncoderState::render_setup_ffv1()
+{
+    // Version 3 is needed to split the frames into slices that are encoded in parallel.
+    av_opt_set(render_video_ctx->priv_data, "level", "3", 0);
+
+    // Every slice is encoded on its own thread, so use as many as there are threads.
+    s32 num_threads = render_video_ctx->thread_count;
+
+    if (num_threads == 0)
+    {
+        SYSTEM_INFO sys_info;
+        GetSystemInfo(&sys_info);
+
+        num_threads = sys_info.dwNumberOfProcessors;
+    }
+
+    render_video_ctx->slices = FFV1_SLICE_COUNTS[0];
+
+    for (s32 i = 0; i < SVR_ARRAY_SIZE(FFV1_SLICE_COUNTS); i++)
+    {
+        if (FFV1_SLICE_COUNTS[i] <= num_threads)
+        {
+            render_video_ctx->slices = FFV1_SLICE_COUNTS[i];
+        }
+    }
+
+    // The range coder states go from one frame to the next until the next keyframe, which is placed by the gop size only.
+    // Segments can be cut on any frame, so every frame must be a keyframe then. This makes the movie a bit larger.
+    if (movie_params.segment_seconds > 0 || movie_params.segment_mb > 0)
+    {
+        render_video_ctx->gop_size = 1;
+    }
+}
@@ -0,0 +1,38 @@
+#include "encoder_priv.h"
+
+// Image sequences where every frame is written to its own file.
+// The files are opened by the image2 muxer, see render_init_sequence_output.
+
+// References:
+// ffmpeg -h encoder=png
+// ffmpeg -h encoder=tiff
+// ffmpeg -h encoder=exr
+// https://raw.githubusercontent.com/FFmpeg/FFmpeg/master/libavcodec/pngenc.c
+// https://raw.githubusercontent.com/FFmpeg/FFmpeg/master/libavcodec/tiffenc.c
+// https://raw.githubusercontent.com/FFmpeg/FFmpeg/master/libavcodec/exrenc.c
+
+// Lower zlib levels are several times faster than the default and the files are only a little larger.
+const s32 IMAGE_ZLIB_LEVEL = 3;
+
+void EncoderState::render_setup_png()
+{
+    // Without prediction the compression is poor for game content. Paeth costs little next to the compression itself.
+    av_opt_set(render_video_ctx->priv_data, "pred", "paeth", 0);
+
+    render_video_ctx->compression_level = IMAGE_ZLIB_LEVEL;
+}
+
+void EncoderState::render_setup_tiff()
+{
+    // The default packbits does almost nothing for game content.
+    av_opt_set(render_video_ctx->priv_data, "compression_algo", "deflate", 0);
+
+    render_video_ctx->compression_level = IMAGE_ZLIB_LEVEL;
+}
+
+void EncoderState::render_setup_exr()
+{
+    // Half floats are what compositing programs use, and zip16 is lossless and supported everywhere.
+    av_opt_set(render_video_ctx->priv_data, "format", "half", 0);
+    av_opt_set(render_video_ctx->priv_data, "compression", "zip16", 0);
+}
@@ -0,0 +1,490 @@
+#include "encoder_priv.h"
+
+// Writing of the container to the movie file.
+// The container writes into large buffers that are then written to the file by a separate thread. This way, the packet thread
+// does not stall when the file system is slow for a moment. Also keeps the file allocated ahead of time, so the file system
+// does not have to find space for every small write. When the length of the movie is known, the whole expected size is
+// allocated at once and the file is cut to the written size when closed.
+// The container can also be written to a pipe instead, either to the stdin of a child process or to a named pipe that
+// another program has created. The same buffers and thread are used, so a slow reader does not stall the packet thread either.
+// Starting the reader and writing to it is done by svr_pipe.
+
+DWORD CALLBACK io_thread_proc(LPVOID param)
+{
+    SetThreadDescription(GetCurrentThread(), L"RENDER IO THREAD");
+
+    IoWriter* io = (IoWriter*)param;
+    io->encoder_ptr->io_proc(io);
+
+    return 0; // Not used.
+}
+
+// Called by the container when the AVIO buffer is full or flushed.
+// In packet or finalize thread.
+int io_write_callback(void* opaque, const uint8_t* buf, int buf_size)
+{
+    IoWriter* io = (IoWriter*)opaque;
+
+    // IO thread broke. Nothing more can be written.
+    if (svr_atom_load(&io->status) == 0)
+    {
+        return AVERROR(EIO);
+    }
+
+    io->encoder_ptr->io_append(io, buf, buf_size);
+
+    return buf_size;
+}
+
+// Called by the container when it wants to go back and update something, or wants to know the file size.
+// In packet or finalize thread.
+int64_t io_seek_callback(void* opaque, int64_t offset, int whence)
+{
+    IoWriter* io = (IoWriter*)opaque;
+
+    if (io->is_pipe)
+    {
+        return AVERROR(ESPIPE);
+    }
+
+    // The buffers know where they should be written, so there is nothing to flush here.
+
+    switch (whence & ~AVSEEK_FORCE)
+    {
+        case AVSEEK_SIZE: return io->file_size;
+        case SEEK_SET: io->write_pos = offset; break;
+        case SEEK_CUR: io->write_pos += offset; break;
+        case SEEK_END: io->write_pos = io->file_size + offset; break;
+        default: return AVERROR(EINVAL);
+    }
+
+    return io->write_pos;
+}
+
+// Keeps the message in the writer for when it is opened by another thread than the main thread, which cannot use error.
+void EncoderState::io_error(IoWriter* io, const char* format, ...)
+{
+    va_list va;
+    va_start(va, format);
+    SVR_VSNPRINTF(io->message, format, va);
+    va_end(va);
+
+    if (GetCurrentThreadId() == main_thread_id)
+    {
+        error("%s", io->message);
+    }
+}
+
+// The estimated size is allocated on the first write, or 0 to grow the allocation in steps of IO_PREALLOC_SIZE.
+bool EncoderState::io_open(IoWriter* io, const char* path, s64 estimated_size)
+{
+    bool ret = false;
+
+    io->encoder_ptr = this;
+    io->estimated_size = estimated_size;
+
+    io->file_h = CreateFileA(path, GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+
+    if (io->file_h == INVALID_HANDLE_VALUE)
+    {
+        io->file_h = NULL;
+
+        DWORD error_code = GetLastError();
+
+        io_error(io, "ERROR: Could not create render output file %s (%lu)\n", path, error_code);
+        goto rfail;
+    }
+
+    if (!io_start(io))
+    {
+        goto rfail;
+    }
+
+    ret = true;
+    goto rexit;
+
+rfail:
+
+rexit:
+    return ret;
+}
+
+// Opens a pipe to write the container to.
+// A target starting with \\.\pipe\ is a named pipe that must already have been created by the reading program.
+// Anything else is a command that is started with the read end of a new pipe as its stdin.
+bool EncoderState::io_open_pipe(IoWriter* io, const char* target)
+{
+    bool ret = false;
+
+    io->encoder_ptr = this;
+    io->is_pipe = true;
+    io->estimated_size = 0;
+
+    if (!svr_pipe_open(&io->pipe, target, IO_PIPE_SIZE))
+    {
+        error("%s", io->pipe.message);
+        goto rfail;
+    }
+
+    if (!io_start(io))
+    {
+        goto rfail;
+    }
+
+    svr_log("Writing movie to pipe %s\n", target);
+
+    ret = true;
+    goto rexit;
+
+rfail:
+
+rexit:
+    return ret;
+}
+
+// Starts the IO thread once the file or pipe is open.
+bool EncoderState::io_start(IoWriter* io)
+{
+    bool ret = false;
+    u8* avio_buf = NULL;
+
+    io->write_queue.init(IO_NUM_BUFFERS);
+    io->free_buffers.init(IO_NUM_BUFFERS);
+
+    for (s32 i = 0; i < IO_NUM_BUFFERS; i++)
+    {
+        io->buffers[i] = (u8*)VirtualAlloc(NULL, IO_BUFFER_SIZE, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+
+        if (io->buffers[i] == NULL)
+        {
+            io_error(io, "ERROR: Could not allocate render output buffers\n");
+            goto rfail;
+        }
+
+        io->free_buffers.push(&i);
+    }
+
+    // The container writes into this buffer and calls io_write_callback when it is full.
+    avio_buf = (u8*)av_malloc(IO_BUFFER_SIZE);
+
+    if (avio_buf == NULL)
+    {
+        io_error(io, "ERROR: Could not allocate render output buffers\n");
+        goto rfail;
+    }
+
+    io->avio = avio_alloc_context(avio_buf, IO_BUFFER_SIZE, 1, io, NULL, io_write_callback, io_seek_callback);
+
+    if (io->avio == NULL)
+    {
+        av_free(avio_buf);
+
+        io_error(io, "ERROR: Could not create render output context\n");
+        goto rfail;
+    }
+
+    // Tell the container to not go back and update anything.
+    if (io->is_pipe)
+    {
+        io->avio->seekable = 0;
+    }
+
+    io->fill_index = -1;
+    io->write_pos = 0;
+    io->file_size = 0;
+    io->num_submitted = 0;
+    io->allocated_size = 0;
+    io->bytes_written = 0;
+    io->write_time = 0;
+
+    io->message[0] = 0;
+    svr_atom_store(&io->status, 1);
+
+    io->wake_event_h = CreateEventA(NULL, FALSE, FALSE, NULL);
+    io->free_event_h = CreateEventA(NULL, FALSE, FALSE, NULL);
+
+    io->thread_h = CreateThread(NULL, 0, io_thread_proc, io, 0, NULL);
+
+    ret = true;
+    goto rexit;
+
+rfail:
+
+rexit:
+    return ret;
+}
+
+// Writes out everything that is remaining and closes the file.
+// Returns false if anything could not be written.
+// In finalize thread.
+bool EncoderState::io_close(IoWriter* io)
+{
+    bool ret = true;
+
+    if (io->avio)
+    {
+        avio_flush(io->avio);
+    }
+
+    if (io->thread_h)
+    {
+        if (io->fill_index != -1)
+        {
+            io_submit_fill(io);
+        }
+
+        // Stop the IO thread after it has written everything.
+
+        s32 stop_index = -1;
+        io->write_queue.push(&stop_index);
+        SetEvent(io->wake_event_h); // Notify IO thread.
+
+        WaitForSingleObject(io->thread_h, INFINITE); // Wait for IO thread to finish.
+
+        svr_maybe_close_handle(&io->thread_h);
+
+        if (svr_atom_load(&io->status) == 0)
+        {
+            svr_log("%s", io->message);
+            ret = false;
+        }
+    }
+
+    if (io->write_time > 0)
+    {
+        double mb = io->bytes_written / (1024.0 * 1024.0);
+        double secs = io->write_time / 1000000.0;
+
+        svr_log("Wrote %.2f MB to the movie file in %d writes in %.2f seconds (%.2f MB/s)\n", mb, io->num_submitted, secs, mb / secs);
+    }
+
+    if (io->avio)
+    {
+        av_freep(&io->avio->buffer);
+        avio_context_free(&io->avio);
+    }
+
+    // Closing the pipe lets the reader know that nothing more is coming.
+    // The child process may still be working on what it has read, so this waits for it to exit.
+    if (io->is_pipe)
+    {
+        if (!svr_pipe_close(&io->pipe))
+        {
+            SVR_COPY_STRING(io->pipe.message, io->message);
+            svr_log("%s", io->message);
+            ret = false;
+        }
+    }
+
+    // The file size must be set because the allocated size may be larger, such as when the estimated size was too large.
+    // The file system gives back the allocated space that goes beyond the end when the file is closed.
+    if (io->file_h)
+    {
+        FILE_END_OF_FILE_INFO eof_info = {};
+        eof_info.EndOfFile.QuadPart = io->file_size;
+        SetFileInformationByHandle(io->file_h, FileEndOfFileInfo, &eof_info, sizeof(eof_info));
+
+        svr_maybe_close_handle(&io->file_h);
+    }
+
+    for (s32 i = 0; i < IO_NUM_BUFFERS; i++)
+    {
+        if (io->buffers[i])
+        {
+            VirtualFree(io->buffers[i], 0, MEM_RELEASE);
+            io->buffers[i] = NULL;
+        }
+    }
+
+    io->write_queue.free();
+    io->free_buffers.free();
+
+    svr_maybe_close_handle(&io->wake_event_h);
+    svr_maybe_close_handle(&io->free_event_h);
+
+    return ret;
+}
+
+// Copies the data into the buffer being filled, and gives the buffer to the IO thread when it is full.
+// The buffer is also given to the IO thread first if the container writes somewhere else, since a buffer is written in one piece.
+// This only blocks if the IO thread is behind by IO_NUM_BUFFERS buffers.
+// In packet or finalize thread.
+void EncoderState::io_append(IoWriter* io, const u8* data, s32 size)
+{
+    if (io->fill_index != -1 && io->write_pos != io->buffer_offsets[io->fill_index] + io->buffer_sizes[io->fill_index])
+    {
+        io_submit_fill(io);
+    }
+
+    while (size > 0)
+    {
+        if (io->fill_index == -1)
+        {
+            while (!io->free_buffers.pull(&io->fill_index))
+            {
+                WaitForSingleObject(io->free_event_h, INFINITE);
+            }
+
+            io->buffer_sizes[io->fill_index] = 0;
+            io->buffer_offsets[io->fill_index] = io->write_pos;
+        }
+
+        s32* fill_size = &io->buffer_sizes[io->fill_index];
+        s32 part_size = svr_min(size, IO_BUFFER_SIZE - *fill_size);
+
+        memcpy(io->buffers[io->fill_index] + *fill_size, data, part_size);
+        *fill_size += part_size;
+
+        data += part_size;
+        size -= part_size;
+
+        io->write_pos += part_size;
+        io->file_size = svr_max(io->file_size, io->write_pos);
+
+        if (*fill_size == IO_BUFFER_SIZE)
+        {
+            io_submit_fill(io);
+        }
+    }
+}
+
+// Gives the buffer being filled to the IO thread.
+// In packet or finalize thread.
+void EncoderState::io_submit_fill(IoWriter* io)
+{
+    io->write_queue.push(&io->fill_index);
+    SetEvent(io->wake_event_h); // Notify IO thread.
+
+    io->fill_index = -1;
+    io->num_submitted++;
+}
+
+// In IO thread.
+void EncoderState::io_proc(IoWriter* io)
+{
+    bool run = true;
+
+    while (run)
+    {
+        WaitForSingleObject(io->wake_event_h, INFINITE);
+
+        s32 index;
+
+        while (io->write_queue.pull(&index))
+        {
+            if (index == -1)
+            {
+                run = false; // Stop on flush index.
+                break;
+            }
+
+            // Keep on going after an error so the buffers are given back, but don't write anything more.
+            if (svr_atom_load(&io->status))
+            {
+                if (!io_write_buffer(io, index))
+                {
+                    svr_atom_store(&io->status, 0);
+                }
+            }
+
+            io->free_buffers.push(&index);
+            SetEvent(io->free_event_h); // Notify packet thread.
+        }
+    }
+}
+
+// In IO thread.
+bool EncoderState::io_write_buffer(IoWriter* io, s32 index)
+{
+    bool ret = false;
+
+    u8* data = io->buffers[index];
+    s32 size = io->buffer_sizes[index];
+    s64 offset = io->buffer_offsets[index];
+
+    if (!io->is_pipe)
+    {
+        io_grow_allocation(io, offset + size);
+    }
+
+    s64 start_time = svr_prof_get_real_time();
+
+    // Pipes have no position, and block here until the reader has made room.
+    if (io->is_pipe)
+    {
+        if (!svr_pipe_write(&io->pipe, data, size))
+        {
+            SVR_COPY_STRING(io->pipe.message, io->message);
+            goto rfail;
+        }
+
+        io->bytes_written += size;
+    }
+
+    else
+    {
+        while (size > 0)
+        {
+            // Write at the position of the buffer.
+            OVERLAPPED overlapped = {};
+            overlapped.Offset = (DWORD)(offset & 0xffffffff);
+            overlapped.OffsetHigh = (DWORD)(offset >> 32);
+
+            DWORD written = 0;
+
+            if (!WriteFile(io->file_h, data, size, &written, &overlapped))
+            {
+                DWORD error_code = GetLastError();
+
+                SVR_SNPRINTF(io->message, "ERROR: Could not write to render output file (%lu)\n", error_code);
+                goto rfail;
+            }
+
+            data += written;
+            offset += written;
+            size -= written;
+
+            io->bytes_written += written;
+        }
+    }
+
+    io->write_time += svr_prof_get_real_time() - start_time;
+
+    ret = true;
+    goto rexit;
+
+rfail:
+
+rexit:
+    return ret;
+}
+
+// Reserve space for the file ahead of time so the file system doesn't have to look for more space on every write.
+// The estimated size is tried first so the file is allocated once. If there is not enough space for it, or the file grows beyond it,
+// the allocation grows in steps instead.
+// Failing to do this is not an error, it will just be slower.
+// In IO thread.
+void EncoderState::io_grow_allocation(IoWriter* io, s64 wanted_size)
+{
+    if (wanted_size <= io->allocated_size)
+    {
+        return;
+    }
+
+    s64 sizes[] = { svr_max(io->estimated_size, wanted_size + IO_PREALLOC_SIZE), wanted_size + IO_PREALLOC_SIZE };
+
+    for (s32 i = 0; i < SVR_ARRAY_SIZE(sizes); i++)
+    {
+        FILE_ALLOCATION_INFO alloc_info = {};
+        alloc_info.AllocationSize.QuadPart = sizes[i];
+
+        if (SetFileInformationByHandle(io->file_h, FileAllocationInfo, &alloc_info, sizeof(alloc_info)))
+        {
+            io->allocated_size = sizes[i];
+            return;
+        }
+    }
+
+    // Don't try again.
+    io->allocated_size = INT64_MAX;
+}
@@ -0,0 +1,22 @@
+#include "encoder_priv.h"
+
+// References:
+// ffmpeg -h encoder=libsvtav1
+// https://raw.githubusercontent.com/FFmpeg/FFmpeg/master/libavcodec/libsvtav1.c
+// https://gitlab.com/AOMediaCodec/SVT-AV1/-/blob/master/Docs/Parameters.md
+
+void EncoderState::render_setup_libsvtav1()
+{
+    av_opt_set(render_video_ctx->priv_data, "preset", svr_va("%d", movie_params.svtav1_preset), 0);
+    av_opt_set(render_video_ctx->priv_data, "crf", svr_va("%d", movie_params.svtav1_crf), 0);
+
+    // Keyframes are placed by the encoder, so keep them close enough for seeking in players.
+    render_video_ctx->gop_size = movie_params.video_fps * 5;
+
+    // Segments are cut on frames that are forced to be keyframes, which libsvtav1 does for frames with AV_PICTURE_TYPE_I.
+    // The gops must be closed so no frame after the cut refers to a frame before it.
+    if (movie_params.segment_seconds > 0 || movie_params.segment_mb > 0)
+    {
+        render_video_ctx->flags |= AV_CODEC_FLAG_CLOSED_GOP;
+    }
+}
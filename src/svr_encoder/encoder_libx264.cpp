@@ -14,4 +14,10 @@ void EncoderState::render_setup_libx264()
     {
         av_opt_set(render_video_ctx->priv_data, "x264-params", "keyint=1", 0);
     }
+
+    // Segments are cut on frames that are forced to be keyframes, and these must be IDR frames for the segments to play on their own.
+    if (movie_params.segment_seconds > 0 || movie_params.segment_mb > 0)
+    {
+        av_opt_set(render_video_ctx->priv_data, "forced-idr", "1", 0);
+    }
 }
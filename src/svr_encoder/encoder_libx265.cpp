@@ -0,0 +1,21 @@
+#include "encoder_priv.h"
+
+// References:
+// ffmpeg -h encoder=libx265
+// https://raw.githubusercontent.com/FFmpeg/FFmpeg/master/libavcodec/libx265.c
+// https://x265.readthedocs.io/en/master/cli.html
+
+void EncoderState::render_setup_libx265()
+{
+    av_opt_set(render_video_ctx->priv_data, "preset", movie_params.x265_preset, 0);
+    av_opt_set(render_video_ctx->priv_data, "crf", svr_va("%d", movie_params.x265_crf), 0);
+
+    // Otherwise every frame prints statistics to the console.
+    av_opt_set(render_video_ctx->priv_data, "x265-params", "log-level=error", 0);
+
+    // Segments are cut on frames that are forced to be keyframes, and these must be IDR frames for the segments to play on their own.
+    if (movie_params.segment_seconds > 0 || movie_params.segment_mb > 0)
+    {
+        av_opt_set(render_video_ctx->priv_data, "forced-idr", "1", 0);
+    }
+}
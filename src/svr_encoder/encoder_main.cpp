@@ -42,9 +42,62 @@ int main(int argc, char** argv)
     _set_error_mode(_OUT_TO_MSGBOX); // Must be called so we can actually use assert because Microsoft messed it up in console builds.
 #endif
 
-    svr_init_log("data\\encoder_log.txt", false);
+    svr_prof_init();
 
-    if (argc != 2)
+    // Spool files can be encoded manually with svr_encoder --from-spool <spool file> [number of chunks].
+    bool from_spool = argc >= 3 && !strcmp(argv[1], "--from-spool");
+
+    // The encoder can be benchmarked without a game with svr_encoder --benchmark [width] [height] [fps] [frames] [video encoder] [pipe command].
+    bool benchmark = argc >= 2 && !strcmp(argv[1], "--benchmark");
+
+    // Recorded sessions can be replayed without a game with svr_encoder --replay <session file> [cpu].
+    // With cpu, the frames are converted without D3D11.
+    bool replay = argc >= 3 && !strcmp(argv[1], "--replay");
+
+    // The best encoder settings for this computer can be found with svr_encoder --tune [width] [height] [minimum fps] [frames].
+    bool tune = argc >= 2 && !strcmp(argv[1], "--tune");
+
+    if (from_spool)
+    {
+        svr_init_log("data\\encoder_offline_log.txt", false);
+    }
+
+    else if (benchmark)
+    {
+        svr_init_log("data\\encoder_bench_log.txt", false);
+    }
+
+    else if (replay)
+    {
+        svr_init_log("data\\encoder_replay_log.txt", false);
+    }
+
+    else if (tune)
+    {
+        svr_init_log("data\\encoder_tune_log.txt", false);
+    }
+
+    else
+    {
+        // Every game started by the launcher with --jobs has its own encoder, which gets its own log.
+        char worker_env[64];
+        u32 launcher_pid;
+        s32 worker;
+
+        DWORD length = GetEnvironmentVariableA(SVR_JOBQ_WORKER_ENV, worker_env, SVR_ARRAY_SIZE(worker_env));
+
+        if (length > 0 && length < SVR_ARRAY_SIZE(worker_env) && sscanf(worker_env, "%u %d", &launcher_pid, &worker) == 2)
+        {
+            svr_init_log(svr_va("data\\encoder_log_%d.txt", worker + 1), false);
+        }
+
+        else
+        {
+            svr_init_log("data\\encoder_log.txt", false);
+        }
+    }
+
+    if (argc != 2 && !from_spool && !benchmark && !replay && !tune)
     {
         svr_log("ERROR: Encoder has not been started properly. This program can not be started manually\n");
         return 1;
@@ -60,6 +113,28 @@ int main(int argc, char** argv)
     svr_log("SVR Encoder " SVR_ARCH_STRING " version %d (%02d/%02d/%04d %02d:%02d:%02d)\n", SVR_VERSION, lt.wDay, lt.wMonth, lt.wYear, lt.wHour, lt.wMinute, lt.wSecond);
     svr_log("For more information see https://github.com/crashfort/SourceDemoRender\n");
 
+    if (from_spool)
+    {
+        s32 num_chunks = argc >= 4 ? atoi(argv[3]) : 0;
+        return offline_main(argv[2], num_chunks);
+    }
+
+    if (benchmark)
+    {
+        return bench_main(argc, argv);
+    }
+
+    if (replay)
+    {
+        bool use_cpu = argc >= 4 && !strcmp(argv[3], "cpu");
+        return replay_main(argv[2], use_cpu);
+    }
+
+    if (tune)
+    {
+        return tune_main(argc, argv);
+    }
+
     // We inherit handles when creating this process, so we can just read the handle address directly.
     // The encoder is 64-bit and the game is 32-bit, but all handles only have 32 bits significant, so this is safe.
     HANDLE shared_mem_h = (HANDLE)(u32)strtoul(argv[1], NULL, 10);
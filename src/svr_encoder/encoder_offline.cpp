@@ -0,0 +1,515 @@
+#include "encoder_priv.h"
+
+// Encoding of spool files written in spool mode (see encoder_spool.cpp).
+// Started with svr_encoder --from-spool <spool file> [number of chunks].
+// There is no game here, so nothing has to keep up with anything. The video frames are split into chunks which are encoded
+// in parallel by separate encoder states, each writing to its own file. The first chunk also encodes all of the audio.
+// When all chunks are done, the packets are copied into the final movie without encoding anything again.
+
+// Waits for a frame to become free so we don't read the whole spool into memory when the encoder is slower than the disk.
+// In chunk thread.
+bool offline_get_video_frame(void* user, u8** planes, s32* strides)
+{
+    OfflineChunk* chunk = (OfflineChunk*)user;
+    EncoderState* es = chunk->es;
+
+    chunk->frame = NULL;
+
+    while (!es->render_movie->recycled_video_frames.pull(&chunk->frame))
+    {
+        if (chunk->num_frames_created < OFFLINE_QUEUED_FRAMES)
+        {
+            chunk->frame = es->render_get_new_video_frame();
+            chunk->num_frames_created++;
+            break;
+        }
+
+        if (es->render_check_thread_errors())
+        {
+            return false;
+        }
+
+        Sleep(1);
+    }
+
+    if (chunk->frame == NULL)
+    {
+        return false;
+    }
+
+    for (s32 i = 0; i < chunk->spool->header.num_planes; i++)
+    {
+        planes[i] = chunk->frame->data[i];
+        strides[i] = chunk->frame->linesize[i];
+    }
+
+    return true;
+}
+
+// In chunk thread.
+bool offline_submit_video_frame(void* user, s64 pts)
+{
+    OfflineChunk* chunk = (OfflineChunk*)user;
+    EncoderState* es = chunk->es;
+
+    chunk->frame->pts = pts;
+    es->render_encode_video_frame(chunk->frame);
+
+    return !es->render_check_thread_errors();
+}
+
+// In chunk thread.
+bool offline_submit_audio_samples(void* user, void* samples, s32 num_samples)
+{
+    OfflineChunk* chunk = (OfflineChunk*)user;
+    EncoderState* es = chunk->es;
+
+    es->render_receive_audio_samples(samples, num_samples);
+
+    return !es->render_check_thread_errors();
+}
+
+// Every chunk has its own encoder state which is used like when rendering from the game.
+// In chunk thread.
+void offline_encode_chunk(OfflineChunk* chunk)
+{
+    SvrSpool* spool = chunk->spool;
+    EncoderState* es = SVR_ZALLOC(EncoderState);
+
+    SvrSpoolSink sink = {};
+    sink.user = chunk;
+    sink.get_video_frame = offline_get_video_frame;
+    sink.submit_video_frame = offline_submit_video_frame;
+    sink.submit_audio_samples = offline_submit_audio_samples;
+
+    chunk->es = es;
+
+    // Calls to error must come from the thread that made the encoder state.
+    es->main_thread_id = GetCurrentThreadId();
+
+    if (!es->render_init())
+    {
+        goto rfail;
+    }
+
+    es->movie_params = spool->header.movie_params;
+    es->movie_params.use_audio = chunk->range.use_audio;
+    es->movie_params.use_spool = false;
+    es->movie_params.use_fragmented = false;
+    es->movie_params.pipe_target[0] = 0; // Chunks are files that are joined afterwards.
+    es->movie_params.segment_seconds = 0;
+    es->movie_params.segment_mb = 0;
+
+    SVR_COPY_STRING(chunk->dest_file, es->movie_params.dest_file);
+
+    if (!es->render_start())
+    {
+        goto rfail;
+    }
+
+    if (es->movie_params.use_audio)
+    {
+        if (!es->audio_start())
+        {
+            goto rfail;
+        }
+    }
+
+    es->render_start_threads();
+
+    if (!svr_spool_run_chunk(spool, &chunk->range, &sink))
+    {
+        // Errors from the encoder have been logged already.
+        if (chunk->range.message[0])
+        {
+            svr_log("ERROR: %s", chunk->range.message);
+        }
+
+        goto rfail;
+    }
+
+    chunk->ok = true;
+    goto rexit;
+
+rfail:
+
+rexit:
+    // The movie is written in the background, so wait for it to be finished.
+    es->render_free_dynamic();
+    es->audio_free_dynamic();
+
+    if (!es->render_reap_finalized_movies(true))
+    {
+        chunk->ok = false;
+    }
+
+    es->render_free_static();
+    es->audio_free_static();
+
+    svr_free(es);
+    chunk->es = NULL;
+}
+
+DWORD CALLBACK offline_chunk_thread_proc(LPVOID param)
+{
+    SetThreadDescription(GetCurrentThread(), L"OFFLINE CHUNK THREAD");
+
+    OfflineChunk* chunk = (OfflineChunk*)param;
+    offline_encode_chunk(chunk);
+
+    return 0; // Not used.
+}
+
+// Returns the index of the first stream of this type, or -1.
+s32 offline_find_stream(AVFormatContext* ctx, AVMediaType type)
+{
+    for (u32 i = 0; i < ctx->nb_streams; i++)
+    {
+        if (ctx->streams[i]->codecpar->codec_type == type)
+        {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+// Reads the next packet of a stream. Returns false at the end of the file.
+bool offline_read_packet(AVFormatContext* ctx, s32 stream_index, AVPacket* packet)
+{
+    while (av_read_frame(ctx, packet) >= 0)
+    {
+        if (packet->stream_index == stream_index)
+        {
+            return true;
+        }
+
+        av_packet_unref(packet);
+    }
+
+    return false;
+}
+
+AVStream* offline_copy_stream(AVFormatContext* dest_ctx, AVStream* source_stream)
+{
+    AVStream* ret = avformat_new_stream(dest_ctx, NULL);
+
+    if (ret == NULL)
+    {
+        return NULL;
+    }
+
+    avcodec_parameters_copy(ret->codecpar, source_stream->codecpar);
+    ret->codecpar->codec_tag = 0; // Let the container choose.
+    ret->time_base = source_stream->time_base;
+    ret->avg_frame_rate = source_stream->avg_frame_rate;
+    ret->id = dest_ctx->nb_streams - 1;
+
+    return ret;
+}
+
+// Puts the video packets from all chunks and the audio packets from the first chunk into the final movie.
+bool offline_join_chunks(SvrSpool* spool, OfflineChunk* chunks, s32 num_chunks)
+{
+    bool ret = false;
+    s32 res;
+
+    const char* dest_file = spool->header.movie_params.dest_file;
+
+    AVFormatContext* output_ctx = NULL;
+    AVFormatContext* video_input_ctx = NULL; // Chunk we are reading video from.
+    AVFormatContext* audio_input_ctx = NULL; // Always the first chunk.
+
+    AVStream* video_stream = NULL;
+    AVStream* audio_stream = NULL;
+    s32 video_input_index = -1;
+    s32 audio_input_index = -1;
+    AVRational video_input_tb = {};
+    AVRational audio_input_tb = {};
+
+    AVPacket* video_packet = av_packet_alloc();
+    AVPacket* audio_packet = av_packet_alloc();
+    bool has_video_packet = false;
+    bool has_audio_packet = false;
+    s64 last_video_dts = INT64_MIN;
+    s32 chunk_idx = 0;
+
+    res = avformat_alloc_output_context2(&output_ctx, NULL, NULL, dest_file);
+
+    if (res < 0)
+    {
+        svr_log("ERROR: Could not create output context for %s (%d)\n", dest_file, res);
+        goto rfail;
+    }
+
+    res = avformat_open_input(&video_input_ctx, chunks[0].dest_file, NULL, NULL);
+
+    if (res < 0)
+    {
+        svr_log("ERROR: Could not open chunk %s (%d)\n", chunks[0].dest_file, res);
+        goto rfail;
+    }
+
+    video_input_index = offline_find_stream(video_input_ctx, AVMEDIA_TYPE_VIDEO);
+
+    if (video_input_index == -1)
+    {
+        svr_log("ERROR: Chunk %s has no video\n", chunks[0].dest_file);
+        goto rfail;
+    }
+
+    video_input_tb = video_input_ctx->streams[video_input_index]->time_base;
+    video_stream = offline_copy_stream(output_ctx, video_input_ctx->streams[video_input_index]);
+
+    if (spool->header.movie_params.use_audio)
+    {
+        res = avformat_open_input(&audio_input_ctx, chunks[0].dest_file, NULL, NULL);
+
+        if (res < 0)
+        {
+            svr_log("ERROR: Could not open chunk %s (%d)\n", chunks[0].dest_file, res);
+            goto rfail;
+        }
+
+        audio_input_index = offline_find_stream(audio_input_ctx, AVMEDIA_TYPE_AUDIO);
+
+        if (audio_input_index != -1)
+        {
+            audio_input_tb = audio_input_ctx->streams[audio_input_index]->time_base;
+            audio_stream = offline_copy_stream(output_ctx, audio_input_ctx->streams[audio_input_index]);
+        }
+    }
+
+    res = avio_open(&output_ctx->pb, dest_file, AVIO_FLAG_WRITE);
+
+    if (res < 0)
+    {
+        svr_log("ERROR: Could not create output file %s (%d)\n", dest_file, res);
+        goto rfail;
+    }
+
+    res = avformat_write_header(output_ctx, NULL);
+
+    if (res < 0)
+    {
+        svr_log("ERROR: Could not write output file header (%d)\n", res);
+        goto rfail;
+    }
+
+    has_video_packet = offline_read_packet(video_input_ctx, video_input_index, video_packet);
+
+    if (audio_stream)
+    {
+        has_audio_packet = offline_read_packet(audio_input_ctx, audio_input_index, audio_packet);
+    }
+
+    while (true)
+    {
+        // Continue with the next chunk when this one runs out.
+        while (!has_video_packet && chunk_idx < num_chunks - 1)
+        {
+            chunk_idx++;
+
+            avformat_close_input(&video_input_ctx);
+
+            res = avformat_open_input(&video_input_ctx, chunks[chunk_idx].dest_file, NULL, NULL);
+
+            if (res < 0)
+            {
+                svr_log("ERROR: Could not open chunk %s (%d)\n", chunks[chunk_idx].dest_file, res);
+                goto rfail;
+            }
+
+            video_input_index = offline_find_stream(video_input_ctx, AVMEDIA_TYPE_VIDEO);
+
+            if (video_input_index == -1)
+            {
+                svr_log("ERROR: Chunk %s has no video\n", chunks[chunk_idx].dest_file);
+                goto rfail;
+            }
+
+            video_input_tb = video_input_ctx->streams[video_input_index]->time_base;
+            has_video_packet = offline_read_packet(video_input_ctx, video_input_index, video_packet);
+        }
+
+        if (!has_video_packet && !has_audio_packet)
+        {
+            break;
+        }
+
+        // Write whichever packet comes first.
+        bool write_video = has_video_packet;
+
+        if (has_video_packet && has_audio_packet)
+        {
+            write_video = av_compare_ts(video_packet->dts, video_input_tb, audio_packet->dts, audio_input_tb) <= 0;
+        }
+
+        if (write_video)
+        {
+            // Encoders with delayed frames may start a chunk with a decode time that goes slightly behind the end of the previous chunk.
+            if (video_packet->dts <= last_video_dts)
+            {
+                video_packet->dts = last_video_dts + 1;
+            }
+
+            last_video_dts = video_packet->dts;
+
+            av_packet_rescale_ts(video_packet, video_input_tb, video_stream->time_base);
+            video_packet->stream_index = video_stream->index;
+
+            res = av_interleaved_write_frame(output_ctx, video_packet);
+
+            has_video_packet = offline_read_packet(video_input_ctx, video_input_index, video_packet);
+        }
+
+        else
+        {
+            av_packet_rescale_ts(audio_packet, audio_input_tb, audio_stream->time_base);
+            audio_packet->stream_index = audio_stream->index;
+
+            res = av_interleaved_write_frame(output_ctx, audio_packet);
+
+            has_audio_packet = offline_read_packet(audio_input_ctx, audio_input_index, audio_packet);
+        }
+
+        if (res < 0)
+        {
+            svr_log("ERROR: Could not write packet to output file (%d)\n", res);
+            goto rfail;
+        }
+    }
+
+    res = av_write_trailer(output_ctx);
+
+    if (res < 0)
+    {
+        svr_log("ERROR: Could not write output file trailer (%d)\n", res);
+        goto rfail;
+    }
+
+    ret = true;
+    goto rexit;
+
+rfail:
+
+rexit:
+    av_packet_free(&video_packet);
+    av_packet_free(&audio_packet);
+
+    avformat_close_input(&video_input_ctx);
+    avformat_close_input(&audio_input_ctx);
+
+    if (output_ctx)
+    {
+        avio_closep(&output_ctx->pb);
+        avformat_free_context(output_ctx);
+    }
+
+    return ret;
+}
+
+int offline_main(const char* spool_path, s32 num_chunks)
+{
+    int ret = 1;
+
+    SvrSpool spool = {};
+    SvrSpoolChunk ranges[SVR_SPOOL_MAX_CHUNKS];
+    OfflineChunk* chunks = NULL;
+    const AVOutputFormat* dest_container;
+    bool chunks_ok = true;
+
+    s64 start_time = svr_prof_get_real_time();
+
+    if (!svr_spool_open(spool_path, &spool))
+    {
+        svr_log("ERROR: %s", spool.message);
+        goto rfail;
+    }
+
+    // The chunks are put together by remuxing, which cannot be done into the many files of an image sequence.
+    dest_container = av_guess_format(NULL, spool.header.movie_params.dest_file, NULL);
+
+    if (dest_container && (dest_container->flags & AVFMT_NOFILE))
+    {
+        svr_log("ERROR: Image sequences cannot be encoded from spool files, render %s without use_spool instead\n", spool.header.movie_params.dest_file);
+        goto rfail;
+    }
+
+    if (spool.header.num_video_frames == 0)
+    {
+        svr_log("ERROR: Spool file has no video frames\n");
+        goto rfail;
+    }
+
+    if (num_chunks <= 0)
+    {
+        SYSTEM_INFO sys_info;
+        GetSystemInfo(&sys_info);
+
+        num_chunks = sys_info.dwNumberOfProcessors / 2;
+    }
+
+    num_chunks = svr_spool_plan_chunks(&spool, num_chunks, ranges);
+
+    svr_log("Encoding %d video frames from %s in %d chunks\n", spool.header.num_video_frames, spool_path, num_chunks);
+
+    chunks = SVR_ZALLOC_NUM(OfflineChunk, num_chunks);
+
+    for (s32 i = 0; i < num_chunks; i++)
+    {
+        OfflineChunk* chunk = &chunks[i];
+        chunk->spool = &spool;
+        chunk->range = ranges[i];
+
+        SVR_SNPRINTF(chunk->dest_file, "%s.chunk%d.nut", spool.header.movie_params.dest_file, i);
+
+        chunk->thread_h = CreateThread(NULL, 0, offline_chunk_thread_proc, chunk, 0, NULL);
+    }
+
+    for (s32 i = 0; i < num_chunks; i++)
+    {
+        WaitForSingleObject(chunks[i].thread_h, INFINITE);
+        svr_maybe_close_handle(&chunks[i].thread_h);
+
+        if (!chunks[i].ok)
+        {
+            chunks_ok = false;
+        }
+    }
+
+    svr_log("Encoded chunks in %.2f seconds\n", (svr_prof_get_real_time() - start_time) / 1000000.0);
+
+    if (!chunks_ok)
+    {
+        svr_log("ERROR: Not all chunks could be encoded\n");
+        goto rfail;
+    }
+
+    if (!offline_join_chunks(&spool, chunks, num_chunks))
+    {
+        goto rfail;
+    }
+
+    svr_log("Wrote %s in %.2f seconds\n", spool.header.movie_params.dest_file, (svr_prof_get_real_time() - start_time) / 1000000.0);
+
+    ret = 0;
+    goto rexit;
+
+rfail:
+
+rexit:
+    if (chunks)
+    {
+        for (s32 i = 0; i < num_chunks; i++)
+        {
+            DeleteFileA(chunks[i].dest_file);
+        }
+
+        svr_free(chunks);
+    }
+
+    svr_spool_close(&spool);
+
+    return ret;
+}
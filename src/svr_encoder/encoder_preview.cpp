@@ -0,0 +1,423 @@
+#include "encoder_priv.h"
+
+// Live preview of the movie while it is rendering.
+// Every preview_interval frames, the downloaded movie frame is downscaled on the main thread into a small frame, which is compressed
+// to JPEG on a low priority thread and published to the shared memory described at ENCODER_PREVIEW_MAPPING.
+// This costs far less than having the game present every frame to its window, and anything can show the images.
+// The preview must never slow down or break the movie, so frames are skipped when the preview thread is behind,
+// and preview errors only disable the preview.
+
+// Frames that can be waiting for the preview thread. More than this and new preview frames are skipped.
+const s32 PREVIEW_NUM_FRAMES = 2;
+
+// JPEG quality, where 2 is best and 31 is worst.
+const s32 PREVIEW_QSCALE = 5;
+
+DWORD CALLBACK preview_thread_proc(LPVOID param)
+{
+    SetThreadDescription(GetCurrentThread(), L"PREVIEW THREAD");
+
+    EncoderState* encoder_ptr = (EncoderState*)param;
+    encoder_ptr->preview_proc();
+
+    return 0; // Not used.
+}
+
+// Not starting the preview is not an error for the movie.
+bool EncoderState::preview_start()
+{
+    bool ret = false;
+    s32 res;
+    char mapping_name[64];
+    const AVCodec* codec = NULL;
+    s32 preview_width;
+    s32 preview_height;
+
+    preview_src_desc = av_pix_fmt_desc_get(render_video_info->pixel_format);
+
+    // Float images are linear light and would need a transfer function to look right.
+    if (preview_src_desc->flags & AV_PIX_FMT_FLAG_FLOAT)
+    {
+        svr_log("Preview is not available for video encoder %s\n", RENDER_VIDEO_NAMES[render_video_info->id]);
+        goto rfail;
+    }
+
+    preview_width = svr_min(movie_params.preview_width, movie_params.output_width) & ~1;
+    preview_height = (s32)(((s64)preview_width * movie_params.output_height) / movie_params.output_width) & ~1;
+
+    if (preview_width < 2 || preview_height < 2)
+    {
+        svr_log("Preview of %dx%d is too small\n", preview_width, preview_height);
+        goto rfail;
+    }
+
+    SVR_SNPRINTF(mapping_name, "%s%u", ENCODER_PREVIEW_MAPPING, shared_mem_ptr ? shared_mem_ptr->game_pid : (u32)GetCurrentProcessId());
+
+    preview_mapping_h = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, sizeof(EncoderPreviewMem), mapping_name);
+
+    if (preview_mapping_h == NULL)
+    {
+        svr_log("Could not create preview memory %s (%lu)\n", mapping_name, GetLastError());
+        goto rfail;
+    }
+
+    preview_free_frames.init(PREVIEW_NUM_FRAMES);
+    preview_frames.init(PREVIEW_NUM_FRAMES + 1);
+
+    preview_mem_ptr = (EncoderPreviewMem*)MapViewOfFile(preview_mapping_h, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+
+    if (preview_mem_ptr == NULL)
+    {
+        svr_log("Could not map preview memory %s (%lu)\n", mapping_name, GetLastError());
+        goto rfail;
+    }
+
+    // The memory is kept by readers between movies, so the images of the last movie must not be shown as this one.
+    svr_atom_store(&preview_mem_ptr->latest_slot, -1);
+    preview_next_slot = 0;
+
+    codec = avcodec_find_encoder(AV_CODEC_ID_MJPEG);
+
+    if (codec == NULL)
+    {
+        svr_log("Could not find the preview encoder\n");
+        goto rfail;
+    }
+
+    preview_ctx = avcodec_alloc_context3(codec);
+
+    if (preview_ctx == NULL)
+    {
+        svr_log("Could not allocate the preview encoder\n");
+        goto rfail;
+    }
+
+    preview_ctx->width = preview_width;
+    preview_ctx->height = preview_height;
+    preview_ctx->time_base = AVRational { 1, movie_params.video_fps };
+    preview_ctx->pix_fmt = AV_PIX_FMT_YUVJ420P;
+    preview_ctx->color_range = AVCOL_RANGE_JPEG;
+    preview_ctx->colorspace = AVCOL_SPC_BT709;
+    preview_ctx->flags |= AV_CODEC_FLAG_QSCALE;
+    preview_ctx->global_quality = FF_QP2LAMBDA * PREVIEW_QSCALE;
+    preview_ctx->thread_count = 1;
+
+    res = avcodec_open2(preview_ctx, codec, NULL);
+
+    if (res < 0)
+    {
+        svr_log("Could not open the preview encoder (%d)\n", res);
+        goto rfail;
+    }
+
+    for (s32 i = 0; i < PREVIEW_NUM_FRAMES; i++)
+    {
+        AVFrame* frame = av_frame_alloc();
+
+        if (frame == NULL)
+        {
+            svr_log("Could not allocate preview frame\n");
+            goto rfail;
+        }
+
+        frame->format = preview_ctx->pix_fmt;
+        frame->width = preview_width;
+        frame->height = preview_height;
+        frame->quality = preview_ctx->global_quality;
+
+        res = av_frame_get_buffer(frame, 0);
+
+        if (res < 0)
+        {
+            av_frame_free(&frame);
+
+            svr_log("Could not allocate preview frame (%d)\n", res);
+            goto rfail;
+        }
+
+        preview_free_frames.push(&frame);
+    }
+
+    // Nearest sampling is enough at this size, and keeps the cost on the main thread small.
+    preview_src_x = (s32*)svr_alloc(sizeof(s32) * preview_width);
+    preview_src_y = (s32*)svr_alloc(sizeof(s32) * preview_height);
+
+    for (s32 i = 0; i < preview_width; i++)
+    {
+        preview_src_x[i] = (s32)(((s64)i * movie_params.output_width) / preview_width);
+    }
+
+    for (s32 i = 0; i < preview_height; i++)
+    {
+        preview_src_y[i] = (s32)(((s64)i * movie_params.output_height) / preview_height);
+    }
+
+    for (s32 i = 0; i < 256; i++)
+    {
+        s32 luma = ((i - 16) * 255 + 109) / 219;
+        s32 chroma = ((i - 128) * 255) / 224 + 128;
+
+        svr_clamp(&luma, 0, 255);
+        svr_clamp(&chroma, 0, 255);
+
+        preview_luma_lut[i] = (u8)luma;
+        preview_chroma_lut[i] = (u8)chroma;
+    }
+
+    preview_wake_event_h = CreateEventA(NULL, FALSE, FALSE, NULL);
+    preview_thread_h = CreateThread(NULL, 0, preview_thread_proc, this, 0, NULL);
+
+    // The preview is only nice to have, so it must not take time from the encoders.
+    SetThreadPriority(preview_thread_h, THREAD_PRIORITY_LOWEST);
+
+    svr_log("Publishing a %dx%d preview every %d frames to %s\n", preview_width, preview_height, movie_params.preview_interval, mapping_name);
+
+    ret = true;
+    goto rexit;
+
+rfail:
+    preview_stop();
+
+rexit:
+    return ret;
+}
+
+void EncoderState::preview_stop()
+{
+    // Everything else is made after the mapping.
+    if (preview_mapping_h == NULL)
+    {
+        return;
+    }
+
+    if (preview_thread_h)
+    {
+        AVFrame* stop_frame = NULL;
+        preview_frames.push(&stop_frame);
+
+        SetEvent(preview_wake_event_h);
+        WaitForSingleObject(preview_thread_h, INFINITE);
+
+        CloseHandle(preview_thread_h);
+        preview_thread_h = NULL;
+    }
+
+    if (preview_wake_event_h)
+    {
+        CloseHandle(preview_wake_event_h);
+        preview_wake_event_h = NULL;
+    }
+
+    AVFrame* frame;
+
+    while (preview_free_frames.pull(&frame))
+    {
+        av_frame_free(&frame);
+    }
+
+    preview_free_frames.free();
+    preview_frames.free();
+
+    if (preview_ctx)
+    {
+        avcodec_free_context(&preview_ctx);
+    }
+
+    if (preview_src_x)
+    {
+        svr_free(preview_src_x);
+        preview_src_x = NULL;
+    }
+
+    if (preview_src_y)
+    {
+        svr_free(preview_src_y);
+        preview_src_y = NULL;
+    }
+
+    if (preview_mem_ptr)
+    {
+        UnmapViewOfFile(preview_mem_ptr);
+        preview_mem_ptr = NULL;
+    }
+
+    CloseHandle(preview_mapping_h);
+    preview_mapping_h = NULL;
+}
+
+// Called by the main thread with the movie frame before it is given to the encoder.
+void EncoderState::preview_submit_frame(AVFrame* frame)
+{
+    AVFrame* preview_frame;
+
+    // Skip this one if the preview thread is still busy with the previous frames.
+    if (!preview_free_frames.pull(&preview_frame))
+    {
+        return;
+    }
+
+    if (preview_src_desc->flags & AV_PIX_FMT_FLAG_RGB)
+    {
+        preview_scale_rgba(frame, preview_frame);
+    }
+
+    else
+    {
+        preview_scale_yuv(frame, preview_frame);
+    }
+
+    preview_frame->pts = frame->pts;
+
+    preview_frames.push(&preview_frame);
+    SetEvent(preview_wake_event_h);
+}
+
+// Reads a component of a yuv format as 8 bits. This covers both the planar and the semi planar formats.
+static inline s32 preview_read_component(AVFrame* frame, const AVComponentDescriptor* comp, s32 x, s32 y)
+{
+    u8* ptr = frame->data[comp->plane] + (y * frame->linesize[comp->plane]) + (x * comp->step) + comp->offset;
+
+    if (comp->depth > 8)
+    {
+        return *(u16*)ptr >> (comp->depth - 8);
+    }
+
+    return *ptr;
+}
+
+void EncoderState::preview_scale_yuv(AVFrame* src, AVFrame* dest)
+{
+    const AVComponentDescriptor* comps = preview_src_desc->comp;
+    s32 shift_w = preview_src_desc->log2_chroma_w;
+    s32 shift_h = preview_src_desc->log2_chroma_h;
+
+    for (s32 y = 0; y < dest->height; y++)
+    {
+        u8* dest_y = dest->data[0] + (y * dest->linesize[0]);
+        s32 src_y = preview_src_y[y];
+
+        for (s32 x = 0; x < dest->width; x++)
+        {
+            dest_y[x] = preview_luma_lut[preview_read_component(src, &comps[0], preview_src_x[x], src_y)];
+        }
+    }
+
+    // The chroma of the preview is half size, and takes the chroma of the top left luma sample of each 2x2 block.
+    for (s32 y = 0; y < dest->height / 2; y++)
+    {
+        u8* dest_u = dest->data[1] + (y * dest->linesize[1]);
+        u8* dest_v = dest->data[2] + (y * dest->linesize[2]);
+        s32 src_y = preview_src_y[y * 2] >> shift_h;
+
+        for (s32 x = 0; x < dest->width / 2; x++)
+        {
+            s32 src_x = preview_src_x[x * 2] >> shift_w;
+
+            dest_u[x] = preview_chroma_lut[preview_read_component(src, &comps[1], src_x, src_y)];
+            dest_v[x] = preview_chroma_lut[preview_read_component(src, &comps[2], src_x, src_y)];
+        }
+    }
+}
+
+// Full range BT.709 from the rgb of the game, in 8 bit fixed point.
+void EncoderState::preview_scale_rgba(AVFrame* src, AVFrame* dest)
+{
+    for (s32 y = 0; y < dest->height; y++)
+    {
+        u8* src_row = src->data[0] + (preview_src_y[y] * src->linesize[0]);
+        u8* dest_y = dest->data[0] + (y * dest->linesize[0]);
+        u8* dest_u = dest->data[1] + ((y / 2) * dest->linesize[1]);
+        u8* dest_v = dest->data[2] + ((y / 2) * dest->linesize[2]);
+        bool chroma_row = (y & 1) == 0;
+
+        for (s32 x = 0; x < dest->width; x++)
+        {
+            u8* px = src_row + (preview_src_x[x] * 4);
+            s32 r = px[0];
+            s32 g = px[1];
+            s32 b = px[2];
+
+            dest_y[x] = (u8)((54 * r + 183 * g + 19 * b + 128) >> 8);
+
+            if (chroma_row && (x & 1) == 0)
+            {
+                s32 u = (-29 * r - 99 * g + 128 * b + 32896) >> 8;
+                s32 v = (128 * r - 116 * g - 12 * b + 32896) >> 8;
+
+                svr_clamp(&u, 0, 255);
+                svr_clamp(&v, 0, 255);
+
+                dest_u[x / 2] = (u8)u;
+                dest_v[x / 2] = (u8)v;
+            }
+        }
+    }
+}
+
+void EncoderState::preview_proc()
+{
+    AVPacket* packet = av_packet_alloc();
+    bool run = true;
+
+    while (run)
+    {
+        WaitForSingleObject(preview_wake_event_h, INFINITE);
+
+        AVFrame* frame;
+
+        while (preview_frames.pull(&frame))
+        {
+            if (frame == NULL)
+            {
+                run = false;
+                break;
+            }
+
+            s64 video_frame = frame->pts;
+
+            s32 res = avcodec_send_frame(preview_ctx, frame);
+
+            // The frame is copied by the encoder or not used at all so it can be reused right away.
+            preview_free_frames.push(&frame);
+
+            if (res < 0)
+            {
+                svr_log("Could not encode preview frame (%d)\n", res);
+                continue;
+            }
+
+            while (avcodec_receive_packet(preview_ctx, packet) == 0)
+            {
+                preview_publish(packet, video_frame);
+                av_packet_unref(packet);
+            }
+        }
+    }
+
+    av_packet_free(&packet);
+}
+
+void EncoderState::preview_publish(AVPacket* packet, s64 video_frame)
+{
+    if (packet->size > ENCODER_PREVIEW_MAX_SIZE)
+    {
+        return;
+    }
+
+    s32 index = preview_next_slot;
+    EncoderPreviewSlot* slot = &preview_mem_ptr->slots[index];
+
+    // Readers check the sequence on both sides of their copy to know that the slot did not change in between.
+    svr_atom_add(&slot->sequence, 1);
+
+    slot->width = preview_ctx->width;
+    slot->height = preview_ctx->height;
+    slot->size = packet->size;
+    slot->video_frame = video_frame;
+    memcpy(slot->data, packet->data, packet->size);
+
+    svr_atom_add(&slot->sequence, 1);
+
+    svr_atom_store(&preview_mem_ptr->latest_slot, index);
+    preview_next_slot = (index + 1) % ENCODER_PREVIEW_SLOTS;
+}
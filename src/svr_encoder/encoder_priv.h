@@ -5,25 +5,39 @@
 #include "svr_alloc.h"
 #include "svr_locked_array.h"
 #include "svr_locked_queue.h"
+#include "svr_queue.h"
+#include "svr_ini.h"
 #include "svr_atom.h"
+#include "svr_prof.h"
+#include "svr_cpu.h"
+#include "svr_jobq.h"
+#include "svr_spool.h"
+#include "svr_resample.h"
+#include "svr_pipe.h"
 #include "svr_defs.h"
 #include <stdio.h>
+#include <math.h>
 #include <Windows.h>
+#include <Psapi.h>
 #include <d3d11_1.h>
 #include <d3d11shadertracing.h>
 #include <dxgi.h>
 #include <assert.h>
+#include <intrin.h>
+#include <immintrin.h>
 
 extern "C"
 {
     #include <libavformat/avformat.h>
     #include <libavcodec/avcodec.h>
     #include <libswresample/swresample.h>
+    #include <libswscale/swscale.h>
     #include <libavutil/avutil.h>
     #include <libavutil/pixfmt.h>
     #include <libavutil/samplefmt.h>
     #include <libavutil/opt.h>
-    #include <libavutil/audio_fifo.h>
+    #include <libavutil/imgutils.h>
+    #include <libavutil/pixdesc.h>
 }
 
 #include "encoder_state.h"
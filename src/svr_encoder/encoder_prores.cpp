@@ -0,0 +1,14 @@
+#include "encoder_priv.h"
+
+// References:
+// ffmpeg -h encoder=prores_ks
+// https://raw.githubusercontent.com/FFmpeg/FFmpeg/master/libavcodec/proresenc_kostya.c
+// https://support.apple.com/en-us/102207
+
+void EncoderState::render_setup_prores()
+{
+    av_opt_set(render_video_ctx->priv_data, "profile", movie_params.prores_profile, 0);
+
+    // Some video editors only accept the files if they look like they come from Apple.
+    av_opt_set(render_video_ctx->priv_data, "vendor", "apl0", 0);
+}
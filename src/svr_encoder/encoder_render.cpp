@@ -3,36 +3,101 @@
 
 // Actual calls to audio and video codecs and container.
 
-// Should be synchronized with proc_profile.cpp.
+#define RENDER_VIDEO_NAME(ID, NAME, CONTAINERS) NAME,
+#define RENDER_VIDEO_CONTAINERS(ID, NAME, CONTAINERS) CONTAINERS,
+#define RENDER_AUDIO_NAME(ID, NAME) NAME,
+
+// Names and containers of the encoders, indexed by the ids in encoder_shared.h.
+const char* RENDER_VIDEO_NAMES[] =
+{
+    ENCODER_VIDEO_ENCODERS(RENDER_VIDEO_NAME)
+};
+
+const char* RENDER_VIDEO_CONTAINERS_TABLE[] =
+{
+    ENCODER_VIDEO_ENCODERS(RENDER_VIDEO_CONTAINERS)
+};
+
+const char* RENDER_AUDIO_NAMES[] =
+{
+    ENCODER_AUDIO_ENCODERS(RENDER_AUDIO_NAME)
+};
+
+#undef RENDER_VIDEO_NAME
+#undef RENDER_VIDEO_CONTAINERS
+#undef RENDER_AUDIO_NAME
+
+// Codec settings for every video encoder in encoder_shared.h, in the same order.
+// There must be a conversion for the pixel format in encoder_video.cpp.
+// The dnxhd encoder crashes without slice threading.
+// The image encoders write one file per frame, and frame threading makes ffmpeg compress that many images in parallel.
+// The bits per pixel only have to be roughly right, since the movie file is cut to the written size when closed.
+// The encoders that don't force keyframes are the ones where every frame already is one, except for ffv1 which is set up for that when segmenting.
 const RenderVideoInfo RENDER_VIDEO_INFOS[] =
 {
-    RenderVideoInfo { "dnxhr", "dnxhd", AV_PIX_FMT_YUV422P, &EncoderState::render_setup_dnxhr },
-    RenderVideoInfo { "libx264", "libx264", AV_PIX_FMT_NV12, &EncoderState::render_setup_libx264 },
-    RenderVideoInfo { "libx264_444", "libx264", AV_PIX_FMT_YUV444P, &EncoderState::render_setup_libx264 },
+    RenderVideoInfo { ENCODER_VIDEO_LIBX264, "libx264", AV_PIX_FMT_NV12, 0, 0.3f, true, &EncoderState::render_setup_libx264 },
+    RenderVideoInfo { ENCODER_VIDEO_LIBX264_444, "libx264", AV_PIX_FMT_YUV444P, 0, 0.6f, true, &EncoderState::render_setup_libx264 },
+    RenderVideoInfo { ENCODER_VIDEO_LIBX265, "libx265", AV_PIX_FMT_YUV420P, 0, 0.15f, true, &EncoderState::render_setup_libx265 },
+    RenderVideoInfo { ENCODER_VIDEO_LIBSVTAV1, "libsvtav1", AV_PIX_FMT_YUV420P, 0, 0.1f, true, &EncoderState::render_setup_libsvtav1 },
+    RenderVideoInfo { ENCODER_VIDEO_DNXHR, "dnxhd", AV_PIX_FMT_YUV422P, FF_THREAD_SLICE, 3.5f, false, &EncoderState::render_setup_dnxhr },
+    RenderVideoInfo { ENCODER_VIDEO_PRORES, "prores_ks", AV_PIX_FMT_YUV422P10LE, FF_THREAD_FRAME, 3.5f, false, &EncoderState::render_setup_prores },
+    RenderVideoInfo { ENCODER_VIDEO_FFV1, "ffv1", AV_PIX_FMT_YUV420P, FF_THREAD_SLICE, 6.0f, false, &EncoderState::render_setup_ffv1 },
+    RenderVideoInfo { ENCODER_VIDEO_UTVIDEO, "utvideo", AV_PIX_FMT_YUV422P, FF_THREAD_FRAME, 8.0f, false, NULL },
+    RenderVideoInfo { ENCODER_VIDEO_RAWVIDEO, "rawvideo", AV_PIX_FMT_YUV420P, 0, 12.0f, false, NULL },
+    RenderVideoInfo { ENCODER_VIDEO_RAWVIDEO_444, "rawvideo", AV_PIX_FMT_YUV444P, 0, 24.0f, false, NULL },
+    RenderVideoInfo { ENCODER_VIDEO_PNG, "png", AV_PIX_FMT_RGBA, FF_THREAD_FRAME, 12.0f, false, &EncoderState::render_setup_png },
+    RenderVideoInfo { ENCODER_VIDEO_TIFF, "tiff", AV_PIX_FMT_RGBA, FF_THREAD_FRAME, 32.0f, false, &EncoderState::render_setup_tiff },
+    RenderVideoInfo { ENCODER_VIDEO_EXR, "exr", AV_PIX_FMT_GBRPF32LE, FF_THREAD_FRAME, 48.0f, false, &EncoderState::render_setup_exr },
 };
 
-// Should be synchronized with proc_profile.cpp.
+// Codec settings for every audio encoder in encoder_shared.h, in the same order.
+// The preferred format and rate are used when the codec supports them, otherwise the closest that the codec supports is used.
+// The sidecar container is the file extension of the separate audio file that is written next to containers without audio, such as image sequences and y4m.
+// The flac encoder runs single threaded, which is cheap next to the video encoding at the rates of the game audio.
 const RenderAudioInfo RENDER_AUDIO_INFOS[] =
 {
-    RenderAudioInfo { "aac", "aac_mf", AV_SAMPLE_FMT_S16, 0, NULL },
+    RenderAudioInfo { ENCODER_AUDIO_AAC, "aac_mf", AV_SAMPLE_FMT_S16, 0, "m4a", NULL },
+    RenderAudioInfo { ENCODER_AUDIO_PCM, "pcm_s16le", AV_SAMPLE_FMT_S16, 0, "wav", NULL },
+    RenderAudioInfo { ENCODER_AUDIO_FLAC, "flac", AV_SAMPLE_FMT_S16, 0, "flac", NULL },
+    RenderAudioInfo { ENCODER_AUDIO_OPUS, "libopus", AV_SAMPLE_FMT_FLT, 48000, "opus", NULL },
 };
 
+static_assert(SVR_ARRAY_SIZE(RENDER_VIDEO_INFOS) == ENCODER_NUM_VIDEO_ENCODERS, "Every video encoder in encoder_shared.h needs codec settings");
+static_assert(SVR_ARRAY_SIZE(RENDER_AUDIO_INFOS) == ENCODER_NUM_AUDIO_ENCODERS, "Every audio encoder in encoder_shared.h needs codec settings");
+
 bool EncoderState::render_init()
 {
-    render_frame_queue.init(RENDER_QUEUED_FRAMES);
-    render_packet_queue.init(RENDER_QUEUED_PACKETS);
     render_audio_queue.init(RENDER_QUEUED_AUDIO_BUFFERS);
-    render_recycled_video_frames.init(RENDER_QUEUED_FRAMES);
-    render_recycled_audio_frames.init(RENDER_QUEUED_FRAMES);
     render_recycled_audio_buffers.init(RENDER_QUEUED_AUDIO_BUFFERS);
 
-    render_frame_wake_event_h = CreateEventA(NULL, FALSE, FALSE, NULL);
-    render_packet_wake_event_h = CreateEventA(NULL, FALSE, FALSE, NULL);
     render_audio_wake_event_h = CreateEventA(NULL, FALSE, FALSE, NULL);
 
-    // Prepare some audio buffers that can be reused.
+    render_finalizing_movies.init(0);
+    render_cached_video_frames.init(0);
+    render_cached_audio_frames.init(0);
+
+    spool_records.init(0);
+
+    return true;
+}
+
+// Prepare some audio buffers that can be reused.
+// The buffers are kept between movies as long as the audio format is the same.
+void EncoderState::render_prepare_audio_buffers()
+{
     const s32 PRECACHED_AUDIO_INPUTS = 256;
 
+    s32 size = render_get_audio_buffer_size(ENCODER_MAX_SAMPLES);
+
+    if (size == render_audio_buffer_size)
+    {
+        return;
+    }
+
+    render_free_recycled_stuff();
+
+    render_audio_buffer_size = size;
+
     RenderAudioThreadInput precached_audio_inputs[PRECACHED_AUDIO_INPUTS];
 
     for (s32 i = 0; i < PRECACHED_AUDIO_INPUTS; i++)
@@ -41,10 +106,154 @@ bool EncoderState::render_init()
     }
 
     render_recycled_audio_buffers.push_range(precached_audio_inputs, PRECACHED_AUDIO_INPUTS);
-    return true;
+}
+
+// Give the frames of earlier movies to the new movie if they have the same format.
+// This must be called after the codecs have been opened.
+// The audio frames are not used in spool mode, so they are all freed then.
+void EncoderState::render_reuse_cached_frames()
+{
+    s32 num_reused = 0;
+
+    for (s32 i = 0; i < render_cached_video_frames.size; i++)
+    {
+        AVFrame* frame = render_cached_video_frames[i];
+
+        if (frame->format == render_video_info->pixel_format && frame->width == movie_params.output_width && frame->height == movie_params.output_height)
+        {
+            render_movie->recycled_video_frames.push(&frame);
+            num_reused++;
+        }
+
+        else
+        {
+            av_frame_free(&frame);
+        }
+    }
+
+    for (s32 i = 0; i < render_cached_audio_frames.size; i++)
+    {
+        AVFrame* frame = render_cached_audio_frames[i];
+
+        // The number of samples is changed for the last frames in a movie, so look at the buffer size instead.
+        bool matches = false;
+
+        if (render_audio_ctx)
+        {
+            s32 needed_linesize = 0;
+            av_samples_get_buffer_size(&needed_linesize, render_audio_ctx->ch_layout.nb_channels, render_audio_ctx->frame_size, render_audio_ctx->sample_fmt, 0);
+
+            matches = frame->format == render_audio_ctx->sample_fmt && frame->sample_rate == render_audio_ctx->sample_rate
+                && frame->ch_layout.nb_channels == render_audio_ctx->ch_layout.nb_channels && frame->linesize[0] >= needed_linesize;
+        }
+
+        if (matches)
+        {
+            render_movie->recycled_audio_frames.push(&frame);
+            num_reused++;
+        }
+
+        else
+        {
+            av_frame_free(&frame);
+        }
+    }
+
+    render_cached_video_frames.size = 0;
+    render_cached_audio_frames.size = 0;
+
+    if (num_reused > 0)
+    {
+        svr_log("Reusing %d frames from previous movies\n", num_reused);
+    }
+}
+
+void EncoderState::render_free_cached_frames()
+{
+    for (s32 i = 0; i < render_cached_video_frames.size; i++)
+    {
+        av_frame_free(&render_cached_video_frames[i]);
+    }
+
+    for (s32 i = 0; i < render_cached_audio_frames.size; i++)
+    {
+        av_frame_free(&render_cached_audio_frames[i]);
+    }
+
+    render_cached_video_frames.free();
+    render_cached_audio_frames.free();
 }
 
 bool EncoderState::render_start()
+{
+    bool ret = false;
+
+    // Free up older movies that have finished in the background.
+    render_reap_finalized_movies(false);
+
+    // Cannot open the file while it is still being written to by an older movie.
+    render_wait_for_finalize_of_file(movie_params.dest_file);
+
+    render_movie = SVR_ZALLOC(RenderMovie);
+    render_movie->encoder_ptr = this;
+
+    SVR_COPY_STRING(movie_params.dest_file, render_movie->dest_file);
+
+    render_movie->frame_queue.init(RENDER_QUEUED_FRAMES);
+    render_movie->packet_queue.init(RENDER_QUEUED_PACKETS);
+    render_movie->recycled_video_frames.init(RENDER_QUEUED_FRAMES);
+    render_movie->recycled_audio_frames.init(RENDER_QUEUED_FRAMES);
+
+    render_movie->frame_wake_event_h = CreateEventA(NULL, FALSE, FALSE, NULL);
+    render_movie->packet_wake_event_h = CreateEventA(NULL, FALSE, FALSE, NULL);
+
+    // In spool mode nothing is encoded now. The frames and samples are written to a spool file that is encoded later.
+    if (movie_params.use_spool)
+    {
+        if (!render_setup_video_info())
+        {
+            goto rfail;
+        }
+
+        if (!spool_start())
+        {
+            goto rfail;
+        }
+    }
+
+    else
+    {
+        if (!render_start_encoders())
+        {
+            goto rfail;
+        }
+    }
+
+    render_reuse_cached_frames();
+
+    // Threads are ok at the start.
+    svr_atom_store(&render_movie->frame_thread_status, 1);
+    svr_atom_store(&render_movie->packet_thread_status, 1);
+    svr_atom_store(&render_audio_thread_status, 1);
+
+    render_audio_thread_message[0] = 0;
+
+    // Be extra sure that this event is not triggered, so the thread enters a waiting state.
+    ResetEvent(render_audio_wake_event_h);
+
+    svr_atom_store(&render_movie->running, 1);
+    svr_atom_store(&render_started, 1);
+
+    ret = true;
+    goto rexit;
+
+rfail:
+
+rexit:
+    return ret;
+}
+
+bool EncoderState::render_start_encoders()
 {
     bool ret = false;
     s32 res;
@@ -67,7 +276,13 @@ bool EncoderState::render_start()
         }
     }
 
-    res = avformat_write_header(render_output_context, NULL);
+    // The options that are used are removed by the header, so keep them for the other segments.
+    if (render_movie->use_segments)
+    {
+        av_dict_copy(&render_movie->segment_options, render_output_options, 0);
+    }
+
+    res = avformat_write_header(render_output_context, &render_output_options);
 
     if (res < 0)
     {
@@ -75,23 +290,26 @@ bool EncoderState::render_start()
         goto rfail;
     }
 
-    // Threads are ok at the start.
-    svr_atom_store(&render_frame_thread_status, 1);
-    svr_atom_store(&render_packet_thread_status, 1);
-    svr_atom_store(&render_audio_thread_status, 1);
-
-    render_frame_thread_message[0] = 0;
-    render_packet_thread_message[0] = 0;
-    render_audio_thread_message[0] = 0;
+    if (render_audio_output_context != render_output_context)
+    {
+        res = avformat_write_header(render_audio_output_context, NULL);
 
-    // Be extra sure that these events are not triggered, so the threads enter a waiting state.
-    ResetEvent(render_frame_wake_event_h);
-    ResetEvent(render_packet_wake_event_h);
-    ResetEvent(render_audio_wake_event_h);
+        if (res < 0)
+        {
+            error("ERROR: Could not create audio file header (%d)\n", res);
+            goto rfail;
+        }
+    }
 
-    svr_atom_store(&render_started, 1);
+    if (movie_params.use_audio)
+    {
+        render_prepare_audio_buffers();
+    }
 
-    render_start_threads();
+    if (render_movie->use_segments)
+    {
+        segment_start();
+    }
 
     ret = true;
     goto rexit;
@@ -104,16 +322,20 @@ rexit:
 
 void EncoderState::render_free_static()
 {
-    svr_maybe_close_handle(&render_frame_wake_event_h);
-    svr_maybe_close_handle(&render_packet_wake_event_h);
+    // Older movies must be completely written before we exit.
+    render_reap_finalized_movies(true);
+    render_finalizing_movies.free();
+
+    render_free_cached_frames();
+    render_free_lingering_thread_inputs();
+    render_free_recycled_stuff();
+
     svr_maybe_close_handle(&render_audio_wake_event_h);
 
-    render_frame_queue.free();
-    render_packet_queue.free();
     render_audio_queue.free();
-    render_recycled_video_frames.free();
-    render_recycled_audio_frames.free();
     render_recycled_audio_buffers.free();
+
+    spool_records.free();
 }
 
 void EncoderState::render_free_dynamic()
@@ -127,14 +349,8 @@ void EncoderState::render_free_dynamic()
             render_submit_texture();
         }
 
-        // Flush out all of the remaining samples in the audio fifo for encode.
-
-        if (movie_params.use_audio)
-        {
-            render_flush_audio_fifo();
-        }
-
         // Send flush to audio thread if we started it.
+        // This has to be done before submitting the last audio frame, because the audio thread writes to it.
 
         if (render_audio_thread_h)
         {
@@ -146,51 +362,65 @@ void EncoderState::render_free_dynamic()
             WaitForSingleObject(render_audio_thread_h, INFINITE); // Wait for audio thread to finish.
         }
 
-        // Send flushes to frame thread.
-
-        if (render_video_ctx)
+        if (movie_params.use_spool)
         {
-            render_encode_video_frame(NULL);
+            spool_finish();
         }
 
-        if (render_audio_ctx)
+        else
         {
-            render_encode_audio_frame(NULL);
-        }
+            // Submit the last samples, which do not have to fill a whole frame.
 
-        WaitForSingleObject(render_frame_thread_h, INFINITE); // Wait for frame thread to finish.
+            if (movie_params.use_audio)
+            {
+                audio_flush();
+            }
 
-        // Flush the packet thread.
+            // Send flushes to frame thread.
+            // The rest of the movie is written in the finalize thread.
 
-        AVPacket* flush_packet = NULL;
-        render_packet_queue.push(&flush_packet);
-        SetEvent(render_packet_wake_event_h); // Notify packet thread.
+            if (render_video_ctx)
+            {
+                render_encode_video_frame(NULL);
+            }
 
-        WaitForSingleObject(render_packet_thread_h, INFINITE); // Wait for packet thread to finish.
+            if (render_audio_ctx)
+            {
+                render_encode_audio_frame(NULL);
+            }
 
-        av_write_trailer(render_output_context); // Can only be written if avformat_write_header was called.
+            render_movie->write_trailer = true;
+        }
     }
 
     else
     {
         // Wake threads so they can exit (if they even started).
-        // Since render_started is 0, they will immediately exit.
+        // Since the movie is not running, they will immediately exit.
+
+        if (render_movie)
+        {
+            svr_atom_store(&render_movie->running, 0);
+
+            SetEvent(render_movie->frame_wake_event_h);
+            SetEvent(render_movie->packet_wake_event_h);
+        }
 
-        SetEvent(render_frame_wake_event_h);
-        SetEvent(render_packet_wake_event_h);
-        SetEvent(render_audio_wake_event_h);
+        // The audio thread uses the movie so it must be finished before the movie is given away.
+        if (render_audio_thread_h)
+        {
+            SetEvent(render_audio_wake_event_h);
+            WaitForSingleObject(render_audio_thread_h, INFINITE);
+        }
     }
 
-    if (render_output_context)
+    if (render_movie)
     {
-        avio_close(render_output_context->pb);
-
-        avformat_free_context(render_output_context);
-        render_output_context = NULL;
+        render_start_finalize();
     }
 
-    avcodec_free_context(&render_video_ctx);
-    avcodec_free_context(&render_audio_ctx);
+    render_output_context = NULL;
+    render_audio_output_context = NULL;
 
     render_video_stream = NULL;
     render_audio_stream = NULL;
@@ -200,29 +430,136 @@ void EncoderState::render_free_dynamic()
 
     render_container = NULL;
 
+    av_dict_free(&render_output_options);
+
     svr_atom_store(&render_started, 0);
 
     render_video_pts = 0;
     render_audio_pts = 0;
 
-    render_free_recycled_stuff();
+    segment_frame_ticks.free();
+
     render_free_lingering_thread_inputs();
 
-    svr_maybe_close_handle(&render_frame_thread_h);
-    svr_maybe_close_handle(&render_packet_thread_h);
     svr_maybe_close_handle(&render_audio_thread_h);
 }
 
+// Free the movies that have been finalized.
+// With wait_all, this will block until every movie has been finalized.
+// Returns false if any of the freed movies could not be finalized. The error will be in render_finalize_message.
+bool EncoderState::render_reap_finalized_movies(bool wait_all)
+{
+    bool ret = true;
+
+    DWORD wait_time = wait_all ? INFINITE : 0;
+
+    for (s32 i = render_finalizing_movies.size - 1; i >= 0; i--)
+    {
+        RenderMovie* movie = render_finalizing_movies[i];
+
+        if (WaitForSingleObject(movie->finalize_thread_h, wait_time) != WAIT_OBJECT_0)
+        {
+            continue;
+        }
+
+        if (movie->finalize_failed)
+        {
+            ret = false;
+        }
+
+        render_free_movie(movie);
+        render_finalizing_movies.remove_index(i);
+    }
+
+    return ret;
+}
+
+// Block until any older movie that is writing to this file has been finalized.
+void EncoderState::render_wait_for_finalize_of_file(const char* dest_file)
+{
+    for (s32 i = render_finalizing_movies.size - 1; i >= 0; i--)
+    {
+        RenderMovie* movie = render_finalizing_movies[i];
+
+        if (_stricmp(movie->dest_file, dest_file))
+        {
+            continue;
+        }
+
+        svr_log("Waiting for previous movie %s to be finalized\n", movie->dest_file);
+
+        WaitForSingleObject(movie->finalize_thread_h, INFINITE);
+
+        render_free_movie(movie);
+        render_finalizing_movies.remove_index(i);
+    }
+}
+
+// Free everything in a movie after its threads have finished.
+void EncoderState::render_free_movie(RenderMovie* movie)
+{
+    // Kept until someone asks, because the movie that failed may not be the one that is waited for.
+    if (movie->finalize_failed)
+    {
+        render_finalize_failed = true;
+        SVR_COPY_STRING(movie->finalize_message, render_finalize_message);
+    }
+
+    // Free any lingering objects that got stuck in a thread input queue that could
+    // not be processed because some error.
+
+    AVPacket* packet_input = NULL;
+
+    while (movie->packet_queue.pull(&packet_input))
+    {
+        av_packet_free(&packet_input);
+    }
+
+    RenderFrameThreadInput frame_input = {};
+
+    while (movie->frame_queue.pull(&frame_input))
+    {
+        av_frame_free(&frame_input.frame);
+    }
+
+    // Keep the encoded frames around for the next movie.
+
+    AVFrame* frame = NULL;
+
+    while (movie->recycled_video_frames.pull(&frame))
+    {
+        render_cached_video_frames.push(frame);
+    }
+
+    while (movie->recycled_audio_frames.pull(&frame))
+    {
+        render_cached_audio_frames.push(frame);
+    }
+
+    movie->frame_queue.free();
+    movie->packet_queue.free();
+    movie->segment_cuts.free();
+    movie->recycled_video_frames.free();
+    movie->recycled_audio_frames.free();
+
+    svr_maybe_close_handle(&movie->frame_wake_event_h);
+    svr_maybe_close_handle(&movie->packet_wake_event_h);
+    svr_maybe_close_handle(&movie->frame_thread_h);
+    svr_maybe_close_handle(&movie->packet_thread_h);
+    svr_maybe_close_handle(&movie->finalize_thread_h);
+
+    svr_free(movie);
+}
+
 // Find the structure matching the configuration in the movie profile.
 bool EncoderState::render_setup_video_info()
 {
-    for (s32 i = 0; i < SVR_ARRAY_SIZE(RENDER_VIDEO_INFOS); i++)
+    for (s32 i = 0; i < ENCODER_NUM_VIDEO_ENCODERS; i++)
     {
-        const RenderVideoInfo* info = &RENDER_VIDEO_INFOS[i];
-
-        if (!strcmp(info->profile_name, movie_params.video_encoder))
+        if (!strcmp(RENDER_VIDEO_NAMES[i], movie_params.video_encoder))
         {
-            render_video_info = info;
+            render_video_info = &RENDER_VIDEO_INFOS[i];
+            assert(render_video_info->id == i);
             return true;
         }
     }
@@ -234,13 +571,12 @@ bool EncoderState::render_setup_video_info()
 // Find the structure matching the configuration in the movie profile.
 bool EncoderState::render_setup_audio_info()
 {
-    for (s32 i = 0; i < SVR_ARRAY_SIZE(RENDER_AUDIO_INFOS); i++)
+    for (s32 i = 0; i < ENCODER_NUM_AUDIO_ENCODERS; i++)
     {
-        const RenderAudioInfo* info = &RENDER_AUDIO_INFOS[i];
-
-        if (!strcmp(info->profile_name, movie_params.audio_encoder))
+        if (!strcmp(RENDER_AUDIO_NAMES[i], movie_params.audio_encoder))
         {
-            render_audio_info = info;
+            render_audio_info = &RENDER_AUDIO_INFOS[i];
+            assert(render_audio_info->id == i);
             return true;
         }
     }
@@ -249,6 +585,30 @@ bool EncoderState::render_setup_audio_info()
     return false;
 }
 
+// Rough size of the movie file for the given length, so the file can be allocated up front. Returns 0 if the length is not known.
+// The audio is counted as 16-bit PCM, which is the most that the audio encoders write.
+s64 EncoderState::render_estimate_size(s32 seconds, bool with_video)
+{
+    if (seconds <= 0)
+    {
+        return 0;
+    }
+
+    double bytes_per_second = 0.0;
+
+    if (with_video)
+    {
+        bytes_per_second += render_video_info->bits_per_pixel * movie_params.output_width * movie_params.output_height * movie_params.video_fps / 8.0;
+    }
+
+    if (movie_params.use_audio)
+    {
+        bytes_per_second += movie_params.audio_hz * movie_params.audio_channels * 2.0;
+    }
+
+    return (s64)(bytes_per_second * seconds);
+}
+
 bool EncoderState::render_init_output_context()
 {
     bool ret = false;
@@ -262,7 +622,8 @@ bool EncoderState::render_init_output_context()
         goto rfail;
     }
 
-    if (render_container->flags & AVFMT_NOFILE)
+    // Image sequences are the only containers that open their own files.
+    if ((render_container->flags & AVFMT_NOFILE) && strcmp(render_container->name, "image2"))
     {
         error("ERROR: Container %s is not for render file output\n", render_container->name);
         goto rfail;
@@ -276,14 +637,171 @@ bool EncoderState::render_init_output_context()
         goto rfail;
     }
 
-    res = avio_open2(&render_output_context->pb, movie_params.dest_file, AVIO_FLAG_WRITE, NULL, NULL);
+    // The output context must be given to the movie now so it can be closed in case of an error later on.
+    render_movie->output_context = render_output_context;
+    render_audio_output_context = render_output_context;
+
+    if (render_container->flags & AVFMT_NOFILE)
+    {
+        if (movie_params.pipe_target[0])
+        {
+            svr_log("Image sequences are always written to files, ignoring the pipe\n");
+        }
+
+        if (movie_params.segment_seconds > 0 || movie_params.segment_mb > 0)
+        {
+            svr_log("Image sequences are already one file per frame, ignoring segmented output\n");
+        }
+
+        if (!render_init_sequence_output())
+        {
+            goto rfail;
+        }
+    }
+
+    else
+    {
+        if (movie_params.pipe_target[0])
+        {
+            if (movie_params.segment_seconds > 0 || movie_params.segment_mb > 0)
+            {
+                svr_log("Pipes are one continuous stream, ignoring segmented output\n");
+            }
+
+            if (!io_open_pipe(&render_movie->io, movie_params.pipe_target))
+            {
+                goto rfail;
+            }
+        }
+
+        else if (movie_params.segment_seconds > 0 || movie_params.segment_mb > 0)
+        {
+            if (!segment_init())
+            {
+                goto rfail;
+            }
+        }
+
+        else
+        {
+            if (!io_open(&render_movie->io, movie_params.dest_file, render_estimate_size(movie_params.expected_seconds, true)))
+            {
+                goto rfail;
+            }
+        }
+
+        render_output_context->pb = render_movie->io.avio;
+        render_output_context->flags |= AVFMT_FLAG_CUSTOM_IO;
+
+        if (movie_params.use_fragmented)
+        {
+            render_setup_fragmented_output();
+        }
+    }
+
+    ret = true;
+    goto rexit;
+
+rfail:
+
+rexit:
+    return ret;
+}
+
+// Makes the file name pattern of an image sequence, which is the movie name with the frame number added.
+// A movie named shot.png becomes shot_000000.png, shot_000001.png and so on.
+// This is a format string, so any percent sign in the name is escaped.
+void render_make_sequence_pattern(const char* dest_file, char* buf, s32 buf_size)
+{
+    const char* ext = strrchr(dest_file, '.');
+    s32 name_len = ext ? (s32)(ext - dest_file) : (s32)strlen(dest_file);
+    s32 pos = 0;
+
+    for (s32 i = 0; i < name_len && pos < buf_size - 2; i++)
+    {
+        if (dest_file[i] == '%')
+        {
+            buf[pos++] = '%';
+        }
+
+        buf[pos++] = dest_file[i];
+    }
+
+    stbsp_snprintf(buf + pos, buf_size - pos, "_%%06d%s", ext ? ext : "");
+}
+
+// Makes the name of the audio file that is written next to an image sequence.
+// A movie named shot.png with pcm audio has its audio in shot.wav.
+void render_make_sidecar_path(const char* dest_file, const char* ext, char* buf, s32 buf_size)
+{
+    const char* dot = strrchr(dest_file, '.');
+    s32 name_len = dot ? (s32)(dot - dest_file) : (s32)strlen(dest_file);
+
+    stbsp_snprintf(buf, buf_size, "%.*s.%s", name_len, dest_file, ext);
+}
+
+// Every frame is written to a file of its own by the image2 muxer.
+// The images are compressed in parallel by the frame threads of the encoder, so the packet thread only has to write them out.
+bool EncoderState::render_init_sequence_output()
+{
+    char pattern[MAX_PATH];
+    render_make_sequence_pattern(movie_params.dest_file, pattern, sizeof(pattern));
+
+    av_freep(&render_output_context->url);
+    render_output_context->url = av_strdup(pattern);
+
+    if (render_output_context->url == NULL)
+    {
+        error("ERROR: Could not create render output context\n");
+        return false;
+    }
+
+    // Number the files from the first frame.
+    av_dict_set(&render_output_options, "start_number", "0", 0);
+
+    if (movie_params.use_fragmented)
+    {
+        svr_log("Image sequences are always written one frame at a time, ignoring fragmented output\n");
+    }
+
+    svr_log("Writing image sequence to %s\n", pattern);
+
+    return true;
+}
+
+// Containers without audio like image sequences and y4m have nowhere to put it, so it is written to a file of its own.
+// This is always a file even when the movie is written to a pipe.
+bool EncoderState::render_init_sidecar_output()
+{
+    bool ret = false;
+    s32 res;
+
+    char path[MAX_PATH];
+    render_make_sidecar_path(movie_params.dest_file, render_audio_info->sidecar_container, path, sizeof(path));
+
+    render_audio_output_context = NULL;
+
+    res = avformat_alloc_output_context2(&render_audio_output_context, NULL, NULL, path);
 
     if (res < 0)
     {
-        error("ERROR: Could not create render output file (%d)\n", res);
+        error("ERROR: Could not create audio output context for %s (%d)\n", path, res);
         goto rfail;
     }
 
+    // Given to the movie now so it can be closed in case of an error later on.
+    render_movie->audio_output_context = render_audio_output_context;
+
+    if (!io_open(&render_movie->audio_io, path, render_estimate_size(movie_params.expected_seconds, false)))
+    {
+        goto rfail;
+    }
+
+    render_audio_output_context->pb = render_movie->audio_io.avio;
+    render_audio_output_context->flags |= AVFMT_FLAG_CUSTOM_IO;
+
+    svr_log("Writing audio to %s\n", path);
+
     ret = true;
     goto rexit;
 
@@ -293,11 +811,37 @@ rexit:
     return ret;
 }
 
+// Write the container in pieces so the index does not have to be written for the whole movie at the end.
+// The file can then be played up to the last piece if the movie is never finished.
+void EncoderState::render_setup_fragmented_output()
+{
+    if (!strcmp(render_container->name, "mov") || !strcmp(render_container->name, "mp4"))
+    {
+        // An empty index is written at the start, and then every fragment has its own index.
+        // Fragments are cut every second instead of on every keyframe, because all frames are keyframes for some encoders.
+        av_dict_set(&render_output_options, "movflags", "empty_moov+default_base_moof", 0);
+        av_dict_set(&render_output_options, "frag_duration", "1000000", 0);
+    }
+
+    else if (!strcmp(render_container->name, "matroska"))
+    {
+        // Clusters are already written as they are completed, so just keep them short.
+        av_dict_set(&render_output_options, "cluster_time_limit", "1000", 0);
+    }
+
+    else
+    {
+        svr_log("Container %s cannot be fragmented, writing it normally\n", render_container->name);
+    }
+}
+
 bool EncoderState::render_init_video()
 {
     bool ret = false;
     s32 res;
 
+    const AVPixFmtDescriptor* pix_desc;
+
     if (!render_setup_video_info())
     {
         goto rfail;
@@ -317,7 +861,8 @@ bool EncoderState::render_init_video()
 
     res = avformat_query_codec(render_container, codec->id, FF_COMPLIANCE_EXPERIMENTAL);
 
-    if (res <= 0)
+    // Some containers like image2 and yuv4mpegpipe cannot be asked about codecs, and will fail when writing the header instead.
+    if (res == 0 || (res < 0 && res != AVERROR_PATCHWELCOME))
     {
         error("ERROR: Encoder %s cannot be used in container %s (%d)\n", codec->name, render_container->name, res);
         goto rfail;
@@ -342,8 +887,8 @@ bool EncoderState::render_init_video()
     }
 
     render_video_ctx->bit_rate = 0;
-    render_video_ctx->width = movie_params.video_width;
-    render_video_ctx->height = movie_params.video_height;
+    render_video_ctx->width = movie_params.output_width;
+    render_video_ctx->height = movie_params.output_height;
     render_video_ctx->time_base = video_q;
     render_video_ctx->pix_fmt = render_video_info->pixel_format;
     render_video_ctx->color_primaries = AVCOL_PRI_BT709;
@@ -351,6 +896,17 @@ bool EncoderState::render_init_video()
     render_video_ctx->color_range = AVCOL_RANGE_MPEG;
     render_video_ctx->colorspace = AVCOL_SPC_BT709;
 
+    // Images are stored as the RGB of the game. Float images are in linear light, see tex2vid.hlsl.
+    pix_desc = av_pix_fmt_desc_get(render_video_ctx->pix_fmt);
+
+    if (pix_desc->flags & AV_PIX_FMT_FLAG_RGB)
+    {
+        render_video_ctx->color_primaries = AVCOL_PRI_BT709;
+        render_video_ctx->color_trc = (pix_desc->flags & AV_PIX_FMT_FLAG_FLOAT) ? AVCOL_TRC_LINEAR : AVCOL_TRC_IEC61966_2_1;
+        render_video_ctx->color_range = AVCOL_RANGE_JPEG;
+        render_video_ctx->colorspace = AVCOL_SPC_RGB;
+    }
+
     render_video_stream->time_base = render_video_ctx->time_base;
     render_video_stream->avg_frame_rate = av_inv_q(render_video_ctx->time_base);
 
@@ -359,13 +915,31 @@ bool EncoderState::render_init_video()
         render_video_ctx->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
     }
 
-    render_video_ctx->thread_count = 0; // Use all threads.
+    render_video_ctx->thread_count = cpu_get_codec_threads(movie_params.video_threads); // 0 uses all threads.
+
+    if (render_video_info->thread_type != 0)
+    {
+        render_video_ctx->thread_type = render_video_info->thread_type;
+    }
 
     if (render_video_info->setup)
     {
         (this->*render_video_info->setup)();
     }
 
+    // Segments are cut on frames that are forced to be keyframes, see segment_check_cut.
+    // Encoders that cannot be told where to put a keyframe can only be cut if every frame is one.
+    if (render_movie->use_segments && !render_video_info->forces_keyframes)
+    {
+        const AVCodecDescriptor* codec_desc = avcodec_descriptor_get(codec->id);
+
+        if (!(codec_desc->props & AV_CODEC_PROP_INTRA_ONLY) && render_video_ctx->gop_size != 1)
+        {
+            error("ERROR: Encoder %s cannot be cut into segments\n", movie_params.video_encoder);
+            goto rfail;
+        }
+    }
+
     res = avcodec_open2(render_video_ctx, codec, NULL);
 
     if (res < 0)
@@ -396,22 +970,13 @@ bool EncoderState::render_init_audio()
     bool ret = false;
     s32 res;
 
+    AVRational audio_q;
+
     if (!render_setup_audio_info())
     {
         goto rfail;
     }
 
-    s32 hz = movie_params.audio_hz;
-
-    // Set from encoder if it requires a set sample rate.
-    if (render_audio_info->hz != 0)
-    {
-        hz = render_audio_info->hz;
-    }
-
-    // Time base for video. Always based in seconds, so 1/44100 for example.
-    AVRational audio_q = av_make_q(1, hz);
-
     const AVCodec* codec = avcodec_find_encoder_by_name(render_audio_info->codec_name);
 
     // Maybe seems silly but this is possible to happen if someone replaces the dlls or something.
@@ -421,15 +986,31 @@ bool EncoderState::render_init_audio()
         goto rfail;
     }
 
-    res = avformat_query_codec(render_container, codec->id, FF_COMPLIANCE_EXPERIMENTAL);
+    if (!render_negotiate_audio_format(codec))
+    {
+        goto rfail;
+    }
+
+    // Time base for audio. Always based in seconds, so 1/44100 for example.
+    audio_q = av_make_q(1, render_audio_hz);
+
+    if (render_container->audio_codec == AV_CODEC_ID_NONE)
+    {
+        if (!render_init_sidecar_output())
+        {
+            goto rfail;
+        }
+    }
+
+    res = avformat_query_codec(render_audio_output_context->oformat, codec->id, FF_COMPLIANCE_EXPERIMENTAL);
 
     if (res <= 0)
     {
-        error("ERROR: Encoder %s cannot be used in container %s (%d)\n", codec->name, render_container->name, res);
+        error("ERROR: Encoder %s cannot be used in container %s (%d)\n", codec->name, render_audio_output_context->oformat->name, res);
         goto rfail;
     }
 
-    render_audio_stream = avformat_new_stream(render_output_context, codec);
+    render_audio_stream = avformat_new_stream(render_audio_output_context, codec);
 
     if (render_audio_stream == NULL)
     {
@@ -437,7 +1018,7 @@ bool EncoderState::render_init_audio()
         goto rfail;
     }
 
-    render_audio_stream->id = render_output_context->nb_streams - 1;
+    render_audio_stream->id = render_audio_output_context->nb_streams - 1;
 
     render_audio_ctx = avcodec_alloc_context3(codec);
 
@@ -450,19 +1031,21 @@ bool EncoderState::render_init_audio()
     AVChannelLayout channel_layout;
     av_channel_layout_default(&channel_layout, movie_params.audio_channels);
 
-    render_audio_ctx->sample_fmt = render_audio_info->sample_format;
+    render_audio_ctx->sample_fmt = render_audio_sample_format;
     render_audio_ctx->sample_rate = audio_q.den;
     render_audio_ctx->ch_layout = channel_layout;
     render_audio_ctx->time_base = audio_q;
 
     render_audio_stream->time_base = render_audio_ctx->time_base;
 
-    if (render_output_context->oformat->flags & AVFMT_GLOBALHEADER)
+    if (render_audio_output_context->oformat->flags & AVFMT_GLOBALHEADER)
     {
         render_audio_ctx->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
     }
 
-    render_audio_ctx->thread_count = 0; // Use all threads.
+    // None of the audio encoders have threading of their own in libavcodec, including flac, so this has no effect for them.
+    // They are all encoded in one thread, which is the frame thread of the movie that also sends the video frames.
+    render_audio_ctx->thread_count = cpu_get_codec_threads(0); // 0 uses all threads.
     render_audio_ctx->bit_rate = 256 * 1000;
 
     if (render_audio_info->setup)
@@ -504,19 +1087,125 @@ rexit:
     return ret;
 }
 
+// Use the sample format and rate of the audio info if the codec supports them, otherwise the closest that it supports.
+bool EncoderState::render_negotiate_audio_format(const AVCodec* codec)
+{
+    bool ret = false;
+    s32 res;
+
+    const AVSampleFormat* formats = NULL;
+    const s32* rates = NULL;
+    s32 num_formats = 0;
+    s32 num_rates = 0;
+
+    AVSampleFormat wanted_format = render_audio_info->sample_format;
+    s32 wanted_hz = movie_params.audio_hz;
+
+    // Set from encoder if it requires a set sample rate.
+    if (render_audio_info->hz != 0)
+    {
+        wanted_hz = render_audio_info->hz;
+    }
+
+    render_audio_sample_format = wanted_format;
+    render_audio_hz = wanted_hz;
+
+    // The lists are NULL if the codec takes anything.
+
+    res = avcodec_get_supported_config(NULL, codec, AV_CODEC_CONFIG_SAMPLE_FORMAT, 0, (const void**)&formats, &num_formats);
+
+    if (res < 0)
+    {
+        error("ERROR: Could not get the sample formats of audio encoder %s (%d)\n", codec->name, res);
+        goto rfail;
+    }
+
+    res = avcodec_get_supported_config(NULL, codec, AV_CODEC_CONFIG_SAMPLE_RATE, 0, (const void**)&rates, &num_rates);
+
+    if (res < 0)
+    {
+        error("ERROR: Could not get the sample rates of audio encoder %s (%d)\n", codec->name, res);
+        goto rfail;
+    }
+
+    if (formats && num_formats > 0)
+    {
+        // Same type of sample with the other layout (planar or packed) is the closest, otherwise whatever the codec likes the most.
+        AVSampleFormat other_layout = av_sample_fmt_is_planar(wanted_format) ? av_get_packed_sample_fmt(wanted_format) : av_get_planar_sample_fmt(wanted_format);
+
+        render_audio_sample_format = formats[0];
+
+        for (s32 i = 0; i < num_formats; i++)
+        {
+            if (formats[i] == wanted_format)
+            {
+                render_audio_sample_format = formats[i];
+                break;
+            }
+
+            if (formats[i] == other_layout)
+            {
+                render_audio_sample_format = formats[i];
+            }
+        }
+    }
+
+    if (rates && num_rates > 0)
+    {
+        // Closest rate that is not lower than the wanted rate, so nothing is lost. Otherwise the highest rate.
+        render_audio_hz = rates[0];
+
+        for (s32 i = 0; i < num_rates; i++)
+        {
+            s32 hz = rates[i];
+            bool best_is_lower = render_audio_hz < wanted_hz;
+
+            if (hz == wanted_hz)
+            {
+                render_audio_hz = hz;
+                break;
+            }
+
+            if (hz > wanted_hz && (best_is_lower || hz < render_audio_hz))
+            {
+                render_audio_hz = hz;
+            }
+
+            else if (hz < wanted_hz && best_is_lower && hz > render_audio_hz)
+            {
+                render_audio_hz = hz;
+            }
+        }
+    }
+
+    if (render_audio_sample_format != wanted_format || render_audio_hz != wanted_hz)
+    {
+        svr_log("Audio encoder %s does not support %s at %d hz, using %s at %d hz\n", codec->name,
+                av_get_sample_fmt_name(wanted_format), wanted_hz, av_get_sample_fmt_name(render_audio_sample_format), render_audio_hz);
+    }
+
+    ret = true;
+    goto rexit;
+
+rfail:
+
+rexit:
+    return ret;
+}
+
 bool EncoderState::render_check_thread_errors()
 {
     // Frame thread broke. Nothing more can be submitted.
-    if (svr_atom_load(&render_frame_thread_status) == 0)
+    if (svr_atom_load(&render_movie->frame_thread_status) == 0)
     {
-        error(render_frame_thread_message);
+        error(render_movie->frame_thread_message);
         return true;
     }
 
     // Packet thread broke. Nothing more can be submitted.
-    if (svr_atom_load(&render_packet_thread_status) == 0)
+    if (svr_atom_load(&render_movie->packet_thread_status) == 0)
     {
-        error(render_packet_thread_message);
+        error(render_movie->packet_thread_message);
         return true;
     }
 
@@ -527,6 +1216,13 @@ bool EncoderState::render_check_thread_errors()
         return true;
     }
 
+    // Spool file could not be written. Nothing more can be submitted.
+    if (movie_params.use_spool && svr_atom_load(&render_movie->io.status) == 0)
+    {
+        error(render_movie->io.message);
+        return true;
+    }
+
     return false;
 }
 
@@ -545,6 +1241,11 @@ bool EncoderState::render_receive_video()
 
     vid_push_texture_for_conversion();
 
+    if (render_movie->use_segments)
+    {
+        segment_receive_frame();
+    }
+
     if (vid_can_map_now())
     {
         render_submit_texture();
@@ -559,39 +1260,38 @@ rexit:
     return ret;
 }
 
-// The shared audio samples have been updated at this point.
-bool EncoderState::render_receive_audio()
+// Same as render_receive_video and render_submit_texture, but the frame is in system memory in B8G8R8X8 format.
+// Only used when vid_use_cpu is set. The source frame is not kept.
+bool EncoderState::render_receive_cpu_video(AVFrame* source_frame)
 {
     bool ret = false;
+    AVFrame* frame = NULL;
 
     if (render_check_thread_errors())
     {
         goto rfail;
     }
 
-    // Copy to a new buffer and pass to the audio thread. The audio thread will convert if needed and pass to the encoder.
-    // If we don't need to do anything, just pass it along without going through the thread.
+    frame = render_get_new_video_frame();
+    frame->pts = render_video_pts;
+    frame->pict_type = AV_PICTURE_TYPE_NONE; // Recycled frames may have been forced to keyframes.
 
-    if (audio_need_conversion())
+    if (render_movie->use_segments)
     {
-        RenderAudioThreadInput input = render_get_new_audio_buffer(shared_mem_ptr->waiting_audio_samples);
-
-        s32 size = render_get_audio_buffer_size(shared_mem_ptr->waiting_audio_samples);
-        memcpy(input.mem, shared_audio_buffer, size);
+        segment_receive_frame();
+        segment_check_cut(frame);
+    }
 
-        render_audio_queue.push(&input);
+    sws_scale(vid_sws_ctx, source_frame->data, source_frame->linesize, 0, movie_params.video_height, frame->data, frame->linesize);
 
-        SetEvent(render_audio_wake_event_h); // Notify audio thread.
+    if (preview_thread_h && render_video_pts % movie_params.preview_interval == 0)
+    {
+        preview_submit_frame(frame);
     }
 
-    else
-    {
-        RenderAudioThreadInput input = {};
-        input.mem = shared_audio_buffer;
-        input.num_samples = shared_mem_ptr->waiting_audio_samples;
+    render_encode_video_frame(frame);
 
-        render_give_audio_thread_input(&input);
-    }
+    render_video_pts++;
 
     ret = true;
     goto rexit;
@@ -602,64 +1302,75 @@ rexit:
     return ret;
 }
 
-void EncoderState::render_give_audio_thread_input(RenderAudioThreadInput* input)
-{
-    audio_convert_to_codec_samples(input);
-
-    // Must submit everything in the fifo so things don't start drifting away.
-    // It's possible that this doesn't do anything in case there aren't enough samples to cover the needed frame size.
-    render_submit_audio_fifo();
-}
-
-// Some encoders need a fixed amount of samples every iteration (except the last).
-// We may be getting less samples from the game, so we have to queue the samples up until we have enough to submit.
-// Call this when rendering is stopping to submit the slack.
-void EncoderState::render_flush_audio_fifo()
+// The shared audio samples have been updated at this point.
+bool EncoderState::render_receive_audio()
 {
-    s32 num_remaining = audio_num_queued_samples();
+    bool ret = false;
 
-    while (num_remaining > 0)
+    if (render_check_thread_errors())
     {
-        s32 num_samples = svr_min(num_remaining, render_audio_ctx->frame_size); // Ok for the last submit to have less samples than the frame size.
-        render_encode_frame_from_audio_fifo(num_samples);
-        num_remaining -= num_samples;
+        goto rfail;
     }
+
+    render_receive_audio_samples(shared_audio_buffer, shared_mem_ptr->waiting_audio_samples);
+
+    ret = true;
+    goto rexit;
+
+rfail:
+
+rexit:
+    return ret;
 }
 
-// Some encoders need a fixed amount of samples every iteration (except the last).
-// We may be getting less samples from the game, so we have to queue the samples up until we have enough to submit.
-// Call this during rendering to submit all possible audio frames.
-void EncoderState::render_submit_audio_fifo()
+void EncoderState::render_receive_audio_samples(void* mem, s32 num_samples)
 {
-    s32 num_remaining = audio_num_queued_samples();
+    if (movie_params.use_spool)
+    {
+        spool_write_audio_samples(mem, num_samples);
+        return;
+    }
 
-    while (num_remaining >= render_audio_ctx->frame_size)
+    // Without libswresample, the samples are copied or converted by us straight to the codec frames on this thread.
+    if (!audio_need_conversion())
     {
-        render_encode_frame_from_audio_fifo(render_audio_ctx->frame_size); // Every submission must have the same size in this case.
-        num_remaining -= render_audio_ctx->frame_size;
+        audio_write_samples(mem, num_samples);
+        return;
     }
-}
 
-// Common code for render_submit_audio_fifo and render_flush_audio_fifo.
-void EncoderState::render_encode_frame_from_audio_fifo(s32 num_samples)
-{
-    AVFrame* frame = render_get_new_audio_frame();
-    frame->pts = render_audio_pts;
+    // Copy to new buffers and pass to the audio thread, which converts into the codec frames.
+    // All audio since the last frame can come at once, but the audio buffers only hold ENCODER_MAX_SAMPLES.
+    while (num_samples > 0)
+    {
+        s32 part_samples = svr_min(num_samples, ENCODER_MAX_SAMPLES);
+        s32 part_size = render_get_audio_buffer_size(part_samples);
 
-    // Override the number of samples.
-    // The frame has a capacity of the expected codec frame size allocated.
-    // For the last frames, we will not be using the full capacity.
-    frame->nb_samples = num_samples;
+        RenderAudioThreadInput input = render_get_new_audio_buffer(part_samples);
+        memcpy(input.mem, mem, part_size);
 
-    audio_copy_samples_to_frame(frame, num_samples);
+        render_audio_queue.push(&input);
 
-    render_audio_pts += num_samples;
+        SetEvent(render_audio_wake_event_h); // Notify audio thread.
 
-    render_encode_audio_frame(frame);
+        mem = (u8*)mem + part_size;
+        num_samples -= part_samples;
+    }
 }
 
 void EncoderState::render_encode_video_frame(AVFrame* frame)
 {
+    if (movie_params.use_spool)
+    {
+        // Nothing to flush in spool mode.
+        if (frame)
+        {
+            spool_write_video_frame(frame);
+            render_movie->recycled_video_frames.push(&frame);
+        }
+
+        return;
+    }
+
     render_encode_frame(render_video_ctx, render_video_stream, frame, AVMEDIA_TYPE_VIDEO);
 }
 
@@ -678,9 +1389,9 @@ void EncoderState::render_encode_frame(AVCodecContext* ctx, AVStream* stream, AV
     input.stream = stream;
     input.type = type;
 
-    render_frame_queue.push(&input);
+    render_movie->frame_queue.push(&input);
 
-    SetEvent(render_frame_wake_event_h); // Notify frame thread.
+    SetEvent(render_movie->frame_wake_event_h); // Notify frame thread.
 }
 
 AVFrame* EncoderState::render_get_new_video_frame()
@@ -689,7 +1400,7 @@ AVFrame* EncoderState::render_get_new_video_frame()
     s32 res;
 
     // Fast and good if we can reuse.
-    if (render_recycled_video_frames.pull(&ret))
+    if (render_movie->recycled_video_frames.pull(&ret))
     {
         return ret;
     }
@@ -702,9 +1413,9 @@ AVFrame* EncoderState::render_get_new_video_frame()
         goto rfail;
     }
 
-    ret->format = render_video_ctx->pix_fmt;
-    ret->width = render_video_ctx->width;
-    ret->height = render_video_ctx->height;
+    ret->format = render_video_info->pixel_format;
+    ret->width = movie_params.output_width;
+    ret->height = movie_params.output_height;
 
     // Allocate buffers for frame.
     res = av_frame_get_buffer(ret, 0);
@@ -729,7 +1440,7 @@ AVFrame* EncoderState::render_get_new_audio_frame()
     s32 res;
 
     // Fast and good if we can reuse.
-    if (render_recycled_audio_frames.pull(&ret))
+    if (render_movie->recycled_audio_frames.pull(&ret))
     {
         return ret;
     }
@@ -800,27 +1511,17 @@ s32 EncoderState::render_get_audio_buffer_size(s32 num_samples)
 // Free the allocated buffers in the recycled stuff.
 void EncoderState::render_free_recycled_stuff()
 {
-    AVFrame* frame = NULL;
-
-    while (render_recycled_video_frames.pull(&frame))
-    {
-        av_frame_free(&frame);
-    }
-
-    while (render_recycled_audio_frames.pull(&frame))
-    {
-        av_frame_free(&frame);
-    }
-
     RenderAudioThreadInput audio_input = {};
 
     while (render_recycled_audio_buffers.pull(&audio_input))
     {
         svr_free(audio_input.mem);
     }
+
+    render_audio_buffer_size = 0;
 }
 
-// Free any lingering objects that got stuck in a thread input queue that could
+// Give back any lingering audio buffers that got stuck in the thread input queue that could
 // not be processed because some error.
 void EncoderState::render_free_lingering_thread_inputs()
 {
@@ -828,30 +1529,31 @@ void EncoderState::render_free_lingering_thread_inputs()
 
     while (render_audio_queue.pull(&audio_input))
     {
-        svr_free(audio_input.mem);
+        if (audio_input.mem)
+        {
+            render_recycled_audio_buffers.push(&audio_input);
+        }
     }
+}
 
-    AVPacket* packet_input = NULL;
+void EncoderState::render_submit_texture()
+{
+    AVFrame* frame = render_get_new_video_frame();
+    frame->pts = render_video_pts;
+    frame->pict_type = AV_PICTURE_TYPE_NONE; // Recycled frames may have been forced to keyframes.
 
-    while (render_packet_queue.pull(&packet_input))
+    if (render_movie->use_segments)
     {
-        av_packet_free(&packet_input);
+        segment_check_cut(frame);
     }
 
-    RenderFrameThreadInput frame_input = {};
+    vid_download_texture_into_frame(frame);
 
-    while (render_frame_queue.pull(&frame_input))
+    if (preview_thread_h && render_video_pts % movie_params.preview_interval == 0)
     {
-        av_frame_free(&frame_input.frame);
+        preview_submit_frame(frame);
     }
-}
 
-void EncoderState::render_submit_texture()
-{
-    AVFrame* frame = render_get_new_video_frame();
-    frame->pts = render_video_pts;
-
-    vid_download_texture_into_frame(frame);
     render_encode_video_frame(frame);
 
     render_video_pts++;
@@ -4,8 +4,8 @@ DWORD CALLBACK render_frame_thread_proc(LPVOID param)
 {
     SetThreadDescription(GetCurrentThread(), L"RENDER FRAME THREAD");
 
-    EncoderState* encoder_ptr = (EncoderState*)param;
-    encoder_ptr->render_frame_proc();
+    RenderMovie* movie = (RenderMovie*)param;
+    movie->encoder_ptr->render_frame_proc(movie);
 
     return 0; // Not used.
 }
@@ -14,8 +14,8 @@ DWORD CALLBACK render_packet_thread_proc(LPVOID param)
 {
     SetThreadDescription(GetCurrentThread(), L"RENDER PACKET THREAD");
 
-    EncoderState* encoder_ptr = (EncoderState*)param;
-    encoder_ptr->render_packet_proc();
+    RenderMovie* movie = (RenderMovie*)param;
+    movie->encoder_ptr->render_packet_proc(movie);
 
     return 0; // Not used.
 }
@@ -30,37 +30,73 @@ DWORD CALLBACK render_audio_thread_proc(LPVOID param)
     return 0; // Not used.
 }
 
+DWORD CALLBACK render_finalize_thread_proc(LPVOID param)
+{
+    SetThreadDescription(GetCurrentThread(), L"RENDER FINALIZE THREAD");
+
+    RenderMovie* movie = (RenderMovie*)param;
+    movie->encoder_ptr->render_finalize_proc(movie);
+
+    return 0; // Not used.
+}
+
 bool EncoderState::render_start_threads()
 {
-    render_frame_thread_h = CreateThread(NULL, 0, render_frame_thread_proc, this, 0, NULL);
-    render_packet_thread_h = CreateThread(NULL, 0, render_packet_thread_proc, this, 0, NULL);
+    // Nothing is encoded in spool mode.
+    if (movie_params.use_spool)
+    {
+        return true;
+    }
+
+    render_movie->frame_thread_h = CreateThread(NULL, 0, render_frame_thread_proc, render_movie, 0, NULL);
+    render_movie->packet_thread_h = CreateThread(NULL, 0, render_packet_thread_proc, render_movie, 0, NULL);
+
+    cpu_setup_worker_thread(render_movie->frame_thread_h);
+    cpu_setup_worker_thread(render_movie->packet_thread_h);
 
     if (audio_need_conversion())
     {
         render_audio_thread_h = CreateThread(NULL, 0, render_audio_thread_proc, this, 0, NULL);
+        cpu_setup_worker_thread(render_audio_thread_h);
     }
 
     return true;
 }
 
+// Give the current movie to a finalize thread so the remaining frames and packets can be written in the background.
+void EncoderState::render_start_finalize()
+{
+    render_movie->video_ctx = render_video_ctx;
+    render_movie->audio_ctx = render_audio_ctx;
+
+    render_output_context = NULL;
+    render_video_ctx = NULL;
+    render_audio_ctx = NULL;
+
+    render_movie->finalize_thread_h = CreateThread(NULL, 0, render_finalize_thread_proc, render_movie, 0, NULL);
+
+    render_finalizing_movies.push(render_movie);
+    render_movie = NULL;
+}
+
 // In frame thread.
-void EncoderState::render_frame_proc()
+void EncoderState::render_frame_proc(RenderMovie* movie)
 {
     bool run = true;
 
     while (run)
     {
-        WaitForSingleObject(render_frame_wake_event_h, INFINITE);
+        WaitForSingleObject(movie->frame_wake_event_h, INFINITE);
 
         // Exit thread on external error.
-        if (svr_atom_load(&render_started) == 0)
+        if (svr_atom_load(&movie->running) == 0)
         {
             break;
         }
 
         RenderFrameThreadInput input = {};
 
-        while (render_frame_queue.pull(&input))
+        while (movie->frame_queue.pull(&input))
         {
             if (input.frame == NULL)
             {
@@ -76,18 +112,18 @@ void EncoderState::render_frame_proc()
             {
                 if (input.type == AVMEDIA_TYPE_VIDEO)
                 {
-                    render_recycled_video_frames.push(&input.frame);
+                    movie->recycled_video_frames.push(&input.frame);
                 }
 
                 if (input.type == AVMEDIA_TYPE_AUDIO)
                 {
-                    render_recycled_audio_frames.push(&input.frame);
+                    movie->recycled_audio_frames.push(&input.frame);
                 }
             }
 
             if (res < 0)
             {
-                SVR_SNPRINTF(render_frame_thread_message, "ERROR: Could not send raw frame to encoder (%d)\n", res);
+                SVR_SNPRINTF(movie->frame_thread_message, "ERROR: Could not send raw frame to encoder (%d)\n", res);
                 goto rfail;
             }
 
@@ -108,7 +144,7 @@ void EncoderState::render_frame_proc()
 
                 if (res < 0)
                 {
-                    SVR_SNPRINTF(render_frame_thread_message, "ERROR: Could not receive packet from encoder (%d)\n", res);
+                    SVR_SNPRINTF(movie->frame_thread_message, "ERROR: Could not receive packet from encoder (%d)\n", res);
                     av_packet_free(&packet);
                     goto rfail;
                 }
@@ -120,9 +156,14 @@ void EncoderState::render_frame_proc()
                     packet->duration = av_rescale_q(packet->duration, input.ctx->time_base, input.stream->time_base);
                     packet->stream_index = input.stream->index;
 
+                    // Containers without audio have it in a separate file.
+                    // The output context of the movie is not set here since it changes between segments.
+                    bool to_audio_file = input.type == AVMEDIA_TYPE_AUDIO && movie->audio_output_context;
+                    packet->opaque = to_audio_file ? movie->audio_output_context : NULL;
+
                     // Send to packet thread.
-                    render_packet_queue.push(&packet);
-                    SetEvent(render_packet_wake_event_h); // Notify packet thread.
+                    movie->packet_queue.push(&packet);
+                    SetEvent(movie->packet_wake_event_h); // Notify packet thread.
                 }
             }
         }
@@ -131,43 +172,83 @@ void EncoderState::render_frame_proc()
     goto rexit;
 
 rfail:
-    svr_atom_store(&render_frame_thread_status, 0);
+    svr_atom_store(&movie->frame_thread_status, 0);
 
 rexit:
     return;
 }
 
 // In packet thread.
-void EncoderState::render_packet_proc()
+void EncoderState::render_packet_proc(RenderMovie* movie)
 {
     bool run = true;
 
+    // Have the second segment ready before the first cut.
+    if (movie->use_segments)
+    {
+        if (!segment_open_next(movie))
+        {
+            goto rfail;
+        }
+    }
+
     while (run)
     {
-        WaitForSingleObject(render_packet_wake_event_h, INFINITE);
+        WaitForSingleObject(movie->packet_wake_event_h, INFINITE);
 
         // Exit thread on external error.
-        if (svr_atom_load(&render_started) == 0)
+        if (svr_atom_load(&movie->running) == 0)
         {
             break;
         }
 
         AVPacket* packet = NULL;
 
-        while (render_packet_queue.pull(&packet))
+        while (movie->packet_queue.pull(&packet))
         {
+            s32 res;
+
             if (packet == NULL)
             {
                 run = false; // Stop on flush packet.
+
+                res = av_interleaved_write_frame(movie->output_context, NULL);
+
+                if (res >= 0 && movie->audio_output_context)
+                {
+                    res = av_interleaved_write_frame(movie->audio_output_context, NULL);
+                }
             }
 
-            s32 res = av_interleaved_write_frame(render_output_context, packet);
+            else
+            {
+                // Set by the frame thread if the packet belongs to the separate audio file.
+                if (packet->opaque)
+                {
+                    res = av_interleaved_write_frame((AVFormatContext*)packet->opaque, packet);
+                }
+
+                else if (movie->use_segments)
+                {
+                    res = segment_write_packet(movie, packet);
+                }
+
+                else
+                {
+                    res = av_interleaved_write_frame(movie->output_context, packet);
+                }
+
+                av_packet_free(&packet);
+            }
 
-            av_packet_free(&packet);
+            if (res == AVERROR_EXTERNAL)
+            {
+                goto rfail; // Segment could not be switched, the message is already set.
+            }
 
             if (res < 0)
             {
-                SVR_SNPRINTF(render_packet_thread_message, "ERROR: Could not write encoded packet to container (%d)\n", res);
+                SVR_SNPRINTF(movie->packet_thread_message, "ERROR: Could not write encoded packet to container (%d)\n", res);
                 goto rfail;
             }
         }
@@ -176,7 +257,7 @@ void EncoderState::render_packet_proc()
     goto rexit;
 
 rfail:
-    svr_atom_store(&render_packet_thread_status, 0);
+    svr_atom_store(&movie->packet_thread_status, 0);
 
 rexit:
     return;
@@ -207,7 +288,8 @@ void EncoderState::render_audio_proc()
                 break;
             }
 
-            render_give_audio_thread_input(&buffer);
+            audio_copied_bytes += render_get_audio_buffer_size(buffer.num_samples); // Copied to the buffer in render_receive_audio_samples.
+            audio_write_samples(buffer.mem, buffer.num_samples);
 
             render_recycled_audio_buffers.push(&buffer); // Give back the audio buffer.
         }
@@ -221,3 +303,139 @@ rfail:
 rexit:
     return;
 }
+
+// In finalize thread.
+// The main thread has already sent the flush frames at this point (unless there was an error), so we just have to wait
+// for everything to come out the other end before closing the file.
+void EncoderState::render_finalize_proc(RenderMovie* movie)
+{
+    s64 start_time = svr_prof_get_real_time();
+
+    // The threads may not have started if the movie failed to start.
+
+    if (movie->frame_thread_h)
+    {
+        WaitForSingleObject(movie->frame_thread_h, INFINITE); // Wait for frame thread to finish.
+    }
+
+    if (movie->packet_thread_h)
+    {
+        // Flush the packet thread.
+        // If the movie is not running anymore, the packet thread will exit without looking at this.
+
+        AVPacket* flush_packet = NULL;
+        movie->packet_queue.push(&flush_packet);
+        SetEvent(movie->packet_wake_event_h); // Notify packet thread.
+
+        WaitForSingleObject(movie->packet_thread_h, INFINITE); // Wait for packet thread to finish.
+    }
+
+    if (svr_atom_load(&movie->frame_thread_status) == 0)
+    {
+        svr_log("%s", movie->frame_thread_message);
+        render_finalize_error(movie, movie->frame_thread_message);
+        movie->write_trailer = false;
+    }
+
+    if (svr_atom_load(&movie->packet_thread_status) == 0)
+    {
+        svr_log("%s", movie->packet_thread_message);
+        render_finalize_error(movie, movie->packet_thread_message);
+        movie->write_trailer = false;
+    }
+
+    if (movie->use_segments)
+    {
+        segment_finish(movie);
+    }
+
+    if (movie->write_trailer)
+    {
+        char message[256];
+
+        s32 res = av_write_trailer(movie->output_context); // Can only be written if avformat_write_header was called.
+
+        if (res < 0)
+        {
+            SVR_SNPRINTF(message, "ERROR: Could not write render file trailer (%d)\n", res);
+            svr_log("%s", message);
+            render_finalize_error(movie, message);
+        }
+
+        if (movie->audio_output_context)
+        {
+            res = av_write_trailer(movie->audio_output_context);
+
+            if (res < 0)
+            {
+                SVR_SNPRINTF(message, "ERROR: Could not write audio file trailer (%d)\n", res);
+                svr_log("%s", message);
+                render_finalize_error(movie, message);
+            }
+        }
+    }
+
+    // Write out the remaining buffers and close the files.
+    // The errors have been logged by io_close.
+
+    if (!io_close(&movie->io))
+    {
+        render_finalize_error(movie, movie->io.message);
+    }
+
+    if (!io_close(&movie->segment_io))
+    {
+        render_finalize_error(movie, movie->segment_io.message);
+    }
+
+    if (!io_close(&movie->audio_io))
+    {
+        render_finalize_error(movie, movie->audio_io.message);
+    }
+
+    if (movie->output_context)
+    {
+        movie->output_context->pb = NULL; // Owned by the IO writer. Image sequences do not have one.
+
+        if (movie->output_context != movie->first_output_context)
+        {
+            avformat_free_context(movie->output_context);
+        }
+
+        movie->output_context = NULL;
+    }
+
+    // Kept until now for segmented movies because the packets were rescaled to its streams.
+    if (movie->first_output_context)
+    {
+        movie->first_output_context->pb = NULL;
+
+        avformat_free_context(movie->first_output_context);
+        movie->first_output_context = NULL;
+    }
+
+    if (movie->audio_output_context)
+    {
+        movie->audio_output_context->pb = NULL; // Owned by the IO writer.
+
+        avformat_free_context(movie->audio_output_context);
+        movie->audio_output_context = NULL;
+    }
+
+    avcodec_free_context(&movie->video_ctx);
+    avcodec_free_context(&movie->audio_ctx);
+
+    svr_log("Finalized movie %s in %lld ms\n", movie->dest_file, (svr_prof_get_real_time() - start_time) / 1000);
+}
+
+// In finalize thread.
+// Only the first error is kept for the main thread, since the later ones usually follow from it.
+// The message is not logged here.
+void EncoderState::render_finalize_error(RenderMovie* movie, const char* message)
+{
+    if (!movie->finalize_failed)
+    {
+        movie->finalize_failed = true;
+        SVR_COPY_STRING(message, movie->finalize_message);
+    }
+}
@@ -0,0 +1,659 @@
+#include "encoder_priv.h"
+
+// Segmented output where a long movie is split into many files, so a broken file or full disk only loses the latest piece.
+// The main thread decides where to cut and forces a keyframe there. Every segment then starts on a keyframe and has all
+// of its frames, so the segments can be joined together again without encoding. Encoders that cannot force a keyframe
+// must make every frame one, otherwise the movie is not started, see render_init_video.
+// The packet thread switches to the next segment when the packets of every stream have reached the cut. The next segment
+// is opened and has its header written before that, so the switch only has to write the trailer of the old one.
+// The segments are listed in a .ffconcat file that the ffmpeg concat demuxer can read.
+
+// References:
+// https://ffmpeg.org/ffmpeg-formats.html#concat-1
+// https://raw.githubusercontent.com/FFmpeg/FFmpeg/master/libavformat/segment.c
+
+const s32 SEGMENT_QUEUED_CUTS = 8;
+
+// A movie named shot.mp4 has its segments in shot_000.mp4, shot_001.mp4 and so on.
+void segment_make_path(const char* dest_file, s32 index, char* buf, s32 buf_size)
+{
+    const char* ext = strrchr(dest_file, '.');
+    s32 name_len = ext ? (s32)(ext - dest_file) : (s32)strlen(dest_file);
+
+    stbsp_snprintf(buf, buf_size, "%.*s_%03d%s", name_len, dest_file, index, ext ? ext : "");
+}
+
+// The manifest is next to the segments, so it only has the file names.
+const char* segment_get_file_name(const char* path)
+{
+    const char* ret = path;
+
+    for (const char* c = path; *c; c++)
+    {
+        if (*c == '\\' || *c == '/')
+        {
+            ret = c + 1;
+        }
+    }
+
+    return ret;
+}
+
+void segment_write_manifest(RenderMovie* movie, const char* text)
+{
+    s32 len = strlen(text);
+
+    DWORD written;
+    WriteFile(movie->manifest_h, text, len, &written, NULL);
+
+    movie->manifest_size += len;
+}
+
+// Called instead of opening dest_file when the movie should be segmented.
+// The first segment is written through the output context that the streams are created in.
+bool EncoderState::segment_init()
+{
+    bool ret = false;
+
+    char path[MAX_PATH];
+    char buf[1024];
+    s32 segment_seconds;
+
+    render_movie->use_segments = true;
+    render_movie->first_output_context = render_output_context;
+    render_movie->current_io = &render_movie->io;
+    render_movie->segment_cuts.init(SEGMENT_QUEUED_CUTS);
+    render_movie->video_fps = movie_params.video_fps;
+    SVR_COPY_STRING(movie_params.video_encoder, render_movie->video_encoder);
+
+    segment_frame_ticks.init(16);
+
+    segment_resume_frame = 0;
+    segment_resume_samples = 0;
+
+    if (movie_params.resume)
+    {
+        if (!segment_read_checkpoint())
+        {
+            goto rfail;
+        }
+    }
+
+    render_make_sidecar_path(movie_params.dest_file, "ffconcat", path, sizeof(path));
+
+    // When resuming, the list is kept up to the segment that is written again.
+    render_movie->manifest_h = CreateFileA(path, GENERIC_WRITE, FILE_SHARE_READ, NULL, movie_params.resume ? OPEN_EXISTING : CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+
+    if (render_movie->manifest_h == INVALID_HANDLE_VALUE)
+    {
+        render_movie->manifest_h = NULL;
+
+        DWORD error_code = GetLastError();
+
+        error("ERROR: Could not create segment list %s (%lu)\n", path, error_code);
+        goto rfail;
+    }
+
+    if (movie_params.resume)
+    {
+        LARGE_INTEGER pos;
+        pos.QuadPart = render_movie->manifest_size;
+
+        SetFilePointerEx(render_movie->manifest_h, pos, NULL, FILE_BEGIN);
+        SetEndOfFile(render_movie->manifest_h);
+    }
+
+    else
+    {
+        stbsp_snprintf(buf, sizeof(buf), "ffconcat version 1.0\n# Join with: ffmpeg -f concat -safe 0 -i \"%s\" -c copy \"%s\"\n", segment_get_file_name(path), segment_get_file_name(movie_params.dest_file));
+        segment_write_manifest(render_movie, buf);
+    }
+
+    // Every segment is allocated for its time or size limit, or for the whole movie if that is shorter.
+    segment_seconds = movie_params.expected_seconds;
+
+    if (movie_params.segment_seconds > 0 && (segment_seconds == 0 || movie_params.segment_seconds < segment_seconds))
+    {
+        segment_seconds = movie_params.segment_seconds;
+    }
+
+    render_movie->segment_estimated_size = render_estimate_size(segment_seconds, true);
+
+    if (movie_params.segment_mb > 0)
+    {
+        s64 max_size = (s64)movie_params.segment_mb * 1024 * 1024;
+
+        if (render_movie->segment_estimated_size == 0 || max_size < render_movie->segment_estimated_size)
+        {
+            render_movie->segment_estimated_size = max_size;
+        }
+    }
+
+    segment_make_path(movie_params.dest_file, render_movie->segment_index, path, sizeof(path));
+
+    if (!io_open(&render_movie->io, path, render_movie->segment_estimated_size))
+    {
+        goto rfail;
+    }
+
+    segment_max_frames = (s64)movie_params.segment_seconds * movie_params.video_fps;
+    segment_max_bytes = (s64)movie_params.segment_mb * 1024 * 1024;
+    segment_start_pts = segment_resume_frame;
+    segment_num_cuts = 0;
+
+    svr_log("Writing segments starting with %s\n", path);
+
+    ret = true;
+    goto rexit;
+
+rfail:
+
+rexit:
+    return ret;
+}
+
+// Reads where to continue from. The segments before it are complete and are kept.
+bool EncoderState::segment_read_checkpoint()
+{
+    bool ret = false;
+
+    SvrIniSection ini_root = {};
+    SvrIniKeyValue* segment_kv = NULL;
+    SvrIniKeyValue* frame_kv = NULL;
+    SvrIniKeyValue* samples_kv = NULL;
+    SvrIniKeyValue* manifest_kv = NULL;
+    SvrIniKeyValue* fps_kv = NULL;
+    SvrIniKeyValue* encoder_kv = NULL;
+
+    char path[MAX_PATH];
+    render_make_sidecar_path(movie_params.dest_file, ENCODER_CHECKPOINT_EXT, path, sizeof(path));
+
+    // There is only one audio file for containers without audio, which would be written over.
+    if (movie_params.use_audio && render_container->audio_codec == AV_CODEC_ID_NONE)
+    {
+        error("ERROR: Movies with audio in a separate file cannot be resumed\n");
+        goto rfail;
+    }
+
+    if (!svr_ini_load(path, &ini_root))
+    {
+        error("ERROR: Could not load checkpoint %s\n", path);
+        goto rfail;
+    }
+
+    segment_kv = svr_ini_section_find_kv(&ini_root, "segment");
+    frame_kv = svr_ini_section_find_kv(&ini_root, "video_frame");
+    samples_kv = svr_ini_section_find_kv(&ini_root, "audio_samples");
+    manifest_kv = svr_ini_section_find_kv(&ini_root, "manifest_size");
+    fps_kv = svr_ini_section_find_kv(&ini_root, "video_fps");
+    encoder_kv = svr_ini_section_find_kv(&ini_root, "video_encoder");
+
+    if (segment_kv == NULL || frame_kv == NULL || samples_kv == NULL || manifest_kv == NULL || fps_kv == NULL || encoder_kv == NULL)
+    {
+        error("ERROR: Checkpoint %s is damaged\n", path);
+        goto rfail;
+    }
+
+    // Segments can only be joined without encoding again if they are encoded the same way.
+    if (atoi(fps_kv->value) != movie_params.video_fps || strcmp(encoder_kv->value, movie_params.video_encoder))
+    {
+        error("ERROR: The movie was started with %s at %s fps and must be resumed with the same profile\n", encoder_kv->value, fps_kv->value);
+        goto rfail;
+    }
+
+    render_movie->segment_index = atoi(segment_kv->value);
+    render_movie->manifest_size = _atoi64(manifest_kv->value);
+    segment_resume_frame = _atoi64(frame_kv->value);
+    segment_resume_samples = _atoi64(samples_kv->value);
+
+    svr_log("Resuming from segment %d at frame %lld\n", render_movie->segment_index, segment_resume_frame);
+
+    ret = true;
+    goto rexit;
+
+rfail:
+
+rexit:
+    svr_ini_free(&ini_root);
+    return ret;
+}
+
+// Sets the timestamps to continue from. The streams must have been created and had their header written, as that decides the time bases.
+void EncoderState::segment_start()
+{
+    render_video_pts = segment_resume_frame;
+    render_audio_pts = segment_resume_samples;
+
+    render_movie->segment_video_start = av_rescale_q(segment_resume_frame, render_video_ctx->time_base, render_video_stream->time_base);
+    render_movie->segment_video_end = render_movie->segment_video_start;
+
+    if (render_audio_stream)
+    {
+        render_movie->segment_audio_start = av_rescale_q(segment_resume_frame, render_video_ctx->time_base, render_audio_stream->time_base);
+    }
+}
+
+// Keeps the demo tick of the frame until the frame is submitted, which is later because of the conversion queue.
+// In main thread.
+void EncoderState::segment_receive_frame()
+{
+    s32 demo_tick = shared_mem_ptr ? shared_mem_ptr->demo_tick : -1;
+    segment_frame_ticks.push(&demo_tick);
+}
+
+// Decides if a new segment should start at this frame, and makes the frame a keyframe if so.
+// Segments are at least one second, so a single large keyframe cannot make a segment for every frame.
+// In main thread.
+void EncoderState::segment_check_cut(AVFrame* frame)
+{
+    s32 demo_tick = -1;
+    segment_frame_ticks.pull(&demo_tick);
+
+    s64 num_frames = frame->pts - segment_start_pts;
+
+    if (num_frames < movie_params.video_fps)
+    {
+        return;
+    }
+
+    bool cut = false;
+
+    if (segment_max_frames > 0 && num_frames >= segment_max_frames)
+    {
+        cut = true;
+    }
+
+    // The size is only known for the segment that is being written, so wait until the previous cut has been done.
+    // The frames that are still in the encoder make the segment a bit larger than the limit.
+    if (segment_max_bytes > 0 && svr_atom_load(&render_movie->segment_switches) == segment_num_cuts)
+    {
+        if (svr_atom_load(&render_movie->segment_bytes) >= segment_max_bytes)
+        {
+            cut = true;
+        }
+    }
+
+    if (!cut)
+    {
+        return;
+    }
+
+    frame->pict_type = AV_PICTURE_TYPE_I;
+
+    RenderSegmentCut seg_cut = {};
+    seg_cut.video_pts = av_rescale_q(frame->pts, render_video_ctx->time_base, render_video_stream->time_base);
+    seg_cut.video_frame = frame->pts;
+    seg_cut.demo_tick = demo_tick;
+
+    // The audio of a resumed movie starts with the frame, so this is the audio time of the frame rather than how much audio there has been.
+    if (render_audio_stream)
+    {
+        seg_cut.audio_pts = av_rescale_q(frame->pts, render_video_ctx->time_base, render_audio_stream->time_base);
+        seg_cut.audio_samples = av_rescale_q(frame->pts, render_video_ctx->time_base, render_audio_ctx->time_base);
+    }
+
+    // Pushed before the frame is encoded, so the packet thread always knows about the cut before the keyframe comes out.
+    render_movie->segment_cuts.push(&seg_cut);
+
+    segment_start_pts = frame->pts;
+    segment_num_cuts++;
+}
+
+// Opens the segment after the current one and writes its header, so it is ready when the cut comes.
+// In packet thread.
+bool EncoderState::segment_open_next(RenderMovie* movie)
+{
+    bool ret = false;
+    s32 res;
+
+    AVFormatContext* first = movie->first_output_context;
+    AVDictionary* options = NULL;
+
+    char path[MAX_PATH];
+    segment_make_path(movie->dest_file, movie->segment_index + 1, path, sizeof(path));
+
+    res = avformat_alloc_output_context2(&movie->next_output_context, first->oformat, NULL, NULL);
+
+    if (res < 0)
+    {
+        SVR_SNPRINTF(movie->packet_thread_message, "ERROR: Could not create output context for segment %s (%d)\n", path, res);
+        goto rfail;
+    }
+
+    // The packets are encoded for the streams of the first segment, so every segment has the same streams.
+    for (u32 i = 0; i < first->nb_streams; i++)
+    {
+        AVStream* first_stream = first->streams[i];
+        AVStream* stream = avformat_new_stream(movie->next_output_context, NULL);
+
+        if (stream == NULL)
+        {
+            SVR_SNPRINTF(movie->packet_thread_message, "ERROR: Could not create stream for segment %s\n", path);
+            goto rfail;
+        }
+
+        res = avcodec_parameters_copy(stream->codecpar, first_stream->codecpar);
+
+        if (res < 0)
+        {
+            SVR_SNPRINTF(movie->packet_thread_message, "ERROR: Could not copy stream for segment %s (%d)\n", path, res);
+            goto rfail;
+        }
+
+        stream->id = first_stream->id;
+        stream->time_base = first_stream->time_base;
+        stream->avg_frame_rate = first_stream->avg_frame_rate;
+    }
+
+    // One writer is for the segment being written and the other for the next one.
+    movie->next_io = (movie->current_io == &movie->io) ? &movie->segment_io : &movie->io;
+
+    if (!io_open(movie->next_io, path, movie->segment_estimated_size))
+    {
+        SVR_COPY_STRING(movie->next_io->message, movie->packet_thread_message);
+        goto rfail;
+    }
+
+    movie->next_output_context->pb = movie->next_io->avio;
+    movie->next_output_context->flags |= AVFMT_FLAG_CUSTOM_IO;
+
+    // The options that are used are removed from the dictionary, so every segment needs a copy.
+    av_dict_copy(&options, movie->segment_options, 0);
+
+    res = avformat_write_header(movie->next_output_context, &options);
+
+    av_dict_free(&options);
+
+    if (res < 0)
+    {
+        SVR_SNPRINTF(movie->packet_thread_message, "ERROR: Could not create header for segment %s (%d)\n", path, res);
+        goto rfail;
+    }
+
+    ret = true;
+    goto rexit;
+
+rfail:
+
+rexit:
+    return ret;
+}
+
+// Writes a packet to the segment it belongs to.
+// Packets that have reached the cut go to the next segment, where their timestamps start over from the cut.
+// In packet thread.
+s32 EncoderState::segment_write_packet(RenderMovie* movie, AVPacket* packet)
+{
+    s32 res;
+
+    AVFormatContext* first = movie->first_output_context;
+    AVStream* first_stream = first->streams[packet->stream_index];
+
+    bool is_video = first_stream->codecpar->codec_type == AVMEDIA_TYPE_VIDEO;
+    bool has_audio = first->nb_streams > 1; // Audio in a separate file does not go through here.
+
+    if (!movie->has_segment_cut)
+    {
+        movie->has_segment_cut = movie->segment_cuts.pull(&movie->segment_cut);
+    }
+
+    bool to_next = false;
+
+    if (movie->has_segment_cut)
+    {
+        if (is_video)
+        {
+            if (!movie->segment_video_cut && packet->pts >= movie->segment_cut.video_pts)
+            {
+                movie->segment_video_cut = true;
+
+                if (!(packet->flags & AV_PKT_FLAG_KEY))
+                {
+                    svr_log("WARNING: Segment %d does not start on a keyframe and cannot be played on its own\n", movie->segment_index + 1);
+                }
+            }
+
+            to_next = movie->segment_video_cut;
+        }
+
+        else
+        {
+            if (packet->pts >= movie->segment_cut.audio_pts)
+            {
+                movie->segment_audio_cut = true;
+            }
+
+            to_next = movie->segment_audio_cut;
+        }
+    }
+
+    if (is_video)
+    {
+        movie->segment_video_end = svr_max(movie->segment_video_end, packet->pts + packet->duration);
+    }
+
+    AVFormatContext* dest = to_next ? movie->next_output_context : movie->output_context;
+
+    s64 start;
+
+    if (to_next)
+    {
+        start = is_video ? movie->segment_cut.video_pts : movie->segment_cut.audio_pts;
+    }
+
+    else
+    {
+        start = is_video ? movie->segment_video_start : movie->segment_audio_start;
+
+        svr_atom_add(&movie->segment_bytes, (s64)packet->size);
+    }
+
+    packet->pts -= start;
+    packet->dts -= start;
+
+    av_packet_rescale_ts(packet, first_stream->time_base, dest->streams[packet->stream_index]->time_base);
+
+    res = av_interleaved_write_frame(dest, packet);
+
+    if (res < 0)
+    {
+        return res;
+    }
+
+    if (movie->has_segment_cut && movie->segment_video_cut && (movie->segment_audio_cut || !has_audio))
+    {
+        if (!segment_switch(movie))
+        {
+            return AVERROR_EXTERNAL;
+        }
+
+        if (!segment_open_next(movie))
+        {
+            return AVERROR_EXTERNAL;
+        }
+    }
+
+    return res;
+}
+
+// Finishes the current segment and continues in the next one.
+// In packet thread, or finalize thread for the last cut.
+bool EncoderState::segment_switch(RenderMovie* movie)
+{
+    bool ret = false;
+
+    s32 res = av_write_trailer(movie->output_context);
+
+    if (res < 0)
+    {
+        SVR_SNPRINTF(movie->packet_thread_message, "ERROR: Could not write trailer of segment %d (%d)\n", movie->segment_index, res);
+        goto rfail;
+    }
+
+    if (!io_close(movie->current_io))
+    {
+        SVR_SNPRINTF(movie->packet_thread_message, "ERROR: Could not write segment %d\n", movie->segment_index);
+        goto rfail;
+    }
+
+    segment_write_manifest_entry(movie, movie->segment_cut.video_pts);
+
+    movie->output_context->pb = NULL; // Owned by the IO writer.
+
+    // The frame thread rescales the packets to the streams of the first segment.
+    if (movie->output_context != movie->first_output_context)
+    {
+        avformat_free_context(movie->output_context);
+    }
+
+    movie->output_context = movie->next_output_context;
+    movie->current_io = movie->next_io;
+    movie->next_output_context = NULL;
+    movie->next_io = NULL;
+
+    movie->segment_index++;
+    movie->segment_video_start = movie->segment_cut.video_pts;
+    movie->segment_audio_start = movie->segment_cut.audio_pts;
+
+    segment_write_checkpoint(movie);
+
+    movie->has_segment_cut = false;
+    movie->segment_video_cut = false;
+    movie->segment_audio_cut = false;
+
+    // Reset before the switch is counted, so the main thread does not see the size of the old segment.
+    svr_atom_store(&movie->segment_bytes, 0ll);
+    svr_atom_add(&movie->segment_switches, 1);
+
+    ret = true;
+    goto rexit;
+
+rfail:
+
+rexit:
+    return ret;
+}
+
+// Adds the current segment to the list. The duration lets the concat demuxer place the next segment right after it.
+void EncoderState::segment_write_manifest_entry(RenderMovie* movie, s64 end_pts)
+{
+    // The video stream is always created first.
+    AVRational time_base = movie->first_output_context->streams[0]->time_base;
+
+    char path[MAX_PATH];
+    segment_make_path(movie->dest_file, movie->segment_index, path, sizeof(path));
+
+    // Quotes in the file name are written as '\'' in the list.
+    char name[MAX_PATH * 4];
+    s32 pos = 0;
+
+    for (const char* c = segment_get_file_name(path); *c && pos < (s32)sizeof(name) - 5; c++)
+    {
+        if (*c == '\'')
+        {
+            memcpy(name + pos, "'\\''", 4);
+            pos += 4;
+            continue;
+        }
+
+        name[pos++] = *c;
+    }
+
+    name[pos] = 0;
+
+    char buf[MAX_PATH * 4 + 128];
+    stbsp_snprintf(buf, sizeof(buf), "file '%s'\n# Starts at %.6f\nduration %.6f\n", name, movie->segment_video_start * av_q2d(time_base), (end_pts - movie->segment_video_start) * av_q2d(time_base));
+
+    segment_write_manifest(movie, buf);
+}
+
+// Writes where the movie can be continued from if it does not finish, which is the start of the segment that was just switched to.
+// The previous segments are complete at this point.
+void EncoderState::segment_write_checkpoint(RenderMovie* movie)
+{
+    // The demo has to be seeked to the start of the segment when resuming, so there is nothing to resume without a demo.
+    if (movie->segment_cut.demo_tick < 0)
+    {
+        return;
+    }
+
+    char path[MAX_PATH];
+    char temp_path[MAX_PATH];
+    char buf[512];
+
+    render_make_sidecar_path(movie->dest_file, ENCODER_CHECKPOINT_EXT, path, sizeof(path));
+    stbsp_snprintf(temp_path, sizeof(temp_path), "%s.tmp", path);
+
+    s32 len = stbsp_snprintf(buf, sizeof(buf), "segment=%d\ndemo_tick=%d\nvideo_frame=%lld\naudio_samples=%lld\nmanifest_size=%lld\nvideo_fps=%d\nvideo_encoder=%s\n",
+                             movie->segment_index, movie->segment_cut.demo_tick, movie->segment_cut.video_frame, movie->segment_cut.audio_samples,
+                             movie->manifest_size, movie->video_fps, movie->video_encoder);
+
+    HANDLE h = CreateFileA(temp_path, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+
+    if (h == INVALID_HANDLE_VALUE)
+    {
+        svr_log("WARNING: Could not write checkpoint %s (%lu)\n", temp_path, GetLastError());
+        return;
+    }
+
+    DWORD written;
+    WriteFile(h, buf, len, &written, NULL);
+    CloseHandle(h);
+
+    // Replaced all at once so there is always a whole checkpoint, even if the process is killed while writing it.
+    if (!MoveFileExA(temp_path, path, MOVEFILE_REPLACE_EXISTING))
+    {
+        svr_log("WARNING: Could not write checkpoint %s (%lu)\n", path, GetLastError());
+    }
+}
+
+// Removes the segment that was opened ahead of time but never got any packets.
+void EncoderState::segment_discard_next(RenderMovie* movie)
+{
+    if (movie->next_output_context)
+    {
+        movie->next_output_context->pb = NULL; // Owned by the IO writer.
+
+        avformat_free_context(movie->next_output_context);
+        movie->next_output_context = NULL;
+    }
+
+    if (movie->next_io)
+    {
+        io_close(movie->next_io);
+        movie->next_io = NULL;
+
+        char path[MAX_PATH];
+        segment_make_path(movie->dest_file, movie->segment_index + 1, path, sizeof(path));
+
+        DeleteFileA(path);
+    }
+}
+
+// In finalize thread, before the trailer of the last segment is written.
+void EncoderState::segment_finish(RenderMovie* movie)
+{
+    // A cut that some stream has reached already has packets in the next segment, so it has to be done.
+    if (movie->write_trailer && movie->has_segment_cut && (movie->segment_video_cut || movie->segment_audio_cut))
+    {
+        if (!segment_switch(movie))
+        {
+            svr_log("%s", movie->packet_thread_message);
+            render_finalize_error(movie, movie->packet_thread_message);
+            movie->write_trailer = false;
+        }
+    }
+
+    segment_discard_next(movie);
+
+    if (movie->write_trailer)
+    {
+        segment_write_manifest_entry(movie, movie->segment_video_end);
+
+        svr_log("Wrote %d segments\n", movie->segment_index + 1);
+    }
+
+    svr_maybe_close_handle(&movie->manifest_h);
+
+    av_dict_free(&movie->segment_options);
+}
@@ -0,0 +1,514 @@
+#include "encoder_priv.h"
+
+// Recording and replaying of the events that svr_game sends to svr_encoder.
+// Recording is enabled with debug_record_session in the movie profile and writes <movie>.svrsession next to the movie.
+// The session can then be replayed with svr_encoder --replay <session file> [cpu], which encodes the same movie again
+// as fast as possible without the game. Replaying is done on a headless encoder state like the benchmark.
+// With cpu, the frames are converted with libswscale instead of D3D11 so the replay can be done on any computer.
+
+// The frames are encoded with FFV1 while the game is running, so don't take too many threads from it.
+const s32 SESSION_NUM_THREADS = 4;
+
+bool EncoderState::session_start()
+{
+    bool ret = false;
+    HRESULT hr;
+    s32 res;
+    char session_path[MAX_PATH];
+    const AVCodec* codec = NULL;
+    u8* start_data = NULL;
+
+    SVR_SNPRINTF(session_path, "%s.svrsession", movie_params.dest_file);
+
+    SessionHeader header = {};
+    memcpy(header.magic, SESSION_MAGIC, sizeof(SESSION_MAGIC));
+    header.version = SESSION_VERSION;
+
+    SessionRecord record = {};
+    record.event_type = ENCODER_EVENT_START;
+
+    D3D11_TEXTURE2D_DESC tex_desc = {};
+    tex_desc.Width = movie_params.video_width;
+    tex_desc.Height = movie_params.video_height;
+    tex_desc.MipLevels = 1;
+    tex_desc.ArraySize = 1;
+    tex_desc.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
+    tex_desc.SampleDesc.Count = 1;
+    tex_desc.Usage = D3D11_USAGE_STAGING;
+    tex_desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+
+    hr = vid_d3d11_device->CreateTexture2D(&tex_desc, NULL, &session_staging_tex);
+
+    if (FAILED(hr))
+    {
+        error("ERROR: Could not create session texture (%#x)\n", hr);
+        goto rfail;
+    }
+
+    codec = avcodec_find_encoder(AV_CODEC_ID_FFV1);
+
+    if (codec == NULL)
+    {
+        error("ERROR: Could not find the FFV1 encoder for the session\n");
+        goto rfail;
+    }
+
+    session_codec_ctx = avcodec_alloc_context3(codec);
+    session_codec_ctx->width = movie_params.video_width;
+    session_codec_ctx->height = movie_params.video_height;
+    session_codec_ctx->pix_fmt = AV_PIX_FMT_BGR0; // Same bytes as the game texture.
+    session_codec_ctx->time_base = AVRational { 1, movie_params.video_fps };
+    session_codec_ctx->thread_type = FF_THREAD_SLICE;
+    session_codec_ctx->thread_count = SESSION_NUM_THREADS;
+    session_codec_ctx->slices = FFV1_SLICE_COUNTS[0];
+
+    // Version 3 is needed for the slices, see render_setup_ffv1.
+    av_opt_set(session_codec_ctx->priv_data, "level", "3", 0);
+
+    res = avcodec_open2(session_codec_ctx, codec, NULL);
+
+    if (res < 0)
+    {
+        error("ERROR: Could not open the session encoder (%d)\n", res);
+        goto rfail;
+    }
+
+    session_frame = av_frame_alloc();
+    session_frame->format = session_codec_ctx->pix_fmt;
+    session_frame->width = movie_params.video_width;
+    session_frame->height = movie_params.video_height;
+
+    session_packet = av_packet_alloc();
+
+    // The decoder needs the extradata of the encoder, so it is stored after the movie parameters.
+    record.size = sizeof(EncoderSharedMovieParams) + session_codec_ctx->extradata_size;
+
+    start_data = (u8*)svr_alloc(record.size);
+    memcpy(start_data, &movie_params, sizeof(EncoderSharedMovieParams));
+
+    if (session_codec_ctx->extradata_size > 0)
+    {
+        memcpy(start_data + sizeof(EncoderSharedMovieParams), session_codec_ctx->extradata, session_codec_ctx->extradata_size);
+    }
+
+    if (!io_open(&session_io, session_path, 0))
+    {
+        goto rfail;
+    }
+
+    session_start_time = svr_prof_get_real_time();
+    session_recording = true;
+
+    avio_write(session_io.avio, (u8*)&header, sizeof(SessionHeader));
+    session_write_record(&record, start_data);
+
+    svr_log("Recording session to %s\n", session_path);
+
+    ret = true;
+    goto rexit;
+
+rfail:
+    session_stop();
+
+rexit:
+    svr_maybe_free((void**)&start_data);
+
+    return ret;
+}
+
+void EncoderState::session_stop()
+{
+    if (session_recording)
+    {
+        SessionRecord record = {};
+        record.event_type = ENCODER_EVENT_STOP;
+
+        session_write_record(&record, NULL);
+
+        svr_log("Recorded session of %.2f MB\n", avio_tell(session_io.avio) / (1024.0 * 1024.0));
+    }
+
+    io_close(&session_io);
+
+    svr_maybe_release(&session_staging_tex);
+
+    avcodec_free_context(&session_codec_ctx);
+    av_frame_free(&session_frame);
+    av_packet_free(&session_packet);
+
+    session_recording = false;
+}
+
+void EncoderState::session_write_record(SessionRecord* record, void* data)
+{
+    record->time = svr_prof_get_real_time() - session_start_time;
+
+    avio_write(session_io.avio, (u8*)record, sizeof(SessionRecord));
+
+    if (record->size > 0)
+    {
+        avio_write(session_io.avio, (u8*)data, record->size);
+    }
+}
+
+// The game texture was copied to the staging texture when it was converted.
+void EncoderState::session_write_video_frame()
+{
+    s32 res;
+
+    D3D11_MAPPED_SUBRESOURCE map;
+    vid_d3d11_context->Map(session_staging_tex, 0, D3D11_MAP_READ, 0, &map);
+
+    // The frame is not reference counted, so the encoder makes its own copy and the texture can be unmapped right away.
+    session_frame->data[0] = (u8*)map.pData;
+    session_frame->linesize[0] = map.RowPitch;
+
+    res = avcodec_send_frame(session_codec_ctx, session_frame);
+
+    vid_d3d11_context->Unmap(session_staging_tex, 0);
+
+    session_frame->data[0] = NULL;
+
+    if (res < 0)
+    {
+        svr_log("ERROR: Could not encode session frame (%d)\n", res);
+        return;
+    }
+
+    // Every frame is a keyframe and comes out right away.
+    while (avcodec_receive_packet(session_codec_ctx, session_packet) == 0)
+    {
+        SessionRecord record = {};
+        record.event_type = ENCODER_EVENT_NEW_VIDEO;
+        record.compression = SESSION_COMPRESSION_FFV1;
+        record.size = session_packet->size;
+
+        session_write_record(&record, session_packet->data);
+
+        av_packet_unref(session_packet);
+    }
+}
+
+void EncoderState::session_write_audio_samples(void* mem, s32 num_samples)
+{
+    SessionRecord record = {};
+    record.event_type = ENCODER_EVENT_NEW_AUDIO;
+    record.num_samples = num_samples;
+    record.size = render_get_audio_buffer_size(num_samples);
+
+    session_write_record(&record, mem);
+}
+
+// -----------------------------------------------
+// Replaying:
+
+struct ReplayStats
+{
+    s32 num_frames;
+    s64 decode_time;
+    s64 video_time; // Conversion, download and submit to the frame thread.
+    s64 audio_time;
+    s64 finish_time; // Stopping the movie and waiting until it is written.
+    s64 start_time;
+    s64 recorded_time; // How long the movie took to render with the game.
+};
+
+void replay_log_stats(ReplayStats* stats)
+{
+    double frames = svr_max(stats->num_frames, 1);
+    double secs = (svr_prof_get_real_time() - stats->start_time) / 1000000.0;
+
+    svr_log("Replayed %d frames in %.2f seconds (%.1f fps), the recorded movie took %.2f seconds\n",
+            stats->num_frames, secs, stats->num_frames / secs, stats->recorded_time / 1000000.0);
+
+    svr_log("Per frame: decode %.3f ms | video %.3f ms | audio %.3f ms. Finishing took %.1f ms\n",
+            (stats->decode_time / 1000.0) / frames,
+            (stats->video_time / 1000.0) / frames,
+            (stats->audio_time / 1000.0) / frames,
+            stats->finish_time / 1000.0);
+}
+
+// Decoder for the frames of a session, made from the extradata in the start record.
+AVCodecContext* replay_create_decoder(EncoderSharedMovieParams* params, u8* extradata, s32 extradata_size)
+{
+    AVCodecContext* ret = NULL;
+    s32 res;
+
+    const AVCodec* codec = avcodec_find_decoder(AV_CODEC_ID_FFV1);
+
+    if (codec == NULL)
+    {
+        svr_log("ERROR: Could not find the FFV1 decoder\n");
+        goto rfail;
+    }
+
+    ret = avcodec_alloc_context3(codec);
+    ret->width = params->video_width;
+    ret->height = params->video_height;
+
+    // Frame threads would hold frames back, but the slices can be decoded in parallel.
+    ret->thread_type = FF_THREAD_SLICE;
+    ret->thread_count = 0;
+
+    if (extradata_size > 0)
+    {
+        ret->extradata = (u8*)av_mallocz(extradata_size + AV_INPUT_BUFFER_PADDING_SIZE);
+        ret->extradata_size = extradata_size;
+
+        memcpy(ret->extradata, extradata, extradata_size);
+    }
+
+    res = avcodec_open2(ret, codec, NULL);
+
+    if (res < 0)
+    {
+        svr_log("ERROR: Could not open the FFV1 decoder (%d)\n", res);
+        goto rfail;
+    }
+
+    goto rexit;
+
+rfail:
+    avcodec_free_context(&ret);
+
+rexit:
+    return ret;
+}
+
+int replay_main(const char* session_path, bool use_cpu)
+{
+    int ret = 1;
+    s32 res;
+
+    FILE* file = NULL;
+    u8* data = NULL; // Data of the current record.
+    s32 data_size = 0;
+
+    EncoderState* es = NULL;
+    AVCodecContext* decoder_ctx = NULL;
+    AVFrame* frame = NULL;
+    AVPacket* packet = NULL;
+
+    SessionHeader header;
+    ReplayStats stats = {};
+
+    file = fopen(session_path, "rb");
+
+    if (file == NULL)
+    {
+        svr_log("ERROR: Could not open session file %s\n", session_path);
+        goto rfail;
+    }
+
+    if (fread(&header, sizeof(SessionHeader), 1, file) != 1)
+    {
+        svr_log("ERROR: Session file %s is too small\n", session_path);
+        goto rfail;
+    }
+
+    if (memcmp(header.magic, SESSION_MAGIC, sizeof(SESSION_MAGIC)))
+    {
+        svr_log("ERROR: %s is not a session file\n", session_path);
+        goto rfail;
+    }
+
+    if (header.version != SESSION_VERSION)
+    {
+        svr_log("ERROR: Session file has version %d but version %d is needed\n", header.version, SESSION_VERSION);
+        goto rfail;
+    }
+
+    frame = av_frame_alloc();
+    packet = av_packet_alloc();
+
+    es = SVR_ZALLOC(EncoderState);
+    es->vid_use_cpu = use_cpu;
+
+    if (!es->init_headless())
+    {
+        goto rfail;
+    }
+
+    if (use_cpu)
+    {
+        svr_log("Replaying with the frames converted on the CPU\n");
+    }
+
+    // A session that was not stopped (such as when the game crashed) is replayed up to where it ends.
+    while (true)
+    {
+        SessionRecord record;
+
+        if (fread(&record, sizeof(SessionRecord), 1, file) != 1)
+        {
+            break;
+        }
+
+        if (record.size < 0 || record.size > INT32_MAX - AV_INPUT_BUFFER_PADDING_SIZE)
+        {
+            break;
+        }
+
+        // The decoder reads a bit past the end of the packet, which must be zeros.
+        if (record.size + AV_INPUT_BUFFER_PADDING_SIZE > data_size)
+        {
+            data_size = (s32)record.size + AV_INPUT_BUFFER_PADDING_SIZE;
+            data = (u8*)svr_realloc(data, data_size);
+        }
+
+        if (record.size > 0 && fread(data, record.size, 1, file) != 1)
+        {
+            break;
+        }
+
+        memset(data + record.size, 0, AV_INPUT_BUFFER_PADDING_SIZE);
+
+        stats.recorded_time = record.time;
+
+        switch (record.event_type)
+        {
+            case ENCODER_EVENT_START:
+            {
+                if (record.size < (s64)sizeof(EncoderSharedMovieParams))
+                {
+                    svr_log("ERROR: Session file %s is damaged\n", session_path);
+                    goto rfail;
+                }
+
+                EncoderSharedMovieParams* params = (EncoderSharedMovieParams*)data;
+
+                avcodec_free_context(&decoder_ctx);
+                decoder_ctx = replay_create_decoder(params, data + sizeof(EncoderSharedMovieParams), (s32)record.size - sizeof(EncoderSharedMovieParams));
+
+                if (decoder_ctx == NULL)
+                {
+                    goto rfail;
+                }
+
+                es->movie_params = *params;
+                es->movie_params.record_session = false;
+
+                // Same container as the original movie.
+                const char* ext = strrchr(params->dest_file, '.');
+                SVR_SNPRINTF(es->movie_params.dest_file, "%s.replay%s", session_path, ext ? ext : ".mp4");
+
+                svr_log("Replaying to %s\n", es->movie_params.dest_file);
+
+                if (!es->start_movie())
+                {
+                    goto rfail;
+                }
+
+                stats = {};
+                stats.start_time = svr_prof_get_real_time();
+                break;
+            }
+
+            case ENCODER_EVENT_STOP:
+            {
+                s64 t = svr_prof_get_real_time();
+
+                es->free_dynamic();
+                es->render_reap_finalized_movies(true);
+
+                stats.finish_time = svr_prof_get_real_time() - t;
+
+                replay_log_stats(&stats);
+                break;
+            }
+
+            case ENCODER_EVENT_NEW_VIDEO:
+            {
+                if (decoder_ctx == NULL || record.compression != SESSION_COMPRESSION_FFV1)
+                {
+                    svr_log("ERROR: Session file %s is damaged\n", session_path);
+                    goto rfail;
+                }
+
+                s64 t = svr_prof_get_real_time();
+
+                // The packet is not reference counted, so the decoder makes its own copy.
+                packet->data = data;
+                packet->size = (s32)record.size;
+
+                res = avcodec_send_packet(decoder_ctx, packet);
+
+                if (res >= 0)
+                {
+                    res = avcodec_receive_frame(decoder_ctx, frame);
+                }
+
+                if (res < 0)
+                {
+                    svr_log("ERROR: Could not decode session frame (%d)\n", res);
+                    goto rfail;
+                }
+
+                stats.decode_time += svr_prof_get_real_time() - t;
+
+                t = svr_prof_get_real_time();
+
+                if (use_cpu)
+                {
+                    if (!es->render_receive_cpu_video(frame))
+                    {
+                        goto rfail;
+                    }
+                }
+
+                else
+                {
+                    es->vid_write_headless_game_texture(frame->data[0], frame->linesize[0]);
+
+                    if (!es->render_receive_video())
+                    {
+                        goto rfail;
+                    }
+                }
+
+                av_frame_unref(frame);
+
+                stats.video_time += svr_prof_get_real_time() - t;
+                stats.num_frames++;
+                break;
+            }
+
+            case ENCODER_EVENT_NEW_AUDIO:
+            {
+                s64 t = svr_prof_get_real_time();
+
+                es->render_receive_audio_samples(data, record.num_samples);
+
+                stats.audio_time += svr_prof_get_real_time() - t;
+                break;
+            }
+        }
+    }
+
+    ret = 0;
+    goto rexit;
+
+rfail:
+
+rexit:
+    if (es)
+    {
+        es->free_dynamic();
+        es->free_static();
+
+        svr_free(es);
+    }
+
+    avcodec_free_context(&decoder_ctx);
+    av_frame_free(&frame);
+    av_packet_free(&packet);
+
+    svr_maybe_free((void**)&data);
+
+    if (file)
+    {
+        fclose(file);
+    }
+
+    return ret;
+}
@@ -0,0 +1,129 @@
+#include "encoder_priv.h"
+
+// Writing of spool files.
+// In spool mode the video frames are only converted to the pixel format of the encoder and written to the spool file together
+// with the audio samples. This is much faster than encoding, so the game can run faster. The spool file is later encoded
+// with svr_encoder --from-spool, see encoder_offline.cpp. The file format is in svr_spool.h.
+
+bool EncoderState::spool_start()
+{
+    bool ret = false;
+    char spool_path[MAX_PATH];
+    s64 frame_size = 0;
+    s64 estimated_size;
+
+    SVR_SNPRINTF(spool_path, "%s.svrspool", movie_params.dest_file);
+
+    const AVPixFmtDescriptor* pix_desc = av_pix_fmt_desc_get(render_video_info->pixel_format);
+
+    spool_header = {};
+    memcpy(spool_header.magic, SVR_SPOOL_MAGIC, sizeof(SVR_SPOOL_MAGIC));
+    spool_header.version = SVR_SPOOL_VERSION;
+    spool_header.num_planes = av_pix_fmt_count_planes(render_video_info->pixel_format);
+    spool_header.movie_params = movie_params;
+
+    for (s32 i = 0; i < spool_header.num_planes; i++)
+    {
+        // Chroma planes may be smaller.
+        s32 shift = (i == 1 || i == 2) ? pix_desc->log2_chroma_h : 0;
+
+        spool_header.plane_row_sizes[i] = av_image_get_linesize(render_video_info->pixel_format, movie_params.output_width, i);
+        spool_header.plane_heights[i] = AV_CEIL_RSHIFT(movie_params.output_height, shift);
+    }
+
+    spool_records.size = 0;
+
+    // The frames are uncompressed, so the size is known from the length of the movie.
+    for (s32 i = 0; i < spool_header.num_planes; i++)
+    {
+        frame_size += (s64)spool_header.plane_row_sizes[i] * spool_header.plane_heights[i];
+    }
+
+    estimated_size = frame_size * movie_params.video_fps * movie_params.expected_seconds + render_estimate_size(movie_params.expected_seconds, false);
+
+    if (!io_open(&render_movie->io, spool_path, estimated_size))
+    {
+        goto rfail;
+    }
+
+    // Written again with the right values when the spool is finished.
+    avio_write(render_movie->io.avio, (u8*)&spool_header, sizeof(SvrSpoolHeader));
+
+    svr_log("Writing spool file %s\n", spool_path);
+
+    ret = true;
+    goto rexit;
+
+rfail:
+
+rexit:
+    return ret;
+}
+
+// Writes the index and the final header.
+// The file is closed by the finalize thread.
+void EncoderState::spool_finish()
+{
+    AVIOContext* avio = render_movie->io.avio;
+
+    spool_header.num_records = spool_records.size;
+    spool_header.index_offset = avio_tell(avio);
+
+    avio_write(avio, (u8*)spool_records.mem, spool_records.used_size_in_memory());
+
+    avio_seek(avio, 0, SEEK_SET);
+    avio_write(avio, (u8*)&spool_header, sizeof(SvrSpoolHeader));
+
+    svr_log("Wrote %d video frames to spool file\n", spool_header.num_video_frames);
+}
+
+void EncoderState::spool_write_video_frame(AVFrame* frame)
+{
+    AVIOContext* avio = render_movie->io.avio;
+
+    SvrSpoolRecord record = {};
+    record.type = SVR_SPOOL_RECORD_VIDEO;
+    record.offset = avio_tell(avio);
+
+    for (s32 i = 0; i < spool_header.num_planes; i++)
+    {
+        s32 row_size = spool_header.plane_row_sizes[i];
+        s32 height = spool_header.plane_heights[i];
+        u8* source_ptr = frame->data[i];
+
+        // Planes are packed tightly in the spool, but the frame may have padding at the end of each row.
+        if (frame->linesize[i] == row_size)
+        {
+            avio_write(avio, source_ptr, row_size * height);
+        }
+
+        else
+        {
+            for (s32 j = 0; j < height; j++)
+            {
+                avio_write(avio, source_ptr, row_size);
+                source_ptr += frame->linesize[i];
+            }
+        }
+
+        record.size += row_size * height;
+    }
+
+    spool_records.push(record);
+    spool_header.num_video_frames++;
+}
+
+void EncoderState::spool_write_audio_samples(void* mem, s32 num_samples)
+{
+    AVIOContext* avio = render_movie->io.avio;
+
+    SvrSpoolRecord record = {};
+    record.type = SVR_SPOOL_RECORD_AUDIO;
+    record.num_samples = num_samples;
+    record.offset = avio_tell(avio);
+    record.size = render_get_audio_buffer_size(num_samples);
+
+    avio_write(avio, (u8*)mem, record.size);
+
+    spool_records.push(record);
+}
@@ -24,6 +24,8 @@ bool EncoderState::init(HANDLE in_shared_mem_h)
     encoder_wake_event_h = (HANDLE)shared_mem_ptr->encoder_wake_event_h;
     shared_audio_buffer = (u8*)shared_mem_ptr + shared_mem_ptr->audio_buffer_offset;
 
+    svr_handoff_init(&game_handoff, &shared_mem_ptr->game_to_encoder, &SVR_HANDOFF_WIN32_BACKEND);
+
     game_process = OpenProcess(SYNCHRONIZE, FALSE, shared_mem_ptr->game_pid);
 
     if (game_process == NULL)
@@ -65,10 +67,36 @@ void EncoderState::start_event()
 {
     svr_log("Starting encoder\n");
 
+    svr_handoff_reset_stats(&game_handoff);
+
     // The movie parameters in the shared memory won't change after this point, but we
     // want to have our own copy either way.
     movie_params = shared_mem_ptr->movie_params;
 
+    if (!start_movie())
+    {
+        return;
+    }
+
+    if (movie_params.record_session)
+    {
+        if (!session_start())
+        {
+            free_dynamic();
+        }
+    }
+}
+
+// Starts a movie with the parameters in movie_params.
+bool EncoderState::start_movie()
+{
+    bool ret = false;
+
+    s64 start_time = svr_prof_get_real_time();
+
+    // Must be done before the encoders are opened so they know how many threads to use.
+    cpu_start();
+
     if (!render_start())
     {
         goto rfail;
@@ -79,7 +107,8 @@ void EncoderState::start_event()
         goto rfail;
     }
 
-    if (movie_params.use_audio)
+    // The audio is converted when the spool is encoded.
+    if (movie_params.use_audio && !movie_params.use_spool)
     {
         if (!audio_start())
         {
@@ -89,28 +118,52 @@ void EncoderState::start_event()
 
     if (render_video_info)
     {
-        svr_log("Using video encoder %s\n", render_video_info->profile_name);
+        svr_log("Using video encoder %s\n", RENDER_VIDEO_NAMES[render_video_info->id]);
     }
 
     if (render_audio_info)
     {
-        svr_log("Using audio encoder %s\n", render_audio_info->profile_name);
+        svr_log("Using audio encoder %s\n", RENDER_AUDIO_NAMES[render_audio_info->id]);
+    }
+
+    if (movie_params.use_spool)
+    {
+        svr_log("Writing to spool file instead of encoding\n");
+    }
+
+    // Threads can only be started after the audio has been set up, as that decides if the audio thread is needed.
+    render_start_threads();
+
+    // The movie goes on without the preview if it cannot be started.
+    if (movie_params.preview_interval > 0)
+    {
+        preview_start();
     }
 
+    svr_log("Encoder started in %.2f ms\n", (svr_prof_get_real_time() - start_time) / 1000.0);
+
+    ret = true;
     goto rexit;
 
 rfail:
     free_dynamic();
 
 rexit:
-    return;
+    return ret;
 }
 
 void EncoderState::stop_event()
 {
     svr_log("Ending encoder\n");
 
+    svr_log("Received %.1f%% of the game events while spinning (%lld spun, %lld slept)\n", svr_handoff_get_spin_ratio(&game_handoff), game_handoff.num_spun, game_handoff.num_blocked);
+
     free_dynamic();
+
+    if (session_recording)
+    {
+        session_stop();
+    }
 }
 
 void EncoderState::new_video_frame_event()
@@ -119,6 +172,11 @@ void EncoderState::new_video_frame_event()
     {
         free_dynamic();
     }
+
+    else if (session_recording)
+    {
+        session_write_video_frame();
+    }
 }
 
 void EncoderState::new_audio_samples_event()
@@ -127,6 +185,41 @@ void EncoderState::new_audio_samples_event()
     {
         free_dynamic();
     }
+
+    else if (session_recording)
+    {
+        session_write_audio_samples(shared_audio_buffer, shared_mem_ptr->waiting_audio_samples);
+    }
+}
+
+// Every video frame comes with the audio since the last frame, so each frame only needs one event.
+void EncoderState::new_frame_event()
+{
+    new_video_frame_event();
+
+    // The movie has been stopped if there was an error.
+    if (shared_mem_ptr->error)
+    {
+        return;
+    }
+
+    if (shared_mem_ptr->waiting_audio_samples > 0)
+    {
+        new_audio_samples_event();
+    }
+}
+
+// The game waits on this when it needs the movie file to be complete, since the end of the file is written in the background.
+void EncoderState::finalize_event()
+{
+    render_reap_finalized_movies(true);
+
+    // Also includes movies that were freed before this, which would otherwise not be reported.
+    if (render_finalize_failed)
+    {
+        render_finalize_failed = false;
+        error("%s", render_finalize_message);
+    }
 }
 
 // Event reading from svr_game.
@@ -134,21 +227,12 @@ void EncoderState::event_loop()
 {
     svr_log("Encoder ready\n");
 
-    HANDLE handles[] =
-    {
-        game_process,
-        encoder_wake_event_h,
-    };
-
     while (true)
     {
-        DWORD waited = WaitForMultipleObjects(SVR_ARRAY_SIZE(handles), handles, FALSE, INFINITE);
-        HANDLE waited_h = handles[waited - WAIT_OBJECT_0];
-
         // Game exited or crashed or something.
         // If we were recording, we did not get the stop command, so just stop as if we got it.
         // This will exit this process too.
-        if (waited_h == game_process)
+        if (!svr_handoff_wait(&game_handoff, &shared_mem_ptr->game_to_encoder, encoder_wake_event_h, game_process))
         {
             if (svr_atom_load(&render_started))
             {
@@ -163,48 +247,92 @@ void EncoderState::event_loop()
         // We are woken up here because svr_game wants us to do something.
         // Any code in here needs to be fast because the game is frozen at this point.
         // Forward relevant stuff to the actual encoder thread.
-        if (waited_h == encoder_wake_event_h)
+
+        // Clear out any error from previous calls.
+        shared_mem_ptr->error = 0;
+        shared_mem_ptr->error_message[0] = 0;
+
+        switch (shared_mem_ptr->event_type)
         {
-            // Clear out any error from previous calls.
-            shared_mem_ptr->error = 0;
-            shared_mem_ptr->error_message[0] = 0;
+            case ENCODER_EVENT_START:
+            {
+                start_event();
+                break;
+            }
+
+            case ENCODER_EVENT_STOP:
+            {
+                stop_event();
+                break;
+            }
 
-            switch (shared_mem_ptr->event_type)
+            case ENCODER_EVENT_NEW_VIDEO:
             {
-                case ENCODER_EVENT_START:
-                {
-                    start_event();
-                    break;
-                }
-
-                case ENCODER_EVENT_STOP:
-                {
-                    stop_event();
-                    break;
-                }
-
-                case ENCODER_EVENT_NEW_VIDEO:
-                {
-                    new_video_frame_event();
-                    break;
-                }
-
-                case ENCODER_EVENT_NEW_AUDIO:
-                {
-                    new_audio_samples_event();
-                    break;
-                }
+                new_video_frame_event();
+                break;
             }
 
-            // Notify svr_game that we handled this event.
-            // We go back to sleep after this, which puts us in a known paused state.
-            SetEvent(game_wake_event_h);
+            case ENCODER_EVENT_NEW_AUDIO:
+            {
+                new_audio_samples_event();
+                break;
+            }
+
+            case ENCODER_EVENT_NEW_FRAME:
+            {
+                new_frame_event();
+                break;
+            }
+
+            case ENCODER_EVENT_FINALIZE:
+            {
+                finalize_event();
+                break;
+            }
         }
+
+        // Notify svr_game that we handled this event.
+        // We go back to sleep after this, which puts us in a known paused state.
+        svr_handoff_signal(&game_handoff, &shared_mem_ptr->encoder_to_game, game_wake_event_h);
     }
 
     svr_log("Encoder finished\n");
 }
 
+// For running the encoder without a game, such as when benchmarking.
+// The game texture is created by vid_start instead and has to be filled by the caller.
+// D3D11 is not used at all if vid_use_cpu is set, and the frames are given with render_receive_cpu_video instead.
+bool EncoderState::init_headless()
+{
+    bool ret = false;
+
+    main_thread_id = GetCurrentThreadId();
+
+    if (!vid_use_cpu && !vid_init())
+    {
+        goto rfail;
+    }
+
+    if (!audio_init())
+    {
+        goto rfail;
+    }
+
+    if (!render_init())
+    {
+        goto rfail;
+    }
+
+    ret = true;
+    goto rexit;
+
+rfail:
+    free_static();
+
+rexit:
+    return ret;
+}
+
 void EncoderState::free_static()
 {
     svr_maybe_close_handle(&game_process);
@@ -223,13 +351,17 @@ void EncoderState::free_static()
     render_free_static();
     vid_free_static();
     audio_free_static();
+
+    cpu_release(); // All movies have been finalized now.
 }
 
 void EncoderState::free_dynamic()
 {
     render_free_dynamic();
+    preview_stop(); // After the last frames have been submitted.
     vid_free_dynamic();
     audio_free_dynamic();
+    cpu_end();
 }
 
 void EncoderState::error(const char* format, ...)
@@ -241,8 +373,25 @@ void EncoderState::error(const char* format, ...)
     // If we have an error then we must stop right now, and not try to process any more data.
     svr_atom_store(&render_started, 0);
 
+    if (render_movie)
+    {
+        svr_atom_store(&render_movie->running, 0);
+    }
+
     va_list va;
     va_start(va, format);
+
+    // There is no game to report to when encoding a spool file.
+    if (shared_mem_ptr == NULL)
+    {
+        char buf[512];
+        SVR_VSNPRINTF(buf, format, va);
+        va_end(va);
+
+        svr_log("%s", buf);
+        return;
+    }
+
     SVR_VSNPRINTF(shared_mem_ptr->error_message, format, va);
     va_end(va);
 
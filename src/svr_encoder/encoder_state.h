@@ -5,7 +5,14 @@ const s32 RENDER_QUEUED_PACKETS = 8192; // Max number of compressed AVPacket* to
 const s32 VID_QUEUED_TEXTURES = 16; // Max number of converted uncompressed frames to store in RAM before encode.
 const s32 RENDER_QUEUED_AUDIO_BUFFERS = 8192; // Max number of audio buffers to queue up for conversion and encoding.
 const s32 VID_MAX_PLANES = 3; // At most, YUV uses 3 planes.
+const s32 VID_NUM_CONVERSIONS = 7; // Pixel formats that the game texture can be converted to, see VID_CONVERSIONS.
 const s32 AUDIO_MAX_CHANS = 8;
+const s32 IO_BUFFER_SIZE = 8 * 1024 * 1024; // Size of each buffer that is written to the movie file in one go.
+const s32 IO_NUM_BUFFERS = 8; // Max number of buffers that can be waiting to be written.
+const s32 IO_PIPE_SIZE = 4 * 1024 * 1024; // Size of the pipe to a child process, so it can read while we write.
+const s64 IO_PREALLOC_SIZE = 512LL * 1024LL * 1024LL; // How much to grow the file allocation by when it runs out.
+
+static_assert(AUDIO_MAX_CHANS <= SVR_RESAMPLE_MAX_CHANS, "Our own resampler must take every channel layout");
 
 struct RenderVideoInfo;
 struct RenderAudioInfo;
@@ -18,12 +25,241 @@ struct RenderFrameThreadInput
     AVMediaType type;
 };
 
+// Where a new segment starts, in the time bases of the video and audio streams.
+// The frame at this time is encoded as a keyframe.
+struct RenderSegmentCut
+{
+    s64 video_pts;
+    s64 audio_pts;
+
+    // For the checkpoint.
+    s64 video_frame;
+    s64 audio_samples;
+    s32 demo_tick; // -1 if not known.
+};
+
 struct RenderAudioThreadInput
 {
     void* mem; // In the format incoming from svr_game. Capacity is always ENCODER_MAX_SAMPLES.
     s32 num_samples; // How many samples there actually are.
 };
 
+struct EncoderState;
+
+// Container output that is written by a separate thread.
+// Writing to the file system can stall for long periods of time, so the packet thread only copies into large buffers
+// which are then written by the IO thread.
+struct IoWriter
+{
+    EncoderState* encoder_ptr;
+
+    HANDLE file_h; // The movie file. Not used for pipes.
+    AVIOContext* avio; // Given to the container. Buffers up to IO_BUFFER_SIZE before calling io_write_callback.
+
+    // Pipes are written in order and cannot be seeked, so the container must be one that can be streamed.
+    bool is_pipe;
+    SvrPipe pipe; // The child process or named pipe that is written to instead of the file.
+
+    HANDLE thread_h; // Thread that writes the buffers to the file.
+    HANDLE wake_event_h; // Set by the packet thread when there are buffers to write.
+    HANDLE free_event_h; // Set by the IO thread when a buffer has been written and can be used again.
+
+    u8* buffers[IO_NUM_BUFFERS]; // Page aligned.
+    s32 buffer_sizes[IO_NUM_BUFFERS];
+    s64 buffer_offsets[IO_NUM_BUFFERS]; // Where in the file the buffer goes. The container may seek back to update headers.
+
+    // Buffer that is being filled, or -1. Writes from the container are added to it until it is full or the container
+    // writes somewhere else, so small flushes do not use up a whole buffer each.
+    s32 fill_index;
+
+    // Indexes of buffers that are ready to be written.
+    // Written to by the packet thread, read by the IO thread.
+    // Order matters.
+    SvrLockedQueue<s32> write_queue;
+
+    // Indexes of buffers that can be filled.
+    // Written to by the IO thread, read by the packet thread.
+    // Order doesn't matter.
+    SvrLockedArray<s32> free_buffers;
+
+    // Only used by the packet thread (and the finalize thread after it).
+    s64 write_pos; // Where the container is writing.
+    s64 file_size; // Largest position that has been written.
+    s32 num_submitted; // Buffers given to the IO thread.
+
+    // Only used by the IO thread.
+    s64 estimated_size; // Expected size of the file, or 0 if not known. Allocated when the file is opened.
+    s64 allocated_size; // How much space the file system has reserved for the file.
+    s64 bytes_written;
+    s64 write_time; // Time spent in WriteFile in microseconds.
+
+    SvrAtom32 status; // Will be set to 0 by the IO thread if it failed. Message will be in message.
+    char message[256]; // Error message for the IO thread.
+};
+
+// State for a single movie that is being rendered or finalized.
+// Everything in here is owned by the frame and packet threads, and later by the finalize thread, so a new movie can be
+// started while an older movie is still writing out its last packets.
+struct RenderMovie
+{
+    EncoderState* encoder_ptr;
+
+    char dest_file[256]; // Used to not start a new movie on a file that is still being finalized.
+
+    // Set to 0 on error to make the threads exit without processing any more data.
+    // This is separate from render_started because the threads may still be running after the main thread has moved on to a new movie.
+    SvrAtom32 running;
+
+    // Frame thread:
+
+    SVR_THREAD_PADDING();
+
+    HANDLE frame_thread_h; // Thread used to process uncompressed video frames and audio samples.
+
+    // Event set by the main and audio threads to notify that there are new frames to encode.
+    HANDLE frame_wake_event_h;
+
+    // Uncompressed frames and samples ready to be encoded.
+    // Written to by the main and audio threads, read by the frame thread.
+    // Order matters.
+    SvrLockedQueue<RenderFrameThreadInput> frame_queue;
+
+    // Video frames that have been encoded.
+    // Written to by the frame thread, read by the main thread.
+    // Order doesn't matter.
+    SvrLockedArray<AVFrame*> recycled_video_frames;
+
+    // Audio frames that have been encoded.
+    // Written to by the frame thread, read by the main and audio threads.
+    // Order doesn't matter.
+    SvrLockedArray<AVFrame*> recycled_audio_frames;
+
+    SvrAtom32 frame_thread_status; // Will be set to 0 by frame thread if it failed. Message will be in frame_thread_message.
+    char frame_thread_message[256]; // Error message for the frame thread.
+
+    // Packet thread:
+
+    SVR_THREAD_PADDING();
+
+    HANDLE packet_thread_h; // Thread used to process encoded packets for writing to the container.
+
+    // Event set by the frame thread to notify that there are encoded packets to write.
+    // When the movie is finalized, this will be set by the finalize thread instead.
+    HANDLE packet_wake_event_h;
+
+    // Compressed packets ready to be written.
+    // Written to by the frame thread, read by the packet thread.
+    // When the movie is finalized, this will be written to by the finalize thread instead.
+    // Order matters.
+    SvrLockedQueue<AVPacket*> packet_queue;
+
+    SvrAtom32 packet_thread_status; // Will be set to 0 by packet thread if it failed. Message will be in packet_thread_message.
+    char packet_thread_message[256]; // Error message for the packet thread.
+
+    // Finalize thread:
+
+    SVR_THREAD_PADDING();
+
+    HANDLE finalize_thread_h; // Thread that waits for the frame and packet threads and then closes the file.
+
+    // Given from the encoder state when the movie stops.
+    AVFormatContext* output_context;
+    AVCodecContext* video_ctx;
+    AVCodecContext* audio_ctx;
+
+    // Separate file for the audio of containers that cannot hold audio, otherwise NULL.
+    // Packets that go to it have it in AVPacket.opaque.
+    AVFormatContext* audio_output_context;
+
+    bool write_trailer; // Only if the movie stopped without errors.
+
+    // Set by the finalize thread if the file could not be completely written. Message will be in finalize_message.
+    // Read by the main thread after the finalize thread has exited.
+    bool finalize_failed;
+    char finalize_message[256];
+
+    IoWriter io; // Not used for image sequences, where the image2 muxer opens the files itself.
+    IoWriter audio_io;
+
+    // Segmented output:
+    // The packet thread switches to the next segment when it sees the cut that the main thread has asked for.
+    // Everything here is used by the packet thread, and by the finalize thread after it, unless said otherwise.
+
+    bool use_segments;
+    s32 segment_index; // Of the segment in output_context.
+
+    // Has the streams that the frame thread rescales the packets to, so it is kept until the movie is finalized.
+    AVFormatContext* first_output_context;
+
+    // The next segment is opened and has its header written ahead of time, so the cut does not have to wait for it.
+    AVFormatContext* next_output_context;
+    IoWriter* next_io;
+    IoWriter segment_io; // Switched with io between segments.
+    IoWriter* current_io; // The one of io and segment_io that output_context is written to.
+    s64 segment_estimated_size; // Expected size of every segment file, or 0 if not known.
+
+    AVDictionary* segment_options; // Given to every segment when writing the header.
+
+    // The cut that is being waited for and which streams have passed it.
+    RenderSegmentCut segment_cut;
+    bool has_segment_cut;
+    bool segment_video_cut;
+    bool segment_audio_cut;
+
+    // Where the current segment starts in the time bases of the streams.
+    s64 segment_video_start;
+    s64 segment_audio_start;
+    s64 segment_video_end; // Where the latest video packet ends, for the length of the last segment.
+
+    HANDLE manifest_h; // List of the segments that can be given to the ffmpeg concat demuxer. Opened by the main thread.
+    s64 manifest_size;
+
+    // For the checkpoint, which is written after every completed segment.
+    s32 video_fps;
+    char video_encoder[32];
+
+    // Written to by the main thread, read by the packet thread.
+    // Order matters.
+    SvrLockedQueue<RenderSegmentCut> segment_cuts;
+
+    SvrAtom64 segment_bytes; // Size of the packets in the current segment. Read by the main thread for the size limit.
+    SvrAtom32 segment_switches; // How many cuts have been done. Read by the main thread.
+};
+
+// Session files have the events that svr_game sent during a movie, so the movie can be encoded again later
+// without the game with svr_encoder --replay. This is used to find out why a certain movie is slow to render.
+// The file starts with a SessionHeader, followed by a SessionRecord and its data for every event.
+// The data of ENCODER_EVENT_START is the EncoderSharedMovieParams. The data of ENCODER_EVENT_NEW_AUDIO is the samples.
+// The data of ENCODER_EVENT_START is followed by the extradata of the video codec.
+// The data of ENCODER_EVENT_NEW_VIDEO is the game texture as a lossless FFV1 frame. Every frame is a keyframe, so a session
+// that was cut off can be replayed up to where it ends. FFV1 is in every libavcodec, so sessions can also be replayed away from Windows and D3D11.
+
+const char SESSION_MAGIC[8] = { 'S', 'V', 'R', 'S', 'E', 'S', 'S', 'N' };
+const s32 SESSION_VERSION = 2;
+
+using SessionCompression = s32;
+
+enum // SessionCompression
+{
+    SESSION_COMPRESSION_NONE,
+    SESSION_COMPRESSION_FFV1, // BGR0 pixels, same as the game texture.
+};
+
+struct SessionHeader
+{
+    char magic[8];
+    s32 version;
+};
+
+struct SessionRecord
+{
+    EncoderSharedEvent event_type;
+    s32 num_samples; // For audio.
+    SessionCompression compression; // For video.
+    s64 time; // Microseconds since the movie started.
+    s64 size; // Size of the data after this record.
+};
+
 struct VidTextureDownloadInput
 {
     ID3D11Texture2D* dl_texs[VID_MAX_PLANES]; // In system memory.
@@ -53,16 +289,23 @@ struct EncoderState
 
     DWORD main_thread_id;
 
+    SvrHandoff game_handoff; // For waiting on events from svr_game.
+
     EncoderSharedMovieParams movie_params; // Copied from the shared memory on movie start.
 
     bool init(HANDLE in_shared_mem_h);
+    bool init_headless();
 
     void start_event();
     void stop_event();
     void new_video_frame_event();
     void new_audio_samples_event();
+    void new_frame_event();
+    void finalize_event();
     void event_loop();
 
+    bool start_movie();
+
     void free_static();
     void free_dynamic();
 
@@ -72,65 +315,64 @@ struct EncoderState
     void error(const char* format, ...);
 
     // -----------------------------------------------
-    // Render state:
+    // CPU state:
 
-    AVFormatContext* render_output_context;
-    const AVOutputFormat* render_container;
+    // Set when the game reserved processors for itself, in which case the encoder is kept off them.
+    bool cpu_budget_active;
 
-    SVR_THREAD_PADDING();
+    // Set while the process is kept to the processors of the encoder, which lasts until the movies have been finalized.
+    bool cpu_mask_held;
 
-    SvrAtom32 render_started;
+    DWORD_PTR cpu_old_process_mask;
+    s32 cpu_num_processors; // Logical processors the encoder can use.
 
-    // The threads start when rendering starts, and stop when rendering stops.
-    // This makes it really easy to synchronize when stopping.
+    // For logging how much of the processors the encoder actually used.
+    s64 cpu_start_time;
+    s64 cpu_start_process_time;
 
-    // Frame thread:
+    void cpu_start();
+    void cpu_end();
+    void cpu_release();
+    void cpu_setup_worker_thread(HANDLE thread_h);
+    s32 cpu_get_codec_threads(s32 wanted);
+    s64 cpu_get_process_time();
 
-    SVR_THREAD_PADDING();
-
-    HANDLE render_frame_thread_h; // Thread used to process uncompressed video frames and audio samples.
-
-    // Event set by the main and audio threads to notify that there are new frames to encode.
-    HANDLE render_frame_wake_event_h;
-
-    // Uncompressed frames and samples ready to be encoded.
-    // Written to by the main and audio threads, read by the frame thread.
-    // Order matters.
-    SvrLockedQueue<RenderFrameThreadInput> render_frame_queue;
-
-    // Video frames that have been encoded.
-    // Written to by the frame thread, read by the main thread.
-    // Order doesn't matter.
-    SvrLockedArray<AVFrame*> render_recycled_video_frames;
-
-    // Audio frames that have been encoded.
-    // Written to by the frame thread, read by the main thread.
-    // Order doesn't matter.
-    SvrLockedArray<AVFrame*> render_recycled_audio_frames;
+    // -----------------------------------------------
+    // Render state:
 
-    SvrAtom32 render_frame_thread_status; // Will be set to 0 by frame thread if it failed. Message will be in render_frame_thread_message.
-    char render_frame_thread_message[256]; // Error message for the frame thread.
+    AVFormatContext* render_output_context;
+    const AVOutputFormat* render_container;
+    AVDictionary* render_output_options; // Given to the container when writing the header.
 
-    // Packet thread:
+    // Where the audio stream goes. Same as render_output_context, except for containers without audio which have it in a separate file.
+    AVFormatContext* render_audio_output_context;
 
     SVR_THREAD_PADDING();
 
-    HANDLE render_packet_thread_h; // Thread used to process encoded packets for writing to the container.
+    SvrAtom32 render_started;
 
-    // Event set by the frame thread to notify that there are encoded packets to write.
-    // When rendering stops, this will be set by the main thread instead.
-    HANDLE render_packet_wake_event_h;
+    // The frame and packet threads belong to a movie and are started when the movie starts.
+    // When the movie stops, the ownership of the movie is given to a finalize thread that waits for the
+    // remaining frames and packets to be written and then closes the file. The main thread can then start the next movie
+    // without waiting for all of that.
+    RenderMovie* render_movie; // Movie currently being rendered, or NULL.
 
-    // Compressed packets ready to be written.
-    // Written to by the frame thread, read by the packet thread.
-    // When rendering stops, this will be written to by the main thread instead.
-    // Order matters.
-    SvrLockedQueue<AVPacket*> render_packet_queue;
+    // Movies that are still being finalized. Only used by the main thread.
+    SvrDynArray<RenderMovie*> render_finalizing_movies;
+
+    // Error of the last movie that could not be finalized, kept for ENCODER_EVENT_FINALIZE.
+    // The finalize thread cannot write to the shared memory, so the main thread reports it when it frees the movie.
+    bool render_finalize_failed;
+    char render_finalize_message[256];
 
-    SvrAtom32 render_packet_thread_status; // Will be set to 0 by packet thread if it failed. Message will be in render_packet_thread_message.
-    char render_packet_thread_message[256]; // Error message for the packet thread.
+    // Encoded frames from movies that have been finalized. Given to the next movie if the format is the same.
+    // Only used by the main thread.
+    SvrDynArray<AVFrame*> render_cached_video_frames;
+    SvrDynArray<AVFrame*> render_cached_audio_frames;
 
     // Audio thread:
+    // This thread starts when rendering starts, and stops when rendering stops. It writes to the audio fifo so it
+    // must be finished before the movie can be finalized.
 
     SVR_THREAD_PADDING();
 
@@ -148,6 +390,7 @@ struct EncoderState
     // Written to by the audio thread, read by the main thread.
     // Order does not matter.
     SvrLockedArray<RenderAudioThreadInput> render_recycled_audio_buffers;
+    s32 render_audio_buffer_size; // Size of the buffers in render_recycled_audio_buffers.
 
     SvrAtom32 render_audio_thread_status; // Will be set to 0 by audio thread if it failed. Message will be in render_audio_thread_message.
     char render_audio_thread_message[256]; // Error message for the audio thread.
@@ -159,9 +402,22 @@ struct EncoderState
     AVCodecContext* render_video_ctx;
     s64 render_video_pts; // Presentation timestamp.
 
+    // Segmented output, see encoder_segment.cpp.
+    s64 segment_max_frames; // Length of a segment from the time limit, or 0.
+    s64 segment_max_bytes; // Size of a segment, or 0.
+    s64 segment_start_pts; // Video frame where the latest segment starts.
+    s32 segment_num_cuts; // Cuts given to the packet thread.
+    SvrDynQueue<s32> segment_frame_ticks; // Demo ticks of the frames that have not been submitted yet.
+
+    // Where the movie continues from when resuming, otherwise 0.
+    s64 segment_resume_frame;
+    s64 segment_resume_samples;
+
     const RenderAudioInfo* render_audio_info;
     AVStream* render_audio_stream;
     AVCodecContext* render_audio_ctx;
+    AVSampleFormat render_audio_sample_format; // Agreed on with the codec.
+    s32 render_audio_hz; // Agreed on with the codec.
 
     SVR_THREAD_PADDING();
 
@@ -171,24 +427,37 @@ struct EncoderState
 
     bool render_init();
     bool render_start();
+    bool render_start_encoders();
     bool render_start_threads();
     void render_free_static();
     void render_free_dynamic();
-    void render_frame_proc();
-    void render_packet_proc();
+    void render_frame_proc(RenderMovie* movie);
+    void render_packet_proc(RenderMovie* movie);
     void render_audio_proc();
+    void render_finalize_proc(RenderMovie* movie);
+    void render_finalize_error(RenderMovie* movie, const char* message);
+    void render_start_finalize();
+    bool render_reap_finalized_movies(bool wait_all);
+    void render_wait_for_finalize_of_file(const char* dest_file);
+    void render_free_movie(RenderMovie* movie);
+    void render_prepare_audio_buffers();
+    void render_reuse_cached_frames();
+    void render_free_cached_frames();
     bool render_setup_video_info();
     bool render_setup_audio_info();
     bool render_init_output_context();
+    bool render_init_sequence_output();
+    bool render_init_sidecar_output();
+    s64 render_estimate_size(s32 seconds, bool with_video);
+    void render_setup_fragmented_output();
     bool render_init_video();
     bool render_init_audio();
+    bool render_negotiate_audio_format(const AVCodec* codec);
     bool render_check_thread_errors();
     bool render_receive_video();
+    bool render_receive_cpu_video(AVFrame* source_frame);
     bool render_receive_audio();
-    void render_give_audio_thread_input(RenderAudioThreadInput* input);
-    void render_flush_audio_fifo();
-    void render_submit_audio_fifo();
-    void render_encode_frame_from_audio_fifo(s32 num_samples);
+    void render_receive_audio_samples(void* mem, s32 num_samples);
     void render_encode_video_frame(AVFrame* frame);
     void render_encode_audio_frame(AVFrame* frame);
     void render_encode_frame(AVCodecContext* ctx, AVStream* stream, AVFrame* frame, AVMediaType type);
@@ -201,8 +470,28 @@ struct EncoderState
     void render_free_lingering_thread_inputs();
     void render_submit_texture();
 
+    bool segment_init();
+    bool segment_read_checkpoint();
+    void segment_start();
+    void segment_receive_frame();
+    void segment_check_cut(AVFrame* frame);
+    bool segment_open_next(RenderMovie* movie);
+    s32 segment_write_packet(RenderMovie* movie, AVPacket* packet);
+    bool segment_switch(RenderMovie* movie);
+    void segment_write_manifest_entry(RenderMovie* movie, s64 end_pts);
+    void segment_write_checkpoint(RenderMovie* movie);
+    void segment_discard_next(RenderMovie* movie);
+    void segment_finish(RenderMovie* movie);
+
     void render_setup_dnxhr();
     void render_setup_libx264();
+    void render_setup_libx265();
+    void render_setup_libsvtav1();
+    void render_setup_prores();
+    void render_setup_ffv1();
+    void render_setup_png();
+    void render_setup_tiff();
+    void render_setup_exr();
 
     // -----------------------------------------------
     // Video state:
@@ -220,20 +509,38 @@ struct EncoderState
     s32 vid_num_planes;
     s32 vid_plane_heights[VID_MAX_PLANES];
 
-    ID3D11ComputeShader* vid_nv12_cs;
-    ID3D11ComputeShader* vid_yuv422_cs;
-    ID3D11ComputeShader* vid_yuv444_cs;
+    // One for every entry in VID_CONVERSIONS.
+    ID3D11ComputeShader* vid_conversion_shaders[VID_NUM_CONVERSIONS];
+
+    // Downscaling of the game texture when the movie resolution is lower than the game resolution.
+    // This is done in two separable passes. The first pass scales horizontally and the second pass scales vertically.
+    // The conversion shader then reads from the last scale texture instead of the game texture.
+    ID3D11ComputeShader* vid_scale_cs; // Points to one of the below, or NULL if not scaling.
+    ID3D11ComputeShader* vid_scale_box_cs;
+    ID3D11ComputeShader* vid_scale_bilinear_cs;
+    ID3D11ComputeShader* vid_scale_lanczos_cs;
+
+    // Kept between movies like the conversion textures.
+    ID3D11Texture2D* vid_scale_texs[2];
+    ID3D11ShaderResourceView* vid_scale_srvs[2];
+    ID3D11UnorderedAccessView* vid_scale_uavs[2];
 
     // Destination textures that are in the correct pixel format.
     // These textures have the actual data that can be encoded.
     // In order to not stall the pipeline by immediately trying to download the result,
     // the results are stored in vid_texture_download_queue until the commands have been processed.
     // Only after some time has passed it is safe to try and download without causing a stall.
+    // These are kept between movies and are only recreated when the pixel format or size changes.
     ID3D11Texture2D* vid_converted_texs[VID_MAX_PLANES];
     ID3D11UnorderedAccessView* vid_converted_uavs[VID_MAX_PLANES];
 
     VidTextureDownloadInput* vid_texture_download_queue;
 
+    // Frames can also be given in system memory with render_receive_cpu_video, which is converted and scaled with libswscale
+    // instead of D3D11. This is used by replays on computers that can't run the compute shaders.
+    bool vid_use_cpu;
+    SwsContext* vid_sws_ctx;
+
     // These indexes get wrapped.
     s64 render_download_write_idx;
     s64 render_download_read_idx;
@@ -247,45 +554,133 @@ struct EncoderState
     bool vid_create_shader(const char* name, void** shader, D3D11_SHADER_TYPE type);
     bool vid_create_shaders_list(EncoderShader* shaders, s32 num);
     bool vid_start();
+    bool vid_start_cpu();
     bool vid_open_game_texture();
+    bool vid_create_headless_game_texture();
+    void vid_write_headless_game_texture(const void* data, s32 pitch);
     void vid_create_conversion_texs();
+    void vid_free_conversion_texs();
+    bool vid_create_scale_texs();
+    void vid_free_scale_texs();
+    bool vid_tex_matches(ID3D11Texture2D* tex, s32 width, s32 height);
+    void vid_scale_game_texture();
     void vid_push_texture_for_conversion();
     void vid_download_texture_into_frame(AVFrame* dest_frame);
     bool vid_can_map_now();
     bool vid_drain_textures();
     s32 vid_get_num_cs_threads(s32 unit);
 
+    // -----------------------------------------------
+    // IO state:
+
+    void io_error(IoWriter* io, const char* format, ...);
+    bool io_open(IoWriter* io, const char* path, s64 estimated_size);
+    bool io_open_pipe(IoWriter* io, const char* target);
+    bool io_start(IoWriter* io);
+    bool io_close(IoWriter* io);
+    void io_proc(IoWriter* io);
+    void io_append(IoWriter* io, const u8* data, s32 size);
+    void io_submit_fill(IoWriter* io);
+    bool io_write_buffer(IoWriter* io, s32 index);
+    void io_grow_allocation(IoWriter* io, s64 wanted_size);
+
+    // -----------------------------------------------
+    // Session state:
+
+    bool session_recording;
+    IoWriter session_io;
+    s64 session_start_time;
+    ID3D11Texture2D* session_staging_tex; // Copy of the game texture in system memory. Written in vid_push_texture_for_conversion.
+    AVCodecContext* session_codec_ctx;
+    AVFrame* session_frame; // Points to the mapped staging texture.
+    AVPacket* session_packet;
+
+    bool session_start();
+    void session_stop();
+    void session_write_record(SessionRecord* record, void* data);
+    void session_write_video_frame();
+    void session_write_audio_samples(void* mem, s32 num_samples);
+
+    // -----------------------------------------------
+    // Spool state:
+
+    SvrSpoolHeader spool_header;
+    SvrDynArray<SvrSpoolRecord> spool_records;
+
+    bool spool_start();
+    void spool_finish();
+    void spool_write_video_frame(AVFrame* frame);
+    void spool_write_audio_samples(void* mem, s32 num_samples);
+
+    // -----------------------------------------------
+    // Preview state:
+
+    HANDLE preview_mapping_h;
+    EncoderPreviewMem* preview_mem_ptr;
+    HANDLE preview_thread_h;
+    HANDLE preview_wake_event_h;
+    AVCodecContext* preview_ctx;
+    const AVPixFmtDescriptor* preview_src_desc;
+    s32* preview_src_x; // Column in the movie frame for every column of the preview.
+    s32* preview_src_y; // Row in the movie frame for every row of the preview.
+    u8 preview_luma_lut[256]; // The movie is limited range and JPEG is full range.
+    u8 preview_chroma_lut[256];
+    s32 preview_next_slot; // Only used by the preview thread.
+    SvrLockedQueue<AVFrame*> preview_free_frames;
+    SvrLockedQueue<AVFrame*> preview_frames; // Frames for the preview thread. NULL to make it exit.
+
+    bool preview_start();
+    void preview_stop();
+    void preview_proc();
+    void preview_submit_frame(AVFrame* frame);
+    void preview_scale_yuv(AVFrame* src, AVFrame* dest);
+    void preview_scale_rgba(AVFrame* src, AVFrame* dest);
+    void preview_publish(AVPacket* packet, s64 video_frame);
+
     // -----------------------------------------------
     // Audio state:
 
+    // The resamplers are kept between movies and are only recreated when the formats change.
+    // Our own resampler is used when it supports the conversion, which is done on the main thread.
+    // Other conversions use libswresample on the audio thread.
+
     SwrContext* audio_swr;
+    SvrResampler audio_resampler;
+    bool audio_use_native;
 
+    AVSampleFormat audio_input_format;
+    AVSampleFormat audio_output_format;
     s32 audio_input_hz;
     s32 audio_output_hz;
     s32 audio_num_channels; // Input and output use the same.
 
-    u8* audio_output_buffers[AUDIO_MAX_CHANS];
-    s32 audio_output_size; // Size of allocated audio buffers.
+    // Frame that the samples are written to, which is submitted when it has the codec frame size of samples.
+    AVFrame* audio_frame;
+    s32 audio_frame_pos; // How many samples have been written to the frame.
 
-    AVAudioFifo* audio_fifo;
+    s64 audio_copied_bytes; // How much audio has been copied during the movie.
 
     bool audio_init();
     void audio_free_static();
     void audio_free_dynamic();
     bool audio_start();
     bool audio_create_resampler();
-    bool audio_create_fifo();
-    void audio_convert_to_codec_samples(RenderAudioThreadInput* buffer);
-    void audio_copy_samples_to_frame(AVFrame* dest_frame, s32 num_samples);
-    s32 audio_num_queued_samples();
+    void audio_write_samples(void* mem, s32 num_samples);
+    void audio_get_frame_pointers(u8** dest);
+    void audio_submit_frame();
+    void audio_flush();
+    void audio_drain_resampler();
     bool audio_need_conversion();
 };
 
 struct RenderVideoInfo
 {
-    const char* profile_name; // Name as written in the movie profile.
+    EncoderVideoEncoder id; // Name and containers are in RENDER_VIDEO_NAMES and RENDER_VIDEO_CONTAINERS_TABLE at this index.
     const char* codec_name; // Name in ffmpeg.
     AVPixelFormat pixel_format; // An encoder may support several pixel formats, so we select the one we like the most.
+    s32 thread_type; // FF_THREAD_FRAME or FF_THREAD_SLICE, or 0 to let ffmpeg decide.
+    float bits_per_pixel; // Rough size of the output with the default profile, used to allocate the movie file up front.
+    bool forces_keyframes; // Makes a keyframe when a frame is AV_PICTURE_TYPE_I. Segments need this unless every frame is a keyframe.
 
     // Set state according to the movie profile.
     // This is called before the codec is opened.
@@ -294,7 +689,7 @@ struct RenderVideoInfo
 
 struct RenderAudioInfo
 {
-    const char* profile_name; // Name as written in the movie profile.
+    EncoderAudioEncoder id; // Name is in RENDER_AUDIO_NAMES at this index.
     const char* codec_name; // Name in ffmpeg.
     AVSampleFormat sample_format; // An encoder may support several sample formats, so we select the one we like the most.
 
@@ -302,7 +697,40 @@ struct RenderAudioInfo
     // Set to 0 to use the same as the input.
     s32 hz;
 
+    // If the codec does not support the format or rate above, the closest ones that it does support are used instead.
+    // See render_negotiate_audio_format.
+
+    const char* sidecar_container; // File extension of the audio file that is written next to containers without audio.
+
     // Set state according to the movie profile.
     // This is called before the codec is opened.
     void(EncoderState::*setup)();
 };
+
+// Encoding of spool files with svr_encoder --from-spool.
+// The chunks are read by svr_spool and every chunk is given to its own encoder state.
+
+const s32 OFFLINE_QUEUED_FRAMES = 16; // Max number of frames per chunk that are waiting to be encoded.
+
+struct OfflineChunk
+{
+    SvrSpool* spool;
+    SvrSpoolChunk range;
+
+    EncoderState* es;
+    AVFrame* frame; // Given to svr_spool to read the next frame into.
+    s32 num_frames_created;
+
+    char dest_file[MAX_PATH];
+
+    HANDLE thread_h;
+    bool ok;
+};
+
+int offline_main(const char* spool_path, s32 num_chunks);
+
+int bench_main(s32 argc, char** argv);
+
+int replay_main(const char* session_path, bool use_cpu);
+
+int tune_main(s32 argc, char** argv);
@@ -0,0 +1,206 @@
+#include "encoder_priv.h"
+
+// Finding the best encoder settings for this computer.
+// Started with svr_encoder --tune [width] [height] [minimum fps] [frames].
+// Short movies of the benchmark content are encoded with libx264 to find the preset with the smallest files that still
+// encodes at the minimum fps, and then the number of encoder threads and the download queue depth that are the fastest
+// for that preset. The result is written to data\profiles\tuned.ini, which is used by video_x264_preset=auto.
+
+const s32 TUNE_QUEUE_DEPTHS[] = { 4, 8, 16 };
+
+// A setting must be this much faster to be picked, so we don't pick something because of noise.
+const double TUNE_MIN_GAIN = 1.03;
+
+struct TuneSettings
+{
+    const char* preset;
+    s32 threads;
+    s32 queue_depth;
+
+    double fps;
+    s64 output_size;
+};
+
+bool tune_run(BenchState* bench, TuneSettings* settings)
+{
+    EncoderSharedMovieParams params;
+    bench_setup_params(bench, ENCODER_VIDEO_LIBX264, "mp4", settings->preset, &params);
+
+    params.video_threads = settings->threads;
+    params.video_queue_depth = settings->queue_depth;
+
+    BenchResult res = bench_run(bench, &params);
+
+    if (!res.ok)
+    {
+        svr_log("%-10s threads %3d depth %2d failed\n", settings->preset, settings->threads, settings->queue_depth);
+        return false;
+    }
+
+    settings->fps = bench->num_frames / (res.total_time / 1000000.0);
+    settings->output_size = res.output_size;
+
+    svr_log("%-10s threads %3d depth %2d %8.1f fps | size %7.2f MB\n", settings->preset, settings->threads, settings->queue_depth, settings->fps, settings->output_size / (1024.0 * 1024.0));
+
+    return true;
+}
+
+bool tune_write_profile(BenchState* bench, TuneSettings* best, s32 min_fps)
+{
+    bool ret = false;
+
+    const char* path = "data\\profiles\\tuned.ini";
+
+    SYSTEMTIME lt;
+    GetLocalTime(&lt);
+
+    char buf[2048];
+
+    SVR_SNPRINTF(buf,
+        "# Written by svr_encoder --tune on %02d/%02d/%04d for %dx%d at a minimum of %d fps.\n"
+        "# Run svr_encoder.exe --tune again if the computer changes.\n"
+        "# This is used by video_x264_preset=auto, but can also be used as a profile of its own.\n"
+        "\n"
+        "video_x264_preset=%s\n"
+        "video_threads=%d\n"
+        "video_queue_depth=%d\n",
+        lt.wDay, lt.wMonth, lt.wYear, bench->width, bench->height, min_fps, best->preset, best->threads, best->queue_depth);
+
+    HANDLE h = CreateFileA(path, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+
+    if (h == INVALID_HANDLE_VALUE)
+    {
+        DWORD error_code = GetLastError();
+
+        svr_log("ERROR: Could not create %s (%lu)\n", path, error_code);
+        goto rfail;
+    }
+
+    WriteFile(h, buf, (DWORD)strlen(buf), NULL, NULL);
+    CloseHandle(h);
+
+    svr_log("Wrote %s\n", path);
+
+    ret = true;
+    goto rexit;
+
+rfail:
+
+rexit:
+    return ret;
+}
+
+int tune_main(s32 argc, char** argv)
+{
+    int ret = 1;
+
+    BenchState bench = {};
+    bench.width = argc > 2 ? atoi(argv[2]) : 1920;
+    bench.height = argc > 3 ? atoi(argv[3]) : 1080;
+    bench.fps = 60;
+    bench.num_frames = argc > 5 ? atoi(argv[5]) : 300;
+
+    s32 min_fps = argc > 4 ? atoi(argv[4]) : 120;
+
+    SYSTEM_INFO sys_info;
+    GetSystemInfo(&sys_info);
+
+    s32 num_cpus = sys_info.dwNumberOfProcessors;
+
+    // Start from the defaults of the default profile.
+    TuneSettings best = {};
+    best.preset = BENCH_X264_PRESETS[0];
+    best.threads = 0;
+    best.queue_depth = VID_QUEUED_TEXTURES;
+
+    s32 thread_counts[] = { num_cpus / 4, num_cpus / 2, (num_cpus * 3) / 4, num_cpus };
+
+    if (bench.width <= 0 || bench.height <= 0 || min_fps <= 0 || bench.num_frames <= 0)
+    {
+        svr_log("ERROR: Usage: svr_encoder --tune [width] [height] [minimum fps] [frames]\n");
+        return 1;
+    }
+
+    svr_log("Tuning with %d frames at %dx%d for a minimum of %d fps on %d threads\n", bench.num_frames, bench.width, bench.height, min_fps, num_cpus);
+
+    if (!bench_init(&bench))
+    {
+        goto rfail;
+    }
+
+    // Slower presets make smaller files, so use the smallest that is still fast enough.
+
+    for (s32 i = 0; i < SVR_ARRAY_SIZE(BENCH_X264_PRESETS); i++)
+    {
+        TuneSettings settings = best;
+        settings.preset = BENCH_X264_PRESETS[i];
+
+        if (!tune_run(&bench, &settings))
+        {
+            continue;
+        }
+
+        bool fast_enough = settings.fps >= min_fps;
+        bool smaller = best.output_size == 0 || settings.output_size < best.output_size;
+
+        if (i == 0 || (fast_enough && smaller))
+        {
+            best = settings;
+        }
+    }
+
+    // Using all threads is not always the fastest, such as when there are a lot of them.
+
+    for (s32 i = 0; i < SVR_ARRAY_SIZE(thread_counts); i++)
+    {
+        if (thread_counts[i] <= 0 || (i > 0 && thread_counts[i] == thread_counts[i - 1]))
+        {
+            continue;
+        }
+
+        TuneSettings settings = best;
+        settings.threads = thread_counts[i];
+
+        if (tune_run(&bench, &settings) && settings.fps > best.fps * TUNE_MIN_GAIN)
+        {
+            best = settings;
+        }
+    }
+
+    for (s32 i = 0; i < SVR_ARRAY_SIZE(TUNE_QUEUE_DEPTHS); i++)
+    {
+        if (TUNE_QUEUE_DEPTHS[i] == best.queue_depth)
+        {
+            continue;
+        }
+
+        TuneSettings settings = best;
+        settings.queue_depth = TUNE_QUEUE_DEPTHS[i];
+
+        if (tune_run(&bench, &settings) && settings.fps > best.fps * TUNE_MIN_GAIN)
+        {
+            best = settings;
+        }
+    }
+
+    svr_log("Best settings are preset %s with %d threads and queue depth %d (%.1f fps)\n", best.preset, best.threads, best.queue_depth, best.fps);
+
+    if (best.fps < min_fps)
+    {
+        svr_log("No preset could encode at %d fps, so the fastest one was picked\n", min_fps);
+    }
+
+    if (!tune_write_profile(&bench, &best, min_fps))
+    {
+        goto rfail;
+    }
+
+    ret = 0;
+    goto rexit;
+
+rfail:
+
+rexit:
+    bench_free(&bench);
+    return ret;
+}
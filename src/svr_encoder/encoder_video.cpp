@@ -4,6 +4,35 @@
 
 const s32 VID_SHADER_SIZE = 8192; // Max size one shader can be when loading.
 
+struct VidPlaneDesc
+{
+    DXGI_FORMAT format;
+    s32 shift_x;
+    s32 shift_y;
+};
+
+// Pixel formats that the game texture can be converted to, with the shader that does it and the planes it writes to.
+// The shaders are made from tex2vid.hlsl in build_shaders.cmd.
+// The pixel format of every video encoder in encoder_shared.h must be in here.
+struct VidConversion
+{
+    AVPixelFormat pixel_format;
+    const char* shader_name;
+    s32 num_planes;
+    VidPlaneDesc planes[VID_MAX_PLANES];
+};
+
+const VidConversion VID_CONVERSIONS[VID_NUM_CONVERSIONS] =
+{
+    VidConversion { AV_PIX_FMT_NV12, "convert_nv12", 2, { { DXGI_FORMAT_R8_UINT, 0, 0 }, { DXGI_FORMAT_R8G8_UINT, 1, 1 } } },
+    VidConversion { AV_PIX_FMT_YUV420P, "convert_yuv420", 3, { { DXGI_FORMAT_R8_UINT, 0, 0 }, { DXGI_FORMAT_R8_UINT, 1, 1 }, { DXGI_FORMAT_R8_UINT, 1, 1 } } },
+    VidConversion { AV_PIX_FMT_YUV422P, "convert_yuv422", 3, { { DXGI_FORMAT_R8_UINT, 0, 0 }, { DXGI_FORMAT_R8_UINT, 1, 0 }, { DXGI_FORMAT_R8_UINT, 1, 0 } } },
+    VidConversion { AV_PIX_FMT_YUV444P, "convert_yuv444", 3, { { DXGI_FORMAT_R8_UINT, 0, 0 }, { DXGI_FORMAT_R8_UINT, 0, 0 }, { DXGI_FORMAT_R8_UINT, 0, 0 } } },
+    VidConversion { AV_PIX_FMT_YUV422P10LE, "convert_yuv422_10", 3, { { DXGI_FORMAT_R16_UINT, 0, 0 }, { DXGI_FORMAT_R16_UINT, 1, 0 }, { DXGI_FORMAT_R16_UINT, 1, 0 } } },
+    VidConversion { AV_PIX_FMT_RGBA, "convert_rgba", 1, { { DXGI_FORMAT_R8G8B8A8_UINT, 0, 0 } } },
+    VidConversion { AV_PIX_FMT_GBRPF32LE, "convert_gbrpf32", 3, { { DXGI_FORMAT_R32_FLOAT, 0, 0 }, { DXGI_FORMAT_R32_FLOAT, 0, 0 }, { DXGI_FORMAT_R32_FLOAT, 0, 0 } } },
+};
+
 bool EncoderState::vid_init()
 {
     bool ret = false;
@@ -90,11 +119,19 @@ bool EncoderState::vid_create_shaders()
 
     EncoderShader shader_list[] =
     {
-        EncoderShader { "convert_nv12", (void**)&vid_nv12_cs, D3D11_COMPUTE_SHADER },
-        EncoderShader { "convert_yuv422", (void**)&vid_yuv422_cs, D3D11_COMPUTE_SHADER },
-        EncoderShader { "convert_yuv444", (void**)&vid_yuv444_cs, D3D11_COMPUTE_SHADER },
+        EncoderShader { "scale_box", (void**)&vid_scale_box_cs, D3D11_COMPUTE_SHADER },
+        EncoderShader { "scale_bilinear", (void**)&vid_scale_bilinear_cs, D3D11_COMPUTE_SHADER },
+        EncoderShader { "scale_lanczos", (void**)&vid_scale_lanczos_cs, D3D11_COMPUTE_SHADER },
     };
 
+    for (s32 i = 0; i < VID_NUM_CONVERSIONS; i++)
+    {
+        if (!vid_create_shader(VID_CONVERSIONS[i].shader_name, (void**)&vid_conversion_shaders[i], D3D11_COMPUTE_SHADER))
+        {
+            goto rfail;
+        }
+    }
+
     if (!vid_create_shaders_list(shader_list, SVR_ARRAY_SIZE(shader_list)))
     {
         goto rfail;
@@ -112,12 +149,24 @@ rexit:
 
 void EncoderState::vid_free_static()
 {
+    if (vid_texture_download_queue)
+    {
+        vid_free_conversion_texs();
+    }
+
+    vid_free_scale_texs();
+
     svr_maybe_release(&vid_d3d11_device);
     svr_maybe_release(&vid_d3d11_context);
 
-    svr_maybe_release(&vid_nv12_cs);
-    svr_maybe_release(&vid_yuv422_cs);
-    svr_maybe_release(&vid_yuv444_cs);
+    for (s32 i = 0; i < VID_NUM_CONVERSIONS; i++)
+    {
+        svr_maybe_release(&vid_conversion_shaders[i]);
+    }
+
+    svr_maybe_release(&vid_scale_box_cs);
+    svr_maybe_release(&vid_scale_bilinear_cs);
+    svr_maybe_release(&vid_scale_lanczos_cs);
 
     svr_maybe_free((void**)&vid_texture_download_queue);
 }
@@ -130,9 +179,20 @@ void EncoderState::vid_free_dynamic()
     svr_maybe_release(&vid_game_tex_srv);
     svr_maybe_release(&vid_game_tex_lock);
 
+    // The conversion and scale textures are kept for the next movie, see vid_create_conversion_texs and vid_create_scale_texs.
+
+    vid_scale_cs = NULL;
+
+    sws_freeContext(vid_sws_ctx);
+    vid_sws_ctx = NULL;
+}
+
+void EncoderState::vid_free_conversion_texs()
+{
     for (s32 i = 0; i < VID_MAX_PLANES; i++)
     {
         svr_maybe_release(&vid_converted_texs[i]);
+        svr_maybe_release(&vid_converted_uavs[i]);
     }
 
     for (s32 i = 0; i < VID_QUEUED_TEXTURES; i++)
@@ -149,6 +209,30 @@ void EncoderState::vid_free_dynamic()
     vid_num_planes = 0;
 }
 
+void EncoderState::vid_free_scale_texs()
+{
+    for (s32 i = 0; i < SVR_ARRAY_SIZE(vid_scale_texs); i++)
+    {
+        svr_maybe_release(&vid_scale_texs[i]);
+        svr_maybe_release(&vid_scale_srvs[i]);
+        svr_maybe_release(&vid_scale_uavs[i]);
+    }
+}
+
+// To see if a texture from a previous movie can be reused.
+bool EncoderState::vid_tex_matches(ID3D11Texture2D* tex, s32 width, s32 height)
+{
+    if (tex == NULL)
+    {
+        return false;
+    }
+
+    D3D11_TEXTURE2D_DESC tex_desc;
+    tex->GetDesc(&tex_desc);
+
+    return tex_desc.Width == width && tex_desc.Height == height;
+}
+
 bool EncoderState::vid_load_shader(const char* name)
 {
     bool ret = false;
@@ -250,7 +334,28 @@ bool EncoderState::vid_start()
 {
     bool ret = false;
 
-    if (!vid_open_game_texture())
+    if (vid_use_cpu)
+    {
+        return vid_start_cpu();
+    }
+
+    if (shared_mem_ptr)
+    {
+        if (!vid_open_game_texture())
+        {
+            goto rfail;
+        }
+    }
+
+    else
+    {
+        if (!vid_create_headless_game_texture())
+        {
+            goto rfail;
+        }
+    }
+
+    if (!vid_create_scale_texs())
     {
         goto rfail;
     }
@@ -260,6 +365,9 @@ bool EncoderState::vid_start()
     render_download_write_idx = 0;
     render_download_read_idx = 0;
 
+    // The download queue cannot be deeper than the number of download textures.
+    svr_clamp(&movie_params.video_queue_depth, 2, VID_QUEUED_TEXTURES);
+
     ret = true;
     goto rexit;
 
@@ -295,65 +403,97 @@ rexit:
     return ret;
 }
 
-struct VidPlaneDesc
+// Setup state and create the textures in the format that can be sent to the encoder.
+// Without a game there is no texture to open, so make one that looks like the one svr_game shares with us.
+// The caller writes to it between AcquireSync(ENCODER_GAME_ID) and ReleaseSync(ENCODER_PROC_ID) like svr_game would.
+bool EncoderState::vid_create_headless_game_texture()
 {
-    DXGI_FORMAT format;
-    s32 shift_x;
-    s32 shift_y;
-};
+    bool ret = false;
+    HRESULT hr;
+
+    D3D11_TEXTURE2D_DESC tex_desc = {};
+    tex_desc.Width = movie_params.video_width;
+    tex_desc.Height = movie_params.video_height;
+    tex_desc.MipLevels = 1;
+    tex_desc.ArraySize = 1;
+    tex_desc.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
+    tex_desc.SampleDesc.Count = 1;
+    tex_desc.Usage = D3D11_USAGE_DEFAULT;
+    tex_desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+    tex_desc.MiscFlags = D3D11_RESOURCE_MISC_SHARED_KEYEDMUTEX;
+
+    hr = vid_d3d11_device->CreateTexture2D(&tex_desc, NULL, &vid_game_tex);
+
+    if (FAILED(hr))
+    {
+        error("ERROR: Could not create game texture (%#x)\n", hr);
+        goto rfail;
+    }
+
+    vid_d3d11_device->CreateShaderResourceView(vid_game_tex, NULL, &vid_game_tex_srv);
+
+    vid_game_tex->QueryInterface(IID_PPV_ARGS(&vid_game_tex_lock));
+
+    ret = true;
+    goto rexit;
+
+rfail:
+
+rexit:
+    return ret;
+}
+
+// Writes a new frame into the headless game texture, the same way svr_game would.
+// Data must be in B8G8R8A8 format.
+void EncoderState::vid_write_headless_game_texture(const void* data, s32 pitch)
+{
+    vid_game_tex_lock->AcquireSync(ENCODER_GAME_ID, INFINITE);
+    vid_d3d11_context->UpdateSubresource(vid_game_tex, 0, NULL, data, pitch, 0);
+    vid_game_tex_lock->ReleaseSync(ENCODER_PROC_ID);
+}
 
-// Setup state and create the textures in the format that can be sent to the encoder.
 void EncoderState::vid_create_conversion_texs()
 {
-    VidPlaneDesc plane_descs[VID_MAX_PLANES];
+    const VidConversion* conversion = NULL;
+    ID3D11ComputeShader* conversion_cs = NULL;
 
-    switch (render_video_info->pixel_format)
+    for (s32 i = 0; i < VID_NUM_CONVERSIONS; i++)
     {
-        case AV_PIX_FMT_NV12:
+        if (VID_CONVERSIONS[i].pixel_format == render_video_info->pixel_format)
         {
-            vid_conversion_cs = vid_nv12_cs;
-            vid_num_planes = 2;
-
-            plane_descs[0] = VidPlaneDesc { DXGI_FORMAT_R8_UINT, 0, 0 };
-            plane_descs[1] = VidPlaneDesc { DXGI_FORMAT_R8G8_UINT, 1, 1 };
+            conversion = &VID_CONVERSIONS[i];
+            conversion_cs = vid_conversion_shaders[i];
             break;
         }
+    }
 
-        case AV_PIX_FMT_YUV422P:
-        {
-            vid_conversion_cs = vid_yuv422_cs;
-            vid_num_planes = 3;
+    // This must work because the render info is our own thing.
+    assert(conversion);
 
-            plane_descs[0] = VidPlaneDesc { DXGI_FORMAT_R8_UINT, 0, 0 };
-            plane_descs[1] = VidPlaneDesc { DXGI_FORMAT_R8_UINT, 1, 0 };
-            plane_descs[2] = VidPlaneDesc { DXGI_FORMAT_R8_UINT, 1, 0 };
-            break;
-        }
+    const VidPlaneDesc* plane_descs = conversion->planes;
+    s32 num_planes = conversion->num_planes;
 
-        case AV_PIX_FMT_YUV444P:
-        {
-            vid_conversion_cs = vid_yuv444_cs;
-            vid_num_planes = 3;
+    // Reuse the textures from the previous movie if it had the same pixel format and size.
+    if (conversion_cs == vid_conversion_cs && vid_tex_matches(vid_converted_texs[0], movie_params.output_width, movie_params.output_height))
+    {
+        svr_log("Reusing conversion textures from previous movie\n");
+        return;
+    }
 
-            plane_descs[0] = VidPlaneDesc { DXGI_FORMAT_R8_UINT, 0, 0 };
-            plane_descs[1] = VidPlaneDesc { DXGI_FORMAT_R8_UINT, 0, 0 };
-            plane_descs[2] = VidPlaneDesc { DXGI_FORMAT_R8_UINT, 0, 0 };
-            break;
-        }
+    vid_free_conversion_texs();
 
-        // This must work because the render info is our own thing.
-        default: assert(false);
-    }
+    vid_conversion_cs = conversion_cs;
+    vid_num_planes = num_planes;
 
     assert(vid_num_planes <= VID_MAX_PLANES);
 
     for (s32 i = 0; i < vid_num_planes; i++)
     {
-        VidPlaneDesc* plane_desc = &plane_descs[i];
+        const VidPlaneDesc* plane_desc = &plane_descs[i];
 
         D3D11_TEXTURE2D_DESC tex_desc = {};
-        tex_desc.Width = movie_params.video_width >> plane_desc->shift_x;
-        tex_desc.Height = movie_params.video_height >> plane_desc->shift_y;
+        tex_desc.Width = movie_params.output_width >> plane_desc->shift_x;
+        tex_desc.Height = movie_params.output_height >> plane_desc->shift_y;
         tex_desc.MipLevels = 1;
         tex_desc.ArraySize = 1;
         tex_desc.Format = plane_desc->format;
@@ -390,17 +530,351 @@ void EncoderState::vid_create_conversion_texs()
     }
 }
 
+#define VID_SCALE_FILTER_NAME(ID, NAME) NAME,
+
+// Names of the scale filters, indexed by the ids in encoder_shared.h.
+const char* VID_SCALE_FILTER_NAMES[] =
+{
+    ENCODER_SCALE_FILTERS(VID_SCALE_FILTER_NAME)
+};
+
+#undef VID_SCALE_FILTER_NAME
+
+struct VidScaleFilter
+{
+    EncoderScaleFilter id;
+    ID3D11ComputeShader* EncoderState::* cs;
+    float kernel_radius; // Same as KERNEL_RADIUS in scale.hlsl, used by vid_scale_reference.
+};
+
+// Compute shader for every scale filter in encoder_shared.h, in the same order.
+const VidScaleFilter VID_SCALE_FILTERS[] =
+{
+    VidScaleFilter { ENCODER_SCALE_BOX, &EncoderState::vid_scale_box_cs, 0.5f },
+    VidScaleFilter { ENCODER_SCALE_BILINEAR, &EncoderState::vid_scale_bilinear_cs, 1.0f },
+    VidScaleFilter { ENCODER_SCALE_LANCZOS, &EncoderState::vid_scale_lanczos_cs, 3.0f },
+};
+
+static_assert(SVR_ARRAY_SIZE(VID_SCALE_FILTERS) == ENCODER_NUM_SCALE_FILTERS, "Every scale filter in encoder_shared.h needs a compute shader");
+
+// Same as kernel_weight in scale.hlsl.
+float vid_scale_kernel_weight(EncoderScaleFilter filter, float x)
+{
+    x = fabsf(x);
+
+    switch (filter)
+    {
+        case ENCODER_SCALE_BOX:
+        {
+            return x <= 0.5f ? 1.0f : 0.0f;
+        }
+
+        case ENCODER_SCALE_BILINEAR:
+        {
+            return svr_max(1.0f - x, 0.0f);
+        }
+
+        case ENCODER_SCALE_LANCZOS:
+        {
+            if (x < 0.0001f)
+            {
+                return 1.0f;
+            }
+
+            if (x >= 3.0f)
+            {
+                return 0.0f;
+            }
+
+            float px = 3.14159265f * x;
+            return (3.0f * sinf(px) * sinf(px / 3.0f)) / (px * px);
+        }
+    }
+
+    return 0.0f;
+}
+
+// One pass of scale.hlsl on the CPU. Scales one axis of RGBA float pixels, where the other axis keeps its length.
+void vid_scale_reference_pass(EncoderScaleFilter filter, const float* src, s32 src_width, s32 src_height, float* dest, s32 dest_width, s32 dest_height)
+{
+    bool horizontal = src_height == dest_height;
+
+    s32 input_length = horizontal ? src_width : src_height;
+    s32 output_length = horizontal ? dest_width : dest_height;
+    s32 other_length = horizontal ? dest_height : dest_width;
+
+    float ratio = (float)input_length / (float)output_length;
+    float radius = VID_SCALE_FILTERS[filter].kernel_radius * ratio;
+
+    for (s32 pos = 0; pos < output_length; pos++)
+    {
+        float center = ((float)pos + 0.5f) * ratio;
+
+        s32 first = svr_max((s32)floorf(center - radius), 0);
+        s32 last = svr_min((s32)ceilf(center + radius), input_length - 1);
+
+        for (s32 other = 0; other < other_length; other++)
+        {
+            float sum[4] = {};
+            float weight_sum = 0.0f;
+
+            for (s32 i = first; i <= last; i++)
+            {
+                float weight = vid_scale_kernel_weight(filter, ((float)i + 0.5f - center) / ratio);
+
+                s32 src_idx = horizontal ? (other * src_width + i) : (i * src_width + other);
+
+                for (s32 c = 0; c < 4; c++)
+                {
+                    sum[c] += src[src_idx * 4 + c] * weight;
+                }
+
+                weight_sum += weight;
+            }
+
+            s32 dest_idx = horizontal ? (other * dest_width + pos) : (pos * dest_width + other);
+
+            for (s32 c = 0; c < 4; c++)
+            {
+                float v = sum[c] / weight_sum;
+                svr_clamp(&v, 0.0f, 1.0f);
+
+                dest[dest_idx * 4 + c] = v;
+            }
+        }
+    }
+}
+
+// Reference for the scale shaders, to check the GPU result and to compare the speed against.
+// Source is in B8G8R8A8 format like the game texture, and the result is RGBA float like the last scale texture.
+// The temporary buffer must have room for dest_width * src_height RGBA float pixels, and the source is converted into dest first,
+// so dest must have room for src_width * src_height RGBA float pixels.
+void vid_scale_reference(EncoderScaleFilter filter, const u32* src, s32 src_pitch, s32 src_width, s32 src_height, float* temp, float* dest, s32 dest_width, s32 dest_height)
+{
+    for (s32 y = 0; y < src_height; y++)
+    {
+        const u32* row = (const u32*)((const u8*)src + y * src_pitch);
+
+        for (s32 x = 0; x < src_width; x++)
+        {
+            u32 px = row[x];
+            float* out = dest + (y * src_width + x) * 4;
+
+            out[0] = ((px >> 16) & 255) / 255.0f;
+            out[1] = ((px >> 8) & 255) / 255.0f;
+            out[2] = (px & 255) / 255.0f;
+            out[3] = ((px >> 24) & 255) / 255.0f;
+        }
+    }
+
+    // Same two passes as vid_scale_game_texture.
+    vid_scale_reference_pass(filter, dest, src_width, src_height, temp, dest_width, src_height);
+    vid_scale_reference_pass(filter, temp, dest_width, src_height, dest, dest_width, dest_height);
+}
+
+// Setup state and create the textures needed to downscale the game texture to the movie resolution.
+// Nothing is created if the movie has the same resolution as the game.
+bool EncoderState::vid_create_scale_texs()
+{
+    bool ret = false;
+    HRESULT hr;
+
+    vid_scale_cs = NULL;
+
+    if (movie_params.output_width == movie_params.video_width && movie_params.output_height == movie_params.video_height)
+    {
+        ret = true;
+        goto rexit;
+    }
+
+    for (s32 i = 0; i < ENCODER_NUM_SCALE_FILTERS; i++)
+    {
+        if (!strcmp(VID_SCALE_FILTER_NAMES[i], movie_params.scale_filter))
+        {
+            const VidScaleFilter* filter = &VID_SCALE_FILTERS[i];
+            assert(filter->id == i);
+
+            vid_scale_cs = this->*filter->cs;
+            break;
+        }
+    }
+
+    if (vid_scale_cs == NULL)
+    {
+        error("ERROR: No scale filter was found with name %s\n", movie_params.scale_filter);
+        goto rfail;
+    }
+
+    // The first pass only scales horizontally and the second pass scales vertically.
+    // Must be high precision so the first pass doesn't round before the second pass.
+    s32 pass_widths[] = { movie_params.output_width, movie_params.output_width };
+    s32 pass_heights[] = { movie_params.video_height, movie_params.output_height };
+
+    // Reuse the textures from the previous movie if it had the same sizes.
+    if (!vid_tex_matches(vid_scale_texs[0], pass_widths[0], pass_heights[0]) || !vid_tex_matches(vid_scale_texs[1], pass_widths[1], pass_heights[1]))
+    {
+        vid_free_scale_texs();
+
+        for (s32 i = 0; i < SVR_ARRAY_SIZE(vid_scale_texs); i++)
+        {
+            D3D11_TEXTURE2D_DESC tex_desc = {};
+            tex_desc.Width = pass_widths[i];
+            tex_desc.Height = pass_heights[i];
+            tex_desc.MipLevels = 1;
+            tex_desc.ArraySize = 1;
+            tex_desc.Format = DXGI_FORMAT_R16G16B16A16_FLOAT;
+            tex_desc.SampleDesc.Count = 1;
+            tex_desc.Usage = D3D11_USAGE_DEFAULT;
+            tex_desc.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_UNORDERED_ACCESS;
+
+            hr = vid_d3d11_device->CreateTexture2D(&tex_desc, NULL, &vid_scale_texs[i]);
+
+            if (FAILED(hr))
+            {
+                error("ERROR: Could not create scale texture (%#x)\n", hr);
+                goto rfail;
+            }
+
+            vid_d3d11_device->CreateShaderResourceView(vid_scale_texs[i], NULL, &vid_scale_srvs[i]);
+            vid_d3d11_device->CreateUnorderedAccessView(vid_scale_texs[i], NULL, &vid_scale_uavs[i]);
+        }
+    }
+
+    svr_log("Scaling from %dx%d to %dx%d using %s\n", movie_params.video_width, movie_params.video_height, movie_params.output_width, movie_params.output_height, movie_params.scale_filter);
+
+    ret = true;
+    goto rexit;
+
+rfail:
+
+rexit:
+    return ret;
+}
+
+// Same as the scale filters of the compute shaders in VID_SCALE_FILTERS.
+const s32 VID_SWS_SCALE_FLAGS[] =
+{
+    SWS_AREA,
+    SWS_BILINEAR,
+    SWS_LANCZOS,
+};
+
+static_assert(SVR_ARRAY_SIZE(VID_SWS_SCALE_FLAGS) == ENCODER_NUM_SCALE_FILTERS, "Every scale filter in encoder_shared.h needs a libswscale filter");
+
+// The frames are converted from B8G8R8X8 to the pixel format of the encoder with libswscale, the same way as the compute shaders.
+bool EncoderState::vid_start_cpu()
+{
+    bool ret = false;
+    s32 scale_flags = SWS_AREA; // Only used for the chroma if the size stays the same.
+    const s32* coeffs = sws_getCoefficients(SWS_CS_ITU709);
+    AVPixelFormat pixel_format = render_video_info->pixel_format;
+    const AVPixFmtDescriptor* pix_desc = av_pix_fmt_desc_get(pixel_format);
+
+    // The compute shader converts to linear light for OpenEXR, which libswscale can't do.
+    if (pix_desc->flags & AV_PIX_FMT_FLAG_FLOAT)
+    {
+        error("ERROR: Video encoder %s can only be used with the GPU\n", movie_params.video_encoder);
+        goto rfail;
+    }
+
+    if (movie_params.output_width != movie_params.video_width || movie_params.output_height != movie_params.video_height)
+    {
+        scale_flags = -1;
+
+        for (s32 i = 0; i < ENCODER_NUM_SCALE_FILTERS; i++)
+        {
+            if (!strcmp(VID_SCALE_FILTER_NAMES[i], movie_params.scale_filter))
+            {
+                scale_flags = VID_SWS_SCALE_FLAGS[i];
+                break;
+            }
+        }
+
+        if (scale_flags == -1)
+        {
+            error("ERROR: No scale filter was found with name %s\n", movie_params.scale_filter);
+            goto rfail;
+        }
+
+        svr_log("Scaling from %dx%d to %dx%d using %s on the CPU\n", movie_params.video_width, movie_params.video_height, movie_params.output_width, movie_params.output_height, movie_params.scale_filter);
+    }
+
+    vid_sws_ctx = sws_getContext(movie_params.video_width, movie_params.video_height, AV_PIX_FMT_BGR0,
+                                 movie_params.output_width, movie_params.output_height, pixel_format,
+                                 scale_flags | SWS_ACCURATE_RND | SWS_FULL_CHR_H_INT, NULL, NULL, NULL);
+
+    if (vid_sws_ctx == NULL)
+    {
+        error("ERROR: Could not create the CPU video conversion\n");
+        goto rfail;
+    }
+
+    // Same as render_init_video. YUV is limited range BT.709 and RGB is kept as full range.
+    sws_setColorspaceDetails(vid_sws_ctx, coeffs, 1, coeffs, (pix_desc->flags & AV_PIX_FMT_FLAG_RGB) ? 1 : 0, 0, 1 << 16, 1 << 16);
+
+    render_download_write_idx = 0;
+    render_download_read_idx = 0;
+
+    ret = true;
+    goto rexit;
+
+rfail:
+
+rexit:
+    return ret;
+}
+
+// Downscale the game texture into the last scale texture.
+void EncoderState::vid_scale_game_texture()
+{
+    ID3D11ShaderResourceView* pass_srvs[] = { vid_game_tex_srv, vid_scale_srvs[0] };
+
+    ID3D11ShaderResourceView* null_srv = NULL;
+    ID3D11UnorderedAccessView* null_uav = NULL;
+
+    vid_d3d11_context->CSSetShader(vid_scale_cs, NULL, 0);
+
+    for (s32 i = 0; i < SVR_ARRAY_SIZE(vid_scale_texs); i++)
+    {
+        D3D11_TEXTURE2D_DESC tex_desc;
+        vid_scale_texs[i]->GetDesc(&tex_desc);
+
+        vid_d3d11_context->CSSetShaderResources(0, 1, &pass_srvs[i]);
+        vid_d3d11_context->CSSetUnorderedAccessViews(0, 1, &vid_scale_uavs[i], NULL);
+
+        vid_d3d11_context->Dispatch(vid_get_num_cs_threads(tex_desc.Width), vid_get_num_cs_threads(tex_desc.Height), 1);
+
+        // Must unbind so the output of this pass can be the input of the next.
+        vid_d3d11_context->CSSetShaderResources(0, 1, &null_srv);
+        vid_d3d11_context->CSSetUnorderedAccessViews(0, 1, &null_uav, NULL);
+    }
+}
+
 // Convert pixel formats and push result to be retrieved later.
 // This must be done to not stall too much.
 void EncoderState::vid_push_texture_for_conversion()
 {
+    ID3D11ShaderResourceView* conversion_srv = vid_game_tex_srv;
+
     vid_game_tex_lock->AcquireSync(ENCODER_PROC_ID, INFINITE); // Allow us to read now.
 
+    // Must be copied while we have the texture.
+    if (session_staging_tex)
+    {
+        vid_d3d11_context->CopyResource(session_staging_tex, vid_game_tex);
+    }
+
+    if (vid_scale_cs)
+    {
+        vid_scale_game_texture();
+        conversion_srv = vid_scale_srvs[SVR_ARRAY_SIZE(vid_scale_srvs) - 1];
+    }
+
     vid_d3d11_context->CSSetShader(vid_conversion_cs, NULL, 0);
-    vid_d3d11_context->CSSetShaderResources(0, 1, &vid_game_tex_srv);
+    vid_d3d11_context->CSSetShaderResources(0, 1, &conversion_srv);
     vid_d3d11_context->CSSetUnorderedAccessViews(0, vid_num_planes, vid_converted_uavs, NULL);
 
-    vid_d3d11_context->Dispatch(vid_get_num_cs_threads(movie_params.video_width), vid_get_num_cs_threads(movie_params.video_height), 1);
+    vid_d3d11_context->Dispatch(vid_get_num_cs_threads(movie_params.output_width), vid_get_num_cs_threads(movie_params.output_height), 1);
 
     vid_game_tex_lock->ReleaseSync(ENCODER_GAME_ID); // Give back to game.
 
@@ -473,7 +947,7 @@ void EncoderState::vid_download_texture_into_frame(AVFrame* dest_frame)
 bool EncoderState::vid_can_map_now()
 {
     s64 dist = render_download_write_idx - render_download_read_idx;
-    return dist > VID_QUEUED_TEXTURES - 2;
+    return dist > movie_params.video_queue_depth - 2;
 }
 
 bool EncoderState::vid_drain_textures()
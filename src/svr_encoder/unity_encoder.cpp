@@ -1,9 +1,23 @@
 #include "encoder_priv.h"
 #include "encoder_main.cpp"
 #include "encoder_state.cpp"
+#include "encoder_cpu.cpp"
 #include "encoder_audio.cpp"
 #include "encoder_video.cpp"
 #include "encoder_render.cpp"
 #include "encoder_dnxhr.cpp"
 #include "encoder_libx264.cpp"
+#include "encoder_libx265.cpp"
+#include "encoder_libsvtav1.cpp"
+#include "encoder_prores.cpp"
+#include "encoder_ffv1.cpp"
+#include "encoder_image.cpp"
 #include "encoder_render_threads.cpp"
+#include "encoder_io.cpp"
+#include "encoder_segment.cpp"
+#include "encoder_spool.cpp"
+#include "encoder_offline.cpp"
+#include "encoder_bench.cpp"
+#include "encoder_session.cpp"
+#include "encoder_preview.cpp"
+#include "encoder_tune.cpp"
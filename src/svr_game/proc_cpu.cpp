@@ -0,0 +1,103 @@
+#include "proc_priv.h"
+
+// Thread budget of the game.
+// With cpu_game_cores in the profile, the fastest cores are reserved for the game thread and the encoder is given the rest,
+// so the game thread is not moved to a slow core or fighting with the codec threads for time.
+// The game thread gets all processors back when the movie ends, even though the encoder may still be finalizing the movie.
+// That does not let the encoder onto the reserved cores, since the encoder keeps itself to its own processors until it has
+// finalized the movie (see encoder_cpu.cpp), and the game thread is a single thread so it can take at most one of the encoder processors.
+
+bool ProcState::cpu_start()
+{
+    cpu_layout = {};
+
+    if (movie_profile.cpu_game_cores == 0)
+    {
+        return true;
+    }
+
+    if (!svr_cpu_make_layout(movie_profile.cpu_game_cores, &cpu_layout))
+    {
+        svr_console_msg_and_log("ERROR: Could not reserve %d cores for the game. There must be processors left for the encoder\n", movie_profile.cpu_game_cores);
+        return false;
+    }
+
+    cpu_game_thread = OpenThread(THREAD_SET_INFORMATION | THREAD_QUERY_INFORMATION, FALSE, GetCurrentThreadId());
+
+    if (cpu_game_thread == NULL)
+    {
+        DWORD error_code = GetLastError();
+
+        svr_log("Could not open the game thread (%lu), not using the thread budget\n", error_code);
+        cpu_layout = {};
+        return true;
+    }
+
+    cpu_old_game_mask = SetThreadAffinityMask(cpu_game_thread, (DWORD_PTR)cpu_layout.game_mask);
+    cpu_old_game_priority = GetThreadPriority(cpu_game_thread);
+
+    SetThreadPriority(cpu_game_thread, THREAD_PRIORITY_ABOVE_NORMAL);
+
+    cpu_start_time = svr_prof_get_real_time();
+    cpu_start_thread_time = cpu_get_game_thread_time();
+
+    char game_str[256];
+    char encoder_str[256];
+    svr_cpu_mask_to_string(cpu_layout.game_mask, game_str, SVR_ARRAY_SIZE(game_str));
+    svr_cpu_mask_to_string(cpu_layout.encoder_mask, encoder_str, SVR_ARRAY_SIZE(encoder_str));
+
+    svr_log("Reserved %d processors for the game (%s) and %d for the encoder (%s)\n", cpu_layout.num_game_cpus, game_str, cpu_layout.num_encoder_cpus, encoder_str);
+
+    return true;
+}
+
+void ProcState::cpu_end()
+{
+    if (cpu_game_thread == NULL)
+    {
+        return;
+    }
+
+    s64 wall_time = svr_prof_get_real_time() - cpu_start_time;
+    s64 thread_time = cpu_get_game_thread_time() - cpu_start_thread_time;
+
+    // If this is low, the game thread is waiting for the encoder and fewer cores could be reserved.
+    if (wall_time > 0)
+    {
+        svr_log("Game thread was busy %.1f%% of the movie\n", (100.0 * thread_time) / wall_time);
+    }
+}
+
+void ProcState::cpu_free_dynamic()
+{
+    if (cpu_game_thread)
+    {
+        if (cpu_old_game_mask)
+        {
+            SetThreadAffinityMask(cpu_game_thread, cpu_old_game_mask);
+        }
+
+        SetThreadPriority(cpu_game_thread, cpu_old_game_priority);
+
+        CloseHandle(cpu_game_thread);
+        cpu_game_thread = NULL;
+    }
+
+    cpu_layout = {};
+    cpu_old_game_mask = 0;
+}
+
+// Returns the processor time used by the game thread in microseconds.
+s64 ProcState::cpu_get_game_thread_time()
+{
+    FILETIME creation_time;
+    FILETIME exit_time;
+    FILETIME kernel_time;
+    FILETIME user_time;
+    GetThreadTimes(cpu_game_thread, &creation_time, &exit_time, &kernel_time, &user_time);
+
+    s64 kernel = ((s64)kernel_time.dwHighDateTime << 32) | kernel_time.dwLowDateTime;
+    s64 user = ((s64)user_time.dwHighDateTime << 32) | user_time.dwLowDateTime;
+
+    return (kernel + user) / 10; // From 100 nanosecond units.
+}
@@ -20,8 +20,6 @@ bool ProcState::encoder_init()
 
     svr_console_msg_and_log("Started encoder process\n");
 
-    encoder_pending_samples.init(ENCODER_MAX_SAMPLES * 2);
-
     ret = true;
     goto rexit;
 
@@ -69,8 +67,6 @@ void ProcState::encoder_free_static()
         CloseHandle(encoder_wake_event_h);
         encoder_wake_event_h = NULL;
     }
-
-    encoder_pending_samples.free();
 }
 
 void ProcState::encoder_free_dynamic()
@@ -99,7 +95,7 @@ bool ProcState::encoder_create_shared_mem()
     sa.bInheritHandle = TRUE; // Allow encoder process to use this handle too.
 
     s32 mem_size = sizeof(EncoderSharedMem);
-    mem_size += sizeof(SvrWaveSample) * ENCODER_MAX_SAMPLES; // Space for audio buffer.
+    mem_size += sizeof(SvrWaveSample) * ENCODER_MAX_SHARED_SAMPLES; // Space for audio buffer.
 
     // Create shared memory handle without a name. The handle will be passed as a parameter to the encoder process
     // and it will open in that way, since we use inherited handles.
@@ -197,6 +193,8 @@ bool ProcState::encoder_start_process()
     encoder_proc = proc_info.hProcess;
     CloseHandle(proc_info.hThread);
 
+    svr_handoff_init(&encoder_handoff, &encoder_shared_ptr->encoder_to_game, &SVR_HANDOFF_WIN32_BACKEND);
+
     // Wait for ready (or failure) early here so you don't have to see the error until trying to start the movie.
 
     HANDLE handles[] =
@@ -266,9 +264,10 @@ bool ProcState::encoder_start()
 
     encoder_share_tex_lock->AcquireSync(ENCODER_GAME_ID, INFINITE); // Set initial owner now.
 
-    encoder_pending_samples.clear();
-
     encoder_sent_video_frames = 0;
+    encoder_failed = false;
+
+    svr_handoff_reset_stats(&encoder_handoff);
 
     ret = true;
     goto rexit;
@@ -290,18 +289,39 @@ bool ProcState::encoder_set_shared_mem_params()
     params->video_fps = movie_profile.video_fps;
     params->video_width = movie_width;
     params->video_height = movie_height;
+    params->output_width = movie_output_width;
+    params->output_height = movie_output_height;
     params->audio_channels = svr_audio_params.audio_channels;
     params->audio_hz = svr_audio_params.audio_hz;
     params->audio_bits = svr_audio_params.audio_bits;
+    params->video_threads = movie_profile.video_threads;
+    params->video_queue_depth = movie_profile.video_queue_depth;
+    params->cpu_encoder_mask = cpu_layout.encoder_mask;
     params->x264_crf = movie_profile.video_x264_crf;
     params->x264_intra = movie_profile.video_x264_intra;
+    params->x265_crf = movie_profile.video_x265_crf;
+    params->svtav1_crf = movie_profile.video_svtav1_crf;
+    params->svtav1_preset = movie_profile.video_svtav1_preset;
     params->use_audio = movie_profile.audio_enabled;
+    params->use_fragmented = movie_profile.video_fragmented;
+    params->use_spool = movie_profile.video_spool;
+    params->record_session = movie_profile.debug_record_session;
+    params->segment_seconds = movie_profile.video_segment_seconds;
+    params->segment_mb = movie_profile.video_segment_mb;
+    params->preview_interval = movie_profile.preview_interval;
+    params->preview_width = movie_profile.preview_width;
+    params->resume = movie_resume;
+    params->expected_seconds = movie_expected_seconds;
 
     SVR_COPY_STRING(movie_path, params->dest_file);
     SVR_COPY_STRING(movie_profile.video_encoder, params->video_encoder);
     SVR_COPY_STRING(movie_profile.video_x264_preset, params->x264_preset);
     SVR_COPY_STRING(movie_profile.video_dnxhr_profile, params->dnxhr_profile);
+    SVR_COPY_STRING(movie_profile.video_x265_preset, params->x265_preset);
+    SVR_COPY_STRING(movie_profile.video_prores_profile, params->prores_profile);
+    SVR_COPY_STRING(movie_profile.video_scale_filter, params->scale_filter);
     SVR_COPY_STRING(movie_profile.audio_encoder, params->audio_encoder);
+    SVR_COPY_STRING(movie_profile.video_pipe, params->pipe_target);
 
     // Must duplicate the handle for the encoder to be able to open it.
     // Doesn't matter if you specify to inherit handles when creating the DXGI handle.
@@ -403,6 +423,20 @@ void ProcState::encoder_end()
     }
 
     encoder_send_event(ENCODER_EVENT_STOP);
+
+    // If this is low, the encoder usually takes too long to be worth spinning for.
+    svr_log("Encoder answered %.1f%% of the events while spinning (%lld spun, %lld slept)\n", svr_handoff_get_spin_ratio(&encoder_handoff), encoder_handoff.num_spun, encoder_handoff.num_blocked);
+}
+
+// The encoder writes the end of the file in the background after the stop event, and can still fail there.
+bool ProcState::encoder_wait_for_finalize()
+{
+    if (encoder_proc == NULL)
+    {
+        return false;
+    }
+
+    return encoder_send_event(ENCODER_EVENT_FINALIZE);
 }
 
 // Call this to resume svr_encoder from a known state.
@@ -415,46 +449,30 @@ bool ProcState::encoder_send_event(EncoderSharedEvent event)
 {
     encoder_shared_ptr->event_type = event;
 
-    SetEvent(encoder_wake_event_h); // Let svr_encoder wake up and handle the event.
+    svr_handoff_signal(&encoder_handoff, &encoder_shared_ptr->game_to_encoder, encoder_wake_event_h); // Let svr_encoder wake up and handle the event.
 
     // Block the calling thread until the event has been processed by svr_encoder.
     // We need to do this to ensure the audio and video data access doesn't suffer from any race condition.
-    // All the event handling is short and fast so this is a very short wait.
+    // All the event handling is short and fast so this is a very short wait, which is why we spin for a bit before sleeping.
     // When this returns, svr_encoder will be paused and in a known state waiting to be woken up again.
     // This call also makes synchronization easier in this process.
 
-    HANDLE handles[] =
-    {
-        encoder_proc,
-        encoder_game_wake_event_h,
-    };
-
-    DWORD waited = WaitForMultipleObjects(SVR_ARRAY_SIZE(handles), handles, FALSE, INFINITE);
-
-    if (waited == WAIT_FAILED)
-    {
-        return false;
-    }
-
-    HANDLE waited_h = handles[waited - WAIT_OBJECT_0];
-
     // Encoder exited or crashed or something.
-    if (waited_h == encoder_proc)
+    if (!svr_handoff_wait(&encoder_handoff, &encoder_shared_ptr->encoder_to_game, encoder_game_wake_event_h, encoder_proc))
     {
         svr_console_msg_and_log("Encoder exited or crashed\n");
+        encoder_failed = true;
         return false;
     }
 
-    if (waited_h == encoder_game_wake_event_h)
+    if (encoder_shared_ptr->error)
     {
-        if (encoder_shared_ptr->error)
-        {
-            // Any error in svr_encoder is written to its log.
-            // We also want to log the error in the console and in our log.
-            svr_console_msg_and_log(encoder_shared_ptr->error_message);
-            svr_console_msg_and_log("See encoder_log.txt for more information\n");
-            return false;
-        }
+        // Any error in svr_encoder is written to its log.
+        // We also want to log the error in the console and in our log.
+        svr_console_msg_and_log(encoder_shared_ptr->error_message);
+        svr_console_msg_and_log("See encoder_log.txt for more information\n");
+        encoder_failed = true;
+        return false;
     }
 
     return true;
@@ -466,7 +484,11 @@ bool ProcState::encoder_send_shared_tex()
 
     encoder_share_tex_lock->ReleaseSync(ENCODER_PROC_ID); // Allow encoder to read.
 
-    if (!encoder_send_event(ENCODER_EVENT_NEW_VIDEO))
+    encoder_shared_ptr->demo_tick = movie_demo_tick;
+
+    // The audio since the last frame is already waiting in the shared memory and is sent together with the frame,
+    // so every frame is only one event.
+    if (!encoder_send_event(ENCODER_EVENT_NEW_FRAME))
     {
         goto rfail;
     }
@@ -479,22 +501,40 @@ bool ProcState::encoder_send_shared_tex()
 rfail:
 
 rexit:
+    encoder_shared_ptr->waiting_audio_samples = 0;
     encoder_share_tex_lock->AcquireSync(ENCODER_GAME_ID, INFINITE); // Give back to us now.
     return ret;
 }
 
 bool ProcState::encoder_send_audio_samples(SvrWaveSample* samples, s32 num_samples)
 {
+    bool ret = false;
+
     // During motion blur capture, we will be getting really low number of samples in here (like 12).
     // This is way too little to wake up the encoder for and block the game.
-    // Queue up a larger amount and send that instead.
-    encoder_pending_samples.push_range(samples, num_samples);
+    // Write them straight to the shared memory and send them together with the next video frame instead.
+    while (num_samples > 0)
+    {
+        s32 num_waiting = encoder_shared_ptr->waiting_audio_samples;
 
-    bool ret = false;
+        // There can be more audio between two frames than fits in the shared memory with very low frame rates.
+        if (num_waiting == ENCODER_MAX_SHARED_SAMPLES)
+        {
+            if (!encoder_send_waiting_audio())
+            {
+                goto rfail;
+            }
 
-    if (!encoder_submit_pending_samples())
-    {
-        goto rfail;
+            continue;
+        }
+
+        s32 num_to_write = svr_min(num_samples, ENCODER_MAX_SHARED_SAMPLES - num_waiting);
+
+        memcpy((SvrWaveSample*)encoder_audio_buffer + num_waiting, samples, sizeof(SvrWaveSample) * num_to_write);
+        encoder_shared_ptr->waiting_audio_samples += num_to_write;
+
+        samples += num_to_write;
+        num_samples -= num_to_write;
     }
 
     ret = true;
@@ -509,51 +549,17 @@ rexit:
 // Send any remaining samples just before the rendering stops.
 void ProcState::encoder_flush_audio()
 {
-    while (encoder_pending_samples.size() > 0)
+    if (encoder_shared_ptr->waiting_audio_samples > 0)
     {
-        s32 samples_to_write = svr_min(encoder_pending_samples.size(), ENCODER_MAX_SAMPLES);
-
-        if (!encoder_send_audio_from_pending(samples_to_write))
-        {
-            break;
-        }
+        encoder_send_waiting_audio();
     }
 }
 
-// Send full batches of audio.
-bool ProcState::encoder_submit_pending_samples()
+// Send the audio waiting in the shared memory without a video frame.
+bool ProcState::encoder_send_waiting_audio()
 {
     bool ret = false;
 
-    while (encoder_pending_samples.size() >= ENCODER_MAX_SAMPLES)
-    {
-        s32 samples_to_write = ENCODER_MAX_SAMPLES;
-
-        if (!encoder_send_audio_from_pending(samples_to_write))
-        {
-            goto rfail;
-        }
-    }
-
-    ret = true;
-    goto rexit;
-
-rfail:
-
-rexit:
-    return ret;
-}
-
-// Shared code between encoder_submit_pending_samples and encoder_flush_audio.
-bool ProcState::encoder_send_audio_from_pending(s32 num_samples)
-{
-    bool ret = false;
-
-    assert(encoder_pending_samples.size() >= num_samples);
-
-    encoder_pending_samples.pull_range((SvrWaveSample*)encoder_audio_buffer, num_samples);
-    encoder_shared_ptr->waiting_audio_samples = num_samples;
-
     if (!encoder_send_event(ENCODER_EVENT_NEW_AUDIO))
     {
         goto rfail;
@@ -565,6 +571,7 @@ bool ProcState::encoder_send_audio_from_pending(s32 num_samples)
 rfail:
 
 rexit:
+    encoder_shared_ptr->waiting_audio_samples = 0;
     return ret;
 }
 
@@ -1,8 +1,5 @@
 #include "proc_priv.h"
 
-// Any weight less than this is not productive to spin up the pipeline for.
-const float MOSAMPLE_MIN_WEIGHT = 1.0f / 255.0f;
-
 struct __declspec(align(16)) MosampleCb
 {
     float mosample_weight;
@@ -89,6 +86,23 @@ bool ProcState::mosample_create_textures()
     bool ret = false;
     HRESULT hr;
 
+    // Reuse the work texture from the previous movie if it has the same size.
+    if (mosample_work_tex)
+    {
+        D3D11_TEXTURE2D_DESC cur_desc;
+        mosample_work_tex->GetDesc(&cur_desc);
+
+        if (cur_desc.Width == movie_width && cur_desc.Height == movie_height)
+        {
+            vid_clear_rtv(mosample_work_tex_rtv, 0.0f, 0.0f, 0.0f, 1.0f);
+
+            ret = true;
+            goto rexit;
+        }
+
+        mosample_free_textures();
+    }
+
     D3D11_TEXTURE2D_DESC tex_desc = {};
     tex_desc.Width = movie_width;
     tex_desc.Height = movie_height;
@@ -128,9 +142,16 @@ void ProcState::mosample_free_static()
     svr_maybe_release(&mosample_cs);
     svr_maybe_release(&mosample_downsample_cs);
     svr_maybe_release(&mosample_cb);
+
+    mosample_free_textures();
 }
 
 void ProcState::mosample_free_dynamic()
+{
+    // The work texture is kept for the next movie, see mosample_create_textures.
+}
+
+void ProcState::mosample_free_textures()
 {
     svr_maybe_release(&mosample_work_tex);
     svr_maybe_release(&mosample_work_tex_rtv);
@@ -147,10 +168,7 @@ bool ProcState::mosample_start()
         goto rfail;
     }
 
-    mosample_remainder = 0.0f;
-
-    s32 sps = movie_profile.video_fps * movie_profile.mosample_mult;
-    mosample_remainder_step = (1.0f / sps) / (1.0f / movie_profile.video_fps);
+    svr_mosample_start(&mosample_state, movie_profile.video_fps, movie_profile.mosample_mult, movie_profile.mosample_exposure, movie_profile.mosample_skip_closed);
 
     ret = true;
     goto rexit;
@@ -170,7 +188,7 @@ void ProcState::mosample_process(float weight)
 {
     // Very small weights will not have any noticable impact on the resulting image.
     // It is not needed to load the pipeline up for this.
-    if (weight < MOSAMPLE_MIN_WEIGHT)
+    if (weight < SVR_MOSAMPLE_MIN_WEIGHT)
     {
         return;
     }
@@ -202,54 +220,32 @@ void ProcState::mosample_process(float weight)
 
 void ProcState::mosample_new_video_frame()
 {
-    float old_rem = mosample_remainder;
-    float exposure = movie_profile.mosample_exposure;
+    SvrMosampleFrame frame = svr_mosample_frame(&mosample_state);
 
-    mosample_remainder += mosample_remainder_step;
+    mosample_process(frame.weight);
 
-    if (mosample_remainder <= (1.0f - exposure))
+    if (frame.num_finished == 0)
     {
+        return;
     }
 
-    else if (mosample_remainder < 1.0f)
-    {
-        float weight = (mosample_remainder - svr_max(1.0f - exposure, old_rem)) * (1.0f / exposure);
-        mosample_process(weight);
-    }
+    mosample_downsample_to_share_tex();
 
-    else
+    // A game frame that is longer than a video frame gives the same image to all of them.
+    for (s32 i = 0; i < frame.num_finished; i++)
     {
-        float weight = (1.0f - svr_max(1.0f - exposure, old_rem)) * (1.0f / exposure);
-
-        mosample_process(weight);
-
-        mosample_downsample_to_share_tex();
-
         process_finished_shared_tex();
+    }
 
-        mosample_remainder -= 1.0f;
-
-        s32 additional = mosample_remainder;
-
-        if (additional > 0)
-        {
-            for (s32 i = 0; i < additional; i++)
-            {
-                process_finished_shared_tex();
-            }
-
-            mosample_remainder -= additional;
-        }
+    // Black is the only color that will work here, because the motion sampling is additive.
+    vid_clear_rtv(mosample_work_tex_rtv, 0.0f, 0.0f, 0.0f, 1.0f);
 
-        // Black is the only color that will work here, because the motion sampling is additive.
-        vid_clear_rtv(mosample_work_tex_rtv, 0.0f, 0.0f, 0.0f, 1.0f);
+    mosample_process(frame.next_weight);
+}
 
-        if (mosample_remainder > MOSAMPLE_MIN_WEIGHT && mosample_remainder > (1.0f - exposure))
-        {
-            weight = ((mosample_remainder - (1.0f - exposure)) * (1.0f / exposure));
-            mosample_process(weight);
-        }
-    }
+s32 ProcState::mosample_get_next_frame_length()
+{
+    return svr_mosample_next_frame_length(&mosample_state);
 }
 
 // Downsample 128 bpp texture to 32 bpp texture.
@@ -16,6 +16,8 @@
 #include <assert.h>
 #include <intrin.h>
 #include "svr_prof.h"
+#include "svr_cpu.h"
+#include "svr_mosample.h"
 #include <stb_sprintf.h>
 #include <stb_image.h>
 #include "svr_api.h"
@@ -43,25 +43,41 @@ OptStrIntMapping VELO_LENGTH_TABLE[] =
     OptStrIntMapping { "z", PROC_VELO_LENGTH_Z },
 };
 
+#define PROC_VIDEO_ENCODER_NAME(ID, NAME, CONTAINERS) NAME,
+#define PROC_VIDEO_ENCODER_CONTAINERS(ID, NAME, CONTAINERS) CONTAINERS,
+
 // Names for ini.
-// Should be synchronized with encoder_render.cpp.
+// Comes from the list in encoder_shared.h.
 const char* VIDEO_ENCODER_TABLE[] =
 {
-    "libx264",
-    "libx264_444",
-    "dnxhr",
+    ENCODER_VIDEO_ENCODERS(PROC_VIDEO_ENCODER_NAME)
+};
+
+// Containers that can be used with the encoder in VIDEO_ENCODER_TABLE at the same index.
+const char* VIDEO_ENCODER_CONTAINERS_TABLE[] =
+{
+    ENCODER_VIDEO_ENCODERS(PROC_VIDEO_ENCODER_CONTAINERS)
 };
 
+#undef PROC_VIDEO_ENCODER_NAME
+#undef PROC_VIDEO_ENCODER_CONTAINERS
+
+#define PROC_AUDIO_ENCODER_NAME(ID, NAME) NAME,
+
 // Names for ini.
-// Should be synchronized with encoder_render.cpp.
+// Comes from the list in encoder_shared.h.
 const char* AUDIO_ENCODER_TABLE[] =
 {
-    "aac",
+    ENCODER_AUDIO_ENCODERS(PROC_AUDIO_ENCODER_NAME)
 };
 
+#undef PROC_AUDIO_ENCODER_NAME
+
 // Names for ini and ffmpeg.
+// The auto preset is replaced with the tuned preset when the movie starts.
 const char* X264_PRESET_TABLE[] =
 {
+    "auto",
     "ultrafast",
     "superfast",
     "veryfast",
@@ -73,6 +89,29 @@ const char* X264_PRESET_TABLE[] =
     "veryslow",
 };
 
+// Names for ini and ffmpeg.
+const char* X265_PRESET_TABLE[] =
+{
+    "ultrafast",
+    "superfast",
+    "veryfast",
+    "faster",
+    "fast",
+    "medium",
+    "slow",
+    "slower",
+    "veryslow",
+};
+
+// Names for ini and ffmpeg.
+const char* PRORES_PROFILE_TABLE[] =
+{
+    "proxy",
+    "lt",
+    "standard",
+    "hq",
+};
+
 // Names for ini.
 // Should be synchronized with encoder_render.cpp.
 const char* DNXHR_PROFILE_TABLE[] =
@@ -82,6 +121,17 @@ const char* DNXHR_PROFILE_TABLE[] =
     "hq",
 };
 
+#define PROC_SCALE_FILTER_NAME(ID, NAME) NAME,
+
+// Names for ini.
+// Comes from the list in encoder_shared.h.
+const char* SCALE_FILTER_TABLE[] =
+{
+    ENCODER_SCALE_FILTERS(PROC_SCALE_FILTER_NAME)
+};
+
+#undef PROC_SCALE_FILTER_NAME
+
 bool ProcState::movie_init()
 {
     return true;
@@ -113,6 +163,113 @@ void ProcState::movie_setup_params()
     movie_height = tex_desc.Height;
 }
 
+// The movie can be encoded at a lower resolution than the game is rendering at.
+// This is used to supersample the game, such as rendering at 4K and encoding at 1080p.
+bool ProcState::movie_setup_output_size()
+{
+    bool ret = false;
+
+    movie_output_width = movie_width;
+    movie_output_height = movie_height;
+
+    if (movie_profile.video_width == 0 && movie_profile.video_height == 0)
+    {
+        ret = true;
+        goto rexit;
+    }
+
+    if (movie_profile.video_width == 0 || movie_profile.video_height == 0)
+    {
+        svr_console_msg_and_log("ERROR: Both video_width and video_height must be set to use a different movie resolution\n");
+        goto rfail;
+    }
+
+    if (movie_profile.video_width > movie_width || movie_profile.video_height > movie_height)
+    {
+        svr_console_msg_and_log("ERROR: The movie resolution (%dx%d) cannot be larger than the game resolution (%dx%d)\n", movie_profile.video_width, movie_profile.video_height, movie_width, movie_height);
+        goto rfail;
+    }
+
+    // Chroma planes are half size for some pixel formats.
+    if ((movie_profile.video_width & 1) || (movie_profile.video_height & 1))
+    {
+        svr_console_msg_and_log("ERROR: The movie resolution (%dx%d) must be a multiple of 2\n", movie_profile.video_width, movie_profile.video_height);
+        goto rfail;
+    }
+
+    movie_output_width = movie_profile.video_width;
+    movie_output_height = movie_profile.video_height;
+
+    ret = true;
+    goto rexit;
+
+rfail:
+rexit:
+    return ret;
+}
+
+// Not all video encoders can be written to all containers, so check this before anything is started.
+bool ProcState::movie_check_container()
+{
+    const char* ext = strrchr(movie_path, '.');
+
+    // The encoder will say that there is no container.
+    if (ext == NULL)
+    {
+        return true;
+    }
+
+    ext++;
+
+    for (s32 i = 0; i < SVR_ARRAY_SIZE(VIDEO_ENCODER_TABLE); i++)
+    {
+        if (strcmp(VIDEO_ENCODER_TABLE[i], movie_profile.video_encoder))
+        {
+            continue;
+        }
+
+        if (!encoder_has_container(VIDEO_ENCODER_CONTAINERS_TABLE[i], ext))
+        {
+            svr_console_msg_and_log("ERROR: Video encoder %s cannot be used with %s. Use one of: %s\n", movie_profile.video_encoder, ext, VIDEO_ENCODER_CONTAINERS_TABLE[i]);
+            return false;
+        }
+
+        break;
+    }
+
+    // Spool files are encoded in chunks that are put together afterwards, which cannot be done with image sequences.
+    if (movie_profile.video_spool && encoder_has_container("png tif tiff exr", ext))
+    {
+        svr_console_msg_and_log("ERROR: Image sequences cannot be used with video_spool\n");
+        return false;
+    }
+
+    // Spool files are encoded afterwards, when there is nothing to pipe to anymore.
+    if (movie_profile.video_spool && movie_profile.video_pipe[0])
+    {
+        svr_console_msg_and_log("ERROR: video_pipe cannot be used with video_spool\n");
+        return false;
+    }
+
+    bool use_segments = movie_profile.video_segment_seconds > 0 || movie_profile.video_segment_mb > 0;
+
+    // Spool chunks and pipes are joined or read as one continuous movie.
+    if (use_segments && (movie_profile.video_spool || movie_profile.video_pipe[0]))
+    {
+        svr_console_msg_and_log("ERROR: video_segment_seconds and video_segment_mb cannot be used with video_spool or video_pipe\n");
+        return false;
+    }
+
+    // Only whole segments are kept when resuming.
+    if (movie_resume && !use_segments)
+    {
+        svr_console_msg_and_log("ERROR: Resuming a movie needs video_segment_seconds or video_segment_mb\n");
+        return false;
+    }
+
+    return true;
+}
+
 void ProcState::movie_setup_default_profile()
 {
     movie_profile = {};
@@ -123,6 +280,18 @@ void ProcState::movie_setup_default_profile()
     movie_profile.video_x264_preset = "ultrafast";
     movie_profile.video_x264_intra = 0;
     movie_profile.video_dnxhr_profile = "hq";
+    movie_profile.video_x265_crf = 20;
+    movie_profile.video_x265_preset = "ultrafast";
+    movie_profile.video_svtav1_crf = 30;
+    movie_profile.video_svtav1_preset = 10;
+    movie_profile.video_prores_profile = "hq";
+    movie_profile.video_width = 0;
+    movie_profile.video_height = 0;
+    movie_profile.video_scale_filter = "lanczos";
+    movie_profile.video_fragmented = 0;
+    movie_profile.video_spool = 0;
+    movie_profile.video_threads = 0;
+    movie_profile.video_queue_depth = 16;
 
     movie_profile.audio_enabled = 0;
     movie_profile.audio_encoder = "aac";
@@ -132,6 +301,7 @@ void ProcState::movie_setup_default_profile()
     movie_profile.mosample_enabled = 0;
     movie_profile.mosample_mult = 60;
     movie_profile.mosample_exposure = 0.5f;
+    movie_profile.mosample_skip_closed = 0;
 
     movie_profile.velo_enabled = 0;
     SVR_COPY_STRING("Segoe UI", movie_profile.velo_font);
@@ -150,6 +320,13 @@ void ProcState::movie_setup_default_profile()
     movie_profile.input_scale = 100;
     movie_profile.input_active_color = { 200, 200, 200, 255 };
     movie_profile.input_inactive_color = { 50, 50, 50, 255 };
+
+    movie_profile.preview_interval = 0;
+    movie_profile.preview_width = 480;
+
+    movie_profile.cpu_game_cores = 0;
+
+    movie_profile.debug_record_session = 0;
 }
 
 bool ProcState::movie_load_profile(const char* name)
@@ -175,6 +352,21 @@ bool ProcState::movie_load_profile(const char* name)
     ret &= OPT_STR_LIST(&ini_root, "video_x264_preset", X264_PRESET_TABLE, &movie_profile.video_x264_preset);
     ret &= OPT_BOOL(&ini_root, "video_x264_intra", &movie_profile.video_x264_intra);
     ret &= OPT_STR_LIST(&ini_root, "video_dnxhr_profile", DNXHR_PROFILE_TABLE, &movie_profile.video_dnxhr_profile);
+    ret &= OPT_S32(&ini_root, "video_x265_crf", 0, 51, &movie_profile.video_x265_crf);
+    ret &= OPT_STR_LIST(&ini_root, "video_x265_preset", X265_PRESET_TABLE, &movie_profile.video_x265_preset);
+    ret &= OPT_S32(&ini_root, "video_svtav1_crf", 1, 63, &movie_profile.video_svtav1_crf);
+    ret &= OPT_S32(&ini_root, "video_svtav1_preset", 0, 13, &movie_profile.video_svtav1_preset);
+    ret &= OPT_STR_LIST(&ini_root, "video_prores_profile", PRORES_PROFILE_TABLE, &movie_profile.video_prores_profile);
+    ret &= OPT_S32(&ini_root, "video_width", 0, 16384, &movie_profile.video_width);
+    ret &= OPT_S32(&ini_root, "video_height", 0, 16384, &movie_profile.video_height);
+    ret &= OPT_STR_LIST(&ini_root, "video_scale_filter", SCALE_FILTER_TABLE, &movie_profile.video_scale_filter);
+    ret &= OPT_BOOL(&ini_root, "video_fragmented", &movie_profile.video_fragmented);
+    ret &= OPT_BOOL(&ini_root, "video_spool", &movie_profile.video_spool);
+    ret &= OPT_S32(&ini_root, "video_threads", 0, 256, &movie_profile.video_threads);
+    ret &= OPT_S32(&ini_root, "video_queue_depth", 2, 16, &movie_profile.video_queue_depth);
+    ret &= OPT_STR(&ini_root, "video_pipe", movie_profile.video_pipe);
+    ret &= OPT_S32(&ini_root, "video_segment_seconds", 0, 86400, &movie_profile.video_segment_seconds);
+    ret &= OPT_S32(&ini_root, "video_segment_mb", 0, 1048576, &movie_profile.video_segment_mb);
     ret &= OPT_BOOL(&ini_root, "audio_enabled", &movie_profile.audio_enabled);
     ret &= OPT_STR_LIST(&ini_root, "audio_encoder", AUDIO_ENCODER_TABLE, &movie_profile.audio_encoder);
 
@@ -183,6 +375,7 @@ bool ProcState::movie_load_profile(const char* name)
     ret &= OPT_BOOL(&ini_root, "motion_blur_enabled", &movie_profile.mosample_enabled);
     ret &= OPT_S32(&ini_root, "motion_blur_fps_mult", 2, INT32_MAX, &movie_profile.mosample_mult);
     ret &= OPT_FLOAT(&ini_root, "motion_blur_exposure", 0.0f, 1.0f, &movie_profile.mosample_exposure);
+    ret &= OPT_BOOL(&ini_root, "motion_blur_skip_closed", &movie_profile.mosample_skip_closed);
 
     ret &= OPT_BOOL(&ini_root, "velo_enabled", &movie_profile.velo_enabled);
     ret &= OPT_STR(&ini_root, "velo_font", movie_profile.velo_font);
@@ -202,6 +395,13 @@ bool ProcState::movie_load_profile(const char* name)
     ret &= OPT_COLOR(&ini_root, "input_inactive_color", &movie_profile.input_inactive_color);
     ret &= OPT_S32(&ini_root, "input_scale", 50, 500, &movie_profile.input_scale);
 
+    ret &= OPT_S32(&ini_root, "preview_interval", 0, 1000, &movie_profile.preview_interval);
+    ret &= OPT_S32(&ini_root, "preview_width", 64, 1920, &movie_profile.preview_width);
+
+    ret &= OPT_S32(&ini_root, "cpu_game_cores", 0, 16, &movie_profile.cpu_game_cores);
+
+    ret &= OPT_BOOL(&ini_root, "debug_record_session", &movie_profile.debug_record_session);
+
     ret = true;
     goto rexit;
 
@@ -110,13 +110,19 @@ void ProcState::process_finished_shared_tex()
     }
 }
 
-bool ProcState::start(const char* dest_file, const char* profile, ProcGameTexture* game_texture, SvrAudioParams* audio_params)
+bool ProcState::start(const char* dest_file, const char* profile, ProcGameTexture* game_texture, SvrAudioParams* audio_params, bool resume, s32 expected_seconds)
 {
     bool ret = false;
 
+    s64 start_time = svr_prof_get_real_time();
+
     svr_game_texture = *game_texture;
     svr_audio_params = *audio_params;
 
+    movie_resume = resume;
+    movie_expected_seconds = expected_seconds;
+    movie_demo_tick = -1;
+
     // Build output video path.
 
     SVR_SNPRINTF(movie_path, "%s\\movies\\", svr_resource_path);
@@ -142,6 +148,26 @@ bool ProcState::start(const char* dest_file, const char* profile, ProcGameTextur
         }
     }
 
+    // The auto preset uses the settings that svr_encoder --tune found to be best for this computer.
+    if (!strcmp(movie_profile.video_x264_preset, "auto"))
+    {
+        if (!movie_load_profile("tuned") || !strcmp(movie_profile.video_x264_preset, "auto"))
+        {
+            svr_console_msg_and_log("ERROR: The auto x264 preset needs the tuned profile. Run svr_encoder.exe --tune to create it\n");
+            goto rfail;
+        }
+    }
+
+    if (!movie_setup_output_size())
+    {
+        goto rfail;
+    }
+
+    if (!movie_check_container())
+    {
+        goto rfail;
+    }
+
     if (!vid_start())
     {
         goto rfail;
@@ -162,6 +188,12 @@ bool ProcState::start(const char* dest_file, const char* profile, ProcGameTextur
         goto rfail;
     }
 
+    // Must be done before the encoder is started so it knows which processors it can use.
+    if (!cpu_start())
+    {
+        goto rfail;
+    }
+
     if (!encoder_start())
     {
         goto rfail;
@@ -174,6 +206,8 @@ bool ProcState::start(const char* dest_file, const char* profile, ProcGameTextur
 
     setup_lag_compensation();
 
+    svr_log("Movie started in %.2f ms\n", (svr_prof_get_real_time() - start_time) / 1000.0);
+
     ret = true;
     goto rexit;
 
@@ -191,6 +225,7 @@ void ProcState::end()
     velo_end();
     input_end();
     vid_end();
+    cpu_end();
 
     free_dynamic();
 }
@@ -213,6 +248,7 @@ void ProcState::free_dynamic()
     velo_free_dynamic();
     input_free_dynamic();
     vid_free_dynamic();
+    cpu_free_dynamic();
 
     svr_game_texture = {};
 }
@@ -227,9 +263,68 @@ s32 ProcState::get_game_rate()
     return movie_profile.video_fps;
 }
 
+s32 ProcState::get_next_frame_length()
+{
+    if (movie_profile.mosample_enabled)
+    {
+        return mosample_get_next_frame_length();
+    }
+
+    return 1;
+}
+
 void ProcState::setup_lag_compensation()
 {
     movie_lagcomp_frame_time = 1.0f / (float)movie_profile.video_fps;
     movie_lagcomp_queued_time = 0.0f;
     movie_lagcomp_interp = movie_profile.lagcomp_override;
 }
+
+void ProcState::movie_give_demo_tick(s32 tick)
+{
+    movie_demo_tick = tick;
+}
+
+// Reads the checkpoint that svr_encoder writes next to segmented movies.
+bool ProcState::movie_get_resume_point(const char* dest_file, s32* demo_tick, s64* video_frame)
+{
+    bool ret = false;
+
+    SvrIniSection ini_root = {};
+    SvrIniKeyValue* tick_kv = NULL;
+    SvrIniKeyValue* frame_kv = NULL;
+
+    // A movie named shot.mp4 has its checkpoint in shot.svrresume.
+    const char* ext = strrchr(dest_file, '.');
+    s32 name_len = ext ? (s32)(ext - dest_file) : (s32)strlen(dest_file);
+
+    char path[MAX_PATH];
+    SVR_SNPRINTF(path, "%s\\movies\\%.*s." ENCODER_CHECKPOINT_EXT, svr_resource_path, name_len, dest_file);
+
+    if (!svr_ini_load(path, &ini_root))
+    {
+        svr_console_msg_and_log("ERROR: Movie %s has no checkpoint to resume from\n", dest_file);
+        goto rfail;
+    }
+
+    tick_kv = svr_ini_section_find_kv(&ini_root, "demo_tick");
+    frame_kv = svr_ini_section_find_kv(&ini_root, "video_frame");
+
+    if (tick_kv == NULL || frame_kv == NULL)
+    {
+        svr_console_msg_and_log("ERROR: Checkpoint %s is damaged\n", path);
+        goto rfail;
+    }
+
+    *demo_tick = atoi(tick_kv->value);
+    *video_frame = _atoi64(frame_kv->value);
+
+    ret = true;
+    goto rexit;
+
+rfail:
+
+rexit:
+    svr_ini_free(&ini_root);
+    return ret;
+}
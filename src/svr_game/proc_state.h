@@ -35,10 +35,25 @@ struct MovieProfile
     const char* video_encoder;
     const char* video_x264_preset;
     const char* video_dnxhr_profile;
+    const char* video_x265_preset;
+    const char* video_prores_profile;
     const char* audio_encoder;
+    const char* video_scale_filter;
     s32 video_fps;
+    s32 video_width; // 0 to use the game resolution.
+    s32 video_height; // 0 to use the game resolution.
     s32 video_x264_crf;
     s32 video_x264_intra;
+    s32 video_x265_crf;
+    s32 video_svtav1_crf;
+    s32 video_svtav1_preset;
+    s32 video_fragmented;
+    s32 video_spool;
+    s32 video_threads;
+    s32 video_queue_depth;
+    char video_pipe[ENCODER_MAX_PIPE_TARGET]; // Command or named pipe to write the movie to instead of the file. Empty to write the file.
+    s32 video_segment_seconds; // Split the movie into files of this length. 0 to not split on length.
+    s32 video_segment_mb; // Split the movie into files of this size. 0 to not split on size.
     s32 audio_enabled;
 
     // Interpolation latency compensation:
@@ -48,6 +63,7 @@ struct MovieProfile
     s32 mosample_enabled;
     s32 mosample_mult;
     float mosample_exposure;
+    s32 mosample_skip_closed;
 
     // Velo options:
     s32 velo_enabled;
@@ -68,6 +84,16 @@ struct MovieProfile
     SvrVec4I input_active_color;
     SvrVec4I input_inactive_color;
     s32 input_scale;
+
+    // Preview options:
+    s32 preview_interval; // 0 to not publish a preview.
+    s32 preview_width;
+
+    // CPU options:
+    s32 cpu_game_cores; // 0 to not reserve any cores.
+
+    // Debug options:
+    s32 debug_record_session;
 };
 
 struct ProcShader
@@ -96,7 +122,7 @@ struct ProcState
     SvrAudioParams svr_audio_params;
 
     bool init(const char* in_resource_path, ID3D11Device* in_d3d11_device);
-    bool start(const char* dest_file, const char* profile, ProcGameTexture* game_texture, SvrAudioParams* audio_params);
+    bool start(const char* dest_file, const char* profile, ProcGameTexture* game_texture, SvrAudioParams* audio_params, bool resume, s32 expected_seconds);
     void new_video_frame();
     void new_audio_samples(SvrWaveSample* samples, s32 num_samples);
     bool is_velo_enabled();
@@ -107,6 +133,7 @@ struct ProcState
     void free_static();
     void free_dynamic();
     s32 get_game_rate();
+    s32 get_next_frame_length();
 
     void setup_lag_compensation();
 
@@ -228,19 +255,20 @@ struct ProcState
     // To not upload data all the time.
     float mosample_weight_cache;
 
-    float mosample_remainder;
-    float mosample_remainder_step;
+    SvrMosample mosample_state;
 
     bool mosample_init();
     bool mosample_create_buffer();
     bool mosample_create_shaders();
     bool mosample_create_textures();
+    void mosample_free_textures();
     void mosample_free_static();
     void mosample_free_dynamic();
     bool mosample_start();
     void mosample_end();
     void mosample_process(float weight);
     void mosample_new_video_frame();
+    s32 mosample_get_next_frame_length();
     void mosample_downsample_to_share_tex();
 
     // -----------------------------------------------
@@ -254,11 +282,6 @@ struct ProcState
     EncoderSharedMem* encoder_shared_ptr;
     void* encoder_audio_buffer;
 
-    // FIFO of audio samples we need to send to the encoder.
-    // During motion blur capture, the number of samples sent from the game will be very low (like 12).
-    // We should not wake up the encoder and wait for just that little, so queue up a bunch instead and send many.
-    SvrDynQueue<SvrWaveSample> encoder_pending_samples;
-
     // Intermediate texture needed for texture sharing.
     // High precision textures are not allowed to be shared, so we need to downsample the result of the mosample to 32 bpp.
     // This texture is the final result from all prior processing, such as motion blur and velo text.
@@ -270,6 +293,8 @@ struct ProcState
     ID2D1Bitmap1* encoder_d2d1_share_tex; // Not a real texture, but a reference to encoder_share_tex.
     IDXGIKeyedMutex* encoder_share_tex_lock;
     s32 encoder_sent_video_frames;
+    bool encoder_failed; // Set when svr_encoder has failed or exited during the movie.
+    SvrHandoff encoder_handoff; // For waiting on svr_encoder to handle events.
 
     bool encoder_init();
     void encoder_free_static();
@@ -280,20 +305,42 @@ struct ProcState
     bool encoder_create_share_textures();
     bool encoder_set_shared_mem_params();
     void encoder_end();
+    bool encoder_wait_for_finalize();
     bool encoder_send_event(EncoderSharedEvent event);
     bool encoder_send_shared_tex();
     bool encoder_send_audio_samples(SvrWaveSample* samples, s32 num_samples);
     void encoder_flush_audio();
-    bool encoder_submit_pending_samples();
-    bool encoder_send_audio_from_pending(s32 num_samples);
+    bool encoder_send_waiting_audio();
     bool encoder_create_d2d1_bitmap();
 
+    // -----------------------------------------------
+    // CPU state:
+
+    SvrCpuLayout cpu_layout;
+    HANDLE cpu_game_thread; // Only set when cores are reserved for the game.
+    DWORD_PTR cpu_old_game_mask;
+    s32 cpu_old_game_priority;
+
+    // For logging how busy the game thread was.
+    s64 cpu_start_time;
+    s64 cpu_start_thread_time;
+
+    bool cpu_start();
+    void cpu_end();
+    void cpu_free_dynamic();
+    s64 cpu_get_game_thread_time();
+
     // -----------------------------------------------
     // Movie state:
 
-    s32 movie_width;
-    s32 movie_height;
+    s32 movie_width; // Game resolution.
+    s32 movie_height; // Game resolution.
+    s32 movie_output_width; // Resolution of the encoded movie. Can be lower than the game resolution.
+    s32 movie_output_height; // Resolution of the encoded movie. Can be lower than the game resolution.
     char movie_path[MAX_PATH];
+    bool movie_resume; // Continue the movie from its checkpoint.
+    s32 movie_expected_seconds; // Expected length of the movie, or 0 if not known.
+    s32 movie_demo_tick; // Demo tick of the latest frame, or -1 if not given.
 
     MovieProfile movie_profile;
 
@@ -307,8 +354,12 @@ struct ProcState
     bool movie_start();
     void movie_end();
     void movie_setup_params();
+    bool movie_setup_output_size();
+    bool movie_check_container();
     void movie_setup_default_profile();
     bool movie_load_profile(const char* name);
+    void movie_give_demo_tick(s32 tick);
+    bool movie_get_resume_point(const char* dest_file, s32* demo_tick, s64* video_frame);
 
     // -----------------------------------------------
     // Studio state:
@@ -275,7 +275,7 @@ bool svr_start(const char* movie_name, const char* movie_profile, SvrStartMovieD
     game_texture.tex = svr_content_tex;
     game_texture.srv = svr_content_srv;
 
-    if (!proc_state.start(movie_name, movie_profile, &game_texture, &movie_data->audio_params))
+    if (!proc_state.start(movie_name, movie_profile, &game_texture, &movie_data->audio_params, movie_data->resume, movie_data->expected_seconds))
     {
         goto rfail;
     }
@@ -306,6 +306,17 @@ int32_t svr_get_game_rate()
     return proc_state.get_game_rate();
 }
 
+int32_t svr_get_next_frame_length()
+{
+    if (!svr_movie_running)
+    {
+        OutputDebugStringA("SVR (svr_get_next_frame_length): Movie is not started. It is not allowed to call this now\n");
+        return 1;
+    }
+
+    return proc_state.get_next_frame_length();
+}
+
 int32_t svr_get_video_frame_rate()
 {
     if (!svr_movie_running)
@@ -368,6 +379,37 @@ void svr_give_buttons(SvrButtons buttons)
     proc_state.input_give(buttons);
 }
 
+void svr_give_demo_tick(int32_t tick)
+{
+    proc_state.movie_give_demo_tick(tick);
+}
+
+bool svr_get_resume_point(const char* movie_name, int32_t* demo_tick, int64_t* video_frame)
+{
+    return proc_state.movie_get_resume_point(movie_name, demo_tick, video_frame);
+}
+
+int64_t svr_get_video_frames()
+{
+    return proc_state.encoder_sent_video_frames;
+}
+
+bool svr_movie_failed()
+{
+    return proc_state.encoder_failed;
+}
+
+bool svr_wait_for_movie()
+{
+    if (svr_movie_running)
+    {
+        OutputDebugStringA("SVR (svr_wait_for_movie): Movie is started. It is not allowed to call this now\n");
+        return false;
+    }
+
+    return proc_state.encoder_wait_for_finalize();
+}
+
 void svr_give_audio(SvrWaveSample* samples, int32_t num_samples)
 {
     proc_state.new_audio_samples(samples, num_samples);
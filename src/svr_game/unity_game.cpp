@@ -8,4 +8,5 @@
 #include "proc_profile.cpp"
 #include "proc_profile_opts.cpp"
 #include "proc_studio.cpp"
+#include "proc_cpu.cpp"
 #include "svr_api.cpp"
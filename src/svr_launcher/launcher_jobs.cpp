@@ -0,0 +1,316 @@
+#include "launcher_priv.h"
+
+// Renders the movies of a job file with several games at the same time.
+// The game thread of one game cannot keep a whole processor busy, so more movies are done at once by running several games, each with its own encoder.
+// Started with svr_launcher <game id> --jobs <job file> [number of games]. The job file is in the same format as for startmovie <job file>.svrbatch.
+// The games take their jobs from a queue in shared memory and take over the jobs of the others when they are done with their own, see svr_jobq.h.
+
+// Estimated work of a job that has no end tick or timeout, in ticks.
+const s64 JOBS_DEFAULT_COST = 20000;
+
+// Ticks per second used to estimate the work of a job with a timeout.
+const s64 JOBS_COST_TICK_RATE = 66;
+
+s32 LauncherState::jobs_run(const char* id, const char* job_file, s32 num_games)
+{
+    LauncherGame* game = find_game(id);
+
+    u32 pid = GetCurrentProcessId();
+
+    jobs_mapping_h = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, sizeof(SvrJobq), svr_va("%s%u", SVR_JOBQ_MAPPING, pid));
+
+    if (jobs_mapping_h == NULL)
+    {
+        DWORD error = GetLastError();
+
+        svr_log("CreateFileMappingA failed with code %lu\n", error);
+        launcher_error("Could not create the job queue.");
+    }
+
+    jobs_queue = (SvrJobq*)MapViewOfFile(jobs_mapping_h, FILE_MAP_READ | FILE_MAP_WRITE, 0, 0, 0);
+
+    if (jobs_queue == NULL)
+    {
+        DWORD error = GetLastError();
+
+        svr_log("MapViewOfFile failed with code %lu\n", error);
+        launcher_error("Could not create the job queue.");
+    }
+
+    jobs_mutex_h = CreateMutexA(NULL, FALSE, svr_va("%s%u", SVR_JOBQ_MUTEX, pid));
+
+    if (jobs_mutex_h == NULL)
+    {
+        DWORD error = GetLastError();
+
+        svr_log("CreateMutexA failed with code %lu\n", error);
+        launcher_error("Could not create the job queue.");
+    }
+
+    if (!jobs_load(job_file))
+    {
+        launcher_error("Could not load job file %s. See svr_log.txt for more information.", job_file);
+    }
+
+    // About one game for every four processors leaves room for the encoders.
+    if (num_games <= 0)
+    {
+        num_games = GetActiveProcessorCount(ALL_PROCESSOR_GROUPS) / 4;
+    }
+
+    svr_clamp(&num_games, 1, svr_min(jobs_queue->num_jobs, SVR_JOBQ_MAX_WORKERS));
+
+    svr_jobq_distribute(jobs_queue, num_games);
+
+    svr_log("Rendering %d jobs from %s with %d games\n", jobs_queue->num_jobs, job_file, num_games);
+
+    HANDLE games[SVR_JOBQ_MAX_WORKERS];
+    s32 game_workers[SVR_JOBQ_MAX_WORKERS];
+    s32 num_running = 0;
+
+    u64 start_time = GetTickCount64();
+
+    for (s32 i = 0; i < num_games; i++)
+    {
+        SvrJobqWorker* worker = &jobs_queue->workers[i];
+        svr_log("Game %d starts with %d jobs\n", i + 1, worker->end - worker->begin);
+
+        games[num_running] = jobs_start_worker(game, i);
+        game_workers[num_running] = i;
+        num_running++;
+    }
+
+    SetEnvironmentVariableA(SVR_JOBQ_WORKER_ENV, NULL);
+
+    // The games quit by themselves when there are no more jobs for them.
+    while (num_running > 0)
+    {
+        DWORD res = WaitForMultipleObjects(num_running, games, FALSE, INFINITE);
+
+        if (res < WAIT_OBJECT_0 || res >= WAIT_OBJECT_0 + num_running)
+        {
+            DWORD error = GetLastError();
+
+            svr_log("WaitForMultipleObjects failed with code %lu\n", error);
+            break;
+        }
+
+        s32 index = res - WAIT_OBJECT_0;
+        s32 worker = game_workers[index];
+
+        // A game that exits with jobs left had to be closed or has crashed. The other games take over its jobs.
+        jobs_lock();
+        svr_jobq_remove_worker(jobs_queue, worker);
+        jobs_unlock();
+
+        svr_log("Game %d has exited\n", worker + 1);
+
+        CloseHandle(games[index]);
+
+        games[index] = games[num_running - 1];
+        game_workers[index] = game_workers[num_running - 1];
+        num_running--;
+
+        // The others take over the jobs of a game that crashes, but not when it was the last game running (or the only one).
+        // Another game is then started for the jobs that are left. Every crash fails the job it was on, and there are only so many workers.
+        if (num_running == 0)
+        {
+            jobs_lock();
+            s32 new_worker = svr_jobq_is_done(jobs_queue) ? -1 : svr_jobq_add_worker(jobs_queue);
+            jobs_unlock();
+
+            if (new_worker != -1)
+            {
+                svr_log("Starting game %d for the jobs that are left\n", new_worker + 1);
+
+                games[num_running] = jobs_start_worker(game, new_worker);
+                game_workers[num_running] = new_worker;
+                num_running++;
+
+                SetEnvironmentVariableA(SVR_JOBQ_WORKER_ENV, NULL);
+            }
+        }
+    }
+
+    jobs_show_results(GetTickCount64() - start_time);
+
+    bool done = svr_jobq_is_done(jobs_queue);
+
+    UnmapViewOfFile(jobs_queue);
+    jobs_queue = NULL;
+
+    svr_maybe_close_handle(&jobs_mapping_h);
+    svr_maybe_close_handle(&jobs_mutex_h);
+
+    return done ? 0 : 1;
+}
+
+// Reads the job file into the queue. The games parse the lines again when they take a job, so only what is needed to spread the jobs is read here.
+bool LauncherState::jobs_load(const char* job_file)
+{
+    bool ret = false;
+    char* file_mem = NULL;
+    char line[SVR_JOBQ_MAX_LINE];
+    const char* prev_str;
+    s32 line_num = 0;
+
+    file_mem = svr_read_file_as_string(job_file, SVR_READ_FILE_FLAGS_NEW_LINE);
+
+    if (file_mem == NULL)
+    {
+        svr_log("Could not open job file %s\n", job_file);
+        goto rfail;
+    }
+
+    prev_str = file_mem;
+
+    while (*prev_str != 0)
+    {
+        prev_str = svr_read_line(prev_str, line, SVR_ARRAY_SIZE(line));
+        line_num++;
+
+        const char* ptr = svr_advance_until_after_whitespace(line);
+
+        // Blanks and comments.
+        if (*ptr == 0 || *ptr == '#' || *ptr == '/')
+        {
+            continue;
+        }
+
+        SvrDynArray<SvrIniKeyValue> inputs = {};
+        svr_ini_parse_command_input(ptr, &inputs);
+
+        const char* opt_demo = svr_ini_find_command_value(&inputs, "demo");
+        const char* opt_output = svr_ini_find_command_value(&inputs, "output");
+        const char* opt_start = svr_ini_find_command_value(&inputs, "start");
+        const char* opt_end = svr_ini_find_command_value(&inputs, "end");
+        const char* opt_timeout = svr_ini_find_command_value(&inputs, "timeout");
+
+        bool valid = opt_demo && opt_output;
+
+        s32 start_tick = opt_start ? atoi(opt_start) : 0;
+        s64 cost = JOBS_DEFAULT_COST;
+
+        if (opt_end)
+        {
+            cost = atoi(opt_end) - start_tick;
+        }
+
+        else if (opt_timeout)
+        {
+            cost = atoi(opt_timeout) * JOBS_COST_TICK_RATE;
+        }
+
+        bool added = valid && svr_jobq_add(jobs_queue, ptr, line_num, opt_demo, start_tick, cost);
+
+        svr_ini_free_kvs(&inputs);
+
+        if (!valid)
+        {
+            svr_log("Job on line %d of %s needs both demo and output\n", line_num, job_file);
+            goto rfail;
+        }
+
+        if (!added)
+        {
+            svr_log("Job file %s has more than %d jobs\n", job_file, SVR_JOBQ_MAX_JOBS);
+            goto rfail;
+        }
+    }
+
+    if (jobs_queue->num_jobs == 0)
+    {
+        svr_log("Job file %s has no jobs\n", job_file);
+        goto rfail;
+    }
+
+    ret = true;
+    goto rexit;
+
+rfail:
+rexit:
+    if (file_mem)
+    {
+        svr_free(file_mem);
+    }
+
+    return ret;
+}
+
+// Starts a game that takes its jobs from the queue as the given worker. Returns the process handle.
+HANDLE LauncherState::jobs_start_worker(LauncherGame* game, s32 worker)
+{
+    // Every game appends to its own log, which the launcher has to create like for one game.
+    char log_path[MAX_PATH];
+    SVR_SNPRINTF(log_path, "%s\\data\\svr_log_%d.txt", working_dir, worker + 1);
+
+    HANDLE log_h = CreateFileA(log_path, GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+
+    if (log_h != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(log_h);
+    }
+
+    // The game finds the queue and its worker index from this, and the encoder it starts inherits it too.
+    SetEnvironmentVariableA(SVR_JOBQ_WORKER_ENV, svr_va("%u %d", GetCurrentProcessId(), worker));
+
+    PROCESS_INFORMATION info;
+    launch_game(game, &info);
+
+    ResumeThread(info.hThread);
+    CloseHandle(info.hThread);
+
+    return info.hProcess;
+}
+
+void LauncherState::jobs_lock()
+{
+    // An abandoned mutex is from a game that has crashed, and the queue is still usable since it is only changed in small steps.
+    WaitForSingleObject(jobs_mutex_h, INFINITE);
+}
+
+void LauncherState::jobs_unlock()
+{
+    ReleaseMutex(jobs_mutex_h);
+}
+
+void LauncherState::jobs_show_results(u64 elapsed_ms)
+{
+    s64 total_frames = 0;
+    s32 num_done = 0;
+
+    svr_log("\n");
+
+    for (s32 i = 0; i < jobs_queue->num_jobs; i++)
+    {
+        SvrJobqJob* job = &jobs_queue->jobs[i];
+
+        if (job->state != SVR_JOBQ_JOB_DONE)
+        {
+            svr_log("    Line %d (%s): not done\n", job->line_num, job->demo);
+            continue;
+        }
+
+        float fps = job->render_secs > 0.0f ? job->num_frames / job->render_secs : 0.0f;
+
+        svr_log("    Line %d (%s): %lld frames in %0.2f seconds (%0.2f fps) by game %d%s\n",
+                job->line_num, job->demo, job->num_frames, job->render_secs, fps, job->worker + 1, job->stolen ? " (taken over)" : "");
+
+        total_frames += job->num_frames;
+        num_done++;
+    }
+
+    svr_log("\n");
+
+    for (s32 i = 0; i < jobs_queue->num_workers; i++)
+    {
+        SvrJobqWorker* worker = &jobs_queue->workers[i];
+        svr_log("    Game %d: %d jobs, took over jobs %d times\n", i + 1, worker->num_done, worker->num_steals);
+    }
+
+    float total_secs = elapsed_ms / 1000.0f;
+    float total_fps = total_secs > 0.0f ? total_frames / total_secs : 0.0f;
+
+    svr_log("\n");
+    svr_log("Finished %d of %d jobs: %lld frames in %0.2f seconds (%0.2f fps)\n", num_done, jobs_queue->num_jobs, total_frames, total_secs, total_fps);
+}
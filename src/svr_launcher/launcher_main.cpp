@@ -20,6 +20,13 @@ int main(int argc, char** argv)
 
     launcher_state.init();
 
+    // Several games can render the movies of a job file together with svr_launcher <game id> --jobs <job file> [number of games].
+    if (argc >= 4 && !strcmp(argv[2], "--jobs"))
+    {
+        s32 num_games = argc >= 5 ? atoi(argv[4]) : 0;
+        return launcher_state.jobs_run(argv[1], argv[3], num_games);
+    }
+
     // Autostarting a game works by giving the game ini.
     if (argc == 2)
     {
@@ -8,6 +8,7 @@
 #include "svr_log.h"
 #include "svr_vdf.h"
 #include "svr_ini.h"
+#include "svr_jobq.h"
 #include "svr_array.h"
 #include <VersionHelpers.h>
 #include <stb_sprintf.h>
@@ -3,7 +3,8 @@
 // Base arguments that every game will have.
 const char* BASE_GAME_ARGS = "-steam -insecure +sv_lan 1 -console -novid -noip";
 
-s32 LauncherState::start_game(LauncherGame* game)
+// Creates the game process with SVR loaded in it. The process is suspended.
+void LauncherState::launch_game(LauncherGame* game, PROCESS_INFORMATION* info)
 {
     // We don't need the game directory necessarily (mods work differently) since we apply the -game parameter.
     // All known Source games will use SetCurrentDirectory to the mod (game) directory anyway.
@@ -24,9 +25,7 @@ s32 LauncherState::start_game(LauncherGame* game)
     STARTUPINFOA start_info = {};
     start_info.cb = sizeof(STARTUPINFOA);
 
-    PROCESS_INFORMATION info;
-
-    if (!CreateProcessA(game->path, full_args, NULL, NULL, FALSE, CREATE_SUSPENDED, NULL, NULL, &start_info, &info))
+    if (!CreateProcessA(game->path, full_args, NULL, NULL, FALSE, CREATE_SUSPENDED, NULL, NULL, &start_info, info))
     {
         DWORD error = GetLastError();
 
@@ -34,7 +33,13 @@ s32 LauncherState::start_game(LauncherGame* game)
         launcher_error("Could not initialize standalone SVR. If you use an antivirus, add exception or disable.");
     }
 
-    ipc_setup_in_remote_process(game, info.hProcess, info.hThread);
+    ipc_setup_in_remote_process(game, info->hProcess, info->hThread);
+}
+
+s32 LauncherState::start_game(LauncherGame* game)
+{
+    PROCESS_INFORMATION info;
+    launch_game(game, &info);
 
     svr_log("Launcher finished, rest of the log is from the game\n");
 
@@ -56,7 +61,7 @@ s32 LauncherState::start_game(LauncherGame* game)
     return 0;
 }
 
-s32 LauncherState::autostart_game(const char* id)
+LauncherGame* LauncherState::find_game(const char* id)
 {
     LauncherGame* found_game = NULL;
 
@@ -76,7 +81,12 @@ s32 LauncherState::autostart_game(const char* id)
         launcher_error("Cannot autostart, no game with id %s was found.", id);
     }
 
-    return start_game(found_game);
+    return found_game;
+}
+
+s32 LauncherState::autostart_game(const char* id)
+{
+    return start_game(find_game(id));
 }
 
 // Load and parse all games.
@@ -23,7 +23,9 @@ struct LauncherState
 
     __declspec(noreturn) void launcher_error(const char* format, ...);
     s32 get_choice_from_user(s32 min, s32 max);
+    void launch_game(LauncherGame* game, PROCESS_INFORMATION* info);
     s32 start_game(LauncherGame* game);
+    LauncherGame* find_game(const char* id);
     s32 autostart_game(const char* id);
     void load_games();
     bool parse_game(const char* file, LauncherGame* dest);
@@ -58,4 +60,19 @@ struct LauncherState
     // IPC state:
 
     void ipc_setup_in_remote_process(LauncherGame* game, HANDLE process, HANDLE thread);
+
+    // -----------------------------------------------
+    // Jobs state:
+
+    // Queue of the job file that the games take their jobs from, see svr_jobq.h.
+    HANDLE jobs_mapping_h;
+    HANDLE jobs_mutex_h;
+    SvrJobq* jobs_queue;
+
+    s32 jobs_run(const char* id, const char* job_file, s32 num_games);
+    bool jobs_load(const char* job_file);
+    HANDLE jobs_start_worker(LauncherGame* game, s32 worker);
+    void jobs_lock();
+    void jobs_unlock();
+    void jobs_show_results(u64 elapsed_ms);
 };
@@ -1,6 +1,7 @@
 #include "launcher_priv.h"
 #include "launcher_main.cpp"
 #include "launcher_ipc.cpp"
+#include "launcher_jobs.cpp"
 #include "launcher_start.cpp"
 #include "launcher_state.cpp"
 #include "launcher_steam.cpp"
@@ -0,0 +1,669 @@
+#include "game_priv.h"
+
+// Renders many movies from a job file in one go, without restarting the game or the encoder between them.
+// Started with startmovie <job file>.svrbatch, where every line of the job file is one movie in the same format as the startmovie parameters:
+//
+//     demo=match1.dem output=clip1.mp4 start=1200 end=2400 profile=my_profile
+//
+// The jobs are done in the order of their demos and start ticks, so every demo is only loaded once and only skipped forward.
+//
+// Games started by the launcher with --jobs instead take their jobs one at a time from a queue that is shared with the other games.
+// This starts by itself once the game is running, and the game quits when the queue has no more jobs for it. See svr_jobq.h.
+
+// How long a demo can take to load before the job is given up.
+const s32 GAME_BATCH_LOAD_TIMEOUT = 120;
+
+// The launcher gives the worker index to every game it starts with --jobs.
+void game_batch_read_worker()
+{
+    char value[64];
+    DWORD length = GetEnvironmentVariableA(SVR_JOBQ_WORKER_ENV, value, SVR_ARRAY_SIZE(value));
+
+    if (length == 0 || length >= SVR_ARRAY_SIZE(value))
+    {
+        return;
+    }
+
+    if (sscanf(value, "%u %d", &game_state.batch_launcher_pid, &game_state.batch_worker) != 2)
+    {
+        return;
+    }
+
+    game_state.batch_is_worker = true;
+}
+
+// Reads one line of a job file, which is in the same format as the startmovie parameters.
+void game_batch_parse_job(const char* line, GameBatchJob* job)
+{
+    *job = {};
+    job->end_tick = -1;
+    job->queue_job = -1;
+
+    SvrDynArray<SvrIniKeyValue> inputs = {};
+    svr_ini_parse_command_input(line, &inputs);
+
+    const char* opt_demo = svr_ini_find_command_value(&inputs, "demo");
+    const char* opt_output = svr_ini_find_command_value(&inputs, "output");
+    const char* opt_start = svr_ini_find_command_value(&inputs, "start");
+    const char* opt_end = svr_ini_find_command_value(&inputs, "end");
+    const char* opt_timeout = svr_ini_find_command_value(&inputs, "timeout");
+    const char* opt_profile = svr_ini_find_command_value(&inputs, "profile");
+
+    if (opt_demo)
+    {
+        SVR_COPY_STRING(opt_demo, job->demo);
+    }
+
+    if (opt_output)
+    {
+        SVR_COPY_STRING(opt_output, job->movie_name);
+    }
+
+    if (opt_profile)
+    {
+        SVR_COPY_STRING(opt_profile, job->profile);
+    }
+
+    if (opt_start)
+    {
+        job->start_tick = atoi(opt_start);
+    }
+
+    if (opt_end)
+    {
+        job->end_tick = atoi(opt_end);
+    }
+
+    if (opt_timeout)
+    {
+        job->timeout = atoi(opt_timeout);
+    }
+
+    svr_ini_free_kvs(&inputs);
+}
+
+// Returns what is wrong with the job, or NULL if it can be done.
+const char* game_batch_check_job(GameBatchJob* job)
+{
+    if (job->demo[0] == 0 || job->movie_name[0] == 0)
+    {
+        return "needs both demo and output";
+    }
+
+    if (!game_rec_is_valid_movie_ext(job->movie_name))
+    {
+        return "has an output with a wrong or missing file extension";
+    }
+
+    if (job->start_tick < 0 || (job->end_tick != -1 && job->end_tick <= job->start_tick))
+    {
+        return "has an end tick that is not after the start tick";
+    }
+
+    return NULL;
+}
+
+// Relative paths are from the SVR folder.
+bool game_batch_load_jobs(const char* name, SvrDynArray<GameBatchJob>* jobs)
+{
+    bool ret = false;
+    char path[MAX_PATH];
+    char* file_mem = NULL;
+    char line[1024];
+    const char* prev_str;
+    s32 line_num = 0;
+
+    if (PathIsRelativeA(name))
+    {
+        SVR_SNPRINTF(path, "%s\\%s", game_state.svr_path, name);
+    }
+
+    else
+    {
+        SVR_COPY_STRING(name, path);
+    }
+
+    file_mem = svr_read_file_as_string(path, SVR_READ_FILE_FLAGS_NEW_LINE);
+
+    if (file_mem == NULL)
+    {
+        svr_console_msg_and_log("Could not open job file %s\n", path);
+        goto rfail;
+    }
+
+    prev_str = file_mem;
+
+    while (*prev_str != 0)
+    {
+        prev_str = svr_read_line(prev_str, line, SVR_ARRAY_SIZE(line));
+        line_num++;
+
+        const char* ptr = svr_advance_until_after_whitespace(line);
+
+        // Blanks and comments.
+        if (*ptr == 0 || *ptr == '#' || *ptr == '/')
+        {
+            continue;
+        }
+
+        GameBatchJob job;
+        game_batch_parse_job(ptr, &job);
+        job.order = jobs->size;
+        job.line = line_num;
+
+        const char* error = game_batch_check_job(&job);
+
+        if (error)
+        {
+            svr_console_msg_and_log("Job on line %d of %s %s\n", line_num, path, error);
+            goto rfail;
+        }
+
+        jobs->push(job);
+    }
+
+    if (jobs->size == 0)
+    {
+        svr_console_msg_and_log("Job file %s has no jobs\n", path);
+        goto rfail;
+    }
+
+    ret = true;
+    goto rexit;
+
+rfail:
+rexit:
+    if (file_mem)
+    {
+        svr_free(file_mem);
+    }
+
+    return ret;
+}
+
+// Same demos together, and earlier ticks first so a demo only has to be played through once.
+s32 game_batch_compare_jobs(const void* a, const void* b)
+{
+    GameBatchJob* job_a = (GameBatchJob*)a;
+    GameBatchJob* job_b = (GameBatchJob*)b;
+
+    s32 res = strcmpi(job_a->demo, job_b->demo);
+
+    if (res != 0)
+    {
+        return res;
+    }
+
+    if (job_a->start_tick != job_b->start_tick)
+    {
+        return job_a->start_tick < job_b->start_tick ? -1 : 1;
+    }
+
+    return job_a->order - job_b->order;
+}
+
+bool game_batch_can_start()
+{
+    // The demo tick is needed to skip, and the signon state to know when a demo has loaded.
+    if (!(game_state.search_desc.caps & GAME_CAP_HAS_STUDIO) || !(game_state.search_desc.caps & GAME_CAP_HAS_AUTOSTOP))
+    {
+        svr_console_msg_and_log("Job files are not supported for this game\n");
+        return false;
+    }
+
+    // The studio waits for one movie at a time.
+    if (game_studio_active())
+    {
+        svr_console_msg_and_log("Job files cannot be used from SVR Studio\n");
+        return false;
+    }
+
+    return true;
+}
+
+bool game_batch_start(const char* name)
+{
+    if (!game_batch_can_start())
+    {
+        return false;
+    }
+
+    SvrDynArray<GameBatchJob> jobs = {};
+
+    if (!game_batch_load_jobs(name, &jobs))
+    {
+        jobs.free();
+        return false;
+    }
+
+    qsort(jobs.mem, jobs.size, sizeof(GameBatchJob), game_batch_compare_jobs);
+
+    s32 num_loads = 0;
+
+    for (s32 i = 0; i < jobs.size; i++)
+    {
+        // Without an end tick it is not known where the previous job left the demo.
+        if (i == 0 || strcmpi(jobs[i].demo, jobs[i - 1].demo) || jobs[i - 1].end_tick == -1 || jobs[i].start_tick < jobs[i - 1].end_tick)
+        {
+            num_loads++;
+        }
+    }
+
+    game_state.batch_jobs = jobs;
+    game_state.batch_job_index = 0;
+    game_state.batch_demo[0] = 0;
+    game_state.batch_start_time = svr_prof_get_real_time();
+    game_state.batch_active = true;
+
+    svr_console_msg_and_log("Starting %d jobs from %s with %d demo loads\n", jobs.size, name, num_loads);
+
+    game_batch_next_job();
+
+    return true;
+}
+
+void game_batch_start_worker()
+{
+    char mapping_name[64];
+    char mutex_name[64];
+
+    game_state.batch_worker_started = true;
+
+    if (!game_batch_can_start())
+    {
+        goto rfail;
+    }
+
+    SVR_SNPRINTF(mapping_name, "%s%u", SVR_JOBQ_MAPPING, game_state.batch_launcher_pid);
+    SVR_SNPRINTF(mutex_name, "%s%u", SVR_JOBQ_MUTEX, game_state.batch_launcher_pid);
+
+    game_state.batch_queue_mapping = OpenFileMappingA(FILE_MAP_READ | FILE_MAP_WRITE, FALSE, mapping_name);
+    game_state.batch_queue_mutex = OpenMutexA(SYNCHRONIZE | MUTEX_MODIFY_STATE, FALSE, mutex_name);
+
+    if (game_state.batch_queue_mapping == NULL || game_state.batch_queue_mutex == NULL)
+    {
+        DWORD error = GetLastError();
+
+        svr_console_msg_and_log("Could not open the job queue of the launcher (%lu)\n", error);
+        goto rfail;
+    }
+
+    game_state.batch_queue = (SvrJobq*)MapViewOfFile(game_state.batch_queue_mapping, FILE_MAP_READ | FILE_MAP_WRITE, 0, 0, 0);
+
+    if (game_state.batch_queue == NULL)
+    {
+        DWORD error = GetLastError();
+
+        svr_console_msg_and_log("Could not view the job queue of the launcher (%lu)\n", error);
+        goto rfail;
+    }
+
+    svr_console_msg_and_log("Taking jobs from the launcher as worker %d\n", game_state.batch_worker + 1);
+
+    game_state.batch_jobs = {};
+    game_state.batch_job_index = 0;
+    game_state.batch_demo[0] = 0;
+    game_state.batch_start_time = svr_prof_get_real_time();
+    game_state.batch_active = true;
+
+    game_batch_next_job();
+    return;
+
+rfail:
+    svr_maybe_close_handle(&game_state.batch_queue_mapping);
+    svr_maybe_close_handle(&game_state.batch_queue_mutex);
+
+    // The jobs of this worker are taken by the other workers when the launcher sees that this game has exited.
+    game_engine_client_command("quit\n");
+}
+
+void game_batch_lock_queue()
+{
+    // An abandoned mutex is from a game that has crashed. The launcher takes care of its jobs.
+    WaitForSingleObject(game_state.batch_queue_mutex, INFINITE);
+}
+
+void game_batch_unlock_queue()
+{
+    ReleaseMutex(game_state.batch_queue_mutex);
+}
+
+// Adds the next job from the shared queue to the end of batch_jobs. Returns false when there are no more jobs for this worker.
+bool game_batch_take_job()
+{
+    while (true)
+    {
+        char line[SVR_JOBQ_MAX_LINE];
+        s32 line_num = 0;
+
+        game_batch_lock_queue();
+
+        s32 queue_job = svr_jobq_take(game_state.batch_queue, game_state.batch_worker);
+
+        if (queue_job != -1)
+        {
+            SVR_COPY_STRING(game_state.batch_queue->jobs[queue_job].line, line);
+            line_num = game_state.batch_queue->jobs[queue_job].line_num;
+        }
+
+        game_batch_unlock_queue();
+
+        if (queue_job == -1)
+        {
+            return false;
+        }
+
+        GameBatchJob job;
+        game_batch_parse_job(line, &job);
+        job.order = game_state.batch_jobs.size;
+        job.line = line_num;
+        job.queue_job = queue_job;
+
+        // The launcher has already checked the lines, but it does not know the movie extensions.
+        const char* error = game_batch_check_job(&job);
+
+        if (error)
+        {
+            svr_console_msg_and_log("Job on line %d %s\n", line_num, error);
+
+            game_batch_lock_queue();
+            svr_jobq_finish(game_state.batch_queue, game_state.batch_worker, queue_job, true, 0, 0.0f);
+            game_batch_unlock_queue();
+
+            continue;
+        }
+
+        game_state.batch_jobs.push(job);
+        return true;
+    }
+}
+
+// Goes to the job at batch_job_index, or ends the batch when there are no more.
+void game_batch_next_job()
+{
+    if (game_state.batch_queue && game_state.batch_job_index == game_state.batch_jobs.size)
+    {
+        game_batch_take_job();
+    }
+
+    if (game_state.batch_job_index == game_state.batch_jobs.size)
+    {
+        game_batch_finish();
+        return;
+    }
+
+    GameBatchJob* job = &game_state.batch_jobs[game_state.batch_job_index];
+    job->begin_time = svr_prof_get_real_time();
+
+    svr_console_msg_and_log("Job %d of %d: %s from %s\n", game_state.batch_job_index + 1, game_state.batch_jobs.size, job->movie_name, job->demo);
+
+    // Going back in a demo is a restart of the demo anyway, and the demo may have ended with the last job.
+    bool same_demo = !strcmpi(game_state.batch_demo, job->demo);
+    bool connected = game_get_signon_state() == game_state.search_desc.signon_state_full;
+
+    if (same_demo && connected && job->start_tick >= game_get_demo_player_playback_tick())
+    {
+        game_batch_skip();
+        return;
+    }
+
+    game_state.batch_demo[0] = 0;
+    game_state.batch_demo_left = false;
+    game_state.batch_state = GAME_BATCH_LOADING;
+
+    game_engine_client_command(svr_va("playdemo \"%s\"\n", job->demo));
+}
+
+void game_batch_skip()
+{
+    GameBatchJob* job = &game_state.batch_jobs[game_state.batch_job_index];
+
+    if (job->start_tick <= game_get_demo_player_playback_tick())
+    {
+        game_batch_record();
+        return;
+    }
+
+    game_state.batch_state = GAME_BATCH_SKIPPING;
+
+    // Go to the tick (not relative) and pause, and skip there as fast as possible. Same as the studio skip.
+    game_engine_client_command(svr_va("demo_gototick %d 0 1\n", job->start_tick));
+    game_engine_client_command("host_framerate 1; r_norefresh 1\n");
+}
+
+void game_batch_record()
+{
+    GameBatchJob* job = &game_state.batch_jobs[game_state.batch_job_index];
+
+    if (game_state.batch_state == GAME_BATCH_SKIPPING)
+    {
+        game_engine_client_command("host_framerate 0; r_norefresh 0\n");
+    }
+
+    game_engine_client_command("demo_resume\n");
+
+    // The window update setting is from the startmovie that started the batch.
+    game_state.rec_timeout = job->timeout;
+    game_state.rec_enable_autostop = true;
+
+    job->record_time = svr_prof_get_real_time();
+
+    if (!game_rec_begin_movie(job->movie_name, job->profile, false))
+    {
+        game_batch_end_job(true);
+        return;
+    }
+
+    game_state.batch_state = GAME_BATCH_RECORDING;
+}
+
+// Called when the job is done or could not be done.
+void game_batch_end_job(bool failed)
+{
+    GameBatchJob* job = &game_state.batch_jobs[game_state.batch_job_index];
+
+    job->failed = failed;
+    job->end_time = svr_prof_get_real_time();
+
+    // The game frames are more than the video frames with motion blur, so take what the encoder got.
+    if (!failed)
+    {
+        job->num_frames = svr_get_video_frames();
+    }
+
+    else
+    {
+        svr_console_msg_and_log("Job %d of %d could not be done\n", game_state.batch_job_index + 1, game_state.batch_jobs.size);
+    }
+
+    if (game_state.batch_queue)
+    {
+        float record_secs = (job->end_time - job->record_time) / 1000000.0f;
+
+        game_batch_lock_queue();
+        svr_jobq_finish(game_state.batch_queue, game_state.batch_worker, job->queue_job, failed, job->num_frames, failed ? 0.0f : record_secs);
+        game_batch_unlock_queue();
+    }
+
+    game_state.batch_job_index++;
+    game_batch_next_job();
+}
+
+void game_batch_update()
+{
+    if (game_state.batch_is_worker && !game_state.batch_worker_started)
+    {
+        game_batch_start_worker();
+    }
+
+    if (!game_state.batch_active)
+    {
+        return;
+    }
+
+    GameBatchJob* job = &game_state.batch_jobs[game_state.batch_job_index];
+
+    s32 state = game_get_signon_state();
+    bool connected = state == game_state.search_desc.signon_state_full;
+
+    switch (game_state.batch_state)
+    {
+        case GAME_BATCH_LOADING:
+        {
+            // The previous demo may still be connected until the new one starts to load.
+            if (!connected)
+            {
+                game_state.batch_demo_left = true;
+            }
+
+            else if (game_state.batch_demo_left)
+            {
+                SVR_COPY_STRING(job->demo, game_state.batch_demo);
+                game_batch_skip();
+                break;
+            }
+
+            if (svr_prof_get_real_time() - job->begin_time > GAME_BATCH_LOAD_TIMEOUT * 1000000LL)
+            {
+                svr_console_msg_and_log("Demo %s did not load\n", job->demo);
+                game_batch_end_job(true);
+            }
+
+            break;
+        }
+
+        case GAME_BATCH_SKIPPING:
+        {
+            if (!connected)
+            {
+                svr_console_msg_and_log("Demo %s ended before tick %d\n", job->demo, job->start_tick);
+                game_engine_client_command("host_framerate 0; r_norefresh 0\n");
+                game_batch_end_job(true);
+                break;
+            }
+
+            if (game_get_demo_player_playback_tick() >= job->start_tick)
+            {
+                game_batch_record();
+            }
+
+            break;
+        }
+
+        case GAME_BATCH_RECORDING:
+        {
+            // The movie can also be ended by the timeout or the end of the demo.
+            if (svr_movie_active() && job->end_tick != -1 && game_get_demo_player_playback_tick() >= job->end_tick)
+            {
+                game_rec_end_movie();
+            }
+
+            // Nothing more gets into the movie after the encoder has failed.
+            if (svr_movie_active() && svr_movie_failed())
+            {
+                svr_console_msg_and_log("Movie %s failed\n", job->movie_name);
+                game_rec_end_movie();
+            }
+
+            // The end of the file is written in the background and can still fail, so the job is not done before that.
+            if (!svr_movie_active())
+            {
+                bool failed = svr_movie_failed() || !svr_wait_for_movie();
+                game_batch_end_job(failed);
+            }
+
+            break;
+        }
+    }
+}
+
+// Stops the batch from endmovie. Jobs that were not done are listed as failed.
+void game_batch_cancel()
+{
+    if (svr_movie_active())
+    {
+        game_rec_end_movie();
+    }
+
+    if (game_state.batch_state == GAME_BATCH_SKIPPING)
+    {
+        game_engine_client_command("host_framerate 0; r_norefresh 0\n");
+    }
+
+    svr_console_msg_and_log("Stopping job file after %d of %d jobs\n", game_state.batch_job_index, game_state.batch_jobs.size);
+
+    for (s32 i = game_state.batch_job_index; i < game_state.batch_jobs.size; i++)
+    {
+        game_state.batch_jobs[i].failed = true;
+
+        if (game_state.batch_queue)
+        {
+            game_batch_lock_queue();
+            svr_jobq_finish(game_state.batch_queue, game_state.batch_worker, game_state.batch_jobs[i].queue_job, true, 0, 0.0f);
+            game_batch_unlock_queue();
+        }
+    }
+
+    game_batch_finish();
+}
+
+void game_batch_finish()
+{
+    s64 now = svr_prof_get_real_time();
+
+    s64 total_frames = 0;
+    s64 total_record_time = 0;
+    s32 num_failed = 0;
+
+    svr_console_msg_and_log("\n");
+
+    for (s32 i = 0; i < game_state.batch_jobs.size; i++)
+    {
+        GameBatchJob* job = &game_state.batch_jobs[i];
+
+        if (job->failed)
+        {
+            svr_console_msg_and_log("    %s (line %d): not done\n", job->movie_name, job->line);
+            num_failed++;
+            continue;
+        }
+
+        s64 record_time = job->end_time - job->record_time;
+        s64 prepare_time = job->record_time - job->begin_time;
+
+        float record_secs = record_time / 1000000.0f;
+        float fps = record_secs > 0.0f ? job->num_frames / record_secs : 0.0f;
+
+        svr_console_msg_and_log("    %s (line %d): %lld frames in %0.2f seconds (%0.2f fps), %0.2f seconds to load and skip\n",
+                                job->movie_name, job->line, job->num_frames, record_secs, fps, prepare_time / 1000000.0f);
+
+        total_frames += job->num_frames;
+        total_record_time += record_time;
+    }
+
+    float total_secs = (now - game_state.batch_start_time) / 1000000.0f;
+    float total_record_secs = total_record_time / 1000000.0f;
+
+    float total_fps = total_secs > 0.0f ? total_frames / total_secs : 0.0f;
+    float record_fps = total_record_secs > 0.0f ? total_frames / total_record_secs : 0.0f;
+
+    svr_console_msg_and_log("\n");
+    svr_console_msg_and_log("Finished %d of %d jobs: %lld frames in %0.2f seconds (%0.2f fps overall, %0.2f fps while rendering)\n",
+                            game_state.batch_jobs.size - num_failed, game_state.batch_jobs.size, total_frames, total_secs, total_fps, record_fps);
+
+    game_state.batch_jobs.free();
+    game_state.batch_active = false;
+    game_state.batch_state = GAME_BATCH_NONE;
+
+    // The launcher waits for all games to exit.
+    if (game_state.batch_queue)
+    {
+        UnmapViewOfFile(game_state.batch_queue);
+        game_state.batch_queue = NULL;
+
+        svr_maybe_close_handle(&game_state.batch_queue_mapping);
+        svr_maybe_close_handle(&game_state.batch_queue_mutex);
+
+        game_engine_client_command("quit\n");
+    }
+}
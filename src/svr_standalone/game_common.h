@@ -169,6 +169,37 @@ void game_search_fill_desc(GameSearchDesc* desc); // Try and fill everything in
 
 // -----------------------------------------------
 
+using GameBatchState = s32;
+
+enum // GameBatchState
+{
+    GAME_BATCH_NONE,
+    GAME_BATCH_LOADING, // Waiting for the demo to load.
+    GAME_BATCH_SKIPPING, // Waiting for the demo to get to the start tick.
+    GAME_BATCH_RECORDING, // Waiting for the movie to end.
+};
+
+// One movie of a job file.
+struct GameBatchJob
+{
+    char demo[MAX_PATH];
+    char movie_name[MAX_PATH];
+    char profile[256];
+    s32 start_tick;
+    s32 end_tick; // -1 to record until the timeout or the end of the demo.
+    s32 timeout;
+    s32 order; // Position in the job file.
+    s32 line;
+    s32 queue_job; // Index in the shared job queue when started by the launcher.
+
+    // Results:
+    bool failed;
+    s64 num_frames; // Video frames the encoder got, which are fewer than the game frames with motion blur.
+    s64 begin_time; // When the demo started to load or skip.
+    s64 record_time; // When the movie started.
+    s64 end_time;
+};
+
 using GameRecState = s32;
 
 enum // GameRecState
@@ -210,7 +241,9 @@ struct GameState
     ITaskbarList3* wind_taskbar_list; // The taskbar progress bar.
 
     s64 game_frames;
-    s64 rec_num_frames; // Number of processed frames.
+    s64 rec_num_frames; // Number of processed frames, at the game rate.
+    s32 rec_frame_length; // How many frames at the game rate the frame being recorded covers.
+    s32 rec_next_frame_length; // Same for the frame after, which host_framerate has already been set for.
     s64 rec_start_time; // Time of start for timing purposes.
     s32 rec_game_rate; // Frames per second the game is processing game at (includes motion blur).
     s32 rec_video_fps;
@@ -218,6 +251,32 @@ struct GameState
     GameRecState rec_state; // Recording state tracking for autostop.
     bool rec_enable_autostop; // From start args: automatically stop on disconnect.
     bool rec_disable_window_update; // From start args: skip swap presentation.
+    s64 rec_resumed_frames; // Frames of the movie before it was resumed, for the timeout.
+
+    // From start args: the movie is resumed when the demo has been skipped to the checkpoint.
+    bool rec_resume_pending;
+    s32 rec_resume_tick;
+    s64 rec_resume_frame; // Video frame of the checkpoint.
+    char rec_resume_movie_name[MAX_PATH];
+    char rec_resume_profile_name[256];
+
+    // From start args: movies of a job file are being rendered.
+    bool batch_active;
+    GameBatchState batch_state;
+    SvrDynArray<GameBatchJob> batch_jobs; // In the order they are rendered.
+    s32 batch_job_index;
+    char batch_demo[MAX_PATH]; // Demo that is loaded, or empty if it has to be loaded again.
+    bool batch_demo_left; // Set when the previous demo has been left after playdemo.
+    s64 batch_start_time;
+
+    // From the launcher: this game is one of several that take jobs from a shared queue.
+    bool batch_is_worker;
+    bool batch_worker_started;
+    u32 batch_launcher_pid;
+    s32 batch_worker;
+    HANDLE batch_queue_mapping;
+    HANDLE batch_queue_mutex;
+    SvrJobq* batch_queue;
 
     bool snd_is_painting; // Our signal to do specific paths during recording.
     bool snd_listener_underwater; // State variable from the engine.
@@ -232,6 +291,7 @@ struct GameState
     s32 studio_spec_skips;
     s32 studio_next_spec_skip;
     bool studio_started_con_log;
+    char studio_demo_path[MAX_PATH]; // Demo that the studio last played, for the tick index.
 };
 
 extern GameState game_state;
@@ -372,9 +432,37 @@ void game_rec_update_recording_state();
 void game_rec_update_autostop();
 void game_rec_show_start_movie_usage();
 void game_rec_start_movie(void* cmd_args);
+bool game_rec_seek_to_resume_point(const char* movie_name, const char* profile_name);
+void game_rec_update_resume();
+bool game_rec_begin_movie(const char* movie_name, const char* profile_name, bool resume);
 void game_rec_end_movie();
 bool game_rec_run_frame();
 void game_rec_do_record_frame();
+void game_rec_give_demo_tick();
+void game_rec_update_frame_length();
+bool game_rec_is_valid_movie_ext(const char* movie_name);
+
+// -----------------------------------------------
+// game_batch.cpp:
+
+void game_batch_read_worker();
+void game_batch_parse_job(const char* line, GameBatchJob* job);
+const char* game_batch_check_job(GameBatchJob* job);
+bool game_batch_load_jobs(const char* name, SvrDynArray<GameBatchJob>* jobs);
+s32 game_batch_compare_jobs(const void* a, const void* b);
+bool game_batch_start(const char* name);
+bool game_batch_can_start();
+void game_batch_start_worker();
+void game_batch_lock_queue();
+void game_batch_unlock_queue();
+bool game_batch_take_job();
+void game_batch_next_job();
+void game_batch_skip();
+void game_batch_record();
+void game_batch_end_job(bool failed);
+void game_batch_update();
+void game_batch_cancel();
+void game_batch_finish();
 
 // -----------------------------------------------
 // game_studio.cpp:
@@ -386,6 +474,9 @@ void game_studio_update_pending_cmd();
 void game_studio_stop_recording();
 bool game_studio_active();
 void game_studio_movie_start_failed();
+void game_studio_get_game_dir(char* dest, s32 dest_size);
+bool game_studio_find_demo(const char* name, char* dest, s32 dest_size);
+bool game_studio_check_skip(s32 tick);
 
 // -----------------------------------------------
 // game_cfg.cpp:
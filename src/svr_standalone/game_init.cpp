@@ -28,6 +28,14 @@ void game_init_log()
     char log_file_path[MAX_PATH];
     SVR_SNPRINTF(log_file_path, "%s\\data\\svr_log.txt", game_state.svr_path);
 
+    // Every game started by the launcher with --jobs has its own log.
+    game_batch_read_worker();
+
+    if (game_state.batch_is_worker)
+    {
+        SVR_SNPRINTF(log_file_path, "%s\\data\\svr_log_%d.txt", game_state.svr_path, game_state.batch_worker + 1);
+    }
+
     // Append to the log file the launcher created.
     svr_init_log(log_file_path, true);
 
@@ -102,6 +102,12 @@ void __cdecl game_start_movie_override_0(void* cmd_args)
 
 void __cdecl game_end_movie_override_0(void* cmd_args)
 {
+    if (game_state.batch_active)
+    {
+        game_batch_cancel();
+        return;
+    }
+
     game_rec_end_movie();
 }
 
@@ -6,6 +6,8 @@
 #include "svr_log.h"
 #include "svr_array.h"
 #include "svr_ini.h"
+#include "svr_dem.h"
+#include "svr_jobq.h"
 #include "svr_alloc.h"
 #include "svr_console.h"
 #include "studio_shared.h"
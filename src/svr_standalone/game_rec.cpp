@@ -14,7 +14,7 @@ void game_rec_update_timeout()
     s64 end_frame = game_state.rec_timeout * game_state.rec_game_rate;
 
     // No more frames should be processed.
-    if (game_state.rec_num_frames >= end_frame)
+    if (game_state.rec_resumed_frames + game_state.rec_num_frames >= end_frame)
     {
         game_rec_end_movie();
     }
@@ -96,12 +96,27 @@ void game_rec_show_start_movie_usage()
     svr_console_msg("    Disable window presentation. This can be 0 or 1. Default is 0.\n");
     svr_console_msg("    For some systems this may improve performance, however you will not be able to see anything.\n");
     svr_console_msg("\n");
+    svr_console_msg("    resume=<value>\n");
+    svr_console_msg("    Continue a segmented movie that did not finish. This can be 0 or 1. Default is 0.\n");
+    svr_console_msg("    The demo that was rendered must be playing. It is skipped to the last complete segment, and the movie continues from there.\n");
+    svr_console_msg("\n");
+    svr_console_msg("A job file with the .svrbatch extension can be given instead of a movie name to render many movies in a row:\n");
+    svr_console_msg("\n");
+    svr_console_msg("    startmovie clips.svrbatch nowindupd=1\n");
+    svr_console_msg("\n");
+    svr_console_msg("Every line of the job file is one movie, written like this:\n");
+    svr_console_msg("\n");
+    svr_console_msg("    demo=match1.dem output=clip1.mp4 start=1200 end=2400 timeout=30 profile=my_profile\n");
+    svr_console_msg("\n");
+    svr_console_msg("Only demo and output are needed. Without end or timeout, the movie is recorded until the demo ends.\n");
+    svr_console_msg("Relative job file paths are from the SVR folder. Use endmovie to stop all jobs.\n");
+    svr_console_msg("\n");
     svr_console_msg("For more information see https://github.com/crashfort/SourceDemoRender\n");
 }
 
 void game_rec_start_movie(void* cmd_args)
 {
-    if (svr_movie_active())
+    if (svr_movie_active() || game_state.rec_resume_pending || game_state.batch_active)
     {
         svr_console_msg("Movie already started\n");
         return;
@@ -145,6 +160,8 @@ void game_rec_start_movie(void* cmd_args)
     game_state.rec_enable_autostop = true;
     game_state.rec_disable_window_update = false;
 
+    bool resume = false;
+
     char profile_name[256];
     profile_name[0] = 0;
 
@@ -157,6 +174,7 @@ void game_rec_start_movie(void* cmd_args)
     const char* opt_timeout = svr_ini_find_command_value(&inputs, "timeout");
     const char* opt_autostop = svr_ini_find_command_value(&inputs, "autostop");
     const char* opt_no_wind_upd = svr_ini_find_command_value(&inputs, "nowindupd");
+    const char* opt_resume = svr_ini_find_command_value(&inputs, "resume");
 
     if (opt_profile)
     {
@@ -178,21 +196,26 @@ void game_rec_start_movie(void* cmd_args)
         game_state.rec_disable_window_update = atoi(opt_no_wind_upd);
     }
 
+    if (opt_resume)
+    {
+        resume = atoi(opt_resume);
+    }
+
     svr_ini_free_kvs(&inputs);
 
-    // Will point to the end if no extension was provided.
-    const char* movie_ext = PathFindExtensionA(movie_name);
+    if (!strcmpi(PathFindExtensionA(movie_name), ".svrbatch"))
+    {
+        if (!game_batch_start(movie_name))
+        {
+            goto rfail;
+        }
 
-    // Only allowed containers that have sufficient encoder support.
-    // Though DNxHR can only be used with MOV, we cannot check the content of the profile here.
-    bool valid_ext =
-        !strcmpi(movie_ext, ".mp4") ||
-        !strcmpi(movie_ext, ".mkv") ||
-        !strcmpi(movie_ext, ".mov");
+        goto rexit;
+    }
 
-    if (!valid_ext)
+    if (!game_rec_is_valid_movie_ext(movie_name))
     {
-        svr_console_msg("File extension is wrong or missing. You may choose between MP4, MKV, MOV\n");
+        svr_console_msg("File extension is wrong or missing. You may choose between MP4, MKV, MOV, NUT, Y4M, or PNG, TIFF, EXR for image sequences\n");
         svr_console_msg("\n");
         svr_console_msg("Example:\n");
         svr_console_msg("\n");
@@ -202,6 +225,115 @@ void game_rec_start_movie(void* cmd_args)
         goto rfail;
     }
 
+    if (resume)
+    {
+        if (!game_rec_seek_to_resume_point(movie_name, profile_name))
+        {
+            goto rfail;
+        }
+
+        // The movie is started by game_rec_update_resume when the demo is there.
+        goto rexit;
+    }
+
+    if (!game_rec_begin_movie(movie_name, profile_name, false))
+    {
+        goto rfail;
+    }
+
+    goto rexit;
+
+rfail:
+    game_studio_movie_start_failed();
+
+rexit:
+    ;
+}
+
+bool game_rec_is_valid_movie_ext(const char* movie_name)
+{
+    // Will point to the end if no extension was provided.
+    const char* movie_ext = PathFindExtensionA(movie_name);
+
+    // Only allowed containers that have sufficient encoder support.
+    // Though DNxHR can only be used with MOV, we cannot check the content of the profile here.
+    // NUT and Y4M are for raw video that is usually piped to another program. The image extensions are for image sequences.
+    bool valid_ext =
+        !strcmpi(movie_ext, ".mp4") ||
+        !strcmpi(movie_ext, ".mkv") ||
+        !strcmpi(movie_ext, ".mov") ||
+        !strcmpi(movie_ext, ".nut") ||
+        !strcmpi(movie_ext, ".y4m") ||
+        !strcmpi(movie_ext, ".png") ||
+        !strcmpi(movie_ext, ".tif") ||
+        !strcmpi(movie_ext, ".tiff") ||
+        !strcmpi(movie_ext, ".exr");
+
+    return valid_ext;
+}
+
+// Skips the demo to where the checkpoint of the movie is. The movie is started when the demo has got there.
+bool game_rec_seek_to_resume_point(const char* movie_name, const char* profile_name)
+{
+    if (!(game_state.search_desc.caps & GAME_CAP_HAS_STUDIO))
+    {
+        svr_console_msg_and_log("Resuming is not supported for this game\n");
+        return false;
+    }
+
+    s32 tick;
+    s64 frame;
+
+    if (!svr_get_resume_point(movie_name, &tick, &frame))
+    {
+        return false;
+    }
+
+    game_state.rec_resume_pending = true;
+    game_state.rec_resume_tick = tick;
+    game_state.rec_resume_frame = frame;
+
+    SVR_COPY_STRING(movie_name, game_state.rec_resume_movie_name);
+    SVR_COPY_STRING(profile_name, game_state.rec_resume_profile_name);
+
+    // Go to the tick (not relative) and pause, and skip there as fast as possible. Same as the studio skip.
+    game_engine_client_command(svr_va("demo_gototick %d 0 1\n", tick));
+    game_engine_client_command("host_framerate 1; r_norefresh 1\n");
+
+    svr_console_msg_and_log("Skipping to tick %d to resume movie %s\n", tick, movie_name);
+
+    return true;
+}
+
+// Starts the resumed movie when the demo has reached the checkpoint.
+void game_rec_update_resume()
+{
+    if (!game_state.rec_resume_pending)
+    {
+        return;
+    }
+
+    if (game_get_demo_player_playback_tick() < game_state.rec_resume_tick)
+    {
+        return;
+    }
+
+    game_state.rec_resume_pending = false;
+
+    game_engine_client_command("host_framerate 0; r_norefresh 0; demo_resume\n");
+
+    if (!game_rec_begin_movie(game_state.rec_resume_movie_name, game_state.rec_resume_profile_name, true))
+    {
+        game_studio_movie_start_failed();
+        return;
+    }
+
+    // Continue the timeout from where the movie was.
+    game_state.rec_resumed_frames = game_state.rec_resume_frame * game_state.rec_game_rate / game_state.rec_video_fps;
+}
+
+bool game_rec_begin_movie(const char* movie_name, const char* profile_name, bool resume)
+{
     // These files must exist in order to set the right values.
 
     bool required_cfgs =
@@ -211,7 +343,7 @@ void game_rec_start_movie(void* cmd_args)
     if (!required_cfgs)
     {
         svr_console_msg_and_log("Required files svr_start_movie.cfg and svr_movie_end.cfg could not be found\n");
-        goto rfail;
+        return false;
     }
 
     // Some commands must be set before svr_start (such as mat_queue_mode 0, due to the backbuffer ordering of the GetRenderTarget call).
@@ -223,12 +355,14 @@ void game_rec_start_movie(void* cmd_args)
     startmovie_data.audio_params.audio_channels = game_state.search_desc.snd_num_channels;
     startmovie_data.audio_params.audio_hz = game_state.search_desc.snd_sample_rate;
     startmovie_data.audio_params.audio_bits = game_state.search_desc.snd_bit_depth;
+    startmovie_data.resume = resume;
+    startmovie_data.expected_seconds = game_state.rec_timeout; // Only known when there is a timeout.
 
     if (!svr_start(movie_name, profile_name, &startmovie_data))
     {
         // Reverse above changes if something went wrong.
         game_run_cfgs_for_event("end");
-        goto rfail;
+        return false;
     }
 
     // Ensure the game runs at a fixed rate.
@@ -248,6 +382,9 @@ void game_rec_start_movie(void* cmd_args)
 
     game_state.game_frames = 0;
     game_state.rec_num_frames = 0;
+    game_state.rec_frame_length = 1;
+    game_state.rec_next_frame_length = 1;
+    game_state.rec_resumed_frames = 0;
     game_state.rec_start_time = svr_prof_get_real_time();
 
     game_state.snd_skipped_samples = 0;
@@ -256,13 +393,7 @@ void game_rec_start_movie(void* cmd_args)
 
     svr_console_msg_and_log("Starting movie to %s\n", movie_name);
 
-    goto rexit;
-
-rfail:
-    game_studio_movie_start_failed();
-
-rexit:
-    ;
+    return true;
 }
 
 void game_rec_end_movie()
@@ -300,8 +431,10 @@ bool game_rec_run_frame()
 {
     game_state.game_frames++;
 
+    game_rec_update_resume();
     game_rec_update_recording_state();
     game_rec_update_autostop();
+    game_batch_update();
     game_studio_update();
 
     if (game_state.rec_state == GAME_REC_POSSIBLE && svr_movie_active())
@@ -315,14 +448,54 @@ bool game_rec_run_frame()
 
 void game_rec_do_record_frame()
 {
+    game_rec_give_demo_tick();
     game_audio_frame();
     game_velo_frame();
     game_input_frame();
 
     svr_frame();
 
-    game_state.rec_num_frames++;
+    game_state.rec_num_frames += game_state.rec_frame_length;
+
+    game_rec_update_frame_length();
 
     game_wind_update();
     game_rec_update_timeout();
 }
+
+// Motion blur can make one frame cover the frames where the shutter is closed, so they do not have to be rendered.
+// The command buffer is run after the engine has read host_framerate for the frame that comes now, so a new length only
+// applies to the frame after that. svr_get_next_frame_length asks for that frame, and the lengths given to the audio move one frame at a time.
+void game_rec_update_frame_length()
+{
+    s32 length = svr_get_next_frame_length();
+
+    game_state.rec_frame_length = game_state.rec_next_frame_length;
+
+    if (length == game_state.rec_next_frame_length)
+    {
+        return;
+    }
+
+    // Values of host_framerate above 1 are frames per second, and below are seconds.
+    if (length == 1)
+    {
+        game_engine_client_command(svr_va("host_framerate %d\n", game_state.rec_game_rate));
+    }
+
+    else
+    {
+        game_engine_client_command(svr_va("host_framerate %0.9f\n", length / (double)game_state.rec_game_rate));
+    }
+
+    game_state.rec_next_frame_length = length;
+}
+
+// So the checkpoints of segmented movies know where in the demo they are.
+void game_rec_give_demo_tick()
+{
+    if (game_state.search_desc.caps & GAME_CAP_HAS_STUDIO)
+    {
+        svr_give_demo_tick(game_get_demo_player_playback_tick());
+    }
+}
@@ -131,6 +131,12 @@ void game_studio_update()
         {
             StudioSharedSkipToStartCmd* cmd = &game_state.studio_peer->cmd_data.skip_to_start_cmd;
 
+            if (!game_studio_check_skip(cmd->tick))
+            {
+                SetEvent((HANDLE)game_state.studio_peer->wake_studio_h);
+                break;
+            }
+
             // Returns when the target tick is reached.
             game_state.studio_pending_cmd = cmd_id;
 
@@ -174,6 +180,8 @@ void game_studio_update()
             game_state.studio_pending_cmd = cmd_id;
 
             game_engine_client_command(svr_va("playdemo %s\n", cmd->demo_name));
+
+            SVR_COPY_STRING(cmd->demo_name, game_state.studio_demo_path);
             break;
         }
 
@@ -302,3 +310,123 @@ void game_studio_movie_start_failed()
     SVR_COPY_STRING("Could not start movie. See svr_log.txt for details", game_state.studio_peer->error);
     SetEvent((HANDLE)game_state.studio_peer->wake_studio_h);
 }
+
+// Directory of the game (mod) that playdemo opens relative demo paths from. This is the -game parameter, or hl2 if not given,
+// and is relative to the directory of the game executable.
+void game_studio_get_game_dir(char* dest, s32 dest_size)
+{
+    char exe_dir[MAX_PATH];
+    char mod_dir[MAX_PATH];
+
+    GetModuleFileNameA(NULL, exe_dir, MAX_PATH);
+    PathRemoveFileSpecA(exe_dir);
+
+    SVR_COPY_STRING("hl2", mod_dir);
+
+    const char* arg = strstr(GetCommandLineA(), " -game ");
+
+    if (arg)
+    {
+        arg = svr_advance_until_after_whitespace(arg + strlen(" -game "));
+        svr_extract_string(arg, mod_dir, SVR_ARRAY_SIZE(mod_dir));
+    }
+
+    if (PathIsRelativeA(mod_dir))
+    {
+        svr_copy_string(svr_va("%s\\%s", exe_dir, mod_dir), dest, dest_size);
+    }
+
+    else
+    {
+        svr_copy_string(mod_dir, dest, dest_size);
+    }
+}
+
+// Finds the file that playdemo opens for a demo name, which is looked for in the game directory and can leave out the extension.
+// The other search paths of the game (custom and mounted content) are not looked in, and then the current directory is tried last.
+bool game_studio_find_demo(const char* name, char* dest, s32 dest_size)
+{
+    char game_dir[MAX_PATH];
+    game_studio_get_game_dir(game_dir, SVR_ARRAY_SIZE(game_dir));
+
+    const char* bases[] = { game_dir, NULL };
+    const char* exts[] = { "", ".dem" };
+
+    for (s32 i = 0; i < SVR_ARRAY_SIZE(bases); i++)
+    {
+        for (s32 j = 0; j < SVR_ARRAY_SIZE(exts); j++)
+        {
+            if (bases[i] && PathIsRelativeA(name))
+            {
+                svr_copy_string(svr_va("%s\\%s%s", bases[i], name, exts[j]), dest, dest_size);
+            }
+
+            else
+            {
+                svr_copy_string(svr_va("%s%s", name, exts[j]), dest, dest_size);
+            }
+
+            if (PathFileExistsA(dest))
+            {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+// Uses the tick index of the demo to know how much of the demo the skip has to go through, and to not start skipping to a tick
+// that the demo never gets to. Returns false with the error set for the studio if the skip should not be done.
+// The skip is always done with demo_gototick, the cost is only logged.
+// Not knowing the demo is not an error, the skip is then done without checking.
+bool game_studio_check_skip(s32 tick)
+{
+    char demo_path[MAX_PATH];
+
+    if (game_state.studio_demo_path[0] == 0)
+    {
+        return true;
+    }
+
+    if (!game_studio_find_demo(game_state.studio_demo_path, demo_path, SVR_ARRAY_SIZE(demo_path)))
+    {
+        svr_log("Game (Studio): Could not find demo %s\n", game_state.studio_demo_path);
+        return true;
+    }
+
+    SvrDemIndex index;
+
+    s64 start_time = svr_prof_get_real_time();
+
+    if (!svr_dem_load_index(demo_path, &index))
+    {
+        svr_log("Game (Studio): Could not index demo %s\n", demo_path);
+        return true;
+    }
+
+    bool ret = true;
+
+    if (index.ticks.size == 0 || tick > index.ticks[index.ticks.size - 1].tick)
+    {
+        s32 last_tick = index.ticks.size > 0 ? index.ticks[index.ticks.size - 1].tick : 0;
+
+        svr_copy_string(svr_va("Tick %d is past the end of the demo (%d ticks)", tick, last_tick), game_state.studio_peer->error, SVR_ARRAY_SIZE(StudioSharedPeer::error));
+        svr_log("Game (Studio): %s\n", game_state.studio_peer->error);
+
+        ret = false;
+    }
+
+    else
+    {
+        bool restart;
+        s64 cost = svr_dem_get_skip_cost(&index, game_get_demo_player_playback_tick(), tick, &restart);
+
+        svr_log("Game (Studio): Skipping to tick %d goes through %lld MB of the demo%s (indexed in %.2f ms)\n",
+                tick, SVR_FROM_MB(cost), restart ? " from the start" : "", (svr_prof_get_real_time() - start_time) / 1000.0);
+    }
+
+    svr_dem_free_index(&index);
+
+    return ret;
+}
@@ -19,3 +19,4 @@
 #include "game_input.cpp"
 #include "game_player.cpp"
 #include "game_studio.cpp"
+#include "game_batch.cpp"
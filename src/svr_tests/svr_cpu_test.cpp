@@ -0,0 +1,218 @@
+#include "svr_cpu.h"
+#include <string.h>
+
+// Test of the topology and budget split of svr_cpu, with made up processors of the kinds that svr_cpu_make_layout finds.
+// The Win32 part is in svr_cpu_win32.cpp and is not built here, so this builds and runs anywhere:
+// g++ -Wall -Wextra -I src/svr_common -I deps/stb src/svr_tests/svr_cpu_test.cpp src/svr_common/svr_cpu.cpp deps/stb/stb_sprintf.cpp -o svr_cpu_test && ./svr_cpu_test
+
+s32 test_num_failed;
+
+#define TEST_CHECK(X) test_check((X), #X, __LINE__)
+
+void test_check(bool value, const char* expr, s32 line)
+{
+    if (!value)
+    {
+        printf("FAILED line %d: %s\n", line, expr);
+        test_num_failed++;
+    }
+}
+
+// Same order as the cpu sets on Windows, where the processors of a core come one after another.
+s32 test_make_sets(SvrCpuSet* sets, s32 first_index, s32 first_core, s32 num_cores, s32 threads_per_core, s32 efficiency_class)
+{
+    s32 num = 0;
+
+    for (s32 i = 0; i < num_cores; i++)
+    {
+        for (s32 j = 0; j < threads_per_core; j++)
+        {
+            SvrCpuSet* set = &sets[num];
+            num++;
+
+            set->group = 0;
+            set->index = first_index + i * threads_per_core + j;
+            set->core_index = first_core + i;
+            set->efficiency_class = efficiency_class;
+        }
+    }
+
+    return num;
+}
+
+// 4 cores with 2 threads each that are all equally fast.
+void test_smt()
+{
+    SvrCpuSet sets[8];
+    s32 num_sets = test_make_sets(sets, 0, 0, 4, 2, 0);
+
+    SvrCpuTopology topology;
+    svr_cpu_build_topology(sets, num_sets, ~0ULL, &topology);
+
+    TEST_CHECK(topology.num_cores == 4);
+    TEST_CHECK(topology.cores[0].mask == 0x03);
+    TEST_CHECK(topology.cores[3].mask == 0xc0);
+
+    SvrCpuLayout layout;
+
+    // The last core is picked, as the first one usually handles the interrupts.
+    TEST_CHECK(svr_cpu_split_layout(&topology, 1, 32, &layout));
+    TEST_CHECK(layout.game_mask == 0xc0);
+    TEST_CHECK(layout.encoder_mask == 0x3f);
+    TEST_CHECK(layout.num_game_cpus == 2);
+    TEST_CHECK(layout.num_encoder_cpus == 6);
+
+    TEST_CHECK(svr_cpu_split_layout(&topology, 3, 32, &layout));
+    TEST_CHECK(layout.game_mask == 0xfc);
+    TEST_CHECK(layout.encoder_mask == 0x03);
+
+    // Nothing would be left for the encoder.
+    TEST_CHECK(!svr_cpu_split_layout(&topology, 4, 32, &layout));
+    TEST_CHECK(layout.game_mask == 0 && layout.encoder_mask == 0 && layout.num_encoder_cpus == 0);
+
+    TEST_CHECK(!svr_cpu_split_layout(&topology, 5, 32, &layout));
+
+    // No reserved cores gives everything to the encoder.
+    TEST_CHECK(svr_cpu_split_layout(&topology, 0, 32, &layout));
+    TEST_CHECK(layout.game_mask == 0);
+    TEST_CHECK(layout.encoder_mask == 0xff);
+}
+
+// 2 performance cores with 2 threads each, followed by 4 efficiency cores with 1 thread each.
+void test_hybrid()
+{
+    SvrCpuSet sets[8];
+    s32 num_sets = 0;
+    num_sets += test_make_sets(sets + num_sets, 0, 0, 2, 2, 1);
+    num_sets += test_make_sets(sets + num_sets, 4, 2, 4, 1, 0);
+
+    SvrCpuTopology topology;
+    svr_cpu_build_topology(sets, num_sets, ~0ULL, &topology);
+
+    TEST_CHECK(topology.num_cores == 6);
+
+    SvrCpuLayout layout;
+
+    TEST_CHECK(svr_cpu_split_layout(&topology, 1, 32, &layout));
+    TEST_CHECK(layout.game_mask == 0x0c);
+    TEST_CHECK(layout.encoder_mask == 0xf3);
+
+    TEST_CHECK(svr_cpu_split_layout(&topology, 2, 32, &layout));
+    TEST_CHECK(layout.game_mask == 0x0f);
+    TEST_CHECK(layout.encoder_mask == 0xf0);
+
+    // Efficiency cores are only taken when the performance cores are used up.
+    TEST_CHECK(svr_cpu_split_layout(&topology, 3, 32, &layout));
+    TEST_CHECK(layout.game_mask == 0x8f);
+    TEST_CHECK(layout.num_game_cpus == 5);
+    TEST_CHECK(layout.num_encoder_cpus == 3);
+}
+
+// The processors that the process can't use and the other groups are left out.
+void test_allowed()
+{
+    SvrCpuSet sets[10];
+    s32 num_sets = test_make_sets(sets, 0, 0, 4, 2, 0);
+
+    sets[num_sets] = SvrCpuSet { 1, 0, 100, 5 };
+    num_sets++;
+
+    sets[num_sets] = SvrCpuSet { 0, 70, 101, 5 };
+    num_sets++;
+
+    SvrCpuTopology topology;
+    svr_cpu_build_topology(sets, num_sets, 0x3f, &topology);
+
+    TEST_CHECK(topology.num_cores == 3);
+
+    SvrCpuLayout layout;
+
+    TEST_CHECK(svr_cpu_split_layout(&topology, 1, 32, &layout));
+    TEST_CHECK(layout.game_mask == 0x30);
+    TEST_CHECK(layout.encoder_mask == 0x0f);
+}
+
+// The game is 32-bit, so the cores above the first 32 processors are for the encoder even if they are faster.
+void test_max_game_cpu()
+{
+    SvrCpuSet sets[48];
+    s32 num_sets = 0;
+    num_sets += test_make_sets(sets + num_sets, 0, 0, 16, 2, 0);
+    num_sets += test_make_sets(sets + num_sets, 32, 16, 8, 2, 1);
+
+    SvrCpuTopology topology;
+    svr_cpu_build_topology(sets, num_sets, ~0ULL, &topology);
+
+    TEST_CHECK(topology.num_cores == 24);
+
+    SvrCpuLayout layout;
+
+    TEST_CHECK(svr_cpu_split_layout(&topology, 1, 32, &layout));
+    TEST_CHECK(layout.game_mask == 0xc0000000ULL);
+    TEST_CHECK(layout.num_encoder_cpus == 46);
+
+    // Without the limit the fastest core is used.
+    TEST_CHECK(svr_cpu_split_layout(&topology, 1, 64, &layout));
+    TEST_CHECK(layout.game_mask == 0xc00000000000ULL);
+
+    // Not enough cores below the limit.
+    TEST_CHECK(!svr_cpu_split_layout(&topology, 17, 32, &layout));
+}
+
+// Processors without hyperthreading, one core each, up to the size of the mask.
+void test_many_cores()
+{
+    SvrCpuSet sets[64];
+    s32 num_sets = test_make_sets(sets, 0, 0, 64, 1, 0);
+
+    SvrCpuTopology topology;
+    svr_cpu_build_topology(sets, num_sets, ~0ULL, &topology);
+
+    TEST_CHECK(topology.num_cores == SVR_CPU_MAX_CORES);
+
+    SvrCpuLayout layout;
+
+    TEST_CHECK(svr_cpu_split_layout(&topology, 2, 32, &layout));
+    TEST_CHECK(layout.game_mask == 0xc0000000ULL);
+    TEST_CHECK(layout.num_encoder_cpus == 62);
+}
+
+void test_mask_string()
+{
+    char buf[256];
+
+    svr_cpu_mask_to_string(0x10f, buf, SVR_ARRAY_SIZE(buf));
+    TEST_CHECK(!strcmp(buf, "0-3,8"));
+
+    svr_cpu_mask_to_string(0, buf, SVR_ARRAY_SIZE(buf));
+    TEST_CHECK(!strcmp(buf, ""));
+
+    svr_cpu_mask_to_string(0x8000000000000001ULL, buf, SVR_ARRAY_SIZE(buf));
+    TEST_CHECK(!strcmp(buf, "0,63"));
+
+    svr_cpu_mask_to_string(~0ULL, buf, SVR_ARRAY_SIZE(buf));
+    TEST_CHECK(!strcmp(buf, "0-63"));
+
+    TEST_CHECK(svr_cpu_count(0) == 0);
+    TEST_CHECK(svr_cpu_count(0x10f) == 5);
+    TEST_CHECK(svr_cpu_count(~0ULL) == 64);
+}
+
+int main()
+{
+    test_smt();
+    test_hybrid();
+    test_allowed();
+    test_max_game_cpu();
+    test_many_cores();
+    test_mask_string();
+
+    if (test_num_failed > 0)
+    {
+        printf("%d checks failed\n", test_num_failed);
+        return 1;
+    }
+
+    printf("All checks passed\n");
+    return 0;
+}
@@ -0,0 +1,326 @@
+#include "svr_dem.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Test of svr_dem, which writes small demos with the framing of the engine and checks the index that is built for them.
+// svr_dem only uses standard C, so this builds and runs anywhere:
+// g++ -Wall -Wextra -I src/svr_common -I deps/stb src/svr_tests/svr_dem_test.cpp src/svr_common/svr_dem.cpp deps/stb/stb_sprintf.cpp -o svr_dem_test && ./svr_dem_test
+
+const char* TEST_DEMO_PATH = "svr_dem_test.dem";
+const char* TEST_INDEX_PATH = "svr_dem_test.dem." SVR_DEM_INDEX_EXT;
+
+const s32 TEST_NUM_TICKS = 100;
+
+s32 test_num_failed;
+
+#define TEST_CHECK(X) test_check((X), #X, __LINE__)
+
+void test_check(bool value, const char* expr, s32 line)
+{
+    if (!value)
+    {
+        printf("FAILED line %d: %s\n", line, expr);
+        test_num_failed++;
+    }
+}
+
+// The parts of svr_common that svr_dem needs.
+
+void* svr_alloc(s32 size)
+{
+    return malloc(size);
+}
+
+void* svr_realloc(void* p, s32 size)
+{
+    return realloc(p, size);
+}
+
+void svr_free(void* addr)
+{
+    free(addr);
+}
+
+void svr_maybe_free(void** addr)
+{
+    if (*addr)
+    {
+        free(*addr);
+        *addr = NULL;
+    }
+}
+
+bool svr_idx_in_range(s32 idx, s32 size)
+{
+    return idx >= 0 && idx < size;
+}
+
+s32 svr_copy_string(const char* source, char* dest, s32 dest_chars)
+{
+    s32 len = (s32)strlen(source);
+    s32 copy = svr_min(len, dest_chars - 1);
+
+    memcpy(dest, source, copy);
+    dest[copy] = 0;
+
+    return copy;
+}
+
+// Writes a demo in the same way as the engine.
+struct TestDemo
+{
+    FILE* file;
+    s32 protocol;
+};
+
+void test_write_s32(TestDemo* demo, s32 value)
+{
+    u8 buf[4] = { (u8)value, (u8)(value >> 8), (u8)(value >> 16), (u8)(value >> 24) };
+    fwrite(buf, 1, 4, demo->file);
+}
+
+void test_write_zeros(TestDemo* demo, s32 size)
+{
+    for (s32 i = 0; i < size; i++)
+    {
+        fputc(0, demo->file);
+    }
+}
+
+void test_open_demo(TestDemo* demo, s32 protocol)
+{
+    demo->file = fopen(TEST_DEMO_PATH, "wb");
+    demo->protocol = protocol;
+
+    char name[260] = {};
+
+    fwrite("HL2DEMO", 1, 8, demo->file);
+    test_write_s32(demo, protocol);
+    test_write_s32(demo, 24);
+
+    test_write_zeros(demo, 260);
+    test_write_zeros(demo, 260);
+
+    SVR_COPY_STRING("cp_badlands", name);
+    fwrite(name, 1, sizeof(name), demo->file);
+
+    SVR_COPY_STRING("tf", name);
+    fwrite(name, 1, sizeof(name), demo->file);
+
+    float playback_time = TEST_NUM_TICKS / 66.0f;
+    fwrite(&playback_time, 1, 4, demo->file);
+
+    test_write_s32(demo, TEST_NUM_TICKS);
+    test_write_s32(demo, TEST_NUM_TICKS);
+    test_write_s32(demo, 0);
+}
+
+// Returns the offset of the message.
+s64 test_write_msg(TestDemo* demo, u8 cmd, s32 tick, s32 size)
+{
+    s64 offset = ftell(demo->file);
+
+    fputc(cmd, demo->file);
+    test_write_s32(demo, tick);
+
+    if (demo->protocol >= 4)
+    {
+        fputc(0, demo->file); // Player slot.
+    }
+
+    switch (cmd)
+    {
+        case 1: // Signon.
+        case 2: // Packet.
+        {
+            test_write_zeros(demo, 76 * (demo->protocol >= 4 ? 2 : 1) + 8);
+            break;
+        }
+
+        case 5: // User command.
+        {
+            test_write_zeros(demo, 4);
+            break;
+        }
+    }
+
+    // Everything but the sync tick and the stop has sized data.
+    if (cmd != 3 && cmd != 7)
+    {
+        test_write_s32(demo, size);
+        test_write_zeros(demo, size);
+    }
+
+    return offset;
+}
+
+s64 test_close_demo(TestDemo* demo)
+{
+    s64 size = ftell(demo->file);
+    fclose(demo->file);
+
+    remove(TEST_INDEX_PATH);
+
+    return size;
+}
+
+// Signon, then packets for every tick with some other messages in between, then a stop.
+void test_full_demo(s32 protocol)
+{
+    TestDemo demo;
+    test_open_demo(&demo, protocol);
+
+    s64 tick_offsets[TEST_NUM_TICKS];
+
+    test_write_msg(&demo, 1, 0, 500);
+    test_write_msg(&demo, 1, 0, 300);
+    s64 signon_end = test_write_msg(&demo, 3, 0, 0);
+    s64 tables_offset = test_write_msg(&demo, 6, 0, 40);
+
+    for (s32 i = 0; i < TEST_NUM_TICKS; i++)
+    {
+        tick_offsets[i] = test_write_msg(&demo, 2, i, 1000 + i);
+
+        if (i % 10 == 0)
+        {
+            test_write_msg(&demo, 4, i, 5);
+            test_write_msg(&demo, 5, i, 16);
+        }
+    }
+
+    // The sync tick is not a tick of its own, so the first tick starts with the data tables.
+    tick_offsets[0] = tables_offset;
+
+    s64 stop_offset = test_write_msg(&demo, 7, TEST_NUM_TICKS, 0);
+    s64 file_size = test_close_demo(&demo);
+
+    SvrDemIndex index;
+    TEST_CHECK(svr_dem_load_index(TEST_DEMO_PATH, &index));
+
+    TEST_CHECK(index.header.demo_protocol == protocol);
+    TEST_CHECK(!strcmp(index.header.map_name, "cp_badlands"));
+    TEST_CHECK(index.file_size == file_size);
+    TEST_CHECK(index.signon_end == signon_end);
+    TEST_CHECK(index.stop_offset == stop_offset);
+    TEST_CHECK(index.ticks.size == TEST_NUM_TICKS);
+
+    for (s32 i = 0; i < index.ticks.size; i++)
+    {
+        TEST_CHECK(index.ticks[i].tick == i);
+        TEST_CHECK(index.ticks[i].offset == tick_offsets[i]);
+    }
+
+    TEST_CHECK(svr_dem_find_tick(&index, -5) == -1);
+    TEST_CHECK(svr_dem_find_tick(&index, 42) == 42);
+    TEST_CHECK(svr_dem_find_tick(&index, 1000) == TEST_NUM_TICKS - 1);
+
+    bool restart;
+
+    // Skipping forward goes through everything after the start tick up to and including the end tick.
+    TEST_CHECK(svr_dem_get_skip_cost(&index, 10, 50, &restart) == tick_offsets[51] - tick_offsets[11]);
+    TEST_CHECK(!restart);
+
+    // Skipping back starts from the signon.
+    TEST_CHECK(svr_dem_get_skip_cost(&index, 60, 10, &restart) == tick_offsets[11] - signon_end);
+    TEST_CHECK(restart);
+
+    TEST_CHECK(svr_dem_get_skip_cost(&index, 0, TEST_NUM_TICKS - 1, &restart) == stop_offset - tick_offsets[1]);
+
+    svr_dem_free_index(&index);
+
+    // The second load is from the cache and must be the same.
+    SvrDemIndex cached;
+    TEST_CHECK(svr_dem_load_index(TEST_DEMO_PATH, &cached));
+
+    TEST_CHECK(cached.signon_end == signon_end);
+    TEST_CHECK(cached.stop_offset == stop_offset);
+    TEST_CHECK(cached.ticks.size == TEST_NUM_TICKS);
+    TEST_CHECK(cached.ticks.size == TEST_NUM_TICKS && cached.ticks[42].offset == tick_offsets[42]);
+
+    svr_dem_free_index(&cached);
+}
+
+// Demos that were stopped while connecting only have the signon.
+void test_signon_demo(bool stopped)
+{
+    TestDemo demo;
+    test_open_demo(&demo, 3);
+
+    test_write_msg(&demo, 1, 0, 500);
+    test_write_msg(&demo, 1, 0, 300);
+    s64 signon_end = ftell(demo.file);
+
+    if (stopped)
+    {
+        test_write_msg(&demo, 7, 0, 0);
+    }
+
+    s64 file_size = test_close_demo(&demo);
+
+    SvrDemIndex index;
+    TEST_CHECK(svr_dem_build_index(TEST_DEMO_PATH, &index));
+
+    TEST_CHECK(index.signon_end == signon_end);
+    TEST_CHECK(index.stop_offset == (stopped ? signon_end : file_size));
+    TEST_CHECK(index.ticks.size == 0);
+
+    bool restart;
+    TEST_CHECK(svr_dem_get_skip_cost(&index, 0, 100, &restart) == 0);
+
+    svr_dem_free_index(&index);
+}
+
+// The ticks before the point where the demo was cut off are still usable.
+void test_cut_demo()
+{
+    TestDemo demo;
+    test_open_demo(&demo, 3);
+
+    s64 tick_offsets[TEST_NUM_TICKS];
+
+    test_write_msg(&demo, 1, 0, 500);
+    s64 signon_end = ftell(demo.file);
+
+    for (s32 i = 0; i < TEST_NUM_TICKS; i++)
+    {
+        tick_offsets[i] = test_write_msg(&demo, 2, i, 1000);
+    }
+
+    // Half of a packet.
+    fputc(2, demo.file);
+    test_write_s32(&demo, TEST_NUM_TICKS);
+    test_write_zeros(&demo, 20);
+
+    test_close_demo(&demo);
+
+    SvrDemIndex index;
+    TEST_CHECK(svr_dem_build_index(TEST_DEMO_PATH, &index));
+
+    TEST_CHECK(index.signon_end == signon_end);
+    TEST_CHECK(index.ticks.size == TEST_NUM_TICKS + 1);
+    TEST_CHECK(index.ticks.size > 0 && index.ticks[0].offset == tick_offsets[0]);
+    TEST_CHECK(index.stop_offset == index.ticks[TEST_NUM_TICKS].offset);
+
+    svr_dem_free_index(&index);
+}
+
+int main()
+{
+    test_full_demo(3);
+    test_full_demo(4);
+    test_signon_demo(true);
+    test_signon_demo(false);
+    test_cut_demo();
+
+    remove(TEST_DEMO_PATH);
+    remove(TEST_INDEX_PATH);
+
+    if (test_num_failed > 0)
+    {
+        printf("%d checks failed\n", test_num_failed);
+        return 1;
+    }
+
+    printf("All checks passed\n");
+    return 0;
+}
@@ -0,0 +1,240 @@
+#include "svr_handoff.h"
+#include "svr_prof.h"
+#include <string.h>
+#include <thread>
+#include <unistd.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <sys/syscall.h>
+
+// Test and benchmark of svr_handoff with the futex backend on Linux.
+// The handoffs go between two threads, and then between two processes through shared memory like svr_game and svr_encoder do.
+// The round trips per second and how many waits ended while spinning are printed, but only the correctness is checked,
+// as that depends on how many processors there are.
+// g++ -O2 -Wall -Wextra -pthread -I src/svr_common -I deps/stb src/svr_tests/svr_handoff_test.cpp src/svr_common/svr_handoff.cpp src/svr_common/svr_handoff_futex.cpp -o svr_handoff_test && ./svr_handoff_test
+
+const s32 TEST_FAST_ROUNDS = 100000;
+const s32 TEST_SLOW_ROUNDS = 50;
+const s32 TEST_SLOW_DELAY_US = 2000;
+const s32 TEST_PROCESS_ROUNDS = 20000;
+
+s32 test_num_failed;
+
+#define TEST_CHECK(X) test_check((X), #X, __LINE__)
+
+void test_check(bool value, const char* expr, s32 line)
+{
+    if (!value)
+    {
+        printf("FAILED line %d: %s\n", line, expr);
+        test_num_failed++;
+    }
+}
+
+// The parts of svr_common that svr_handoff needs.
+
+void svr_atom_store(SvrAtom32* atom, s32 value)
+{
+    __atomic_store_n(&atom->v, value, __ATOMIC_RELEASE);
+}
+
+s32 svr_atom_load(SvrAtom32* atom)
+{
+    return __atomic_load_n(&atom->v, __ATOMIC_ACQUIRE);
+}
+
+s32 svr_atom_add(SvrAtom32* atom, s32 num)
+{
+    return __atomic_add_fetch(&atom->v, num, __ATOMIC_SEQ_CST);
+}
+
+s32 svr_atom_swap(SvrAtom32* atom, s32 value)
+{
+    return __atomic_exchange_n(&atom->v, value, __ATOMIC_SEQ_CST);
+}
+
+s64 svr_prof_get_real_time()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (s64)ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+// Same as the shared memory between svr_game and svr_encoder.
+struct TestShared
+{
+    SvrHandoffChannel game_to_encoder;
+    SvrHandoffChannel encoder_to_game;
+
+    s32 event; // Written before every handoff, so the other side must see the new value after the wait.
+    s32 num_wrong;
+};
+
+// The side that sends the events, like svr_game.
+void test_run_game(TestShared* shared, SvrHandoff* handoff, s32 num_rounds, void* other_h)
+{
+    for (s32 i = 0; i < num_rounds; i++)
+    {
+        shared->event = i;
+
+        svr_handoff_signal(handoff, &shared->game_to_encoder, NULL);
+
+        if (!svr_handoff_wait(handoff, &shared->encoder_to_game, NULL, other_h))
+        {
+            shared->num_wrong++;
+            return;
+        }
+
+        if (shared->event != -i)
+        {
+            shared->num_wrong++;
+        }
+    }
+}
+
+// The side that handles the events, like svr_encoder.
+void test_run_encoder(TestShared* shared, SvrHandoff* handoff, s32 num_rounds, s32 delay_us)
+{
+    for (s32 i = 0; i < num_rounds; i++)
+    {
+        if (!svr_handoff_wait(handoff, &shared->game_to_encoder, NULL, NULL))
+        {
+            shared->num_wrong++;
+            return;
+        }
+
+        if (shared->event != i)
+        {
+            shared->num_wrong++;
+        }
+
+        if (delay_us > 0)
+        {
+            usleep(delay_us);
+        }
+
+        shared->event = -i;
+
+        svr_handoff_signal(handoff, &shared->encoder_to_game, NULL);
+    }
+}
+
+void test_log(const char* name, s32 num_rounds, s64 taken, SvrHandoff* game_handoff, SvrHandoff* encoder_handoff)
+{
+    double secs = svr_max(taken, (s64)1) / 1000000.0;
+
+    printf("%s: %d round trips in %.1f ms (%.0f per second, %.2f us each). Game spun %.1f%%, encoder spun %.1f%%\n",
+           name, num_rounds, taken / 1000.0, num_rounds / secs, (taken / (double)num_rounds),
+           svr_handoff_get_spin_ratio(game_handoff), svr_handoff_get_spin_ratio(encoder_handoff));
+}
+
+// Handoffs between two threads. When the answers come right away and there are processors for both, most waits end while spinning.
+void test_threads(const char* name, s32 num_rounds, s32 delay_us)
+{
+    TestShared shared = {};
+
+    SvrHandoff game_handoff;
+    SvrHandoff encoder_handoff;
+    svr_handoff_init(&game_handoff, &shared.encoder_to_game, &SVR_HANDOFF_FUTEX_BACKEND);
+    svr_handoff_init(&encoder_handoff, &shared.game_to_encoder, &SVR_HANDOFF_FUTEX_BACKEND);
+
+    s64 start_time = svr_prof_get_real_time();
+
+    std::thread encoder_thread(test_run_encoder, &shared, &encoder_handoff, num_rounds, delay_us);
+    test_run_game(&shared, &game_handoff, num_rounds, NULL);
+    encoder_thread.join();
+
+    s64 taken = svr_prof_get_real_time() - start_time;
+
+    TEST_CHECK(shared.num_wrong == 0);
+    TEST_CHECK(game_handoff.num_spun + game_handoff.num_blocked == num_rounds);
+    TEST_CHECK(encoder_handoff.num_spun + encoder_handoff.num_blocked == num_rounds);
+
+    // Answers that take longer than the spin time must sleep.
+    if (delay_us > SVR_HANDOFF_MAX_SPIN_US)
+    {
+        TEST_CHECK(game_handoff.num_blocked > 0);
+    }
+
+    test_log(name, num_rounds, taken, &game_handoff, &encoder_handoff);
+}
+
+// The channels are in shared memory, and the encoder exits without answering at the end.
+// The game must see that through the pidfd of the encoder instead of waiting forever.
+void test_processes()
+{
+    TestShared* shared = (TestShared*)mmap(NULL, sizeof(TestShared), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    TEST_CHECK(shared != MAP_FAILED);
+
+    if (shared == MAP_FAILED)
+    {
+        return;
+    }
+
+    memset(shared, 0, sizeof(TestShared));
+
+    // Both sides must start from the same sequence numbers, which svr_game and svr_encoder do before the first event.
+    SvrHandoff game_handoff;
+    SvrHandoff encoder_handoff;
+    svr_handoff_init(&game_handoff, &shared->encoder_to_game, &SVR_HANDOFF_FUTEX_BACKEND);
+    svr_handoff_init(&encoder_handoff, &shared->game_to_encoder, &SVR_HANDOFF_FUTEX_BACKEND);
+
+    pid_t encoder_pid = fork();
+
+    if (encoder_pid == 0)
+    {
+        // One more event is received than is answered.
+        test_run_encoder(shared, &encoder_handoff, TEST_PROCESS_ROUNDS, 0);
+        svr_handoff_wait(&encoder_handoff, &shared->game_to_encoder, NULL, NULL);
+
+        _exit(0);
+    }
+
+    int encoder_fd = (int)syscall(SYS_pidfd_open, encoder_pid, 0);
+    TEST_CHECK(encoder_fd >= 0);
+
+    s64 start_time = svr_prof_get_real_time();
+
+    test_run_game(shared, &game_handoff, TEST_PROCESS_ROUNDS, &encoder_fd);
+
+    s64 taken = svr_prof_get_real_time() - start_time;
+
+    TEST_CHECK(shared->num_wrong == 0);
+
+    printf("Processes: %d round trips in %.1f ms (%.2f us each). Game spun %.1f%%\n",
+           TEST_PROCESS_ROUNDS, taken / 1000.0, taken / (double)TEST_PROCESS_ROUNDS, svr_handoff_get_spin_ratio(&game_handoff));
+
+    // This one is not answered.
+    start_time = svr_prof_get_real_time();
+
+    svr_handoff_signal(&game_handoff, &shared->game_to_encoder, NULL);
+    TEST_CHECK(!svr_handoff_wait(&game_handoff, &shared->encoder_to_game, NULL, &encoder_fd));
+
+    taken = svr_prof_get_real_time() - start_time;
+
+    // The futex wakes up every 100 ms to check the encoder, so this must not take much longer than that.
+    TEST_CHECK(taken < 1000000);
+
+    waitpid(encoder_pid, NULL, 0);
+    close(encoder_fd);
+
+    munmap(shared, sizeof(TestShared));
+}
+
+int main()
+{
+    test_threads("Threads", TEST_FAST_ROUNDS, 0);
+    test_threads("Slow answers", TEST_SLOW_ROUNDS, TEST_SLOW_DELAY_US);
+    test_processes();
+
+    if (test_num_failed > 0)
+    {
+        printf("%d checks failed\n", test_num_failed);
+        return 1;
+    }
+
+    printf("All checks passed\n");
+    return 0;
+}
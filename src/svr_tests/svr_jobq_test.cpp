@@ -0,0 +1,434 @@
+#include "svr_jobq.h"
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <mutex>
+#include <atomic>
+
+// Test of svr_jobq, where every worker is a thread and the queue is locked with a mutex like the launcher and the games do.
+// svr_jobq only uses standard C, so this builds and runs anywhere:
+// g++ -Wall -Wextra -pthread -I src/svr_common -I deps/stb src/svr_tests/svr_jobq_test.cpp src/svr_common/svr_jobq.cpp -o svr_jobq_test && ./svr_jobq_test
+
+const s32 TEST_NUM_DEMOS = 40;
+const s32 TEST_JOBS_PER_DEMO = 5;
+const s32 TEST_NUM_WORKERS = 6;
+
+s32 test_num_failed;
+
+#define TEST_CHECK(X) test_check((X), #X, __LINE__)
+
+void test_check(bool value, const char* expr, s32 line)
+{
+    if (!value)
+    {
+        printf("FAILED line %d: %s\n", line, expr);
+        test_num_failed++;
+    }
+}
+
+// The parts of svr_common that svr_jobq needs.
+
+s32 svr_copy_string(const char* source, char* dest, s32 dest_chars)
+{
+    s32 len = (s32)strlen(source);
+    s32 copy = svr_min(len, dest_chars - 1);
+
+    memcpy(dest, source, copy);
+    dest[copy] = 0;
+
+    return copy;
+}
+
+SvrJobq test_queue;
+std::mutex test_mutex;
+
+// How many times every job has been given out.
+std::atomic<s32> test_num_taken[SVR_JOBQ_MAX_JOBS];
+
+// Demos have different lengths so the workers get uneven work and have to steal.
+void test_add_jobs(s32 num_demos)
+{
+    memset(&test_queue, 0, sizeof(SvrJobq));
+
+    for (s32 i = 0; i < SVR_JOBQ_MAX_JOBS; i++)
+    {
+        test_num_taken[i] = 0;
+    }
+
+    for (s32 i = 0; i < num_demos; i++)
+    {
+        for (s32 j = 0; j < TEST_JOBS_PER_DEMO; j++)
+        {
+            char demo[64];
+            char line[128];
+
+            // Added in reverse tick order, the queue has to sort them.
+            s32 start_tick = (TEST_JOBS_PER_DEMO - j) * 1000;
+
+            snprintf(demo, sizeof(demo), "demo_%02d.dem", i);
+            snprintf(line, sizeof(line), "demo %s start %d", demo, start_tick);
+
+            bool added = svr_jobq_add(&test_queue, line, j + 1, demo, start_tick, 100 + (i % 7) * 400);
+            TEST_CHECK(added);
+        }
+    }
+}
+
+// Renders jobs like a game. Returns after crash_after jobs without finishing the last one, or when there are no more jobs.
+void test_run_worker(s32 worker, s32 crash_after)
+{
+    s32 num_taken = 0;
+
+    while (true)
+    {
+        s32 job;
+
+        {
+            std::lock_guard<std::mutex> lock(test_mutex);
+            job = svr_jobq_take(&test_queue, worker);
+        }
+
+        if (job == -1)
+        {
+            break;
+        }
+
+        test_num_taken[job]++;
+        num_taken++;
+
+        // Leaves with the job still running, like a game that crashes.
+        if (num_taken == crash_after)
+        {
+            return;
+        }
+
+        std::this_thread::sleep_for(std::chrono::microseconds(test_queue.jobs[job].cost));
+
+        {
+            std::lock_guard<std::mutex> lock(test_mutex);
+            svr_jobq_finish(&test_queue, worker, job, false, test_queue.jobs[job].cost, 1.0f);
+        }
+    }
+}
+
+// The launcher removes every worker that exits.
+void test_remove_worker(s32 worker)
+{
+    std::lock_guard<std::mutex> lock(test_mutex);
+    svr_jobq_remove_worker(&test_queue, worker);
+}
+
+void test_check_jobs(s32 expected_failed)
+{
+    s32 num_failed = 0;
+
+    for (s32 i = 0; i < test_queue.num_jobs; i++)
+    {
+        SvrJobqJob* job = &test_queue.jobs[i];
+
+        TEST_CHECK(job->state == SVR_JOBQ_JOB_DONE || job->state == SVR_JOBQ_JOB_FAILED);
+        TEST_CHECK(test_num_taken[i] == 1);
+
+        if (job->state == SVR_JOBQ_JOB_FAILED)
+        {
+            num_failed++;
+        }
+
+        else
+        {
+            TEST_CHECK(job->num_frames == job->cost);
+        }
+    }
+
+    TEST_CHECK(num_failed == expected_failed);
+    TEST_CHECK(svr_jobq_is_done(&test_queue));
+}
+
+// Every job is in the range of one worker, the jobs of a demo are all with the same worker, and they are in order of ticks.
+void test_distribute()
+{
+    test_add_jobs(TEST_NUM_DEMOS);
+    svr_jobq_distribute(&test_queue, TEST_NUM_WORKERS);
+
+    TEST_CHECK(test_queue.num_workers == TEST_NUM_WORKERS);
+
+    s32 seen[SVR_JOBQ_MAX_JOBS] = {};
+    s32 pos = 0;
+
+    for (s32 i = 0; i < test_queue.num_workers; i++)
+    {
+        SvrJobqWorker* w = &test_queue.workers[i];
+
+        TEST_CHECK(w->begin == pos);
+        TEST_CHECK(w->end >= w->begin);
+        TEST_CHECK(w->running == -1);
+
+        for (s32 j = w->begin; j < w->end; j++)
+        {
+            seen[test_queue.order[j]]++;
+
+            if (j > w->begin)
+            {
+                SvrJobqJob* prev = &test_queue.jobs[test_queue.order[j - 1]];
+                SvrJobqJob* cur = &test_queue.jobs[test_queue.order[j]];
+
+                s32 res = strcmp(prev->demo, cur->demo);
+                TEST_CHECK(res < 0 || (res == 0 && prev->start_tick < cur->start_tick));
+            }
+        }
+
+        pos = w->end;
+    }
+
+    TEST_CHECK(pos == test_queue.num_jobs);
+
+    for (s32 i = 0; i < test_queue.num_jobs; i++)
+    {
+        TEST_CHECK(seen[i] == 1);
+
+        // Every job of the demo is next to this one in the order, so it belongs to the same worker.
+        for (s32 j = 0; j < test_queue.num_workers; j++)
+        {
+            SvrJobqWorker* w = &test_queue.workers[j];
+            bool has_demo = false;
+            bool has_all = true;
+
+            for (s32 k = 0; k < test_queue.num_jobs; k++)
+            {
+                if (strcmp(test_queue.jobs[k].demo, test_queue.jobs[i].demo))
+                {
+                    continue;
+                }
+
+                bool in_range = false;
+
+                for (s32 l = w->begin; l < w->end; l++)
+                {
+                    in_range |= test_queue.order[l] == k;
+                }
+
+                has_demo |= in_range;
+                has_all &= in_range;
+            }
+
+            TEST_CHECK(!has_demo || has_all);
+        }
+    }
+}
+
+// All workers run at once and steal from each other until every job is done.
+// Whether a steal happens here depends on the timing of the threads, so stealing itself is checked in test_steal.
+void test_threads()
+{
+    test_add_jobs(TEST_NUM_DEMOS);
+    svr_jobq_distribute(&test_queue, TEST_NUM_WORKERS);
+
+    std::thread threads[TEST_NUM_WORKERS];
+
+    for (s32 i = 0; i < TEST_NUM_WORKERS; i++)
+    {
+        threads[i] = std::thread(test_run_worker, i, -1);
+    }
+
+    for (s32 i = 0; i < TEST_NUM_WORKERS; i++)
+    {
+        threads[i].join();
+        test_remove_worker(i);
+    }
+
+    test_check_jobs(0);
+
+    s32 num_done = 0;
+
+    for (s32 i = 0; i < test_queue.num_workers; i++)
+    {
+        num_done += test_queue.workers[i].num_done;
+    }
+
+    TEST_CHECK(num_done == test_queue.num_jobs);
+}
+
+// A worker that has finished its own jobs steals the later half of the work of the worker with the most work left.
+// Done from one thread so the order of the takes is known.
+void test_steal()
+{
+    test_add_jobs(TEST_NUM_DEMOS);
+    svr_jobq_distribute(&test_queue, 3);
+
+    SvrJobqWorker* thief = &test_queue.workers[0];
+
+    // Worker 0 does all of its own jobs before the others start.
+    while (thief->begin < thief->end)
+    {
+        s32 job = svr_jobq_take(&test_queue, 0);
+        test_num_taken[job]++;
+        svr_jobq_finish(&test_queue, 0, job, false, test_queue.jobs[job].cost, 1.0f);
+    }
+
+    TEST_CHECK(thief->num_steals == 0);
+
+    s64 costs[3];
+
+    for (s32 i = 1; i < 3; i++)
+    {
+        SvrJobqWorker* w = &test_queue.workers[i];
+        costs[i] = 0;
+
+        for (s32 j = w->begin; j < w->end; j++)
+        {
+            costs[i] += test_queue.jobs[test_queue.order[j]].cost;
+        }
+    }
+
+    s32 victim_index = costs[1] >= costs[2] ? 1 : 2;
+    SvrJobqWorker* victim = &test_queue.workers[victim_index];
+
+    s32 victim_begin = victim->begin;
+    s32 victim_end = victim->end;
+    s32 victim_first = test_queue.order[victim->begin];
+
+    s32 job = svr_jobq_take(&test_queue, 0);
+    test_num_taken[job]++;
+
+    TEST_CHECK(thief->num_steals == 1);
+    TEST_CHECK(test_queue.jobs[job].stolen);
+    TEST_CHECK(test_queue.jobs[job].worker == 0);
+
+    // The thief has the end of the range of the victim, and the victim keeps its next job and the part before the split.
+    TEST_CHECK(thief->end == victim_end);
+    TEST_CHECK(victim->end == thief->begin - 1);
+    TEST_CHECK(victim->begin == victim_begin);
+    TEST_CHECK(victim->end > victim->begin);
+    TEST_CHECK(test_queue.order[victim->begin] == victim_first);
+    TEST_CHECK(!test_queue.jobs[victim_first].stolen);
+
+    svr_jobq_finish(&test_queue, 0, job, false, test_queue.jobs[job].cost, 1.0f);
+
+    // Then everyone finishes what they have, one at a time.
+    for (s32 i = 0; i < 3; i++)
+    {
+        while (true)
+        {
+            job = svr_jobq_take(&test_queue, i);
+
+            if (job == -1)
+            {
+                break;
+            }
+
+            test_num_taken[job]++;
+            svr_jobq_finish(&test_queue, i, job, false, test_queue.jobs[job].cost, 1.0f);
+        }
+    }
+
+    test_check_jobs(0);
+}
+
+// One worker crashes while the others are still running, so they take over its jobs. Only the job it was on is failed.
+void test_crash()
+{
+    test_add_jobs(TEST_NUM_DEMOS);
+    svr_jobq_distribute(&test_queue, TEST_NUM_WORKERS);
+
+    std::thread threads[TEST_NUM_WORKERS];
+
+    for (s32 i = 0; i < TEST_NUM_WORKERS; i++)
+    {
+        threads[i] = std::thread(test_run_worker, i, i == 0 ? 2 : -1);
+    }
+
+    // The crashed worker is removed as soon as it is gone, like the launcher does.
+    threads[0].join();
+    test_remove_worker(0);
+
+    for (s32 i = 1; i < TEST_NUM_WORKERS; i++)
+    {
+        threads[i].join();
+        test_remove_worker(i);
+    }
+
+    test_check_jobs(1);
+    TEST_CHECK(test_queue.workers[0].gone);
+}
+
+// The last worker that is running crashes with jobs of its own left. Nobody takes them until a new worker is added for them.
+void test_orphaned()
+{
+    test_add_jobs(TEST_NUM_DEMOS);
+    svr_jobq_distribute(&test_queue, 2);
+
+    // Both crash on their first job, one after the other.
+    std::thread first(test_run_worker, 0, 1);
+    first.join();
+    test_remove_worker(0);
+
+    std::thread second(test_run_worker, 1, 1);
+    second.join();
+    test_remove_worker(1);
+
+    TEST_CHECK(!svr_jobq_is_done(&test_queue));
+
+    s32 worker;
+
+    {
+        std::lock_guard<std::mutex> lock(test_mutex);
+        worker = svr_jobq_add_worker(&test_queue);
+    }
+
+    TEST_CHECK(worker == 2);
+
+    std::thread replacement(test_run_worker, worker, -1);
+    replacement.join();
+    test_remove_worker(worker);
+
+    test_check_jobs(2);
+    TEST_CHECK(test_queue.workers[worker].num_done == test_queue.num_jobs - 2);
+}
+
+// Remove a worker before it has taken anything, then all its jobs must be taken over by a worker added afterwards.
+void test_add_worker()
+{
+    test_add_jobs(TEST_NUM_DEMOS);
+    svr_jobq_distribute(&test_queue, 2);
+
+    test_remove_worker(0);
+    test_remove_worker(1);
+
+    TEST_CHECK(!svr_jobq_is_done(&test_queue));
+
+    s32 worker = svr_jobq_add_worker(&test_queue);
+    TEST_CHECK(worker == 2);
+
+    std::thread replacement(test_run_worker, worker, -1);
+    replacement.join();
+    test_remove_worker(worker);
+
+    test_check_jobs(0);
+    TEST_CHECK(test_queue.workers[worker].num_done == test_queue.num_jobs);
+
+    // There is room for a limited number of workers.
+    while (svr_jobq_add_worker(&test_queue) != -1)
+    {
+    }
+
+    TEST_CHECK(test_queue.num_workers == SVR_JOBQ_MAX_WORKERS);
+}
+
+int main()
+{
+    test_distribute();
+    test_threads();
+    test_steal();
+    test_crash();
+    test_orphaned();
+    test_add_worker();
+
+    if (test_num_failed > 0)
+    {
+        printf("%d checks failed\n", test_num_failed);
+        return 1;
+    }
+
+    printf("All checks passed\n");
+    return 0;
+}
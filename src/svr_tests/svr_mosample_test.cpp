@@ -0,0 +1,136 @@
+#include "svr_mosample.h"
+#include <stdio.h>
+#include <math.h>
+
+// Test of the motion blur weights in svr_mosample, with a game that takes the frame lengths one frame late like the engine does
+// with host_framerate. Only standard C is used there, so this builds and runs anywhere:
+// g++ -Wall -Wextra -I src/svr_common -I deps/stb src/svr_tests/svr_mosample_test.cpp src/svr_common/svr_mosample.cpp -o svr_mosample_test && ./svr_mosample_test
+
+const s32 TEST_VIDEO_FPS = 60;
+const s32 TEST_MULT = 60;
+const s32 TEST_NUM_VIDEO_FRAMES = 600;
+
+s32 test_num_failed;
+
+#define TEST_CHECK(X) test_check((X), #X, __LINE__)
+
+void test_check(bool value, const char* expr, s32 line)
+{
+    if (!value)
+    {
+        printf("FAILED line %d: %s\n", line, expr);
+        test_num_failed++;
+    }
+}
+
+struct TestResult
+{
+    s32 num_rendered; // Game frames that were rendered.
+    s64 num_steps; // Game time in frames at the game rate.
+    s32 num_bad_weights; // Video frames with weights that do not add up to 1.
+    s32 num_long_weighted; // Frames longer than one step that were given a weight.
+    s32 num_lost_steps; // Frames where the game and the weights did not agree on where the frame ended.
+};
+
+// Runs the game until the given number of video frames are complete.
+// The game runs every frame with the length that was asked for before the previous frame, like the standalone does it.
+TestResult test_run(float exposure, bool skip_closed)
+{
+    TestResult ret = {};
+
+    SvrMosample m;
+    svr_mosample_start(&m, TEST_VIDEO_FPS, TEST_MULT, exposure, skip_closed);
+
+    s32 host_length = 1; // What host_framerate is set to.
+    s32 running_length = 1; // Length the engine took for the frame that runs now.
+
+    s32 num_video_frames = 0;
+    double sum = 0.0;
+
+    while (num_video_frames < TEST_NUM_VIDEO_FRAMES)
+    {
+        // The engine reads host_framerate, then runs the console commands of the frame.
+        s32 frame_length = running_length;
+        running_length = host_length;
+
+        ret.num_steps += frame_length;
+        ret.num_rendered++;
+
+        SvrMosampleFrame frame = svr_mosample_frame(&m);
+
+        sum += frame.weight;
+
+        if (frame_length > 1 && frame.weight != 0.0f)
+        {
+            ret.num_long_weighted++;
+        }
+
+        // Where the game is in the current video frame must be where the weights think it is.
+        double pos = fmod((double)ret.num_steps / TEST_MULT, 1.0);
+
+        if (fabs(pos - m.remainder) > 0.001 && fabs(pos - m.remainder) < 0.999)
+        {
+            ret.num_lost_steps++;
+        }
+
+        for (s32 i = 0; i < frame.num_finished; i++)
+        {
+            if (fabs(sum - 1.0) > 0.001)
+            {
+                ret.num_bad_weights++;
+            }
+
+            sum = 0.0;
+            num_video_frames++;
+        }
+
+        sum += frame.next_weight;
+
+        host_length = svr_mosample_next_frame_length(&m);
+    }
+
+    return ret;
+}
+
+void test_exposure(float exposure)
+{
+    TestResult full = test_run(exposure, false);
+    TestResult skip = test_run(exposure, true);
+
+    printf("Exposure %0.2f: %d frames rendered instead of %d\n", exposure, skip.num_rendered, full.num_rendered);
+
+    TEST_CHECK(full.num_bad_weights == 0);
+    TEST_CHECK(skip.num_bad_weights == 0);
+    TEST_CHECK(full.num_lost_steps == 0);
+    TEST_CHECK(skip.num_lost_steps == 0);
+    TEST_CHECK(skip.num_long_weighted == 0);
+
+    // Same game time for the same video.
+    TEST_CHECK(skip.num_steps == full.num_steps);
+    TEST_CHECK(full.num_rendered == TEST_NUM_VIDEO_FRAMES * TEST_MULT + 1);
+
+    // Only the open part is rendered, and about one or two frames for every closed part.
+    // The first closed part has one more, since the length of the frame after the first can not be asked for in time.
+    s32 num_open = (s32)(exposure * TEST_MULT);
+    TEST_CHECK(skip.num_rendered <= TEST_NUM_VIDEO_FRAMES * (num_open + 2) + 2);
+}
+
+int main()
+{
+    test_exposure(0.5f);
+    test_exposure(0.25f);
+
+    // Nothing to skip when the shutter is always open.
+    TestResult open = test_run(1.0f, true);
+    TEST_CHECK(open.num_bad_weights == 0);
+    TEST_CHECK(open.num_rendered == TEST_NUM_VIDEO_FRAMES * TEST_MULT + 1);
+
+    if (test_num_failed == 0)
+    {
+        printf("All checks passed\n");
+        return 0;
+    }
+
+    printf("%d checks failed\n", test_num_failed);
+    return 1;
+}
@@ -0,0 +1,420 @@
+#include "svr_pipe.h"
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+// Test of svr_pipe on Linux, which svr_encoder writes the movie through when video_pipe is set.
+// A Y4M stream is written the same way as the IO thread writes the container, in large buffers that end anywhere in a frame,
+// to cat > file as a stand in for an encoder, and to a named pipe. The stream that comes out is read back and every pixel is checked.
+// If ffmpeg is installed, the stream is also given to it to make a NUT file, which is then decoded again and checked.
+// g++ -Wall -Wextra -pthread -I src/svr_common -I deps/stb src/svr_tests/svr_pipe_test.cpp src/svr_common/svr_pipe_posix.cpp deps/stb/stb_sprintf.cpp -o svr_pipe_test && ./svr_pipe_test
+
+const char* TEST_Y4M_PATH = "svr_pipe_test.y4m";
+const char* TEST_NUT_PATH = "svr_pipe_test.nut";
+const char* TEST_FIFO_PATH = "svr_pipe_test.fifo";
+
+const s32 TEST_WIDTH = 320;
+const s32 TEST_HEIGHT = 180;
+const s32 TEST_FPS = 60;
+const s32 TEST_NUM_FRAMES = 120; // More than fits in the pipe, so the writes must wait for the reader.
+
+const s32 TEST_PIPE_SIZE = 4 * 1024 * 1024; // Same as IO_PIPE_SIZE in svr_encoder.
+const s32 TEST_BUFFER_SIZE = 1024 * 1024; // Smaller than IO_BUFFER_SIZE in svr_encoder, so a short movie still takes many writes.
+
+const s32 TEST_FRAME_SIZE = TEST_WIDTH * TEST_HEIGHT * 3 / 2; // YUV420P.
+
+s32 test_num_failed;
+
+#define TEST_CHECK(X) test_check((X), #X, __LINE__)
+
+void test_check(bool value, const char* expr, s32 line)
+{
+    if (!value)
+    {
+        printf("FAILED line %d: %s\n", line, expr);
+        test_num_failed++;
+    }
+}
+
+// Every pixel of every plane is different between frames.
+u8 test_pixel(s32 frame, s32 plane, s32 x, s32 y)
+{
+    return (u8)(x * 3 + y * 5 + frame * 7 + plane * 50);
+}
+
+void test_make_frame(s32 frame, u8* dest)
+{
+    for (s32 plane = 0; plane < 3; plane++)
+    {
+        s32 w = plane == 0 ? TEST_WIDTH : TEST_WIDTH / 2;
+        s32 h = plane == 0 ? TEST_HEIGHT : TEST_HEIGHT / 2;
+
+        for (s32 y = 0; y < h; y++)
+        {
+            for (s32 x = 0; x < w; x++)
+            {
+                *dest = test_pixel(frame, plane, x, y);
+                dest++;
+            }
+        }
+    }
+}
+
+bool test_check_frame(s32 frame, const u8* data)
+{
+    u8* expected = (u8*)malloc(TEST_FRAME_SIZE);
+    test_make_frame(frame, expected);
+
+    bool ret = !memcmp(data, expected, TEST_FRAME_SIZE);
+
+    free(expected);
+    return ret;
+}
+
+// Same header as the yuv4mpegpipe muxer writes for the rawvideo encoder.
+s32 test_make_y4m_header(char* buf, s32 buf_size)
+{
+    return stbsp_snprintf(buf, buf_size, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg XYSCSS=420JPEG\n", TEST_WIDTH, TEST_HEIGHT, TEST_FPS);
+}
+
+// Collects the stream into large buffers that are written to the pipe when full, like the IO thread of svr_encoder.
+struct TestStream
+{
+    SvrPipe* pipe;
+    u8* buffer;
+    s32 fill;
+    bool failed;
+    s32 num_writes;
+};
+
+void test_stream_flush(TestStream* stream)
+{
+    if (stream->fill > 0 && !stream->failed)
+    {
+        if (!svr_pipe_write(stream->pipe, stream->buffer, stream->fill))
+        {
+            stream->failed = true;
+        }
+
+        stream->num_writes++;
+    }
+
+    stream->fill = 0;
+}
+
+void test_stream_append(TestStream* stream, const void* data, s32 size)
+{
+    const u8* pos = (const u8*)data;
+
+    while (size > 0)
+    {
+        s32 part = svr_min(size, TEST_BUFFER_SIZE - stream->fill);
+
+        memcpy(stream->buffer + stream->fill, pos, part);
+        stream->fill += part;
+
+        pos += part;
+        size -= part;
+
+        if (stream->fill == TEST_BUFFER_SIZE)
+        {
+            test_stream_flush(stream);
+        }
+    }
+}
+
+// Returns false if the pipe could not be written to.
+bool test_write_y4m(SvrPipe* pipe, s32* num_writes)
+{
+    TestStream stream = {};
+    stream.pipe = pipe;
+    stream.buffer = (u8*)malloc(TEST_BUFFER_SIZE);
+
+    char header[128];
+    s32 header_size = test_make_y4m_header(header, SVR_ARRAY_SIZE(header));
+    test_stream_append(&stream, header, header_size);
+
+    u8* frame = (u8*)malloc(TEST_FRAME_SIZE);
+
+    for (s32 i = 0; i < TEST_NUM_FRAMES && !stream.failed; i++)
+    {
+        test_make_frame(i, frame);
+
+        test_stream_append(&stream, "FRAME\n", 6);
+        test_stream_append(&stream, frame, TEST_FRAME_SIZE);
+    }
+
+    test_stream_flush(&stream);
+
+    free(frame);
+    free(stream.buffer);
+
+    if (num_writes)
+    {
+        *num_writes = stream.num_writes;
+    }
+
+    return !stream.failed;
+}
+
+u8* test_read_file(const char* path, s64* size)
+{
+    FILE* f = fopen(path, "rb");
+
+    if (f == NULL)
+    {
+        *size = 0;
+        return NULL;
+    }
+
+    fseek(f, 0, SEEK_END);
+    *size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    u8* data = (u8*)malloc(*size + 1);
+    *size = fread(data, 1, *size, f);
+    data[*size] = 0;
+
+    fclose(f);
+    return data;
+}
+
+// Reads back the stream that came out of the pipe and checks the header and every frame.
+void test_check_y4m(const u8* data, s64 size)
+{
+    char header[128];
+    s32 header_size = test_make_y4m_header(header, SVR_ARRAY_SIZE(header));
+
+    TEST_CHECK(size == header_size + (s64)TEST_NUM_FRAMES * (6 + TEST_FRAME_SIZE));
+
+    if (data == NULL || size < 10 || memcmp(data, "YUV4MPEG2 ", 10))
+    {
+        TEST_CHECK(false);
+        return;
+    }
+
+    const u8* header_end = (const u8*)memchr(data, '\n', size);
+    TEST_CHECK(header_end != NULL);
+
+    if (header_end == NULL)
+    {
+        return;
+    }
+
+    s32 width = 0;
+    s32 height = 0;
+    s32 rate_num = 0;
+    s32 rate_den = 0;
+
+    TEST_CHECK(sscanf((const char*)data, "YUV4MPEG2 W%d H%d F%d:%d", &width, &height, &rate_num, &rate_den) == 4);
+    TEST_CHECK(width == TEST_WIDTH && height == TEST_HEIGHT);
+    TEST_CHECK(rate_num == TEST_FPS && rate_den == 1);
+
+    const u8* pos = header_end + 1;
+    const u8* end = data + size;
+    s32 num_frames = 0;
+    s32 num_wrong = 0;
+
+    while (pos + 6 + TEST_FRAME_SIZE <= end)
+    {
+        if (memcmp(pos, "FRAME\n", 6))
+        {
+            num_wrong++;
+            break;
+        }
+
+        if (!test_check_frame(num_frames, pos + 6))
+        {
+            num_wrong++;
+        }
+
+        pos += 6 + TEST_FRAME_SIZE;
+        num_frames++;
+    }
+
+    TEST_CHECK(num_frames == TEST_NUM_FRAMES);
+    TEST_CHECK(num_wrong == 0);
+    TEST_CHECK(pos == end);
+}
+
+// The reader starts late, like an encoder that takes a moment to start, so the writes must wait for it.
+void test_cat()
+{
+    remove(TEST_Y4M_PATH);
+
+    char cmd[256];
+    SVR_SNPRINTF(cmd, "sleep 0.2; cat > %s", TEST_Y4M_PATH);
+
+    SvrPipe pipe;
+    TEST_CHECK(svr_pipe_open(&pipe, cmd, TEST_PIPE_SIZE));
+
+    s32 num_writes = 0;
+    TEST_CHECK(test_write_y4m(&pipe, &num_writes));
+    TEST_CHECK(num_writes > 1);
+
+    // Only once the child has exited is everything in the file.
+    TEST_CHECK(svr_pipe_close(&pipe));
+
+    s64 size;
+    u8* data = test_read_file(TEST_Y4M_PATH, &size);
+
+    test_check_y4m(data, size);
+
+    printf("cat: %d frames (%.1f MB) in %d writes\n", TEST_NUM_FRAMES, size / (1024.0 * 1024.0), num_writes);
+
+    free(data);
+    remove(TEST_Y4M_PATH);
+}
+
+// The other program has made the named pipe and reads from it by itself.
+void test_fifo()
+{
+    remove(TEST_FIFO_PATH);
+    TEST_CHECK(mkfifo(TEST_FIFO_PATH, 0600) == 0);
+
+    u8* data = (u8*)malloc(TEST_FRAME_SIZE * (TEST_NUM_FRAMES + 1));
+    s64 size = 0;
+
+    std::thread reader([&]()
+    {
+        int fd = open(TEST_FIFO_PATH, O_RDONLY);
+
+        if (fd == -1)
+        {
+            return;
+        }
+
+        while (true)
+        {
+            ssize_t num = read(fd, data + size, TEST_FRAME_SIZE);
+
+            if (num <= 0)
+            {
+                break;
+            }
+
+            size += num;
+        }
+
+        close(fd);
+    });
+
+    SvrPipe pipe;
+    TEST_CHECK(svr_pipe_open(&pipe, TEST_FIFO_PATH, TEST_PIPE_SIZE));
+    TEST_CHECK(pipe.process_id == 0);
+
+    TEST_CHECK(test_write_y4m(&pipe, NULL));
+    TEST_CHECK(svr_pipe_close(&pipe));
+
+    reader.join();
+
+    test_check_y4m(data, size);
+
+    free(data);
+    remove(TEST_FIFO_PATH);
+}
+
+// Encoders that fail must be reported when the movie is closed.
+void test_failures()
+{
+    SvrPipe pipe;
+
+    TEST_CHECK(svr_pipe_open(&pipe, "cat > /dev/null; exit 3", TEST_PIPE_SIZE));
+    TEST_CHECK(test_write_y4m(&pipe, NULL));
+    TEST_CHECK(!svr_pipe_close(&pipe));
+    TEST_CHECK(strstr(pipe.message, "code 3") != NULL);
+
+    // The shell starts but the command does not.
+    TEST_CHECK(svr_pipe_open(&pipe, "svr_pipe_test_no_such_command 2> /dev/null", TEST_PIPE_SIZE));
+    TEST_CHECK(!svr_pipe_close(&pipe));
+    TEST_CHECK(strstr(pipe.message, "code 127") != NULL);
+
+    // A reader that stops early must make the writes fail instead of blocking forever or ending the process.
+    TEST_CHECK(svr_pipe_open(&pipe, "head -c 1000 > /dev/null", TEST_PIPE_SIZE));
+    TEST_CHECK(!test_write_y4m(&pipe, NULL));
+    TEST_CHECK(pipe.message[0] != 0);
+    TEST_CHECK(svr_pipe_close(&pipe));
+}
+
+// Like a movie that is given to an ffmpeg of your own, such as video_pipe=ffmpeg -f yuv4mpegpipe -i - out.nut.
+// The frames are decoded from the NUT file again to see that they went through unchanged.
+void test_ffmpeg()
+{
+    if (system("command -v ffmpeg > /dev/null 2>&1") != 0)
+    {
+        printf("ffmpeg: not installed, skipped\n");
+        return;
+    }
+
+    remove(TEST_NUT_PATH);
+
+    char cmd[256];
+    SVR_SNPRINTF(cmd, "ffmpeg -v error -y -f yuv4mpegpipe -i - -c:v rawvideo -f nut %s", TEST_NUT_PATH);
+
+    SvrPipe pipe;
+    TEST_CHECK(svr_pipe_open(&pipe, cmd, TEST_PIPE_SIZE));
+    TEST_CHECK(test_write_y4m(&pipe, NULL));
+    TEST_CHECK(svr_pipe_close(&pipe));
+
+    s64 size;
+    u8* data = test_read_file(TEST_NUT_PATH, &size);
+
+    // Every NUT file starts with this, followed by the main header.
+    const char NUT_MAGIC[] = "nut/multimedia container";
+    TEST_CHECK(data && size > (s64)sizeof(NUT_MAGIC) && !memcmp(data, NUT_MAGIC, sizeof(NUT_MAGIC)));
+
+    free(data);
+
+    SVR_SNPRINTF(cmd, "ffmpeg -v error -i %s -f rawvideo -pix_fmt yuv420p -", TEST_NUT_PATH);
+
+    FILE* f = popen(cmd, "r");
+    TEST_CHECK(f != NULL);
+
+    if (f == NULL)
+    {
+        return;
+    }
+
+    u8* frame = (u8*)malloc(TEST_FRAME_SIZE);
+    s32 num_frames = 0;
+    s32 num_wrong = 0;
+
+    while (fread(frame, 1, TEST_FRAME_SIZE, f) == (size_t)TEST_FRAME_SIZE)
+    {
+        if (!test_check_frame(num_frames, frame))
+        {
+            num_wrong++;
+        }
+
+        num_frames++;
+    }
+
+    TEST_CHECK(pclose(f) == 0);
+    TEST_CHECK(num_frames == TEST_NUM_FRAMES);
+    TEST_CHECK(num_wrong == 0);
+
+    printf("ffmpeg: %d frames through NUT\n", num_frames);
+
+    free(frame);
+    remove(TEST_NUT_PATH);
+}
+
+int main()
+{
+    test_cat();
+    test_fifo();
+    test_failures();
+    test_ffmpeg();
+
+    if (test_num_failed > 0)
+    {
+        printf("%d checks failed\n", test_num_failed);
+        return 1;
+    }
+
+    printf("All checks passed\n");
+    return 0;
+}
@@ -0,0 +1,534 @@
+#include "svr_resample.h"
+#include "svr_alloc.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+// Test and benchmark of svr_resample, with the game audio rates that svr_encoder resamples between.
+// The output is compared to a reference windowed sinc resampler in double precision with a much longer filter, for both the
+// scalar and the AVX2 path. The samples per second are printed, but not checked, as that depends on the processor.
+// g++ -O2 -Wall -Wextra -I src/svr_common -I deps/stb src/svr_tests/svr_resample_test.cpp src/svr_common/svr_resample.cpp -o svr_resample_test && ./svr_resample_test
+
+const s32 TEST_CHANS = 2;
+const s32 TEST_SECONDS = 4;
+const s32 TEST_BENCH_SECONDS = 60;
+const s32 TEST_FPS = 60; // The game gives the audio of one frame at a time.
+
+const s32 TEST_REF_HALF = 256; // Taps on each side of the reference filter.
+const double TEST_REF_BETA = 14.0;
+const double TEST_PI = 3.14159265358979323846;
+
+// Lowest signal to noise ratio in dB against the reference. The 32 taps of svr_resample give a bit over 90 dB for tones up
+// to half of the lower rate, which is about what the 16 bits of the game audio give.
+const double TEST_MIN_SNR = 90.0;
+
+// The scalar and AVX2 paths sum in another order, so they are not the same to the last bit.
+const double TEST_MIN_PATH_SNR = 120.0;
+
+s32 test_num_failed;
+
+#define TEST_CHECK(X) test_check((X), #X, __LINE__)
+
+void test_check(bool value, const char* expr, s32 line)
+{
+    if (!value)
+    {
+        printf("FAILED line %d: %s\n", line, expr);
+        test_num_failed++;
+    }
+}
+
+// The parts of svr_common that svr_resample needs.
+
+void* svr_alloc(s32 size)
+{
+    return malloc(size);
+}
+
+void svr_free(void* addr)
+{
+    free(addr);
+}
+
+void svr_maybe_free(void** addr)
+{
+    if (*addr)
+    {
+        free(*addr);
+        *addr = NULL;
+    }
+}
+
+s64 test_get_time()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (s64)ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+// A few tones in each channel below half of the lower rate, like game audio without the top end.
+s16* test_make_input(s32 rate, s32 num_samples)
+{
+    const double FREQS[TEST_CHANS][4] = {
+        { 440.0, 1250.0, 4100.0, 9300.0 },
+        { 220.0, 2750.0, 6300.0, 10700.0 },
+    };
+
+    s16* input = (s16*)malloc(num_samples * TEST_CHANS * sizeof(s16));
+
+    for (s32 i = 0; i < num_samples; i++)
+    {
+        for (s32 j = 0; j < TEST_CHANS; j++)
+        {
+            double v = 0.0;
+
+            for (s32 k = 0; k < 4; k++)
+            {
+                v += 0.2 * sin(2.0 * TEST_PI * FREQS[j][k] * i / rate + k);
+            }
+
+            input[i * TEST_CHANS + j] = (s16)lrint(v * 32767.0);
+        }
+    }
+
+    return input;
+}
+
+double test_bessel_i0(double x)
+{
+    double sum = 1.0;
+    double term = 1.0;
+
+    for (s32 k = 1; k < 200; k++)
+    {
+        double v = x / (2.0 * k);
+        term *= v * v;
+        sum += term;
+
+        if (term < sum * 1e-17)
+        {
+            break;
+        }
+    }
+
+    return sum;
+}
+
+// Output sample n is at input sample n * input_hz / output_hz, same as svr_resample, with the same cutoff but a much sharper filter.
+double* test_reference_resample(const s16* input, s32 num_samples, s32 chan, s32 input_hz, s32 output_hz, s32 num_output)
+{
+    double cutoff = 0.97 * fmin(1.0, (double)output_hz / (double)input_hz);
+    double beta_i0 = test_bessel_i0(TEST_REF_BETA);
+
+    double* output = (double*)malloc(num_output * sizeof(double));
+
+    for (s32 n = 0; n < num_output; n++)
+    {
+        s64 pos = (s64)n * input_hz / output_hz;
+        double t = (double)((s64)n * input_hz - pos * output_hz) / (double)output_hz + (double)pos;
+
+        double sum = 0.0;
+        double weights = 0.0;
+
+        for (s64 j = pos - TEST_REF_HALF + 1; j <= pos + TEST_REF_HALF; j++)
+        {
+            double x = (double)j - t;
+            double w = x / TEST_REF_HALF;
+
+            if (w < -1.0 || w > 1.0)
+            {
+                continue;
+            }
+
+            double window = test_bessel_i0(TEST_REF_BETA * sqrt(1.0 - w * w)) / beta_i0;
+            double sinc = 1.0;
+
+            if (x != 0.0)
+            {
+                sinc = sin(TEST_PI * cutoff * x) / (TEST_PI * cutoff * x);
+            }
+
+            double weight = sinc * window;
+            weights += weight;
+
+            if (j >= 0 && j < num_samples)
+            {
+                sum += weight * (input[j * TEST_CHANS + chan] / 32768.0);
+            }
+        }
+
+        output[n] = sum / weights;
+    }
+
+    return output;
+}
+
+// The edges are left out as the input starts and ends in silence there.
+double test_snr(const double* ref, const float* v, s32 num)
+{
+    s32 edge = TEST_REF_HALF * 2;
+
+    double signal = 0.0;
+    double noise = 0.0;
+
+    for (s32 i = edge; i < num - edge; i++)
+    {
+        double d = (double)v[i] - ref[i];
+        signal += ref[i] * ref[i];
+        noise += d * d;
+    }
+
+    if (noise == 0.0)
+    {
+        return 1000.0;
+    }
+
+    return 10.0 * log10(signal / noise);
+}
+
+double test_snr_float(const float* a, const float* b, s32 num)
+{
+    double signal = 0.0;
+    double noise = 0.0;
+
+    for (s32 i = 0; i < num; i++)
+    {
+        double d = (double)a[i] - (double)b[i];
+        signal += (double)a[i] * (double)a[i];
+        noise += d * d;
+    }
+
+    if (noise == 0.0)
+    {
+        return 1000.0;
+    }
+
+    return 10.0 * log10(signal / noise);
+}
+
+// Gives the input in pieces of the given size and takes the output in pieces of at most space, then drains.
+// Returns the number of output samples per channel.
+s32 test_run(SvrResampler* rs, const s16* input, s32 num_samples, s32 chunk, s32 space, float** output, s32 output_capacity)
+{
+    s32 num_output = 0;
+    s32 pos = 0;
+
+    svr_resample_reset(rs);
+
+    while (pos < num_samples)
+    {
+        s32 num = chunk;
+
+        if (pos + num > num_samples)
+        {
+            num = num_samples - pos;
+        }
+
+        const s16* src = input + pos * TEST_CHANS;
+        s32 src_num = num;
+
+        while (true)
+        {
+            s32 room = output_capacity - num_output;
+
+            if (room > space)
+            {
+                room = space;
+            }
+
+            u8* dest[TEST_CHANS];
+
+            for (s32 i = 0; i < TEST_CHANS; i++)
+            {
+                dest[i] = (u8*)(output[i] + num_output);
+            }
+
+            s32 written = svr_resample_process(rs, dest, room, src, src_num);
+            num_output += written;
+
+            src = NULL;
+            src_num = 0;
+
+            if (written < room || room == 0)
+            {
+                break;
+            }
+        }
+
+        pos += num;
+    }
+
+    while (true)
+    {
+        s32 room = output_capacity - num_output;
+
+        if (room > space)
+        {
+            room = space;
+        }
+
+        u8* dest[TEST_CHANS];
+
+        for (s32 i = 0; i < TEST_CHANS; i++)
+        {
+            dest[i] = (u8*)(output[i] + num_output);
+        }
+
+        s32 written = svr_resample_drain(rs, dest, room);
+        num_output += written;
+
+        if (written < room || room == 0)
+        {
+            break;
+        }
+    }
+
+    return num_output;
+}
+
+void test_rates(s32 input_hz, s32 output_hz, bool has_avx2)
+{
+    s32 num_samples = input_hz * TEST_SECONDS;
+    s32 expected = (s32)(((s64)num_samples * output_hz + input_hz - 1) / input_hz);
+    s32 capacity = expected + 64;
+
+    s16* input = test_make_input(input_hz, num_samples);
+
+    float* scalar[TEST_CHANS];
+    float* avx2[TEST_CHANS];
+    float* pieces[TEST_CHANS];
+
+    for (s32 i = 0; i < TEST_CHANS; i++)
+    {
+        scalar[i] = (float*)calloc(capacity, sizeof(float));
+        avx2[i] = (float*)calloc(capacity, sizeof(float));
+        pieces[i] = (float*)calloc(capacity, sizeof(float));
+    }
+
+    TEST_CHECK(svr_resample_is_supported(TEST_CHANS, input_hz, output_hz));
+
+    SvrResampler rs = {};
+    svr_resample_init(&rs, SVR_RESAMPLE_FLTP, TEST_CHANS, input_hz, output_hz);
+
+    // Everything in one go.
+    rs.use_avx2 = false;
+    s32 num_scalar = test_run(&rs, input, num_samples, num_samples, capacity, scalar, capacity);
+
+    // The first output sample is in line with the first input and the last with the last input.
+    TEST_CHECK(num_scalar == expected);
+
+    for (s32 i = 0; i < TEST_CHANS; i++)
+    {
+        double* ref = test_reference_resample(input, num_samples, i, input_hz, output_hz, num_scalar);
+        double snr = test_snr(ref, scalar[i], num_scalar);
+
+        printf("%d to %d hz, channel %d: scalar %.1f dB", input_hz, output_hz, i, snr);
+        TEST_CHECK(snr >= TEST_MIN_SNR);
+
+        if (has_avx2)
+        {
+            rs.use_avx2 = true;
+            s32 num_avx2 = test_run(&rs, input, num_samples, num_samples, capacity, avx2, capacity);
+            TEST_CHECK(num_avx2 == num_scalar);
+
+            double avx2_snr = test_snr(ref, avx2[i], num_scalar);
+            double path_snr = test_snr_float(scalar[i], avx2[i], num_scalar);
+
+            printf(", AVX2 %.1f dB, AVX2 to scalar %.1f dB", avx2_snr, path_snr);
+            TEST_CHECK(avx2_snr >= TEST_MIN_SNR);
+            TEST_CHECK(path_snr >= TEST_MIN_PATH_SNR);
+        }
+
+        printf("\n");
+
+        free(ref);
+    }
+
+    // Frames of game audio with little room in the output must give the same samples.
+    rs.use_avx2 = false;
+    s32 num_pieces = test_run(&rs, input, num_samples, input_hz / TEST_FPS, 100, pieces, capacity);
+    TEST_CHECK(num_pieces == num_scalar);
+
+    for (s32 i = 0; i < TEST_CHANS; i++)
+    {
+        TEST_CHECK(!memcmp(pieces[i], scalar[i], num_scalar * sizeof(float)));
+    }
+
+    svr_resample_free(&rs);
+
+    for (s32 i = 0; i < TEST_CHANS; i++)
+    {
+        free(scalar[i]);
+        free(avx2[i]);
+        free(pieces[i]);
+    }
+
+    free(input);
+}
+
+// Same rate, where the samples are only converted. The AVX2 path must give the same values as the scalar path.
+void test_convert(bool has_avx2)
+{
+    const s32 NUM = 1001; // Not a multiple of the vector size so the scalar tail is used too.
+
+    s16* input = test_make_input(48000, NUM);
+
+    // Full range values too.
+    input[0] = -32768;
+    input[1] = 32767;
+
+    SvrResampleFormat formats[] = { SVR_RESAMPLE_S16, SVR_RESAMPLE_S16P, SVR_RESAMPLE_FLT, SVR_RESAMPLE_FLTP };
+
+    for (s32 f = 0; f < SVR_ARRAY_SIZE(formats); f++)
+    {
+        SvrResampler rs = {};
+        svr_resample_init(&rs, formats[f], TEST_CHANS, 48000, 48000);
+
+        // Room for the interleaved formats too.
+        u8* scalar_dest[TEST_CHANS];
+        u8* avx2_dest[TEST_CHANS];
+
+        for (s32 i = 0; i < TEST_CHANS; i++)
+        {
+            scalar_dest[i] = (u8*)calloc(NUM * TEST_CHANS, sizeof(float));
+            avx2_dest[i] = (u8*)calloc(NUM * TEST_CHANS, sizeof(float));
+        }
+
+        rs.use_avx2 = false;
+        svr_resample_convert(&rs, scalar_dest, input, NUM);
+
+        if (has_avx2)
+        {
+            rs.use_avx2 = true;
+            svr_resample_convert(&rs, avx2_dest, input, NUM);
+
+            for (s32 i = 0; i < TEST_CHANS; i++)
+            {
+                TEST_CHECK(!memcmp(scalar_dest[i], avx2_dest[i], NUM * TEST_CHANS * sizeof(float)));
+            }
+        }
+
+        s16* s16_l = (s16*)scalar_dest[0];
+        s16* s16_r = (s16*)scalar_dest[1];
+        float* flt_l = (float*)scalar_dest[0];
+        float* flt_r = (float*)scalar_dest[1];
+
+        // Check a few values of every layout.
+        switch (formats[f])
+        {
+            case SVR_RESAMPLE_S16:
+            {
+                TEST_CHECK(!memcmp(s16_l, input, NUM * TEST_CHANS * sizeof(s16)));
+                break;
+            }
+
+            case SVR_RESAMPLE_S16P:
+            {
+                TEST_CHECK(s16_l[0] == -32768);
+                TEST_CHECK(s16_r[0] == 32767);
+                TEST_CHECK(s16_r[NUM - 1] == input[NUM * 2 - 1]);
+                break;
+            }
+
+            case SVR_RESAMPLE_FLT:
+            {
+                TEST_CHECK(flt_l[0] == -1.0f);
+                TEST_CHECK(flt_l[NUM * 2 - 1] == input[NUM * 2 - 1] / 32768.0f);
+                break;
+            }
+
+            case SVR_RESAMPLE_FLTP:
+            {
+                TEST_CHECK(flt_l[0] == -1.0f);
+                TEST_CHECK(flt_r[0] == 32767.0f / 32768.0f);
+                TEST_CHECK(flt_r[NUM - 1] == input[NUM * 2 - 1] / 32768.0f);
+                break;
+            }
+        }
+
+        svr_resample_free(&rs);
+
+        for (s32 i = 0; i < TEST_CHANS; i++)
+        {
+            free(scalar_dest[i]);
+            free(avx2_dest[i]);
+        }
+    }
+
+    free(input);
+}
+
+// Resampling of one minute of game audio in the pieces of one frame, to the float planar format that AAC and Opus take.
+void test_bench(s32 input_hz, s32 output_hz, bool use_avx2)
+{
+    s32 chunk = input_hz / TEST_FPS;
+    s32 num_samples = input_hz * TEST_BENCH_SECONDS;
+    s32 capacity = chunk * 2 + SVR_RESAMPLE_TAPS;
+
+    s16* input = test_make_input(input_hz, num_samples);
+
+    float* output[TEST_CHANS];
+
+    for (s32 i = 0; i < TEST_CHANS; i++)
+    {
+        output[i] = (float*)malloc(capacity * sizeof(float));
+    }
+
+    SvrResampler rs = {};
+    svr_resample_init(&rs, SVR_RESAMPLE_FLTP, TEST_CHANS, input_hz, output_hz);
+    rs.use_avx2 = use_avx2;
+
+    s64 start_time = test_get_time();
+
+    for (s32 pos = 0; pos + chunk <= num_samples; pos += chunk)
+    {
+        svr_resample_process(&rs, (u8**)output, capacity, input + pos * TEST_CHANS, chunk);
+    }
+
+    s64 taken = test_get_time() - start_time;
+    double secs = (taken > 0 ? taken : 1) / 1000000.0;
+
+    printf("%d to %d hz, %s: %.1f million samples per second, %.0f times realtime\n",
+           input_hz, output_hz, use_avx2 ? "AVX2" : "scalar", num_samples / secs / 1000000.0, TEST_BENCH_SECONDS / secs);
+
+    svr_resample_free(&rs);
+
+    for (s32 i = 0; i < TEST_CHANS; i++)
+    {
+        free(output[i]);
+    }
+
+    free(input);
+}
+
+int main()
+{
+    bool has_avx2 = svr_resample_has_avx2();
+
+    if (!has_avx2)
+    {
+        printf("No AVX2, only the scalar path is tested\n");
+    }
+
+    test_rates(44100, 48000, has_avx2);
+    test_rates(48000, 44100, has_avx2);
+    test_convert(has_avx2);
+
+    test_bench(44100, 48000, false);
+
+    if (has_avx2)
+    {
+        test_bench(44100, 48000, true);
+    }
+
+    if (test_num_failed > 0)
+    {
+        printf("%d checks failed\n", test_num_failed);
+        return 1;
+    }
+
+    printf("All checks passed\n");
+    return 0;
+}
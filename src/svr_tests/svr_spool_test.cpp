@@ -0,0 +1,506 @@
+#include "svr_spool.h"
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+
+// Test of svr_spool, which writes a spool file in the same way as svr_encoder and reads it back in chunks on several threads,
+// like svr_encoder --from-spool does. The sink here checks the frames and samples instead of encoding them.
+// svr_spool only uses standard C, so this builds and runs anywhere:
+// g++ -Wall -Wextra -pthread -I src/svr_common -I deps/stb src/svr_tests/svr_spool_test.cpp src/svr_common/svr_spool.cpp deps/stb/stb_sprintf.cpp -o svr_spool_test && ./svr_spool_test
+
+const char* TEST_SPOOL_PATH = "svr_spool_test.svrspool";
+
+const s32 TEST_NUM_FRAMES = 250;
+const s32 TEST_WIDTH = 40;
+const s32 TEST_HEIGHT = 16;
+const s32 TEST_STRIDE_PADDING = 24; // Encoders want their rows aligned, so the frames are wider than the spool rows.
+
+s32 test_num_failed;
+
+#define TEST_CHECK(X) test_check((X), #X, __LINE__)
+
+void test_check(bool value, const char* expr, s32 line)
+{
+    if (!value)
+    {
+        printf("FAILED line %d: %s\n", line, expr);
+        test_num_failed++;
+    }
+}
+
+// The parts of svr_common that svr_spool needs.
+
+void* svr_alloc(s32 size)
+{
+    return malloc(size);
+}
+
+void* svr_zalloc(s32 size)
+{
+    return calloc(1, size);
+}
+
+void* svr_realloc(void* p, s32 size)
+{
+    return realloc(p, size);
+}
+
+void svr_free(void* addr)
+{
+    free(addr);
+}
+
+void svr_maybe_free(void** addr)
+{
+    if (*addr)
+    {
+        free(*addr);
+        *addr = NULL;
+    }
+}
+
+s32 svr_copy_string(const char* source, char* dest, s32 dest_chars)
+{
+    s32 len = (s32)strlen(source);
+    s32 copy = svr_min(len, dest_chars - 1);
+
+    memcpy(dest, source, copy);
+    dest[copy] = 0;
+
+    return copy;
+}
+
+// Contents of the frames and samples, so the reader can tell if it got the right ones.
+
+u8 test_pixel(s32 frame, s32 plane, s32 row, s32 col)
+{
+    return (u8)(frame * 7 + plane * 31 + row * 3 + col);
+}
+
+s16 test_sample(s32 index)
+{
+    return (s16)(index * 13);
+}
+
+// Audio comes in varying amounts between the frames, like from the game.
+s32 test_num_samples_after_frame(s32 frame)
+{
+    return 700 + (frame % 5) * 10;
+}
+
+// Writes a spool in the same way as svr_encoder, with yuv420p planes.
+// Returns the header that was written.
+SvrSpoolHeader test_write_spool(bool use_audio, bool finish)
+{
+    SvrSpoolHeader header = {};
+    memcpy(header.magic, SVR_SPOOL_MAGIC, sizeof(SVR_SPOOL_MAGIC));
+    header.version = SVR_SPOOL_VERSION;
+    header.num_planes = 3;
+    header.plane_row_sizes[0] = TEST_WIDTH;
+    header.plane_row_sizes[1] = TEST_WIDTH / 2;
+    header.plane_row_sizes[2] = TEST_WIDTH / 2;
+    header.plane_heights[0] = TEST_HEIGHT;
+    header.plane_heights[1] = TEST_HEIGHT / 2;
+    header.plane_heights[2] = TEST_HEIGHT / 2;
+    header.movie_params.use_audio = use_audio;
+    header.movie_params.audio_channels = 2;
+
+    SVR_COPY_STRING("movie.mp4", header.movie_params.dest_file);
+
+    SvrSpoolRecord* records = (SvrSpoolRecord*)calloc(TEST_NUM_FRAMES * 2, sizeof(SvrSpoolRecord));
+    s32 num_records = 0;
+    s32 sample_pos = 0;
+
+    FILE* file = fopen(TEST_SPOOL_PATH, "wb");
+    fwrite(&header, sizeof(SvrSpoolHeader), 1, file);
+
+    for (s32 i = 0; i < TEST_NUM_FRAMES; i++)
+    {
+        SvrSpoolRecord* record = &records[num_records++];
+        record->type = SVR_SPOOL_RECORD_VIDEO;
+        record->offset = ftell(file);
+
+        for (s32 p = 0; p < header.num_planes; p++)
+        {
+            for (s32 y = 0; y < header.plane_heights[p]; y++)
+            {
+                for (s32 x = 0; x < header.plane_row_sizes[p]; x++)
+                {
+                    fputc(test_pixel(i, p, y, x), file);
+                }
+            }
+
+            record->size += header.plane_row_sizes[p] * header.plane_heights[p];
+        }
+
+        if (use_audio)
+        {
+            s32 num_samples = test_num_samples_after_frame(i);
+
+            record = &records[num_records++];
+            record->type = SVR_SPOOL_RECORD_AUDIO;
+            record->num_samples = num_samples;
+            record->offset = ftell(file);
+            record->size = num_samples * 2 * sizeof(s16);
+
+            for (s32 j = 0; j < num_samples; j++)
+            {
+                s16 sample[2] = { test_sample(sample_pos + j), (s16)-test_sample(sample_pos + j) };
+                fwrite(sample, sizeof(sample), 1, file);
+            }
+
+            sample_pos += num_samples;
+        }
+    }
+
+    header.num_records = num_records;
+    header.num_video_frames = TEST_NUM_FRAMES;
+
+    if (finish)
+    {
+        header.index_offset = ftell(file);
+        fwrite(records, sizeof(SvrSpoolRecord), num_records, file);
+    }
+
+    fseek(file, 0, SEEK_SET);
+    fwrite(&header, sizeof(SvrSpoolHeader), 1, file);
+
+    fclose(file);
+    free(records);
+
+    return header;
+}
+
+// Checks everything that a chunk gets, and can stop the chunk like a failed encoder would.
+struct TestSink
+{
+    SvrSpool* spool;
+    SvrSpoolChunk* chunk;
+
+    u8* planes[SVR_SPOOL_MAX_PLANES];
+    s32 strides[SVR_SPOOL_MAX_PLANES];
+
+    s32 num_frames;
+    s64 next_pts;
+    s32 num_bad_frames;
+
+    s32 num_samples;
+    s32 num_bad_samples;
+
+    s32 stop_after_frames; // Or -1 to not stop.
+};
+
+bool test_get_video_frame(void* user, u8** planes, s32* strides)
+{
+    TestSink* sink = (TestSink*)user;
+
+    for (s32 i = 0; i < sink->spool->header.num_planes; i++)
+    {
+        // Write something that is not the frame, so frames that are not read are noticed.
+        memset(sink->planes[i], 0xcd, sink->strides[i] * sink->spool->header.plane_heights[i]);
+
+        planes[i] = sink->planes[i];
+        strides[i] = sink->strides[i];
+    }
+
+    return true;
+}
+
+bool test_submit_video_frame(void* user, s64 pts)
+{
+    TestSink* sink = (TestSink*)user;
+    SvrSpoolHeader* header = &sink->spool->header;
+
+    bool ok = pts == sink->next_pts;
+
+    for (s32 p = 0; p < header->num_planes; p++)
+    {
+        for (s32 y = 0; y < header->plane_heights[p]; y++)
+        {
+            u8* row = sink->planes[p] + y * sink->strides[p];
+
+            for (s32 x = 0; x < header->plane_row_sizes[p]; x++)
+            {
+                ok &= row[x] == test_pixel((s32)pts, p, y, x);
+            }
+        }
+    }
+
+    if (!ok)
+    {
+        sink->num_bad_frames++;
+    }
+
+    sink->next_pts = pts + 1;
+    sink->num_frames++;
+
+    return sink->stop_after_frames == -1 || sink->num_frames < sink->stop_after_frames;
+}
+
+bool test_submit_audio_samples(void* user, void* samples, s32 num_samples)
+{
+    TestSink* sink = (TestSink*)user;
+    s16* values = (s16*)samples;
+
+    for (s32 i = 0; i < num_samples; i++)
+    {
+        s16 expected = test_sample(sink->num_samples + i);
+
+        if (values[i * 2] != expected || values[i * 2 + 1] != (s16)-expected)
+        {
+            sink->num_bad_samples++;
+        }
+    }
+
+    sink->num_samples += num_samples;
+
+    return true;
+}
+
+void test_init_sink(TestSink* test_sink, SvrSpool* spool, SvrSpoolChunk* chunk, SvrSpoolSink* sink)
+{
+    *test_sink = {};
+    test_sink->spool = spool;
+    test_sink->chunk = chunk;
+    test_sink->next_pts = chunk->first_frame;
+    test_sink->stop_after_frames = -1;
+
+    for (s32 i = 0; i < spool->header.num_planes; i++)
+    {
+        test_sink->strides[i] = spool->header.plane_row_sizes[i] + TEST_STRIDE_PADDING;
+        test_sink->planes[i] = (u8*)malloc(test_sink->strides[i] * spool->header.plane_heights[i]);
+    }
+
+    *sink = {};
+    sink->user = test_sink;
+    sink->get_video_frame = test_get_video_frame;
+    sink->submit_video_frame = test_submit_video_frame;
+    sink->submit_audio_samples = test_submit_audio_samples;
+}
+
+void test_free_sink(TestSink* test_sink)
+{
+    for (s32 i = 0; i < SVR_SPOOL_MAX_PLANES; i++)
+    {
+        free(test_sink->planes[i]);
+    }
+}
+
+s32 test_total_samples()
+{
+    s32 ret = 0;
+
+    for (s32 i = 0; i < TEST_NUM_FRAMES; i++)
+    {
+        ret += test_num_samples_after_frame(i);
+    }
+
+    return ret;
+}
+
+void test_open()
+{
+    SvrSpoolHeader header = test_write_spool(true, true);
+
+    SvrSpool spool;
+    TEST_CHECK(svr_spool_open(TEST_SPOOL_PATH, &spool));
+
+    TEST_CHECK(spool.header.num_video_frames == TEST_NUM_FRAMES);
+    TEST_CHECK(spool.header.num_records == header.num_records);
+    TEST_CHECK(spool.header.num_planes == 3);
+    TEST_CHECK(!strcmp(spool.header.movie_params.dest_file, "movie.mp4"));
+    TEST_CHECK(spool.records[0].type == SVR_SPOOL_RECORD_VIDEO);
+    TEST_CHECK(spool.records[0].offset == sizeof(SvrSpoolHeader));
+    TEST_CHECK(spool.records[1].type == SVR_SPOOL_RECORD_AUDIO);
+    TEST_CHECK(spool.records[1].num_samples == test_num_samples_after_frame(0));
+
+    svr_spool_close(&spool);
+}
+
+// Spools that cannot be used must not be encoded.
+void test_bad_spools()
+{
+    SvrSpool spool;
+
+    remove(TEST_SPOOL_PATH);
+    TEST_CHECK(!svr_spool_open(TEST_SPOOL_PATH, &spool));
+    TEST_CHECK(spool.message[0] != 0);
+
+    // The game crashed before the spool was finished.
+    test_write_spool(true, false);
+    TEST_CHECK(!svr_spool_open(TEST_SPOOL_PATH, &spool));
+    TEST_CHECK(strstr(spool.message, "not finished") != NULL);
+
+    // Not a spool.
+    FILE* file = fopen(TEST_SPOOL_PATH, "r+b");
+    fwrite("HL2DEMO", 1, 8, file);
+    fclose(file);
+
+    TEST_CHECK(!svr_spool_open(TEST_SPOOL_PATH, &spool));
+    TEST_CHECK(strstr(spool.message, "not a spool file") != NULL);
+
+    // Too small for a header.
+    file = fopen(TEST_SPOOL_PATH, "wb");
+    fwrite(SVR_SPOOL_MAGIC, 1, sizeof(SVR_SPOOL_MAGIC), file);
+    fclose(file);
+
+    TEST_CHECK(!svr_spool_open(TEST_SPOOL_PATH, &spool));
+    TEST_CHECK(strstr(spool.message, "too small") != NULL);
+}
+
+void test_plan_chunks()
+{
+    test_write_spool(true, true);
+
+    SvrSpool spool;
+    TEST_CHECK(svr_spool_open(TEST_SPOOL_PATH, &spool));
+
+    SvrSpoolChunk chunks[SVR_SPOOL_MAX_CHUNKS];
+
+    // Every frame is in one chunk, in order.
+    s32 wanted[] = { 1, 2, 3, 4, 100, 0, -1 };
+
+    for (s32 w = 0; w < SVR_ARRAY_SIZE(wanted); w++)
+    {
+        s32 num_chunks = svr_spool_plan_chunks(&spool, wanted[w], chunks);
+
+        TEST_CHECK(num_chunks >= 1);
+        TEST_CHECK(num_chunks <= svr_max(wanted[w], 1));
+
+        s32 next_frame = 0;
+
+        for (s32 i = 0; i < num_chunks; i++)
+        {
+            TEST_CHECK(chunks[i].index == i);
+            TEST_CHECK(chunks[i].first_frame == next_frame);
+            TEST_CHECK(chunks[i].num_frames > 0);
+            TEST_CHECK(chunks[i].use_audio == (i == 0));
+
+            next_frame += chunks[i].num_frames;
+        }
+
+        TEST_CHECK(next_frame == TEST_NUM_FRAMES);
+    }
+
+    // Not smaller than SVR_SPOOL_MIN_CHUNK_FRAMES.
+    TEST_CHECK(svr_spool_plan_chunks(&spool, 100, chunks) == TEST_NUM_FRAMES / SVR_SPOOL_MIN_CHUNK_FRAMES);
+
+    // Rounding the chunk size up to 84 leaves the third chunk with the rest.
+    TEST_CHECK(svr_spool_plan_chunks(&spool, 3, chunks) == 3);
+    TEST_CHECK(chunks[0].num_frames == 84 && chunks[2].num_frames == 82);
+
+    svr_spool_close(&spool);
+}
+
+// All chunks at once on their own threads, like svr_encoder --from-spool.
+void test_run_chunks(bool use_audio)
+{
+    test_write_spool(use_audio, true);
+
+    SvrSpool spool;
+    TEST_CHECK(svr_spool_open(TEST_SPOOL_PATH, &spool));
+
+    SvrSpoolChunk chunks[SVR_SPOOL_MAX_CHUNKS];
+    s32 num_chunks = svr_spool_plan_chunks(&spool, 4, chunks);
+
+    TestSink test_sinks[SVR_SPOOL_MAX_CHUNKS];
+    SvrSpoolSink sinks[SVR_SPOOL_MAX_CHUNKS];
+    bool results[SVR_SPOOL_MAX_CHUNKS];
+    std::thread threads[SVR_SPOOL_MAX_CHUNKS];
+
+    for (s32 i = 0; i < num_chunks; i++)
+    {
+        test_init_sink(&test_sinks[i], &spool, &chunks[i], &sinks[i]);
+
+        threads[i] = std::thread([&, i]()
+        {
+            results[i] = svr_spool_run_chunk(&spool, &chunks[i], &sinks[i]);
+        });
+    }
+
+    for (s32 i = 0; i < num_chunks; i++)
+    {
+        threads[i].join();
+    }
+
+    s32 num_frames = 0;
+
+    for (s32 i = 0; i < num_chunks; i++)
+    {
+        TestSink* sink = &test_sinks[i];
+
+        TEST_CHECK(results[i]);
+        TEST_CHECK(sink->num_frames == chunks[i].num_frames);
+        TEST_CHECK(sink->num_bad_frames == 0);
+        TEST_CHECK(sink->num_bad_samples == 0);
+
+        // Only the first chunk has the audio, and all of it.
+        TEST_CHECK(sink->num_samples == ((use_audio && i == 0) ? test_total_samples() : 0));
+
+        num_frames += sink->num_frames;
+
+        test_free_sink(sink);
+    }
+
+    TEST_CHECK(num_frames == TEST_NUM_FRAMES);
+
+    svr_spool_close(&spool);
+}
+
+// A failed encoder stops its chunk.
+void test_stop_chunk()
+{
+    test_write_spool(true, true);
+
+    SvrSpool spool;
+    TEST_CHECK(svr_spool_open(TEST_SPOOL_PATH, &spool));
+
+    SvrSpoolChunk chunks[SVR_SPOOL_MAX_CHUNKS];
+    svr_spool_plan_chunks(&spool, 2, chunks);
+
+    TestSink test_sink;
+    SvrSpoolSink sink;
+    test_init_sink(&test_sink, &spool, &chunks[1], &sink);
+    test_sink.stop_after_frames = 10;
+
+    TEST_CHECK(!svr_spool_run_chunk(&spool, &chunks[1], &sink));
+    TEST_CHECK(test_sink.num_frames == 10);
+    TEST_CHECK(test_sink.num_bad_frames == 0);
+    TEST_CHECK(chunks[1].message[0] == 0); // The sink knows why.
+
+    test_free_sink(&test_sink);
+
+    // The spool is cut off after it was opened.
+    FILE* file = fopen(TEST_SPOOL_PATH, "wb");
+    fclose(file);
+
+    test_init_sink(&test_sink, &spool, &chunks[0], &sink);
+
+    TEST_CHECK(!svr_spool_run_chunk(&spool, &chunks[0], &sink));
+    TEST_CHECK(chunks[0].message[0] != 0);
+
+    test_free_sink(&test_sink);
+
+    svr_spool_close(&spool);
+}
+
+int main()
+{
+    test_open();
+    test_bad_spools();
+    test_plan_chunks();
+    test_run_chunks(true);
+    test_run_chunks(false);
+    test_stop_chunk();
+
+    remove(TEST_SPOOL_PATH);
+
+    if (test_num_failed > 0)
+    {
+        printf("%d checks failed\n", test_num_failed);
+        return 1;
+    }
+
+    printf("All checks passed\n");
+    return 0;
+}